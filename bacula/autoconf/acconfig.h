@@ -111,6 +111,12 @@
 /* Define if you have lzo lib */
 #undef HAVE_LZO
 
+/* Define if you have zstd lib */
+#undef HAVE_ZSTD
+
+/* Define if you have lz4 lib */
+#undef HAVE_LZ4
+
 /* Define if you have libacl */
 #undef HAVE_ACL
 
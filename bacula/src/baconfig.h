@@ -218,6 +218,29 @@ void InitWinAPIWrapper();
 /* Size of crypto length stored at head of crypto buffer. Do NOT change! */
 #define CRYPTO_LEN_SIZE ((int)sizeof(uint32_t))
 
+/**
+ * Binary accurate file list sent by the Director to the File daemon
+ *  (accurate format=1).  Each message is a block:
+ *    uint8   ACC_BLOCK_RAW or ACC_BLOCK_ZLIB
+ *    uint32  length of the records once uncompressed (ACC_BLOCK_ZLIB)
+ *    records
+ *  and each record:
+ *    uint8   ACC_REC_xxx flags
+ *    string  path, if ACC_REC_PATH (always set in the first record)
+ *    string  file name
+ *    uint8   number of lstat fields, followed by each as svarint
+ *    varint  delta sequence
+ *    uint8   digest length and digest, if ACC_REC_DIGEST(_TEXT)
+ *  Do NOT change!
+ */
+#define ACC_BLOCK_RAW        0
+#define ACC_BLOCK_ZLIB       1
+#define ACC_BLOCK_SIZE       (64 * 1024)       /* records per block */
+#define ACC_BLOCK_MAX_SIZE   (4 * 1024 * 1024) /* refused above */
+#define ACC_REC_PATH         0x01     /* new path */
+#define ACC_REC_DIGEST       0x02     /* binary digest */
+#define ACC_REC_DIGEST_TEXT  0x04     /* base64 digest, as in the catalog */
+
 
 /**
  * This is for dumb compilers/libraries like Solaris. Linux GCC
@@ -19,15 +19,25 @@
 /*
  * Number of insert statements to batch-up in batch insert
  * mode. We use multi-row inserts only in the batch mode
- * on the private database connection.
+ * on the private database connection. The number starts at
+ * MYSQL_CHANGES_PER_BATCH_INSERT and is tuned between the
+ * MIN and MAX values, the query being also flushed when it
+ * reaches MYSQL_MAX_BATCH_INSERT_SIZE bytes (max_allowed_packet
+ * is 1MB by default on old servers).
  */
 #define MYSQL_CHANGES_PER_BATCH_INSERT 32
+#define MYSQL_MIN_CHANGES_PER_BATCH_INSERT 8
+#define MYSQL_MAX_CHANGES_PER_BATCH_INSERT 2048
+#define MYSQL_MAX_BATCH_INSERT_SIZE (512 * 1024)
 
 class B_DB_MYSQL: public B_DB_PRIV {
 private:
    MYSQL *m_db_handle;
    MYSQL m_instance;
    MYSQL_RES *m_result;
+   int m_batch_len;             /* length of the batch insert in cmd */
+
+   bool sql_batch_flush();
 
 public:
    B_DB_MYSQL(JCR *jcr, const char *db_driver, const char *db_name,
@@ -16,6 +16,15 @@
 #ifndef __BDB_SQLITE_H_
 #define __BDB_SQLITE_H_ 1
 
+/*
+ * Number of rows inserted per transaction in batch insert
+ * mode. The number starts at SQLITE_CHANGES_PER_BATCH_INSERT
+ * and is tuned between the MIN and MAX values.
+ */
+#define SQLITE_CHANGES_PER_BATCH_INSERT 1000
+#define SQLITE_MIN_CHANGES_PER_BATCH_INSERT 100
+#define SQLITE_MAX_CHANGES_PER_BATCH_INSERT 100000
+
 class B_DB_SQLITE: public B_DB_PRIV {
 private:
    struct sqlite3 *m_db_handle;
@@ -23,6 +32,11 @@ private:
    char **m_col_names;          /* used to access fields when using db_sql_query() */
    char *m_sqlite_errmsg;
    SQL_FIELD m_sql_field;       /* used when using db_sql_query() and sql_fetch_field() */
+   struct sqlite3_stmt *m_batch_stmt; /* batch insert statement */
+   btime_t m_batch_begin;       /* start of the batch insert transaction */
+
+   bool sql_batch_begin();
+   bool sql_batch_commit();
 
 public:
    B_DB_SQLITE(JCR *jcr, const char *db_driver, const char *db_name,
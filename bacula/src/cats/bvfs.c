@@ -193,63 +193,6 @@ void Bvfs::set_jobids(char *ids)
  */
 
 
-/*
- * Working Object to store PathId already seen (avoid
- * database queries), equivalent to %cache_ppathid in perl
- */
-
-#define NITEMS 50000
-class pathid_cache {
-private:
-   hlink *nodes;
-   int nb_node;
-   int max_node;
-
-   alist *table_node;
-
-   htable *cache_ppathid;
-
-public:
-   pathid_cache() {
-      hlink link;
-      cache_ppathid = (htable *)malloc(sizeof(htable));
-      cache_ppathid->init(&link, &link, NITEMS);
-      max_node = NITEMS;
-      nodes = (hlink *) malloc(max_node * sizeof (hlink));
-      nb_node = 0;
-      table_node = New(alist(5, owned_by_alist));
-      table_node->append(nodes);
-   }
-
-   hlink *get_hlink() {
-      if (++nb_node >= max_node) {
-         nb_node = 0;
-         nodes = (hlink *)malloc(max_node * sizeof(hlink));
-         table_node->append(nodes);
-      }
-      return nodes + nb_node;
-   }
-
-   bool lookup(char *pathid) {
-      bool ret = cache_ppathid->lookup(pathid) != NULL;
-      return ret;
-   }
-
-   void insert(char *pathid) {
-      hlink *h = get_hlink();
-      cache_ppathid->insert(pathid, h);
-   }
-
-   ~pathid_cache() {
-      cache_ppathid->destroy();
-      free(cache_ppathid);
-      delete table_node;
-   }
-private:
-   pathid_cache(const pathid_cache &); /* prohibit pass by value */
-   pathid_cache &operator= (const pathid_cache &);/* prohibit class assignment*/
-} ;
-
 /* Return the parent_dir with the trailing /  (update the given string)
  * TODO: see in the rest of bacula if we don't have already this function
  * dir=/tmp/toto/
@@ -310,88 +253,365 @@ char *bvfs_basename_dir(char *path)
    return p;
 }
 
-static void build_path_hierarchy(JCR *jcr, B_DB *mdb,
-                                 pathid_cache &ppathid_cache,
-                                 char *org_pathid, char *path)
+/*
+ * Working objects to build the PathHierarchy of a job in memory.
+ *
+ * Each directory of the job, and each parent directory found by
+ * walking them upward, has a node indexed by its path. The PathIds
+ * of the parents are resolved, and the missing Path records are
+ * created, one level at a time with a few statements per level. The
+ * hierarchy rows are inserted with multi-row statements.
+ */
+struct hier_node {
+   hlink link;
+   DBId_t PathId;
+   hier_node *parent;
+   bool created;                      /* Path record created here */
+   char path[1];                      /* allocated with the node */
+};
+
+/* List of nodes */
+struct hier_list {
+   hier_node **items;
+   int num;
+   int max;
+};
+
+/* Number of rows sent in one statement */
+#define HIER_BATCH 250
+/* Maximum size of the values of one statement */
+#define HIER_MAX_VALUES (512 * 1024)
+
+class hier_builder {
+private:
+   JCR *jcr;
+   B_DB *mdb;
+   htable *nodes;                     /* all nodes, by path */
+   hier_list level;                   /* nodes that need a PathHierarchy row */
+   hier_list parents;                 /* new parents of these nodes */
+   POOLMEM *esc;
+   POOL_MEM values;                   /* values of the next statement */
+   int nb_values;
+   int values_len;
+
+   hier_node *new_node(const char *path, DBId_t PathId, bool index);
+   void push(hier_list *list, hier_node *node);
+   void add_value(const char *value);
+   void add_path(const char *fmt, const char *path);
+   bool flush_values(const char *cmd, DB_RESULT_HANDLER *handler, void *ctx);
+   bool resolve_parents();
+   bool insert_rows();
+   bool next_level();
+public:
+   int64_t nb_rows;                   /* PathHierarchy rows inserted */
+   int64_t nb_created;                /* Path records created */
+
+   hier_builder(JCR *j, B_DB *db);
+   ~hier_builder();
+   void add_job_path(const char *path, DBId_t PathId);
+   bool build();
+private:
+   hier_builder(const hier_builder &); /* prohibit pass by value */
+   hier_builder &operator= (const hier_builder &);/* prohibit class assignment*/
+};
+
+hier_builder::hier_builder(JCR *j, B_DB *db)
 {
-   Dmsg1(dbglevel, "build_path_hierarchy(%s)\n", path);
-   char pathid[50];
-   ATTR_DBR parent;
-   char *bkp = mdb->path;
-   strncpy(pathid, org_pathid, sizeof(pathid));
-
-   /* Does the ppathid exist for this ? we use a memory cache...  In order to
-    * avoid the full loop, we consider that if a dir is allready in the
-    * PathHierarchy table, then there is no need to calculate all the
-    * hierarchy
-    */
-   while (path && *path)
-   {
-      if (!ppathid_cache.lookup(pathid))
-      {
-         Mmsg(mdb->cmd,
-              "SELECT PPathId FROM PathHierarchy WHERE PathId = %s",
-              pathid);
-
-         if (!QUERY_DB(jcr, mdb, mdb->cmd)) {
-            goto bail_out;      /* Query failed, just leave */
-         }
+   hier_node *node = NULL;
+   jcr = j;
+   mdb = db;
+   nodes = New(htable(node, &node->link, 50000));
+   memset(&level, 0, sizeof(level));
+   memset(&parents, 0, sizeof(parents));
+   esc = get_pool_memory(PM_FNAME);
+   nb_values = values_len = 0;
+   nb_rows = nb_created = 0;
+}
 
-         /* Do we have a result ? */
-         if (sql_num_rows(mdb) > 0) {
-            ppathid_cache.insert(pathid);
-            /* This dir was in the db ...
-             * It means we can leave, the tree has allready been built for
-             * this dir
-             */
-            goto bail_out;
-         } else {
-            /* search or create parent PathId in Path table */
-            mdb->path = bvfs_parent_dir(path);
-            mdb->pnl = strlen(mdb->path);
-            if (!db_create_path_record(jcr, mdb, &parent)) {
-               goto bail_out;
-            }
-            ppathid_cache.insert(pathid);
+hier_builder::~hier_builder()
+{
+   delete nodes;
+   if (level.items) {
+      free(level.items);
+   }
+   if (parents.items) {
+      free(parents.items);
+   }
+   free_pool_memory(esc);
+}
 
-            Mmsg(mdb->cmd,
-                 "INSERT INTO PathHierarchy (PathId, PPathId) "
-                 "VALUES (%s,%lld)",
-                 pathid, (uint64_t) parent.PathId);
+hier_node *hier_builder::new_node(const char *path, DBId_t PathId, bool index)
+{
+   int len = strlen(path);
+   hier_node *node = (hier_node *)nodes->hash_malloc(sizeof(hier_node) + len);
+   memcpy(node->path, path, len + 1);
+   node->PathId = PathId;
+   node->parent = NULL;
+   node->created = false;
+   if (index) {
+      nodes->insert(node->path, node);
+   }
+   return node;
+}
 
-            if (!INSERT_DB(jcr, mdb, mdb->cmd)) {
-               goto bail_out;   /* Can't insert the record, just leave */
-            }
+void hier_builder::push(hier_list *list, hier_node *node)
+{
+   if (list->num == list->max) {
+      list->max = list->max ? 2 * list->max : 1000;
+      list->items = (hier_node **)realloc(list->items,
+                                          list->max * sizeof(hier_node *));
+   }
+   list->items[list->num++] = node;
+}
 
-            edit_uint64(parent.PathId, pathid);
-            path = mdb->path;   /* already done */
-         }
+/*
+ * A directory of the job that is not yet in PathHierarchy
+ */
+void hier_builder::add_job_path(const char *path, DBId_t PathId)
+{
+   hier_node *node = (hier_node *)nodes->lookup((char *)path);
+   if (node && node->PathId == PathId) {
+      return;
+   }
+   /* A duplicate Path record is linked too, but not indexed */
+   node = new_node(path, PathId, node == NULL);
+   if (*node->path) {                 /* the top directory has no parent */
+      push(&level, node);
+   }
+}
+
+/*
+ * Add a value to the next statement
+ */
+void hier_builder::add_value(const char *value)
+{
+   if (nb_values++ > 0) {
+      pm_strcat(values, ",");
+   }
+   values_len = pm_strcat(values, value);
+}
+
+/*
+ * Add a quoted path to the next statement, fmt gives the quotes
+ */
+void hier_builder::add_path(const char *fmt, const char *path)
+{
+   int len = strlen(path);
+   esc = check_pool_memory_size(esc, 2 * len + 2);
+   db_escape_string(jcr, mdb, esc, (char *)path, len);
+   Mmsg(mdb->cmd, fmt, esc);
+   add_value(mdb->cmd);
+}
+
+/*
+ * Run cmd with the values collected so far
+ */
+bool hier_builder::flush_values(const char *cmd, DB_RESULT_HANDLER *handler, void *ctx)
+{
+   bool ok = true;
+   if (nb_values > 0) {
+      Mmsg(mdb->cmd, cmd, values.c_str());
+      if (handler) {
+         ok = db_sql_query(mdb, mdb->cmd, handler, ctx);
       } else {
-         /* It's already in the cache.  We can leave, no time to waste here,
-          * all the parent dirs have allready been done
-          */
-         goto bail_out;
+         ok = db_sql_query(mdb, mdb->cmd, 0);
+      }
+      if (!ok) {
+         Jmsg(jcr, M_ERROR, 0, _("Bvfs query failed. ERR=%s\n"), sql_strerror(mdb));
       }
    }
+   pm_strcpy(values, "");
+   nb_values = values_len = 0;
+   return ok;
+}
 
-bail_out:
-   mdb->path = bkp;
-   mdb->fnl = 0;
+#define batch_full() (nb_values >= HIER_BATCH || values_len > HIER_MAX_VALUES)
+
+static int hier_path_handler(void *ctx, int fields, char **row)
+{
+   htable *nodes = (htable *)ctx;
+   hier_node *node = (hier_node *)nodes->lookup(row[1]);
+   if (node && node->PathId == 0) {   /* take the first one */
+      node->PathId = str_to_uint64(row[0]);
+   }
+   return 0;
 }
 
 /*
- * Internal function to update path_hierarchy cache with a shared pathid cache
+ * Find the parent of each node of the current level, and the
+ *  PathId of the parents not known yet. The missing Path records
+ *  are created.
+ */
+bool hier_builder::resolve_parents()
+{
+   static const char *select = "SELECT PathId, Path FROM Path WHERE Path IN (%s)";
+   static const char *insert = "INSERT INTO Path (Path) VALUES %s";
+   POOL_MEM path(PM_FNAME);
+   hier_node *node, *p;
+   int i;
+
+   parents.num = 0;
+   for (i = 0; i < level.num; i++) {
+      node = level.items[i];
+      pm_strcpy(path, node->path);
+      bvfs_parent_dir(path.c_str());
+      p = (hier_node *)nodes->lookup(path.c_str());
+      if (!p) {
+         p = new_node(path.c_str(), 0, true);
+         push(&parents, p);
+      }
+      node->parent = p;
+   }
+
+   /* Search the PathId of the new parents */
+   for (i = 0; i < parents.num; i++) {
+      add_path("'%s'", parents.items[i]->path);
+      if (batch_full() && !flush_values(select, hier_path_handler, nodes)) {
+         return false;
+      }
+   }
+   if (!flush_values(select, hier_path_handler, nodes)) {
+      return false;
+   }
+
+   /* Create the missing ones, then get their PathId */
+   for (i = 0; i < parents.num; i++) {
+      p = parents.items[i];
+      if (p->PathId == 0) {
+         p->created = true;
+         nb_created++;
+         add_path("('%s')", p->path);
+         if (batch_full() && !flush_values(insert, NULL, NULL)) {
+            return false;
+         }
+      }
+   }
+   if (!flush_values(insert, NULL, NULL)) {
+      return false;
+   }
+   for (i = 0; i < parents.num; i++) {
+      p = parents.items[i];
+      if (p->created) {
+         add_path("'%s'", p->path);
+         if (batch_full() && !flush_values(select, hier_path_handler, nodes)) {
+            return false;
+         }
+      }
+   }
+   if (!flush_values(select, hier_path_handler, nodes)) {
+      return false;
+   }
+   for (i = 0; i < parents.num; i++) {
+      if (parents.items[i]->PathId == 0) {
+         Jmsg(jcr, M_ERROR, 0, _("Could not create Path record for \"%s\"\n"),
+              parents.items[i]->path);
+         return false;
+      }
+   }
+   return true;
+}
+
+/*
+ * Insert the PathHierarchy rows of the nodes of the current level
+ */
+bool hier_builder::insert_rows()
+{
+   static const char *insert = "INSERT INTO PathHierarchy (PathId, PPathId) VALUES %s";
+   POOL_MEM row;
+   char ed1[50], ed2[50];
+   hier_node *node;
+
+   for (int i = 0; i < level.num; i++) {
+      node = level.items[i];
+      Mmsg(row, "(%s,%s)", edit_uint64(node->PathId, ed1),
+           edit_uint64(node->parent->PathId, ed2));
+      add_value(row.c_str());
+      nb_rows++;
+      if (batch_full() && !flush_values(insert, NULL, NULL)) {
+         return false;
+      }
+   }
+   return flush_values(insert, NULL, NULL);
+}
+
+static int hier_linked_handler(void *ctx, int fields, char **row)
+{
+   htable *linked = (htable *)ctx;
+   linked->insert((uint64_t)str_to_uint64(row[0]), linked->hash_malloc(sizeof(hlink)));
+   return 0;
+}
+
+/*
+ * The next level is made of the new parents that are not in
+ *  PathHierarchy yet. The others have all their own parents.
+ */
+bool hier_builder::next_level()
+{
+   static const char *select = "SELECT PathId FROM PathHierarchy WHERE PathId IN (%s)";
+   hlink *h = NULL;
+   htable *linked;
+   hier_node *p;
+   char ed1[50];
+   bool ok = true;
+   int i;
+
+   linked = New(htable(h, h, 1000));
+   for (i = 0; ok && i < parents.num; i++) {
+      p = parents.items[i];
+      if (!p->created) {
+         add_value(edit_uint64(p->PathId, ed1));
+         if (batch_full()) {
+            ok = flush_values(select, hier_linked_handler, linked);
+         }
+      }
+   }
+   if (ok) {
+      ok = flush_values(select, hier_linked_handler, linked);
+   }
+
+   level.num = 0;
+   for (i = 0; ok && i < parents.num; i++) {
+      p = parents.items[i];
+      if (*p->path && !linked->lookup((uint64_t)p->PathId)) {
+         push(&level, p);
+      }
+   }
+   delete linked;
+   return ok;
+}
+
+/*
+ * Link all the directories given by add_job_path() and
+ *  their missing parents.
+ */
+bool hier_builder::build()
+{
+   while (level.num > 0) {
+      if (!resolve_parents() || !insert_rows() || !next_level()) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static int hier_job_path_handler(void *ctx, int fields, char **row)
+{
+   hier_builder *hb = (hier_builder *)ctx;
+   hb->add_job_path(row[1], str_to_uint64(row[0]));
+   return 0;
+}
+
+/*
+ * Internal function to update path_hierarchy cache
  * return Error 0
  *        OK    1
  */
 static int update_path_hierarchy_cache(JCR *jcr,
                                         B_DB *mdb,
-                                        pathid_cache &ppathid_cache,
                                         JobId_t JobId)
 {
    Dmsg0(dbglevel, "update_path_hierarchy_cache()\n");
    int ret=0;
-   uint32_t num;
    char jobid[50];
    edit_uint64(JobId, jobid);
 
@@ -422,8 +642,8 @@ static int update_path_hierarchy_cache(JCR *jcr,
    }
 
    /* Now we have to do the directory recursion stuff to determine missing
-    * visibility We try to avoid recursion, to be as fast as possible We also
-    * only work on not allready hierarchised directories...
+    * visibility. We only work on not already hierarchised directories,
+    * their parents are computed in memory and linked in bulk.
     */
    Mmsg(mdb->cmd,
      "SELECT PathVisibility.PathId, Path "
@@ -432,38 +652,21 @@ static int update_path_hierarchy_cache(JCR *jcr,
             "LEFT JOIN PathHierarchy "
          "ON (PathVisibility.PathId = PathHierarchy.PathId) "
       "WHERE PathVisibility.JobId = %s "
-        "AND PathHierarchy.PathId IS NULL "
-      "ORDER BY Path", jobid);
+        "AND PathHierarchy.PathId IS NULL", jobid);
    Dmsg1(dbglevel_sql, "q=%s\n", mdb->cmd);
 
-   if (!QUERY_DB(jcr, mdb, mdb->cmd)) {
-      Dmsg1(dbglevel, "Can't get new Path %d\n", (uint32_t)JobId );
-      goto bail_out;
-   }
-
-   /* TODO: I need to reuse the DB connection without emptying the result
-    * So, now i'm copying the result in memory to be able to query the
-    * catalog descriptor again.
-    */
-   num = sql_num_rows(mdb);
-   if (num > 0) {
-      char **result = (char **)malloc (num * 2 * sizeof(char *));
-
-      SQL_ROW row;
-      int i=0;
-      while((row = sql_fetch_row(mdb))) {
-         result[i++] = bstrdup(row[0]);
-         result[i++] = bstrdup(row[1]);
+   {
+      hier_builder hb(jcr, mdb);
+      if (!db_sql_query(mdb, mdb->cmd, hier_job_path_handler, &hb)) {
+         Dmsg1(dbglevel, "Can't get new Path %d\n", (uint32_t)JobId );
+         goto bail_out;
       }
-
-      i=0;
-      while (num > 0) {
-         build_path_hierarchy(jcr, mdb, ppathid_cache, result[i], result[i+1]);
-         free(result[i++]);
-         free(result[i++]);
-         num--;
+      if (!hb.build()) {
+         Dmsg1(dbglevel, "Can't build PathHierarchy %d\n", (uint32_t)JobId );
+         goto bail_out;
       }
-      free(result);
+      Dmsg3(dbglevel, "JobId=%d PathHierarchy rows=%lld new Path=%lld\n",
+            (uint32_t)JobId, hb.nb_rows, hb.nb_created);
    }
 
    if (mdb->db_get_type_index() == SQL_TYPE_SQLITE3) {
@@ -736,7 +939,6 @@ void bvfs_update_cache(JCR *jcr, B_DB *mdb)
 int
 bvfs_update_path_hierarchy_cache(JCR *jcr, B_DB *mdb, char *jobids)
 {
-   pathid_cache ppathid_cache;
    JobId_t JobId;
    char *p;
    int ret=1;
@@ -750,7 +952,7 @@ bvfs_update_path_hierarchy_cache(JCR *jcr, B_DB *mdb, char *jobids)
          break;
       }
       Dmsg1(dbglevel, "Updating cache for %lld\n", (uint64_t)JobId);
-      if (!update_path_hierarchy_cache(jcr, mdb, ppathid_cache, JobId)) {
+      if (!update_path_hierarchy_cache(jcr, mdb, JobId)) {
          ret = 0;
       }
    }
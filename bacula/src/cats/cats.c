@@ -61,8 +61,17 @@ B_DB *B_DB::db_clone_database_connection(JCR *jcr, bool mult_db_connections)
    /*
     * A bit more to do here just open a new session to the database.
     */
-   return db_init_database(jcr, m_db_driver, m_db_name, m_db_user, m_db_password,
-                           m_db_address, m_db_port, m_db_socket, true, m_disabled_batch_insert);
+   B_DB *mdb = db_init_database(jcr, m_db_driver, m_db_name, m_db_user, m_db_password,
+                                m_db_address, m_db_port, m_db_socket, true,
+                                m_disabled_batch_insert);
+   if (mdb && m_batch_size && m_batch_min == m_batch_max) {
+      mdb->set_batch_size(m_batch_size);  /* keep a size set by hand */
+   }
+   if (mdb) {
+      mdb->path_cache = path_cache;
+      mdb->filename_cache = filename_cache;
+   }
+   return mdb;
 }
 
 const char *B_DB::db_get_type(void)
@@ -124,6 +133,71 @@ bool B_DB::db_sql_query(const char *query, int flags)
    return retval;
 }
 
+/*
+ * Batch insert tuning
+ *
+ * The backends that send batch inserts in groups of rows (multi-row
+ * INSERT, transaction) call batch_size_tune() after each group with
+ * the time its round trip took. Every few round trips, the group size
+ * is doubled or halved, within the limits of the backend, in the
+ * direction that gives more rows per second. This adapts the size to
+ * the latency of the database connection.
+ */
+#define BATCH_TUNE_TRIPS 8            /* round trips measured per size */
+
+void B_DB::batch_size_init(uint32_t size, uint32_t min, uint32_t max)
+{
+   m_batch_size = size;
+   m_batch_min = min;
+   m_batch_max = max;
+   m_batch_step = 1;
+   m_batch_trips = 0;
+   m_batch_rows = 0;
+   m_batch_time = 0;
+   m_batch_rate = 0;
+}
+
+/*
+ * Use a fixed batch size, e.g. for benchmarks. Zero keeps the
+ *  current settings.
+ */
+void B_DB::set_batch_size(uint32_t size)
+{
+   if (size > 0) {
+      batch_size_init(size, size, size);
+   }
+}
+
+void B_DB::batch_size_tune(uint32_t rows, btime_t elapsed)
+{
+   double rate;
+   uint32_t size;
+
+   if (m_batch_min == m_batch_max) {
+      return;
+   }
+   m_batch_rows += rows;
+   m_batch_time += elapsed;
+   if (++m_batch_trips < BATCH_TUNE_TRIPS) {
+      return;
+   }
+   rate = (double)m_batch_rows * 1000000 / MAX(m_batch_time, 1);
+   if (rate < m_batch_rate * 0.9) {
+      m_batch_step = -m_batch_step;   /* worse than before, go back */
+   }
+   m_batch_rate = rate;
+   if (m_batch_step > 0) {
+      size = MIN(m_batch_size * 2, m_batch_max);
+   } else {
+      size = MAX(m_batch_size / 2, m_batch_min);
+   }
+   Dmsg3(100, "Batch size %u -> %u at %d rows/s\n", m_batch_size, size, (int)rate);
+   m_batch_size = size;
+   m_batch_trips = 0;
+   m_batch_rows = 0;
+   m_batch_time = 0;
+}
+
 void B_DB::print_lock_info(FILE *fp)
 {
    if (m_lock.valid == RWLOCK_VALID) {
@@ -431,6 +431,8 @@ typedef int (DB_RESULT_HANDLER)(void *, int, char **);
 /* Current database version number for all drivers */
 #define BDB_VERSION 14
 
+class ID_CACHE;
+
 class B_DB: public SMARTALLOC {
 protected:
    brwlock_t m_lock;                      /* transaction lock */
@@ -450,6 +452,14 @@ protected:
    int m_db_port;                         /* port for host name address */
    bool m_disabled_batch_insert;          /* explicitly disabled batch insert mode ? */
    bool m_dedicated;                      /* is this connection dedicated? */
+   uint32_t m_batch_size;                 /* rows per batch insert round trip */
+   uint32_t m_batch_min;                  /* lower limit of m_batch_size */
+   uint32_t m_batch_max;                  /* upper limit of m_batch_size */
+   int m_batch_step;                      /* last change of m_batch_size, +1 or -1 */
+   int m_batch_trips;                     /* round trips measured with m_batch_size */
+   uint64_t m_batch_rows;                 /* rows sent in these round trips */
+   btime_t m_batch_time;                  /* time taken by these round trips */
+   double m_batch_rate;                   /* rows/second with the previous size */
 
 public:
    POOLMEM *errmsg;                       /* nicely edited error message */
@@ -465,14 +475,31 @@ public:
    POOLMEM *esc_obj;                      /* Escaped restore object */
    int fnl;                               /* file name length */
    int pnl;                               /* path name length */
+   ID_CACHE *path_cache;                  /* Path -> PathId cache of the Catalog */
+   ID_CACHE *filename_cache;              /* Filename -> FilenameId cache */
+   uint32_t batch_path_hits;              /* batch rows with a cached PathId */
+   uint32_t batch_path_misses;            /* batch rows without */
+   uint32_t batch_filename_hits;          /* batch rows with a cached FilenameId */
+   uint32_t batch_filename_misses;        /* batch rows without */
 
    /* methods */
-   B_DB() {};
+   B_DB() {
+      path_cache = filename_cache = NULL;
+      batch_path_hits = batch_path_misses = 0;
+      batch_filename_hits = batch_filename_misses = 0;
+      batch_size_init(0, 0, 0);
+   };
    virtual ~B_DB() {};
    const char *get_db_name(void) { return m_db_name; };
    const char *get_db_user(void) { return m_db_user; };
+   const char *get_db_address(void) { return m_db_address; };
+   int get_db_port(void) { return m_db_port; };
    bool is_connected(void) { return m_connected; };
    bool batch_insert_available(void) { return m_have_batch_insert; };
+   uint32_t get_batch_size(void) { return m_batch_size; };
+   void set_batch_size(uint32_t size);
+   void batch_size_init(uint32_t size, uint32_t min, uint32_t max);
+   void batch_size_tune(uint32_t rows, btime_t elapsed);
    void increment_refcount(void) { m_ref_count++; };
 
    /* low level methods */
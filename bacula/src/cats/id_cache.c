@@ -0,0 +1,287 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Path and Filename Id cache
+ *
+ *  When the batch of attributes of a job is inserted, the PathId and
+ *  FilenameId of the rows found in the cache are written in the batch
+ *  table, and only the other rows go through the locked Path and
+ *  Filename fill queries and the joins, see db_write_batch_file_records().
+ *  The Ids found by the joins are then added to the cache, so that the
+ *  next jobs of the Catalog find the directories and the names backed
+ *  up by the recent jobs.
+ *
+ *  The cached Ids are checked against the Path and Filename tables
+ *  before they are used, a wrong Id (e.g. after a dbcheck or a restore
+ *  of the catalog) only costs a miss.
+ */
+
+#include "bacula.h"
+
+#if HAVE_SQLITE3 || HAVE_MYSQL || HAVE_POSTGRESQL
+
+#include "cats.h"
+#include "id_cache.h"
+
+static const int dbglevel = 100;
+
+/* One pair of caches per Catalog */
+struct id_cache_set {
+   char *key;                         /* dbname:address:port */
+   ID_CACHE *path_cache;
+   ID_CACHE *filename_cache;
+};
+
+static alist *id_cache_sets = NULL;
+static pthread_mutex_t id_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* FNV-1a */
+static uint32_t id_cache_hash(const char *key, uint32_t len)
+{
+   uint32_t hash = 2166136261U;
+
+   for (uint32_t i = 0; i < len; i++) {
+      hash ^= (uint8_t)key[i];
+      hash *= 16777619U;
+   }
+   return hash;
+}
+
+ID_CACHE::ID_CACHE(uint32_t size)
+{
+   uint32_t capacity = (size + ID_CACHE_SHARDS - 1) / ID_CACHE_SHARDS;
+   uint32_t nbuckets = 16;
+
+   if (capacity == 0) {
+      capacity = 1;
+   }
+   while (nbuckets < capacity) {
+      nbuckets <<= 1;
+   }
+   for (int i = 0; i < ID_CACHE_SHARDS; i++) {
+      id_cache_shard *s = &m_shards[i];
+      memset(s, 0, sizeof(id_cache_shard));
+      pthread_mutex_init(&s->mutex, NULL);
+      s->capacity = capacity;
+      s->nbuckets = nbuckets;
+      s->buckets = (int32_t *)malloc(nbuckets * sizeof(int32_t));
+      memset(s->buckets, 0xff, nbuckets * sizeof(int32_t));     /* all -1 */
+   }
+}
+
+ID_CACHE::~ID_CACHE()
+{
+   flush();
+   for (int i = 0; i < ID_CACHE_SHARDS; i++) {
+      id_cache_shard *s = &m_shards[i];
+      if (s->entries) {
+         free(s->entries);
+      }
+      free(s->buckets);
+      pthread_mutex_destroy(&s->mutex);
+   }
+}
+
+/*
+ * Remove an entry from its bucket. Called with the shard locked.
+ */
+void ID_CACHE::unlink_entry(id_cache_shard *s, int32_t idx)
+{
+   id_cache_entry *e = &s->entries[idx];
+   int32_t *prev = &s->buckets[(e->hash >> 4) & (s->nbuckets - 1)];
+
+   while (*prev != idx) {
+      prev = &s->entries[*prev].next;
+   }
+   *prev = e->next;
+}
+
+/*
+ * Returns: true  with the Id in *id if key is cached
+ *          false otherwise
+ */
+bool ID_CACHE::lookup(const char *key, uint32_t len, DBId_t *id)
+{
+   uint32_t hash = id_cache_hash(key, len);
+   id_cache_shard *s = get_shard(hash);
+   bool found = false;
+
+   P(s->mutex);
+   for (int32_t i = s->buckets[(hash >> 4) & (s->nbuckets - 1)]; i >= 0;
+        i = s->entries[i].next) {
+      id_cache_entry *e = &s->entries[i];
+      if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) {
+         e->ref = true;
+         *id = e->id;
+         found = true;
+         break;
+      }
+   }
+   if (found) {
+      s->hits++;
+   } else {
+      s->misses++;
+   }
+   V(s->mutex);
+   return found;
+}
+
+void ID_CACHE::insert(const char *key, uint32_t len, DBId_t id)
+{
+   uint32_t hash = id_cache_hash(key, len);
+   id_cache_shard *s = get_shard(hash);
+   int32_t *bucket = &s->buckets[(hash >> 4) & (s->nbuckets - 1)];
+   id_cache_entry *e;
+   int32_t idx;
+
+   P(s->mutex);
+   for (idx = *bucket; idx >= 0; idx = s->entries[idx].next) {
+      e = &s->entries[idx];
+      if (e->hash == hash && e->len == len && memcmp(e->key, key, len) == 0) {
+         e->id = id;
+         V(s->mutex);
+         return;
+      }
+   }
+   if (s->count < s->capacity) {
+      /* The entry array grows up to the capacity of the shard */
+      if (s->count % 1024 == 0) {
+         uint32_t alloc = MIN(s->count + 1024, s->capacity);
+         s->entries = (id_cache_entry *)realloc(s->entries,
+                                               alloc * sizeof(id_cache_entry));
+      }
+      idx = s->count++;
+   } else {
+      /* Give a second chance to the entries used since the last round */
+      while (s->entries[s->hand].ref) {
+         s->entries[s->hand].ref = false;
+         s->hand = (s->hand + 1) % s->capacity;
+      }
+      idx = s->hand;
+      s->hand = (s->hand + 1) % s->capacity;
+      unlink_entry(s, idx);
+      free(s->entries[idx].key);
+   }
+   e = &s->entries[idx];
+   e->key = (char *)malloc(len + 1);
+   memcpy(e->key, key, len);
+   e->key[len] = 0;
+   e->len = len;
+   e->hash = hash;
+   e->id = id;
+   e->ref = false;
+   e->next = *bucket;
+   *bucket = idx;
+   V(s->mutex);
+}
+
+/*
+ * Forget all the entries, e.g. when some of them are found wrong
+ */
+void ID_CACHE::flush()
+{
+   for (int i = 0; i < ID_CACHE_SHARDS; i++) {
+      id_cache_shard *s = &m_shards[i];
+      P(s->mutex);
+      for (uint32_t j = 0; j < s->count; j++) {
+         free(s->entries[j].key);
+      }
+      if (s->entries) {
+         free(s->entries);
+         s->entries = NULL;
+      }
+      s->count = 0;
+      s->hand = 0;
+      memset(s->buckets, 0xff, s->nbuckets * sizeof(int32_t));
+      V(s->mutex);
+   }
+}
+
+void ID_CACHE::get_stats(uint64_t *hits, uint64_t *misses, uint32_t *count)
+{
+   *hits = *misses = 0;
+   *count = 0;
+   for (int i = 0; i < ID_CACHE_SHARDS; i++) {
+      id_cache_shard *s = &m_shards[i];
+      P(s->mutex);
+      *hits += s->hits;
+      *misses += s->misses;
+      *count += s->count;
+      V(s->mutex);
+   }
+}
+
+/*
+ * Attach the Id caches of the Catalog of mdb to mdb, creating them
+ *  with size entries each if needed. With size 0, mdb does not use
+ *  the caches. The size of existing caches is not changed.
+ */
+void db_use_id_cache(B_DB *mdb, uint32_t size)
+{
+   id_cache_set *set;
+   POOL_MEM key;
+
+   if (size == 0) {
+      mdb->path_cache = mdb->filename_cache = NULL;
+      return;
+   }
+   Mmsg(key, "%s:%s:%d", mdb->get_db_name(), NPRTB(mdb->get_db_address()),
+        mdb->get_db_port());
+
+   P(id_cache_mutex);
+   if (!id_cache_sets) {
+      id_cache_sets = New(alist(5, not_owned_by_alist));
+   }
+   foreach_alist(set, id_cache_sets) {
+      if (strcmp(set->key, key.c_str()) == 0) {
+         break;
+      }
+   }
+   if (!set) {
+      Dmsg2(dbglevel, "Create Id caches of %u entries for %s\n", size, key.c_str());
+      set = (id_cache_set *)malloc(sizeof(id_cache_set));
+      set->key = bstrdup(key.c_str());
+      set->path_cache = New(ID_CACHE(size));
+      set->filename_cache = New(ID_CACHE(size));
+      id_cache_sets->append(set);
+   }
+   mdb->path_cache = set->path_cache;
+   mdb->filename_cache = set->filename_cache;
+   V(id_cache_mutex);
+}
+
+/*
+ * Release all the Id caches, called when the Director terminates
+ */
+void db_free_id_caches()
+{
+   id_cache_set *set;
+
+   P(id_cache_mutex);
+   if (id_cache_sets) {
+      foreach_alist(set, id_cache_sets) {
+         delete set->path_cache;
+         delete set->filename_cache;
+         free(set->key);
+         free(set);
+      }
+      delete id_cache_sets;
+      id_cache_sets = NULL;
+   }
+   V(id_cache_mutex);
+}
+
+#endif /* HAVE_SQLITE3 || HAVE_MYSQL || HAVE_POSTGRESQL */
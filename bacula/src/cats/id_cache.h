@@ -0,0 +1,71 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+
+#ifndef __ID_CACHE_H_
+#define __ID_CACHE_H_ 1
+
+/*
+ * Bounded cache of Path -> PathId or Filename -> FilenameId
+ *  shared by all the jobs of a Catalog, see id_cache.c
+ *
+ * The entries are spread over ID_CACHE_SHARDS shards, each with
+ *  its own lock, so that the jobs that insert their attributes
+ *  at the same time rarely wait for each other. When a shard is
+ *  full, an entry that was not used since the clock hand passed
+ *  it last time is replaced (CLOCK, an approximation of LRU).
+ */
+
+#define ID_CACHE_SHARDS 16
+
+struct id_cache_entry {
+   char *key;                         /* Path or Filename, malloced */
+   uint32_t len;                      /* length of key */
+   uint32_t hash;                     /* hash of key */
+   int32_t next;                      /* next entry in the bucket, or -1 */
+   bool ref;                          /* used since the hand passed */
+   DBId_t id;                         /* PathId or FilenameId */
+};
+
+struct id_cache_shard {
+   pthread_mutex_t mutex;
+   id_cache_entry *entries;           /* capacity entries */
+   int32_t *buckets;                  /* first entry of each bucket, or -1 */
+   uint32_t nbuckets;                 /* power of 2 */
+   uint32_t capacity;                 /* max entries */
+   uint32_t count;                    /* entries in use */
+   uint32_t hand;                     /* clock hand */
+   uint64_t hits;
+   uint64_t misses;
+};
+
+class ID_CACHE: public SMARTALLOC {
+   id_cache_shard m_shards[ID_CACHE_SHARDS];
+
+   id_cache_shard *get_shard(uint32_t hash) {
+      return &m_shards[hash & (ID_CACHE_SHARDS - 1)];
+   };
+   void unlink_entry(id_cache_shard *s, int32_t idx);
+
+public:
+   ID_CACHE(uint32_t size);
+   ~ID_CACHE();
+   bool lookup(const char *key, uint32_t len, DBId_t *id);
+   void insert(const char *key, uint32_t len, DBId_t id);
+   void flush();
+   void get_stats(uint64_t *hits, uint64_t *misses, uint32_t *count);
+};
+
+#endif /* __ID_CACHE_H_ */
@@ -103,6 +103,8 @@ B_DB_MYSQL::B_DB_MYSQL(JCR *jcr,
    esc_path = get_pool_memory(PM_FNAME);
    esc_obj = get_pool_memory(PM_FNAME);
    m_allow_transactions = mult_db_connections;
+   batch_size_init(MYSQL_CHANGES_PER_BATCH_INSERT, MYSQL_MIN_CHANGES_PER_BATCH_INSERT,
+                   MYSQL_MAX_CHANGES_PER_BATCH_INSERT);
 
    /* At this time, when mult_db_connections == true, this is for
     * specific console command such as bvfs or batch mode, and we don't
@@ -116,6 +118,7 @@ B_DB_MYSQL::B_DB_MYSQL(JCR *jcr,
     */
    m_db_handle = NULL;
    m_result = NULL;
+   m_batch_len = 0;
 
    /*
     * Put the db in the list.
@@ -579,7 +582,9 @@ bool B_DB_MYSQL::sql_batch_start(JCR *jcr)
                               "Name blob,"
                               "LStat tinyblob,"
                               "MD5 tinyblob,"
-                              "DeltaSeq integer)");
+                              "DeltaSeq integer,"
+                              "PathId integer,"
+                              "FilenameId integer)");
    db_unlock(this);
 
    /*
@@ -603,12 +608,29 @@ bool B_DB_MYSQL::sql_batch_end(JCR *jcr, const char *error)
     * Flush any pending inserts.
     */
    if (changes) {
-      return sql_query(cmd);
+      return sql_batch_flush();
    }
 
    return true;
 }
 
+/*
+ * Send the multi-row insert in cmd, and tune the number of
+ *  rows of the next ones with the time it took.
+ */
+bool B_DB_MYSQL::sql_batch_flush()
+{
+   btime_t start = get_current_btime();
+   bool retval;
+
+   retval = sql_query(cmd);
+   if (retval) {
+      batch_size_tune(changes, get_current_btime() - start);
+   }
+   changes = 0;
+   return retval;
+}
+
 /*
  * Returns true if OK
  *         false if failed
@@ -617,6 +639,7 @@ bool B_DB_MYSQL::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
 {
    const char *digest;
    char ed1[50];
+   int len;
 
    esc_name = check_pool_memory_size(esc_name, fnl*2+1);
    db_escape_string(jcr, esc_name, fname, fnl);
@@ -634,20 +657,22 @@ bool B_DB_MYSQL::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
     * Try to batch up multiple inserts using multi-row inserts.
     */
    if (changes == 0) {
-      Mmsg(cmd, "INSERT INTO batch VALUES "
-           "(%u,%s,'%s','%s','%s','%s',%u)",
+      m_batch_len = Mmsg(cmd, "INSERT INTO batch VALUES "
+           "(%u,%s,'%s','%s','%s','%s',%u,%u,%u)",
            ar->FileIndex, edit_int64(ar->JobId,ed1), esc_path,
-           esc_name, ar->attr, digest, ar->DeltaSeq);
+           esc_name, ar->attr, digest, ar->DeltaSeq, ar->PathId, ar->FilenameId);
       changes++;
    } else {
       /*
        * We use the esc_obj for temporary storage otherwise
        * we keep on copying data.
        */
-      Mmsg(esc_obj, ",(%u,%s,'%s','%s','%s','%s',%u)",
+      len = Mmsg(esc_obj, ",(%u,%s,'%s','%s','%s','%s',%u,%u,%u)",
            ar->FileIndex, edit_int64(ar->JobId,ed1), esc_path,
-           esc_name, ar->attr, digest, ar->DeltaSeq);
-      pm_strcat(cmd, esc_obj);
+           esc_name, ar->attr, digest, ar->DeltaSeq, ar->PathId, ar->FilenameId);
+      cmd = check_pool_memory_size(cmd, m_batch_len + len + 1);
+      memcpy(cmd + m_batch_len, esc_obj, len + 1);
+      m_batch_len += len;
       changes++;
    }
 
@@ -655,13 +680,8 @@ bool B_DB_MYSQL::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
     * See if we need to flush the query buffer filled
     * with multi-row inserts.
     */
-   if ((changes % MYSQL_CHANGES_PER_BATCH_INSERT) == 0) {
-      if (!sql_query(cmd)) {
-         changes = 0;
-         return false;
-      } else {
-         changes = 0;
-      }
+   if ((uint32_t)changes >= m_batch_size || m_batch_len >= MYSQL_MAX_BATCH_INSERT_SIZE) {
+      return sql_batch_flush();
    }
    return true;
 }
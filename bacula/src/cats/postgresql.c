@@ -945,7 +945,9 @@ bool B_DB_POSTGRESQL::sql_batch_start(JCR *jcr)
                           "Name varchar,"
                           "LStat varchar,"
                           "Md5 varchar,"
-                          "DeltaSeq smallint)")) {
+                          "DeltaSeq smallint,"
+                          "PathId int,"
+                          "FilenameId int)")) {
       Dmsg0(500, "sql_batch_start failed\n");
       return false;
    }
@@ -1059,9 +1061,9 @@ bool B_DB_POSTGRESQL::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
       digest = ar->Digest;
    }
 
-   len = Mmsg(cmd, "%u\t%s\t%s\t%s\t%s\t%s\t%u\n",
+   len = Mmsg(cmd, "%u\t%s\t%s\t%s\t%s\t%s\t%u\t%u\t%u\n",
               ar->FileIndex, edit_int64(ar->JobId, ed1), esc_path,
-              esc_name, ar->attr, digest, ar->DeltaSeq);
+              esc_name, ar->attr, digest, ar->DeltaSeq, ar->PathId, ar->FilenameId);
 
    do {
       res = PQputCopyData(m_db_handle, cmd, len);
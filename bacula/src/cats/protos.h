@@ -28,6 +28,10 @@
 
 /* Database prototypes */
 
+/* id_cache.c */
+void db_use_id_cache(B_DB *mdb, uint32_t size);
+void db_free_id_caches();
+
 /* sql.c */
 bool db_open_batch_connexion(JCR *jcr, B_DB *mdb);
 char *db_strerror(B_DB *mdb);
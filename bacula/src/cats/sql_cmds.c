@@ -898,18 +898,18 @@ const char *batch_fill_path_query[] = {
    /* Mysql */
    "INSERT INTO Path (Path) "
       "SELECT a.Path FROM "
-         "(SELECT DISTINCT Path FROM batch) AS a WHERE NOT EXISTS "
+         "(SELECT DISTINCT Path FROM batch WHERE PathId = 0) AS a WHERE NOT EXISTS "
          "(SELECT Path FROM Path AS p WHERE p.Path = a.Path)",
 
    /* Postgresql */
    "INSERT INTO Path (Path) "
       "SELECT a.Path FROM "
-         "(SELECT DISTINCT Path FROM batch) AS a "
+         "(SELECT DISTINCT Path FROM batch WHERE PathId = 0) AS a "
        "WHERE NOT EXISTS (SELECT Path FROM Path WHERE Path = a.Path) ",
 
    /* SQLite3 */
    "INSERT INTO Path (Path) "
-      "SELECT DISTINCT Path FROM batch "
+      "SELECT DISTINCT Path FROM batch WHERE PathId = 0 "
       "EXCEPT SELECT Path FROM Path"
 };
 
@@ -917,19 +917,19 @@ const char *batch_fill_filename_query[] = {
    /* Mysql */
    "INSERT INTO Filename (Name) "
       "SELECT a.Name FROM "
-         "(SELECT DISTINCT Name FROM batch) AS a WHERE NOT EXISTS "
+         "(SELECT DISTINCT Name FROM batch WHERE FilenameId = 0) AS a WHERE NOT EXISTS "
          "(SELECT Name FROM Filename AS f WHERE f.Name = a.Name)",
 
    /* Postgresql */
    "INSERT INTO Filename (Name) "
       "SELECT a.Name FROM "
-         "(SELECT DISTINCT Name FROM batch) as a "
+         "(SELECT DISTINCT Name FROM batch WHERE FilenameId = 0) as a "
        "WHERE NOT EXISTS "
         "(SELECT Name FROM Filename WHERE Name = a.Name)",
 
    /* SQLite3 */
    "INSERT INTO Filename (Name) "
-      "SELECT DISTINCT Name FROM batch "
+      "SELECT DISTINCT Name FROM batch WHERE FilenameId = 0 "
       "EXCEPT SELECT Name FROM Filename"
 };
 
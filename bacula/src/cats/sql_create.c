@@ -29,6 +29,7 @@ static const int dbglevel = 100;
 #include "cats.h"
 #include "bdb_priv.h"
 #include "sql_glue.h"
+#include "id_cache.h"
 
 /* -----------------------------------------------------------------------
  *
@@ -773,13 +774,87 @@ void db_disable_batch_insert(bool enabled)
  *  tables.
  *
  *  To sum up :
- *   - bulk load a temp table
+ *   - bulk load a temp table, with the PathId and FilenameId found in
+ *   - the Id caches of the Catalog (see id_cache.c), 0 otherwise
+ *   - reset the cached Ids that do not match the Path and Filename tables
  *   - insert missing filenames into filename with a single query (lock filenames
  *   - table before that to avoid possible duplicate inserts with concurrent update)
  *   - insert missing paths into path with another single query
- *   - then insert the join between the temp, filename and path tables into file.
+ *   - then insert the rows with both Ids into file, and the join between
+ *   - the other rows of the temp, filename and path tables.
+ *   - add the Ids found by the join to the caches
  */
 
+/*
+ * Reset the cached Ids of the batch table that are not right
+ *
+ * Returns: -1 on failure
+ *          number of Ids reset on success
+ */
+static int db_reset_stale_batch_ids(JCR *jcr, B_DB *mdb, const char *query)
+{
+   int stale;
+
+   db_lock(mdb);
+   if (!sql_query(mdb, query)) {
+      Mmsg2(&mdb->errmsg, _("Check of cached Ids failed: ERR=%s\n%s\n"),
+            sql_strerror(mdb), query);
+      db_unlock(mdb);
+      return -1;
+   }
+   stale = sql_affected_rows(mdb);
+   db_unlock(mdb);
+   return stale;
+}
+
+/*
+ * Add the Path or Filename Id in row[1] to the cache
+ */
+static int db_id_cache_handler(void *ctx, int num_fields, char **row)
+{
+   ID_CACHE *cache = (ID_CACHE *)ctx;
+
+   if (row[0] && row[1]) {
+      cache->insert(row[0], strlen(row[0]), str_to_int64(row[1]));
+   }
+   return 0;
+}
+
+/*
+ * Lock the table, insert the missing records and unlock it
+ */
+static bool db_fill_batch_table(JCR *jcr, B_DB *mdb, const char *table,
+                                const char *lock_query, const char *fill_query,
+                                btime_t *lock_time)
+{
+   btime_t start = get_current_btime();
+   bool retval = false;
+
+   /*
+    * We have to lock tables
+    */
+   if (!db_sql_query(mdb, lock_query, NULL, NULL)) {
+      Jmsg2(jcr, M_FATAL, 0, "Lock %s table %s\n", table, mdb->errmsg);
+      goto bail_out;
+   }
+
+   if (!db_sql_query(mdb, fill_query, NULL, NULL)) {
+      Jmsg2(jcr, M_FATAL, 0, "Fill %s table %s\n", table, mdb->errmsg);
+      db_sql_query(mdb, batch_unlock_tables_query[db_get_type_index(mdb)], NULL, NULL);
+      goto bail_out;
+   }
+
+   if (!db_sql_query(mdb, batch_unlock_tables_query[db_get_type_index(mdb)], NULL, NULL)) {
+      Jmsg2(jcr, M_FATAL, 0, "Unlock %s table %s\n", table, mdb->errmsg);
+      goto bail_out;
+   }
+   retval = true;
+
+bail_out:
+   *lock_time += get_current_btime() - start;
+   return retval;
+}
+
 /*
  * Returns true if OK
  *         false if failed
@@ -788,6 +863,9 @@ bool db_write_batch_file_records(JCR *jcr)
 {
    bool retval = false;
    int JobStatus = jcr->JobStatus;
+   B_DB *mdb = jcr->db_batch;
+   btime_t lock_time = 0;
+   int stale;
 
    if (!jcr->batch_started) {         /* no files to backup ? */
       Dmsg0(50,"db_create_file_record : no files\n");
@@ -810,10 +888,10 @@ bool db_write_batch_file_records(JCR *jcr)
       }
    }
 
-   Dmsg1(50,"db_create_file_record changes=%u\n",jcr->db_batch->changes);
+   Dmsg1(50,"db_create_file_record changes=%u\n",mdb->changes);
 
-   if (!sql_batch_end(jcr, jcr->db_batch, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Batch end %s\n", jcr->db_batch->errmsg);
+   if (!sql_batch_end(jcr, mdb, NULL)) {
+      Jmsg1(jcr, M_FATAL, 0, "Batch end %s\n", mdb->errmsg);
       goto bail_out;
    }
    if (job_canceled(jcr)) {
@@ -821,66 +899,147 @@ bool db_write_batch_file_records(JCR *jcr)
    }
 
    /*
-    * We have to lock tables
+    * The cached Ids are checked with the primary keys, no need to
+    *  lock the tables. A Path or Filename record is never updated.
     */
-   if (!db_sql_query(jcr->db_batch, batch_lock_path_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Lock Path table %s\n", jcr->db_batch->errmsg);
-      goto bail_out;
-   }
-
-   if (!db_sql_query(jcr->db_batch, batch_fill_path_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Fill Path table %s\n",jcr->db_batch->errmsg);
-      db_sql_query(jcr->db_batch, batch_unlock_tables_query[db_get_type_index(jcr->db_batch)], NULL, NULL);
-      goto bail_out;
+   if (mdb->batch_path_hits) {
+      stale = db_reset_stale_batch_ids(jcr, mdb,
+         "UPDATE batch SET PathId = 0 WHERE PathId > 0 AND NOT EXISTS "
+           "(SELECT 1 FROM Path WHERE Path.PathId = batch.PathId "
+                                 "AND Path.Path = batch.Path)");
+      if (stale < 0) {
+         Jmsg1(jcr, M_FATAL, 0, "%s", mdb->errmsg);
+         goto bail_out;
+      }
+      if (stale > 0) {
+         Dmsg1(50, "%d cached PathIds are wrong, flush the cache\n", stale);
+         mdb->path_cache->flush();
+         mdb->batch_path_hits -= stale;
+         mdb->batch_path_misses += stale;
+      }
    }
-
-   if (!db_sql_query(jcr->db_batch, batch_unlock_tables_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Unlock Path table %s\n", jcr->db_batch->errmsg);
-      goto bail_out;
+   if (mdb->batch_filename_hits) {
+      stale = db_reset_stale_batch_ids(jcr, mdb,
+         "UPDATE batch SET FilenameId = 0 WHERE FilenameId > 0 AND NOT EXISTS "
+           "(SELECT 1 FROM Filename WHERE Filename.FilenameId = batch.FilenameId "
+                                     "AND Filename.Name = batch.Name)");
+      if (stale < 0) {
+         Jmsg1(jcr, M_FATAL, 0, "%s", mdb->errmsg);
+         goto bail_out;
+      }
+      if (stale > 0) {
+         Dmsg1(50, "%d cached FilenameIds are wrong, flush the cache\n", stale);
+         mdb->filename_cache->flush();
+         mdb->batch_filename_hits -= stale;
+         mdb->batch_filename_misses += stale;
+      }
    }
 
    /*
-    * We have to lock tables
+    * Only the rows without a cached Id need the locked fill queries
     */
-   if (!db_sql_query(jcr->db_batch, batch_lock_filename_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Lock Filename table %s\n", jcr->db_batch->errmsg);
+   if (mdb->batch_path_misses &&
+       !db_fill_batch_table(jcr, mdb, "Path",
+                            batch_lock_path_query[db_get_type_index(mdb)],
+                            batch_fill_path_query[db_get_type_index(mdb)],
+                            &lock_time)) {
       goto bail_out;
    }
 
-   if (!db_sql_query(jcr->db_batch, batch_fill_filename_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr,M_FATAL,0,"Fill Filename table %s\n",jcr->db_batch->errmsg);
-      db_sql_query(jcr->db_batch, batch_unlock_tables_query[db_get_type_index(jcr->db_batch)], NULL, NULL);
+   if (mdb->batch_filename_misses &&
+       !db_fill_batch_table(jcr, mdb, "Filename",
+                            batch_lock_filename_query[db_get_type_index(mdb)],
+                            batch_fill_filename_query[db_get_type_index(mdb)],
+                            &lock_time)) {
       goto bail_out;
    }
 
-   if (!db_sql_query(jcr->db_batch, batch_unlock_tables_query[db_get_type_index(jcr->db_batch)], NULL, NULL)) {
-      Jmsg1(jcr, M_FATAL, 0, "Unlock Filename table %s\n", jcr->db_batch->errmsg);
+   if (mdb->batch_path_hits && mdb->batch_filename_hits &&
+       !db_sql_query(mdb,
+"INSERT INTO File (FileIndex, JobId, PathId, FilenameId, LStat, MD5, DeltaSeq) "
+    "SELECT FileIndex, JobId, PathId, FilenameId, LStat, MD5, DeltaSeq "
+      "FROM batch "
+     "WHERE PathId > 0 AND FilenameId > 0",
+                     NULL, NULL))
+   {
+      Jmsg1(jcr, M_FATAL, 0, "Fill File table %s\n", mdb->errmsg);
       goto bail_out;
    }
 
-   if (!db_sql_query(jcr->db_batch,
+   if ((mdb->batch_path_misses || mdb->batch_filename_misses) &&
+       !db_sql_query(mdb,
 "INSERT INTO File (FileIndex, JobId, PathId, FilenameId, LStat, MD5, DeltaSeq) "
     "SELECT batch.FileIndex, batch.JobId, Path.PathId, "
            "Filename.FilenameId,batch.LStat, batch.MD5, batch.DeltaSeq "
       "FROM batch "
       "JOIN Path ON (batch.Path = Path.Path) "
-      "JOIN Filename ON (batch.Name = Filename.Name)",
+      "JOIN Filename ON (batch.Name = Filename.Name) "
+     "WHERE batch.PathId = 0 OR batch.FilenameId = 0",
                      NULL, NULL))
    {
-      Jmsg1(jcr, M_FATAL, 0, "Fill File table %s\n", jcr->db_batch->errmsg);
+      Jmsg1(jcr, M_FATAL, 0, "Fill File table %s\n", mdb->errmsg);
       goto bail_out;
    }
 
+   /*
+    * Keep the new Ids for the next jobs, a failure only costs misses
+    */
+   if (mdb->path_cache && mdb->batch_path_misses &&
+       !db_sql_query(mdb,
+          "SELECT DISTINCT batch.Path, Path.PathId FROM batch "
+            "JOIN Path ON (batch.Path = Path.Path) WHERE batch.PathId = 0",
+                     db_id_cache_handler, mdb->path_cache)) {
+      Dmsg1(50, "Cannot load PathIds into the cache: %s\n", mdb->errmsg);
+   }
+   if (mdb->filename_cache && mdb->batch_filename_misses &&
+       !db_sql_query(mdb,
+          "SELECT DISTINCT batch.Name, Filename.FilenameId FROM batch "
+            "JOIN Filename ON (batch.Name = Filename.Name) WHERE batch.FilenameId = 0",
+                     db_id_cache_handler, mdb->filename_cache)) {
+      Dmsg1(50, "Cannot load FilenameIds into the cache: %s\n", mdb->errmsg);
+   }
+
+   if (mdb->path_cache) {
+      Jmsg(jcr, M_INFO, 0, _("Catalog Id cache: Path %u/%u Filename %u/%u hits, "
+           "%.3f secs under table locks\n"),
+           mdb->batch_path_hits, mdb->batch_path_hits + mdb->batch_path_misses,
+           mdb->batch_filename_hits, mdb->batch_filename_hits + mdb->batch_filename_misses,
+           (double)lock_time / 1000000);
+   } else {
+      Dmsg1(50, "%.3f secs under table locks\n", (double)lock_time / 1000000);
+   }
+
    jcr->JobStatus = JobStatus;         /* reset entry status */
    retval = true;
 
 bail_out:
-   db_sql_query(jcr->db_batch, "DROP TABLE batch", NULL,NULL);
+   db_sql_query(mdb, "DROP TABLE batch", NULL,NULL);
+   mdb->batch_path_hits = mdb->batch_path_misses = 0;
+   mdb->batch_filename_hits = mdb->batch_filename_misses = 0;
    jcr->batch_started = false;
 
    return retval;
 }
 
+/*
+ * Look up the Ids of mdb->path and mdb->fname in the caches,
+ *  the Ids not found are left to 0.
+ */
+static void batch_lookup_ids(B_DB *mdb, ATTR_DBR *ar)
+{
+   ar->PathId = ar->FilenameId = 0;
+   if (mdb->path_cache && mdb->path_cache->lookup(mdb->path, mdb->pnl, &ar->PathId)) {
+      mdb->batch_path_hits++;
+   } else {
+      mdb->batch_path_misses++;
+   }
+   if (mdb->filename_cache && mdb->filename_cache->lookup(mdb->fname, mdb->fnl, &ar->FilenameId)) {
+      mdb->batch_filename_hits++;
+   } else {
+      mdb->batch_filename_misses++;
+   }
+}
+
 /**
  * Create File record in B_DB
  *
@@ -921,6 +1080,7 @@ bool db_create_batch_file_attributes_record(JCR *jcr, B_DB *mdb, ATTR_DBR *ar)
    }
 
    split_path_and_file(jcr, jcr->db_batch, ar->fname);
+   batch_lookup_ids(jcr->db_batch, ar);
 
    return sql_batch_insert(jcr, jcr->db_batch, ar);
 }
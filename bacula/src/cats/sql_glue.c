@@ -98,6 +98,16 @@ void db_end_transaction(JCR *jcr, B_DB *mdb)
    mdb->db_end_transaction(jcr);
 }
 
+void db_set_batch_size(B_DB *mdb, uint32_t size)
+{
+   mdb->set_batch_size(size);
+}
+
+uint32_t db_get_batch_size(B_DB *mdb)
+{
+   return mdb->get_batch_size();
+}
+
 bool db_sql_query(B_DB *mdb, const char *query, int flags)
 {
    mdb->errmsg[0] = 0;
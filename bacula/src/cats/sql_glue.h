@@ -38,6 +38,8 @@ void db_unescape_object(JCR *jcr, B_DB *mdb,
                         POOLMEM **dest, int32_t *len);
 void db_start_transaction(JCR *jcr, B_DB *mdb);
 void db_end_transaction(JCR *jcr, B_DB *mdb);
+void db_set_batch_size(B_DB *mdb, uint32_t size);
+uint32_t db_get_batch_size(B_DB *mdb);
 bool db_sql_query(B_DB *mdb, const char *query, int flags=0);
 bool db_sql_query(B_DB *mdb, const char *query, DB_RESULT_HANDLER *result_handler, void *ctx);
 bool db_big_sql_query(B_DB *mdb, const char *query, DB_RESULT_HANDLER *result_handler, void *ctx);
@@ -99,6 +99,8 @@ B_DB_SQLITE::B_DB_SQLITE(JCR *jcr,
    esc_path = get_pool_memory(PM_FNAME);
    esc_obj  = get_pool_memory(PM_FNAME);
    m_allow_transactions = mult_db_connections;
+   batch_size_init(SQLITE_CHANGES_PER_BATCH_INSERT, SQLITE_MIN_CHANGES_PER_BATCH_INSERT,
+                   SQLITE_MAX_CHANGES_PER_BATCH_INSERT);
 
    /* At this time, when mult_db_connections == true, this is for
     * specific console command such as bvfs or batch mode, and we don't
@@ -113,6 +115,7 @@ B_DB_SQLITE::B_DB_SQLITE(JCR *jcr,
    m_db_handle = NULL;
    m_result = NULL;
    m_sqlite_errmsg = NULL;
+   m_batch_stmt = NULL;
 
    /*
     * Put the db in the list.
@@ -227,6 +230,9 @@ void B_DB_SQLITE::db_close_database(JCR *jcr)
          sql_free_result();
       }
       db_list->remove(this);
+      if (m_batch_stmt) {
+         sqlite3_finalize(m_batch_stmt);
+      }
       if (m_connected && m_db_handle) {
          sqlite3_close(m_db_handle);
       }
@@ -635,6 +641,11 @@ bool B_DB_SQLITE::sql_field_is_numeric(int field_type)
    }
 }
 
+/*
+ * In batch mode, the rows are inserted with a prepared statement
+ * in transactions of m_batch_size rows, see batch_size_tune().
+ */
+
 /*
  * Returns true if OK
  *         false if failed
@@ -651,12 +662,51 @@ bool B_DB_SQLITE::sql_batch_start(JCR *jcr)
                               "Name blob,"
                               "LStat tinyblob,"
                               "MD5 tinyblob,"
-                              "DeltaSeq integer)");
+                              "DeltaSeq integer,"
+                              "PathId integer,"
+                              "FilenameId integer)");
+   if (retval) {
+      if (sqlite3_prepare_v2(m_db_handle, "INSERT INTO batch VALUES (?,?,?,?,?,?,?,?,?)",
+                             -1, &m_batch_stmt, NULL) != SQLITE_OK) {
+         Mmsg1(&errmsg, _("error starting batch mode: %s"), sqlite3_errmsg(m_db_handle));
+         m_batch_stmt = NULL;
+         retval = false;
+      } else {
+         retval = sql_batch_begin();
+      }
+   }
    db_unlock(this);
+   changes = 0;
 
    return retval;
 }
 
+bool B_DB_SQLITE::sql_batch_begin()
+{
+   if (!sql_query("BEGIN")) {
+      Mmsg1(&errmsg, _("error starting batch mode: %s"), sql_strerror());
+      return false;
+   }
+   m_batch_begin = get_current_btime();
+   return true;
+}
+
+/*
+ * Commit the rows inserted since sql_batch_begin(), and tune
+ *  the number of rows of the next transactions with the time
+ *  it all took.
+ */
+bool B_DB_SQLITE::sql_batch_commit()
+{
+   if (!sql_query("COMMIT")) {
+      Mmsg1(&errmsg, _("error committing batch mode: %s"), sql_strerror());
+      return false;
+   }
+   batch_size_tune(changes, get_current_btime() - m_batch_begin);
+   changes = 0;
+   return true;
+}
+
 /* set error to something to abort operation */
 /*
  * Returns true if OK
@@ -664,9 +714,17 @@ bool B_DB_SQLITE::sql_batch_start(JCR *jcr)
  */
 bool B_DB_SQLITE::sql_batch_end(JCR *jcr, const char *error)
 {
+   bool retval = true;
+
    m_status = 0;
 
-   return true;
+   if (m_batch_stmt) {
+      sqlite3_finalize(m_batch_stmt);
+      m_batch_stmt = NULL;
+      retval = sql_batch_commit();
+   }
+
+   return retval;
 }
 
 /*
@@ -676,13 +734,7 @@ bool B_DB_SQLITE::sql_batch_end(JCR *jcr, const char *error)
 bool B_DB_SQLITE::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
 {
    const char *digest;
-   char ed1[50];
-
-   esc_name = check_pool_memory_size(esc_name, fnl*2+1);
-   db_escape_string(jcr, esc_name, fname, fnl);
-
-   esc_path = check_pool_memory_size(esc_path, pnl*2+1);
-   db_escape_string(jcr, esc_path, path, pnl);
+   int stat;
 
    if (ar->Digest == NULL || ar->Digest[0] == 0) {
       digest = "0";
@@ -690,12 +742,29 @@ bool B_DB_SQLITE::sql_batch_insert(JCR *jcr, ATTR_DBR *ar)
       digest = ar->Digest;
    }
 
-   Mmsg(cmd, "INSERT INTO batch VALUES "
-        "(%u,%s,'%s','%s','%s','%s',%u)",
-        ar->FileIndex, edit_int64(ar->JobId,ed1), esc_path,
-        esc_name, ar->attr, digest, ar->DeltaSeq);
+   /*
+    * Bound values are not parsed, no need to escape them
+    */
+   sqlite3_bind_int64(m_batch_stmt, 1, ar->FileIndex);
+   sqlite3_bind_int64(m_batch_stmt, 2, ar->JobId);
+   sqlite3_bind_text(m_batch_stmt, 3, path, pnl, SQLITE_STATIC);
+   sqlite3_bind_text(m_batch_stmt, 4, fname, fnl, SQLITE_STATIC);
+   sqlite3_bind_text(m_batch_stmt, 5, ar->attr, -1, SQLITE_STATIC);
+   sqlite3_bind_text(m_batch_stmt, 6, digest, -1, SQLITE_STATIC);
+   sqlite3_bind_int64(m_batch_stmt, 7, ar->DeltaSeq);
+   sqlite3_bind_int64(m_batch_stmt, 8, ar->PathId);
+   sqlite3_bind_int64(m_batch_stmt, 9, ar->FilenameId);
+   stat = sqlite3_step(m_batch_stmt);
+   sqlite3_reset(m_batch_stmt);
+   if (stat != SQLITE_DONE) {
+      Mmsg1(&errmsg, _("error inserting batch mode: %s"), sqlite3_errmsg(m_db_handle));
+      return false;
+   }
 
-   return sql_query(cmd);
+   if ((uint32_t)++changes >= m_batch_size) {
+      return sql_batch_commit() && sql_batch_begin();
+   }
+   return true;
 }
 
 /*
@@ -29,6 +29,8 @@
 #define COMPRESS_NONE  0x4e4f4e45  /* used for incompressible block */
 #define COMPRESS_GZIP  0x475a4950
 #define COMPRESS_LZO1X 0x4c5a4f58
+#define COMPRESS_ZSTD  0x5a535444
+#define COMPRESS_LZ4   0x4c5a3442
 
 /*
  * Compression header version
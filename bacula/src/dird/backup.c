@@ -31,13 +31,21 @@
 #include "bacula.h"
 #include "dird.h"
 #include "ua.h"
+#include "cats/bvfs.h"
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 
 /* Commands sent to File daemon */
 static char backupcmd[] = "backup FileIndex=%ld\n";
 static char storaddr[]  = "storage address=%s port=%d ssl=%d\n";
+static char accuratecmd[] = "accurate files=%s format=%d\n";
+static char accuratecachecmd[] = "accuratecache files=%s fileset=%s jobids=%s\n";
 
 /* Responses received from File daemon */
 static char OKbackup[]   = "2000 OK backup\n";
+static char OKaccurate[] = "2000 OK accurate format=%d compress=%d\n";
+static char OKaccuratecache[] = "2000 OK accuratecache found=%d\n";
 static char OKstore[]    = "2000 OK storage\n";
 /* Pre 17 Aug 2013 */
 static char EndJob[]     = "2800 End Job TermCode=%d JobFiles=%u "
@@ -133,16 +141,279 @@ static bool get_base_jobids(JCR *jcr, db_list_ctx *jobids)
    return jobids->count > 0;
 }
 
+/*
+ * The accurate list is sent to a File daemon that knows the binary
+ *  format (accurate format=1, see baconfig.h) in blocks that are
+ *  filled by the catalog query while a second thread compresses
+ *  and sends the previous ones.
+ */
+#define ACC_NB_BLOCKS      4            /* blocks in the pipeline */
+#define ACC_LSTAT_FIELDS   14           /* dev ... ctime LinkFI, compared by the FD */
+#define ACC_MAX_RECORD     (1 + 1 + ACC_LSTAT_FIELDS * 10 + 10 + 1 + 255)
+
+struct ACC_SENDER {
+   JCR *jcr;
+   BSOCK *fd;
+   bool binary;                         /* send format=1 blocks */
+   bool compress;                       /* deflate the blocks */
+   bool thread_started;
+   pthread_t tid;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   POOLMEM *block[ACC_NB_BLOCKS];       /* ring of blocks */
+   int32_t block_len[ACC_NB_BLOCKS];
+   int first;                           /* oldest block to send */
+   int count;                           /* blocks waiting to be sent */
+   int fill;                            /* block being filled */
+   int32_t len;                         /* bytes in the block being filled */
+   POOLMEM *last_path;                  /* path of the last record */
+   bool done;                           /* no more blocks */
+   bool error;                          /* send error */
+   uint64_t nfiles;                     /* files sent */
+   uint64_t raw_bytes;                  /* bytes of records */
+   uint64_t sent_bytes;                 /* bytes sent */
+};
+
+/*
+ * Send a block in a single message, compressed if that helps
+ */
+static bool acc_send_block(ACC_SENDER *s, char *block, int32_t len, POOLMEM *&out)
+{
+   POOLMEM *msg;
+   int32_t n = 0;
+   bool ok;
+   ser_declare;
+
+#ifdef HAVE_LIBZ
+   if (s->compress) {
+      int clen = len + len / 1000 + 64;
+      out = check_pool_memory_size(out, clen + 5);
+      if (Zdeflate(block, len, out + 5, clen, 1) == Z_STREAM_END && clen < len) {
+         ser_begin(out, 5);
+         ser_uint8(ACC_BLOCK_ZLIB);
+         ser_uint32(len);
+         n = clen + 5;
+      }
+   }
+#endif
+   if (n == 0) {
+      out = check_pool_memory_size(out, len + 1);
+      out[0] = ACC_BLOCK_RAW;
+      memcpy(out + 1, block, len);
+      n = len + 1;
+   }
+   msg = s->fd->msg;
+   s->fd->msg = out;
+   s->fd->msglen = n;
+   ok = s->fd->send();
+   s->fd->msg = msg;
+   s->raw_bytes += len;
+   s->sent_bytes += n;
+   return ok;
+}
+
+static void *acc_sender_thread(void *arg)
+{
+   ACC_SENDER *s = (ACC_SENDER *)arg;
+   POOLMEM *out = get_pool_memory(PM_MESSAGE);
+   bool ok;
+   int i;
+
+   for ( ;; ) {
+      P(s->mutex);
+      while (s->count == 0 && !s->done) {
+         pthread_cond_wait(&s->cond, &s->mutex);
+      }
+      if (s->count == 0) {
+         V(s->mutex);
+         break;
+      }
+      i = s->first;
+      ok = !s->error;
+      V(s->mutex);
+
+      if (ok) {
+         ok = acc_send_block(s, s->block[i], s->block_len[i], out);
+      }
+
+      P(s->mutex);
+      if (!ok) {
+         s->error = true;
+      }
+      s->first = (s->first + 1) % ACC_NB_BLOCKS;
+      s->count--;
+      pthread_cond_broadcast(&s->cond);
+      V(s->mutex);
+   }
+   free_pool_memory(out);
+   return NULL;
+}
+
+/*
+ * Queue the block being filled and wait for a free one
+ */
+static bool acc_sender_push(ACC_SENDER *s)
+{
+   bool ok;
+
+   P(s->mutex);
+   s->block_len[s->fill] = s->len;
+   s->count++;
+   pthread_cond_broadcast(&s->cond);
+   while (s->count == ACC_NB_BLOCKS && !s->error) {
+      pthread_cond_wait(&s->cond, &s->mutex);
+   }
+   s->fill = (s->first + s->count) % ACC_NB_BLOCKS;
+   ok = !s->error;
+   V(s->mutex);
+   s->len = 0;
+   return ok;
+}
+
+static ACC_SENDER *new_acc_sender(JCR *jcr, bool binary, bool compress)
+{
+   ACC_SENDER *s = (ACC_SENDER *)malloc(sizeof(ACC_SENDER));
+   int status;
+
+   memset(s, 0, sizeof(ACC_SENDER));
+   s->jcr = jcr;
+   s->fd = jcr->file_bsock;
+   s->binary = binary;
+   s->compress = compress;
+   if (!binary) {
+      return s;
+   }
+   for (int i = 0; i < ACC_NB_BLOCKS; i++) {
+      s->block[i] = get_memory(ACC_BLOCK_SIZE);
+   }
+   s->last_path = get_pool_memory(PM_FNAME);
+   pthread_mutex_init(&s->mutex, NULL);
+   pthread_cond_init(&s->cond, NULL);
+   if ((status = pthread_create(&s->tid, NULL, acc_sender_thread, s)) != 0) {
+      berrno be;
+      Jmsg1(jcr, M_FATAL, 0, _("Cannot create accurate list thread: ERR=%s\n"),
+            be.bstrerror(status));
+      s->error = true;
+   } else {
+      s->thread_started = true;
+   }
+   return s;
+}
+
+/*
+ * Send the last block, wait for the thread and free everything.
+ *  Returns false if the list could not be sent.
+ */
+static bool free_acc_sender(ACC_SENDER *s)
+{
+   bool ok = !s->error;
+
+   if (s->binary) {
+      if (s->thread_started) {
+         if (s->len > 0) {
+            acc_sender_push(s);
+         }
+         P(s->mutex);
+         s->done = true;
+         pthread_cond_broadcast(&s->cond);
+         V(s->mutex);
+         pthread_join(s->tid, NULL);
+         ok = !s->error;
+      }
+      Dmsg4(50, "accurate list: files=%lld raw=%lld sent=%lld compress=%d\n",
+            s->nfiles, s->raw_bytes, s->sent_bytes, s->compress);
+      pthread_cond_destroy(&s->cond);
+      pthread_mutex_destroy(&s->mutex);
+      for (int i = 0; i < ACC_NB_BLOCKS; i++) {
+         free_memory(s->block[i]);
+      }
+      free_pool_memory(s->last_path);
+   }
+   free(s);
+   return ok;
+}
+
+/*
+ * Add a file to the block being filled
+ */
+static bool acc_sender_add(ACC_SENDER *s, char **row, bool chksum)
+{
+   int64_t fields[ACC_LSTAT_FIELDS];
+   char md[255], buf[512];
+   const char *digest = NULL;
+   int path_len, nfields, digest_len = 0;
+   uint8_t flags = 0;
+   POOLMEM *block;
+   ser_declare;
+
+   if (chksum) {
+      /* Binary digest if we can edit it back the same */
+      int len = strlen(row[6]);
+      digest_len = base64_to_bin(md, sizeof(md), row[6], len);
+      if (digest_len > 0 && len < (int)sizeof(buf) &&
+          bin_to_base64(buf, sizeof(buf), md, digest_len, true) == len &&
+          memcmp(buf, row[6], len) == 0) {
+         flags |= ACC_REC_DIGEST;
+         digest = md;
+      } else if (len <= 255) {
+         flags |= ACC_REC_DIGEST_TEXT;
+         digest = row[6];
+         digest_len = len;
+      } else {
+         digest_len = 0;
+      }
+   }
+
+   path_len = strlen(row[0]);
+   if (s->len + path_len + strlen(row[1]) + 2 + ACC_MAX_RECORD > ACC_BLOCK_SIZE &&
+       s->len > 0) {
+      if (!acc_sender_push(s)) {
+         return false;
+      }
+   }
+   if (s->len == 0 || strcmp(s->last_path, row[0]) != 0) {
+      flags |= ACC_REC_PATH;
+      pm_strcpy(s->last_path, row[0]);
+   }
+
+   /* A block holds at least one record, however long its name */
+   s->block[s->fill] = check_pool_memory_size(s->block[s->fill],
+                          s->len + path_len + strlen(row[1]) + 2 + ACC_MAX_RECORD);
+   block = s->block[s->fill];
+   ser_begin(block + s->len, ACC_MAX_RECORD);
+   ser_uint8(flags);
+   if (flags & ACC_REC_PATH) {
+      ser_string(row[0]);
+   }
+   ser_string(row[1]);
+   nfields = from_base64_list(fields, ACC_LSTAT_FIELDS, row[4]);
+   ser_uint8(nfields);
+   for (int i = 0; i < nfields; i++) {
+      ser_svarint(fields[i]);
+   }
+   ser_varint((uint32_t)str_to_int64(row[5]));
+   if (digest) {
+      ser_uint8(digest_len);
+      ser_bytes(digest, digest_len);
+   }
+   s->len += ser_length(block + s->len);
+   s->nfiles++;
+   return true;
+}
+
 /*
  * Foreach files in currrent list, send "/path/fname\0LStat\0MD5\0Delta" to FD
+ *  or add it to the current binary block.
  *      row[0]=Path, row[1]=Filename, row[2]=FileIndex
  *      row[3]=JobId row[4]=LStat row[5]=DeltaSeq row[6]=MD5
  */
 static int accurate_list_handler(void *ctx, int num_fields, char **row)
 {
-   JCR *jcr = (JCR *)ctx;
+   ACC_SENDER *s = (ACC_SENDER *)ctx;
+   JCR *jcr = s->jcr;
+   bool chksum;
 
-   if (job_canceled(jcr)) {
+   if (job_canceled(jcr) || s->error) {
       return 1;
    }
 
@@ -151,11 +422,15 @@ static int accurate_list_handler(void *ctx, int num_fields, char **row)
    }
 
    /* sending with checksum */
-   if (jcr->use_accurate_chksum
-       && num_fields == 7
-       && row[6][0] /* skip checksum = '0' */
-       && row[6][1])
-   {
+   chksum = jcr->use_accurate_chksum
+      && num_fields == 7
+      && row[6][0] /* skip checksum = '0' */
+      && row[6][1];
+
+   if (s->binary) {
+      return acc_sender_add(s, row, chksum) ? 0 : 1;
+   }
+   if (chksum) {
       jcr->file_bsock->fsend("%s%s%c%s%c%s%c%s",
                              row[0], row[1], 0, row[4], 0, row[6], 0, row[5]);
    } else {
@@ -225,6 +500,39 @@ static bool is_checksum_needed_by_fileset(JCR *jcr)
    return false;
 }
 
+static bool send_accurate_file_list(JCR *jcr, db_list_ctx *jobids, ACC_SENDER *sender);
+
+/*
+ * Tell a File daemon that can keep the file list of its last job
+ *  (Accurate Cache) the JobIds of the accurate list of this one,
+ *  none for a Full.  found is set when it has them, and the list
+ *  must not be sent.
+ *    DIR -> FD : accuratecache files=xxx fileset=<md5> jobids=<jobids|none>
+ *    FD -> DIR : 2000 OK accuratecache found=0|1
+ */
+static bool send_accurate_cache_cmd(JCR *jcr, const char *nb, const char *jobids,
+                                    bool *found)
+{
+   BSOCK *fd = jcr->file_bsock;
+   int ok_found;
+
+   *found = false;
+   if (jcr->FDVersion < 7 || !jcr->fileset->MD5[0] ||
+       strcmp(jcr->fileset->MD5, "**Dummy**") == 0) {
+      return true;
+   }
+   fd->fsend(accuratecachecmd, nb, jcr->fileset->MD5, jobids);
+   if (bget_dirmsg(fd) <= 0 ||
+       sscanf(fd->msg, OKaccuratecache, &ok_found) != 1) {
+      Jmsg(jcr, M_FATAL, 0, _("Bad response to accuratecache command: %s\n"),
+           fd->msg);
+      return false;
+   }
+   *found = ok_found != 0;
+   Dmsg2(50, "accurate cache jobids=%s found=%d\n", jobids, ok_found);
+   return true;
+}
+
 /*
  * Send current file list to FD
  *    DIR -> FD : accurate files=xxxx
@@ -232,6 +540,13 @@ static bool is_checksum_needed_by_fileset(JCR *jcr)
  *    DIR -> FD : /path/to/dir/\0Lstat\0MD5\0Delta
  *    ...
  *    DIR -> FD : EOD
+ *
+ * or, if the FD knows it
+ *    DIR -> FD : accurate files=xxxx format=1
+ *    FD -> DIR : 2000 OK accurate format=1 compress=0|1
+ *    DIR -> FD : block of binary records
+ *    ...
+ *    DIR -> FD : EOD
  */
 bool send_accurate_current_files(JCR *jcr)
 {
@@ -239,6 +554,10 @@ bool send_accurate_current_files(JCR *jcr)
    db_list_ctx jobids;
    db_list_ctx nb;
    char ed1[50];
+   BSOCK *fd = jcr->file_bsock;
+   ACC_SENDER *sender;
+   int format = 0, compress = 0;
+   bool ok, found;
 
    if (jcr->is_canceled() || jcr->is_JobLevel(L_BASE)) {
       return true;
@@ -253,7 +572,8 @@ bool send_accurate_current_files(JCR *jcr)
          jcr->HasBase = true;
          Jmsg(jcr, M_INFO, 0, _("Using BaseJobId(s): %s\n"), jobids.list);
       } else if (!jcr->rerunning) {
-         return true;
+         /* Let the FD start its accurate cache */
+         return send_accurate_cache_cmd(jcr, "0", "none", &found);
       }
    } else {
       /* For Incr/Diff level, we search for older jobs */
@@ -274,15 +594,38 @@ bool send_accurate_current_files(JCR *jcr)
    /* Don't send and store the checksum if fileset doesn't require it */
    jcr->use_accurate_chksum = is_checksum_needed_by_fileset(jcr);
 
-   if (jcr->JobId) {            /* display the message only for real jobs */
-      Jmsg(jcr, M_INFO, 0, _("Sending Accurate information to the FD.\n"));
-   }
-
    /* to be able to allocate the right size for htable */
    Mmsg(buf, "SELECT sum(JobFiles) FROM Job WHERE JobId IN (%s)", jobids.list);
    db_sql_query(jcr->db, buf.c_str(), db_list_handler, &nb);
    Dmsg2(200, "jobids=%s nb=%s\n", jobids.list, nb.list);
-   jcr->file_bsock->fsend("accurate files=%s\n", nb.list);
+
+   /* The FD may still have the list of the last job */
+   if (!jcr->HasBase && !jcr->rerunning) {
+      if (!send_accurate_cache_cmd(jcr, nb.list, jobids.list, &found)) {
+         return false;
+      }
+      if (found) {
+         return true;
+      }
+   }
+
+   if (jcr->JobId) {            /* display the message only for real jobs */
+      Jmsg(jcr, M_INFO, 0, _("Sending Accurate information to the FD.\n"));
+   }
+   if (jcr->FDVersion >= 6) {
+      fd->fsend(accuratecmd, nb.list, 1);
+      if (bget_dirmsg(fd) <= 0 ||
+          sscanf(fd->msg, OKaccurate, &format, &compress) != 2) {
+         Jmsg(jcr, M_FATAL, 0, _("Bad response to accurate command: %s\n"),
+              fd->msg);
+         return false;
+      }
+   } else {
+      fd->fsend("accurate files=%s\n", nb.list);
+   }
+#ifndef HAVE_LIBZ
+   compress = 0;
+#endif
 
    if (!db_open_batch_connexion(jcr, jcr->db)) {
       Jmsg0(jcr, M_FATAL, 0, "Can't get batch sql connexion");
@@ -291,27 +634,46 @@ bool send_accurate_current_files(JCR *jcr)
 
    if (jcr->HasBase) {
       jcr->nb_base_files = str_to_int64(nb.list);
-      if (!db_create_base_file_list(jcr, jcr->db, jobids.list)) {
+   }
+   sender = new_acc_sender(jcr, format == 1, compress != 0);
+   fd->begin_batch();
+   ok = send_accurate_file_list(jcr, &jobids, sender);
+   if (!free_acc_sender(sender) && ok) {
+      Jmsg(jcr, M_FATAL, 0, _("Network error sending the accurate list to the FD.\n"));
+      ok = false;
+   }
+
+   /* TODO: close the batch connection ? (can be used very soon) */
+   fd->signal(BNET_EOD);
+   fd->end_batch();
+   return ok;
+}
+
+/*
+ * Run the catalog query of the accurate list, each file goes
+ *  to accurate_list_handler()
+ */
+static bool send_accurate_file_list(JCR *jcr, db_list_ctx *jobids, ACC_SENDER *sender)
+{
+   if (jcr->HasBase) {
+      if (!db_create_base_file_list(jcr, jcr->db, jobids->list)) {
          Jmsg1(jcr, M_FATAL, 0, "%s", db_strerror(jcr->db));
          return false;
       }
       if (!db_get_base_file_list(jcr, jcr->db, jcr->use_accurate_chksum,
-                            accurate_list_handler, (void *)jcr)) {
+                            accurate_list_handler, (void *)sender)) {
          Jmsg1(jcr, M_FATAL, 0, "%s", db_strerror(jcr->db));
          return false;
       }
 
    } else {
       if (!db_get_file_list(jcr, jcr->db_batch,
-                       jobids.list, jcr->use_accurate_chksum, false /* no delta */,
-                       accurate_list_handler, (void *)jcr)) {
+                       jobids->list, jcr->use_accurate_chksum, false /* no delta */,
+                       accurate_list_handler, (void *)sender)) {
          Jmsg1(jcr, M_FATAL, 0, "%s", db_strerror(jcr->db));
          return false;
       }
    }
-
-   /* TODO: close the batch connection ? (can be used very soon) */
-   jcr->file_bsock->signal(BNET_EOD);
    return true;
 }
 
@@ -928,6 +1290,10 @@ void backup_cleanup(JCR *jcr, int TermCode)
         sd_term_msg,
         term_msg);
 
+   if (jcr->job->UpdateBvfsCache &&
+       (TermCode == JS_Terminated || TermCode == JS_Warnings)) {
+      update_bvfs_cache_in_background(jcr);
+   }
    Dmsg0(100, "Leave backup_cleanup()\n");
 }
 
@@ -1001,3 +1367,103 @@ void update_bootstrap_file(JCR *jcr)
       free_pool_memory(fname);
    }
 }
+
+/*
+ * Jobs waiting for their Bvfs cache to be updated
+ */
+struct bvfs_update_item {
+   dlink link;
+   JobId_t JobId;
+   char catalog[MAX_NAME_LENGTH];     /* Catalog resource name */
+};
+
+static dlist *bvfs_update_queue = NULL;
+static bool bvfs_updater_running = false;
+static pthread_mutex_t bvfs_update_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Update the Bvfs cache of the queued jobs, with a catalog
+ *  connection of our own, and exit when the queue is empty.
+ */
+extern "C" void *bvfs_updater(void *arg)
+{
+   bvfs_update_item *item;
+   CAT *catalog;
+   B_DB *db;
+   JCR *jcr;
+   char ed1[50];
+
+   pthread_detach(pthread_self());
+   jcr = new_control_jcr("*BvfsUpdate*", JT_SYSTEM);
+   for ( ;; ) {
+      P(bvfs_update_mutex);
+      item = (bvfs_update_item *)bvfs_update_queue->first();
+      if (!item) {
+         bvfs_updater_running = false;
+         V(bvfs_update_mutex);
+         break;
+      }
+      bvfs_update_queue->remove(item);
+      V(bvfs_update_mutex);
+
+      db = NULL;
+      LockRes();
+      catalog = (CAT *)GetResWithName(R_CATALOG, item->catalog);
+      if (catalog) {
+         db = db_init_database(jcr, catalog->db_driver, catalog->db_name,
+                               catalog->db_user, catalog->db_password,
+                               catalog->db_address, catalog->db_port,
+                               catalog->db_socket, true /* own connection */,
+                               catalog->disable_batch_insert);
+      }
+      UnlockRes();
+      if (!db || !db_open_database(jcr, db)) {
+         Jmsg(jcr, M_ERROR, 0, _("Could not open Catalog \"%s\" to update the Bvfs cache of JobId %d.\n"),
+              item->catalog, (int)item->JobId);
+      } else {
+         Dmsg1(100, "Update Bvfs cache for JobId=%d\n", (int)item->JobId);
+         if (!bvfs_update_path_hierarchy_cache(jcr, db, edit_uint64(item->JobId, ed1))) {
+            Jmsg(jcr, M_ERROR, 0, _("Could not update the Bvfs cache of JobId %d.\n"),
+                 (int)item->JobId);
+         }
+      }
+      if (db) {
+         db_close_database(jcr, db);
+      }
+      free(item);
+   }
+   free_jcr(jcr);
+   return NULL;
+}
+
+/*
+ * Queue the job to have its Bvfs cache updated after it
+ *  terminates, without delaying the end of the job.
+ */
+void update_bvfs_cache_in_background(JCR *jcr)
+{
+   bvfs_update_item *item = NULL;
+   pthread_t thid;
+   int stat;
+
+   P(bvfs_update_mutex);
+   if (!bvfs_update_queue) {
+      bvfs_update_queue = New(dlist(item, &item->link));
+   }
+   item = (bvfs_update_item *)malloc(sizeof(bvfs_update_item));
+   item->JobId = jcr->JobId;
+   bstrncpy(item->catalog, jcr->catalog->name(), sizeof(item->catalog));
+   bvfs_update_queue->append(item);
+   if (!bvfs_updater_running) {
+      if ((stat = pthread_create(&thid, NULL, bvfs_updater, NULL)) != 0) {
+         berrno be;
+         bvfs_update_queue->remove(item);
+         free(item);
+         Jmsg(jcr, M_WARNING, 0, _("Cannot create Bvfs update thread: %s\n"),
+              be.bstrerror(stat));
+      } else {
+         bvfs_updater_running = true;
+      }
+   }
+   V(bvfs_update_mutex);
+}
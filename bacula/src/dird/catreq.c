@@ -578,6 +578,10 @@ static void update_attribute(JCR *jcr, char *msg, int32_t msglen)
             len = CRYPTO_DIGEST_SHA512_SIZE;
             type = CRYPTO_DIGEST_SHA512;
             break;
+         case STREAM_XXH64_DIGEST:
+            len = CRYPTO_DIGEST_XXH64_SIZE;
+            type = CRYPTO_DIGEST_XXH64;
+            break;
          default:
             /* Never reached ... */
             Jmsg(jcr, M_ERROR, 0, _("Catalog error updating file digest. Unsupported digest stream type: %d"),
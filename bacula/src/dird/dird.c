@@ -323,6 +323,7 @@ int main (int argc, char *argv[])
    Dmsg0(200, "Start UA server\n");
    start_UA_server(director->DIRaddrs);
 
+   start_message_dispatcher();        /* deliver messages in background */
    start_watchdog();                  /* start network watchdog thread */
 
    init_jcr_subsystem();              /* start JCR watchdogs etc. */
@@ -380,6 +381,7 @@ void terminate_dird(int sig)
       config = NULL;
    }
    term_ua_server();
+   db_free_id_caches();
    term_msg();                        /* terminate message handler */
    cleanup_crypto();
    close_memory_pool();               /* release free memory in pool */
@@ -71,6 +71,14 @@ typedef struct {
    POOLMEM *content;
 } plugin_config_item;
 
+/* A scheduled run of a Job, see find_next_runs() */
+struct sched_run {
+   JOB *job;
+   RUN *run;
+   time_t runtime;                    /* time to run */
+   int Priority;
+};
+
 struct idpkt {
    POOLMEM *list;
    uint32_t count;
@@ -250,6 +250,7 @@ static RES_ITEM cat_items[] = {
    /* Turned off for the moment */
    {"multipleconnections", store_bit, ITEM(res_cat.mult_db_connections), 0, 0, 0},
    {"disablebatchinsert", store_bool, ITEM(res_cat.disable_batch_insert), 0, ITEM_DEFAULT, false},
+   {"idcachesize", store_pint32, ITEM(res_cat.id_cache_size), 0, ITEM_DEFAULT, 100000},
    {NULL, NULL, {0}, 0, 0, 0}
 };
 
@@ -311,6 +312,7 @@ RES_ITEM job_items[] = {
    {"enabled",     store_bool, ITEM(res_job.enabled), 0, ITEM_DEFAULT, true},
    {"spoolattributes",store_bool, ITEM(res_job.SpoolAttributes), 0, ITEM_DEFAULT, false},
    {"spooldata",   store_bool, ITEM(res_job.spool_data), 0, ITEM_DEFAULT, false},
+   {"updatebvfscache", store_bool, ITEM(res_job.UpdateBvfsCache), 0, ITEM_DEFAULT, false},
    {"spoolsize",   store_size64, ITEM(res_job.spool_size), 0, 0, 0},
    {"rerunfailedlevels",   store_bool, ITEM(res_job.rerun_failed_levels), 0, ITEM_DEFAULT, false},
    {"prefermountedvolumes", store_bool, ITEM(res_job.PreferMountedVolumes), 0, ITEM_DEFAULT, true},
@@ -659,11 +661,11 @@ void dump_resource(int type, RES *reshdr, void sendit(void *sock, const char *fm
          break;
       }
       sendit(sock, _("Catalog: name=%s address=%s DBport=%d db_name=%s\n"
-"      db_driver=%s db_user=%s MutliDBConn=%d\n"),
+"      db_driver=%s db_user=%s MutliDBConn=%d IdCacheSize=%u\n"),
          res->res_cat.hdr.name, NPRT(res->res_cat.db_address),
          res->res_cat.db_port, res->res_cat.db_name,
          NPRT(res->res_cat.db_driver), NPRT(res->res_cat.db_user),
-         res->res_cat.mult_db_connections);
+         res->res_cat.mult_db_connections, res->res_cat.id_cache_size);
       break;
 
    case R_JOB:
@@ -224,6 +224,7 @@ public:
    char *db_driver;                   /* Select appropriate driver */
    uint32_t mult_db_connections;      /* set if multiple connections wanted */
    bool disable_batch_insert;         /* set if batch inserts should be disabled */
+   uint32_t id_cache_size;            /* Path and Filename Ids cached, 0 = no cache */
 
    /* Methods */
    char *name() const;
@@ -424,6 +425,7 @@ public:
    bool PruneVolumes;                 /* Force pruning of Volumes */
    bool SpoolAttributes;              /* Set to spool attributes in SD */
    bool spool_data;                   /* Set to spool data in SD */
+   bool UpdateBvfsCache;              /* Update the Bvfs cache after the job */
    bool rerun_failed_levels;          /* Upgrade to rerun failed levels */
    bool PreferMountedVolumes;         /* Prefer vols mounted rather than new one */
    bool write_part_after_job;         /* Set to write part after job in SD */
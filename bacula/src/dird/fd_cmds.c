@@ -386,10 +386,18 @@ static bool send_fileset(JCR *jcr)
                bool done=false;         /* print warning only if compression enabled in FS */
                int j = 0;
                for (k=0; fo->opts[k]!='\0'; k++) {
-                 /* Z compress option is followed by the single-digit compress level or 'o' */
+                 /*
+                  * Z compress option is followed by the single-digit compress level,
+                  *  'o', 'l', or 'z' and the zstd level
+                  */
                  if (fo->opts[k]=='Z') {
                     done=true;
                     k++;                /* skip option and level */
+                    if (fo->opts[k]=='z') {
+                       while (B_ISDIGIT(fo->opts[k+1])) {
+                          k++;
+                       }
+                    }
                  } else {
                     newopts[j] = fo->opts[k];
                     j++;
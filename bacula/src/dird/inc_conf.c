@@ -205,6 +205,7 @@ static struct s_fs_opt FS_options[] = {
    {"sha1",     INC_KW_DIGEST,        "S"},
    {"sha256",   INC_KW_DIGEST,       "S2"},
    {"sha512",   INC_KW_DIGEST,       "S3"},
+   {"xxh64",    INC_KW_DIGEST,       "S4"},
    {"gzip",     INC_KW_COMPRESSION,  "Z6"},
    {"gzip1",    INC_KW_COMPRESSION,  "Z1"},
    {"gzip2",    INC_KW_COMPRESSION,  "Z2"},
@@ -216,6 +217,27 @@ static struct s_fs_opt FS_options[] = {
    {"gzip8",    INC_KW_COMPRESSION,  "Z8"},
    {"gzip9",    INC_KW_COMPRESSION,  "Z9"},
    {"lzo",      INC_KW_COMPRESSION,  "Zo"},
+   {"lz4",      INC_KW_COMPRESSION,  "Zl"},
+   {"zstd",     INC_KW_COMPRESSION,  "Zz3"},
+   {"zstd1",    INC_KW_COMPRESSION,  "Zz1"},
+   {"zstd2",    INC_KW_COMPRESSION,  "Zz2"},
+   {"zstd3",    INC_KW_COMPRESSION,  "Zz3"},
+   {"zstd4",    INC_KW_COMPRESSION,  "Zz4"},
+   {"zstd5",    INC_KW_COMPRESSION,  "Zz5"},
+   {"zstd6",    INC_KW_COMPRESSION,  "Zz6"},
+   {"zstd7",    INC_KW_COMPRESSION,  "Zz7"},
+   {"zstd8",    INC_KW_COMPRESSION,  "Zz8"},
+   {"zstd9",    INC_KW_COMPRESSION,  "Zz9"},
+   {"zstd10",   INC_KW_COMPRESSION,  "Zz10"},
+   {"zstd11",   INC_KW_COMPRESSION,  "Zz11"},
+   {"zstd12",   INC_KW_COMPRESSION,  "Zz12"},
+   {"zstd13",   INC_KW_COMPRESSION,  "Zz13"},
+   {"zstd14",   INC_KW_COMPRESSION,  "Zz14"},
+   {"zstd15",   INC_KW_COMPRESSION,  "Zz15"},
+   {"zstd16",   INC_KW_COMPRESSION,  "Zz16"},
+   {"zstd17",   INC_KW_COMPRESSION,  "Zz17"},
+   {"zstd18",   INC_KW_COMPRESSION,  "Zz18"},
+   {"zstd19",   INC_KW_COMPRESSION,  "Zz19"},
    {"blowfish", INC_KW_ENCRYPTION,    "B"},   /* ***FIXME*** not implemented */
    {"3des",     INC_KW_ENCRYPTION,    "3"},   /* ***FIXME*** not implemented */
    {"yes",      INC_KW_ONEFS,         "0"},
@@ -127,6 +127,7 @@ bool setup_job(JCR *jcr)
       goto bail_out;
    }
    Dmsg0(150, "DB opened\n");
+   db_use_id_cache(jcr->db, jcr->catalog->id_cache_size);
    if (!jcr->fname) {
       jcr->fname = get_pool_memory(PM_FNAME);
    }
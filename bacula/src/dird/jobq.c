@@ -42,9 +42,23 @@ extern "C" void *jobq_server(void *arg);
 extern "C" void *sched_wait(void *arg);
 
 static int  start_server(jobq_t *jq);
-static bool acquire_resources(JCR *jcr);
+static bool acquire_resources(JCR *jcr, void **wait_res);
 static bool reschedule_job(JCR *jcr, jobq_t *jq, jobq_item_t *je);
 static void dec_write_store(JCR *jcr);
+static void ready_push(jobq_t *jq, jobq_item_t *item, bool canceled);
+static jobq_item_t *ready_pop(jobq_t *jq);
+static void wait_for_resource(jobq_t *jq, jobq_item_t *item, void *res);
+static void stop_waiting(jobq_t *jq, jobq_item_t *item);
+static int  wake_waiters(jobq_t *jq, void *res);
+static void wake_all_waiters(jobq_t *jq);
+
+/*
+ * A job that cannot get a resource waits for it in the queue of
+ *  that resource, and is checked again only when a job releases
+ *  it. All the waiting jobs are checked again after this many
+ *  seconds, in case a resource changed in some other way.
+ */
+static const int jobq_recheck_interval = 10;
 
 /*
  * Initialize a job queue
@@ -86,9 +100,14 @@ int jobq_init(jobq_t *jq, int threads, void *(*engine)(void *arg))
    jq->engine = engine;               /* routine to run */
    jq->valid = JOBQ_VALID;
    /* Initialize the job queues */
+   jobq_res_t *rw = NULL;
    jq->waiting_jobs = New(dlist(item, &item->link));
    jq->running_jobs = New(dlist(item, &item->link));
-   jq->ready_jobs = New(dlist(item, &item->link));
+   jq->ready_jobs = NULL;
+   jq->num_ready = jq->max_ready = 0;
+   jq->res_waits = New(htable(rw, &rw->link));
+   jq->seq = 0;
+   memset(&jq->stats, 0, sizeof(jq->stats));
    return 0;
 }
 
@@ -136,7 +155,13 @@ int jobq_destroy(jobq_t *jq)
    stat2 = pthread_attr_destroy(&jq->attr);
    delete jq->waiting_jobs;
    delete jq->running_jobs;
-   delete jq->ready_jobs;
+   for (int i=0; i < jq->num_ready; i++) {
+      free(jq->ready_jobs[i]);
+   }
+   if (jq->ready_jobs) {
+      free(jq->ready_jobs);
+   }
+   delete jq->res_waits;
    return (stat != 0 ? stat : (stat1 != 0 ? stat1 : stat2));
 }
 
@@ -196,7 +221,6 @@ int jobq_add(jobq_t *jq, JCR *jcr)
 {
    int stat;
    jobq_item_t *item, *li;
-   bool inserted = false;
    time_t wtime = jcr->sched_time - time(NULL);
    pthread_t id;
    wait_pkt *sched_pkt;
@@ -239,30 +263,35 @@ int jobq_add(jobq_t *jq, JCR *jcr)
       return ENOMEM;
    }
    item->jcr = jcr;
+   item->wait_res = NULL;
+   item->wait_prev = item->wait_next = NULL;
+   item->seq = ++jq->seq;
 
    /* While waiting in a queue this job is not attached to a thread */
    set_jcr_in_tsd(INVALID_JCR);
    if (job_canceled(jcr)) {
       /* Add job to ready queue so that it is canceled quickly */
-      jq->ready_jobs->prepend(item);
-      Dmsg1(2300, "Prepended job=%d to ready queue\n", jcr->JobId);
+      ready_push(jq, item, true);
+      Dmsg1(2300, "Put job=%d first in ready queue\n", jcr->JobId);
    } else {
-      /* Add this job to the wait queue in priority sorted order */
-      foreach_dlist(li, jq->waiting_jobs) {
-         Dmsg2(2300, "waiting item jobid=%d priority=%d\n",
-            li->jcr->JobId, li->jcr->JobPriority);
-         if (li->jcr->JobPriority > jcr->JobPriority) {
-            jq->waiting_jobs->insert_before(item, li);
-            Dmsg2(2300, "insert_before jobid=%d before waiting job=%d\n",
-               li->jcr->JobId, jcr->JobId);
-            inserted = true;
+      /*
+       * Add this job to the wait queue in priority sorted order,
+       *  looking from the end as most jobs come with the same or
+       *  a lower priority.
+       */
+      for (li = (jobq_item_t *)jq->waiting_jobs->last(); li;
+           li = (jobq_item_t *)jq->waiting_jobs->prev(li)) {
+         if (li->jcr->JobPriority <= jcr->JobPriority) {
             break;
          }
       }
-      /* If not jobs in wait queue, append it */
-      if (!inserted) {
-         jq->waiting_jobs->append(item);
-         Dmsg1(2300, "Appended item jobid=%d to waiting queue\n", jcr->JobId);
+      if (li) {
+         jq->waiting_jobs->insert_after(item, li);
+         Dmsg2(2300, "insert_after jobid=%d after waiting job=%d\n",
+            jcr->JobId, li->jcr->JobId);
+      } else {
+         jq->waiting_jobs->prepend(item);
+         Dmsg1(2300, "Prepended item jobid=%d to waiting queue\n", jcr->JobId);
       }
    }
 
@@ -308,8 +337,9 @@ int jobq_remove(jobq_t *jq, JCR *jcr)
    }
 
    /* Move item to be the first on the list */
+   stop_waiting(jq, item);
    jq->waiting_jobs->remove(item);
-   jq->ready_jobs->prepend(item);
+   ready_push(jq, item, true);
    Dmsg2(2300, "jobq_remove jobid=%d jcr=0x%x moved to ready queue\n", jcr->JobId, jcr);
 
    stat = start_server(jq);
@@ -355,6 +385,194 @@ static int start_server(jobq_t *jq)
    return stat;
 }
 
+/*
+ * Ready jobs are kept in a heap, canceled jobs first so that they
+ *  terminate quickly, then by priority and order of arrival.
+ */
+static bool ready_before(jobq_item_t *a, jobq_item_t *b)
+{
+   if (a->priority != b->priority) {
+      return a->priority < b->priority;
+   }
+   return a->seq < b->seq;
+}
+
+static void ready_push(jobq_t *jq, jobq_item_t *item, bool canceled)
+{
+   jobq_item_t **heap;
+   int i, parent;
+
+   if (jq->num_ready == jq->max_ready) {
+      jq->max_ready = jq->max_ready ? 2 * jq->max_ready : 32;
+      jq->ready_jobs = (jobq_item_t **)realloc(jq->ready_jobs,
+                          jq->max_ready * sizeof(jobq_item_t *));
+   }
+   item->priority = canceled ? -1 : item->jcr->JobPriority;
+   heap = jq->ready_jobs;
+   for (i = jq->num_ready++; i > 0; i = parent) {
+      parent = (i - 1) / 2;
+      if (!ready_before(item, heap[parent])) {
+         break;
+      }
+      heap[i] = heap[parent];
+   }
+   heap[i] = item;
+}
+
+static jobq_item_t *ready_pop(jobq_t *jq)
+{
+   jobq_item_t **heap = jq->ready_jobs;
+   jobq_item_t *first, *last;
+   int i, child, n;
+
+   if (jq->num_ready == 0) {
+      return NULL;
+   }
+   first = heap[0];
+   n = --jq->num_ready;
+   last = heap[n];
+   for (i = 0; (child = 2 * i + 1) < n; i = child) {
+      if (child + 1 < n && ready_before(heap[child + 1], heap[child])) {
+         child++;
+      }
+      if (!ready_before(heap[child], last)) {
+         break;
+      }
+      heap[i] = heap[child];
+   }
+   heap[i] = last;
+   return first;
+}
+
+/*
+ * Put a waiting job in the queue of the resource it could not get
+ */
+static void wait_for_resource(jobq_t *jq, jobq_item_t *item, void *res)
+{
+   jobq_res_t *rw;
+
+   rw = (jobq_res_t *)jq->res_waits->lookup((uint64_t)(intptr_t)res);
+   if (!rw) {
+      rw = (jobq_res_t *)jq->res_waits->hash_malloc(sizeof(jobq_res_t));
+      rw->res = res;
+      rw->first = rw->last = NULL;
+      jq->res_waits->insert((uint64_t)(intptr_t)res, rw);
+   }
+   item->wait_res = res;
+   item->wait_next = NULL;
+   item->wait_prev = rw->last;
+   if (rw->last) {
+      rw->last->wait_next = item;
+   } else {
+      rw->first = item;
+   }
+   rw->last = item;
+}
+
+/*
+ * Remove a job from the queue of the resource it waits for
+ */
+static void stop_waiting(jobq_t *jq, jobq_item_t *item)
+{
+   jobq_res_t *rw;
+
+   if (!item->wait_res) {
+      return;
+   }
+   rw = (jobq_res_t *)jq->res_waits->lookup((uint64_t)(intptr_t)item->wait_res);
+   ASSERT(rw);
+   if (item->wait_prev) {
+      item->wait_prev->wait_next = item->wait_next;
+   } else {
+      rw->first = item->wait_next;
+   }
+   if (item->wait_next) {
+      item->wait_next->wait_prev = item->wait_prev;
+   } else {
+      rw->last = item->wait_prev;
+   }
+   item->wait_res = NULL;
+   item->wait_prev = item->wait_next = NULL;
+}
+
+/*
+ * A resource was released, the jobs waiting for it will be
+ *  checked again.
+ *
+ *  Returns: number of jobs woken
+ */
+static int wake_waiters(jobq_t *jq, void *res)
+{
+   jobq_res_t *rw;
+   jobq_item_t *item, *next;
+   int count = 0;
+
+   if (!res) {
+      return 0;
+   }
+   rw = (jobq_res_t *)jq->res_waits->lookup((uint64_t)(intptr_t)res);
+   if (!rw) {
+      return 0;
+   }
+   for (item = rw->first; item; item = next) {
+      next = item->wait_next;
+      item->wait_res = NULL;
+      item->wait_prev = item->wait_next = NULL;
+      count++;
+   }
+   rw->first = rw->last = NULL;
+   jq->stats.wakeups += count;
+   return count;
+}
+
+static void wake_all_waiters(jobq_t *jq)
+{
+   jobq_res_t *rw;
+
+   foreach_htable(rw, jq->res_waits) {
+      wake_waiters(jq, rw->res);
+   }
+}
+
+/*
+ * Called when a resource is released outside of the job queue,
+ *  so that the jobs waiting for it are checked again.
+ */
+void jobq_release_resource(jobq_t *jq, void *res)
+{
+   if (jq->valid != JOBQ_VALID) {
+      return;
+   }
+   P(jq->mutex);
+   if (wake_waiters(jq, res) > 0) {
+      start_server(jq);
+   }
+   V(jq->mutex);
+}
+
+/*
+ * Get a copy of the job queue counters
+ */
+void jobq_get_stats(jobq_t *jq, jobq_stats_t *stats)
+{
+   jobq_item_t *item;
+
+   memset(stats, 0, sizeof(jobq_stats_t));
+   if (jq->valid != JOBQ_VALID) {
+      return;
+   }
+   P(jq->mutex);
+   *stats = jq->stats;
+   foreach_dlist(item, jq->waiting_jobs) {
+      stats->waiting++;
+      if (item->wait_res) {
+         stats->blocked++;
+      }
+   }
+   stats->ready = jq->num_ready;
+   stats->running = jq->running_jobs->size();
+   V(jq->mutex);
+}
 
 /*
  * This is the worker thread that serves the job queue.
@@ -390,7 +608,9 @@ void *jobq_server(void *arg)
              * Wait 4 seconds, then if no more work, exit
              */
             Dmsg0(2300, "pthread_cond_timedwait()\n");
+            jq->idle_workers++;
             stat = pthread_cond_timedwait(&jq->work, &jq->mutex, &timeout);
+            jq->idle_workers--;
             if (stat == ETIMEDOUT) {
                Dmsg0(2300, "timedwait timedout.\n");
                timedout = true;
@@ -409,12 +629,11 @@ void *jobq_server(void *arg)
        * If anything is in the ready queue, run it
        */
       Dmsg0(2300, "Checking ready queue.\n");
-      while (!jq->ready_jobs->empty() && !jq->quit) {
+      while (jq->num_ready > 0 && !jq->quit) {
          JCR *jcr;
-         je = (jobq_item_t *)jq->ready_jobs->first();
+         je = ready_pop(jq);
          jcr = je->jcr;
-         jq->ready_jobs->remove(je);
-         if (!jq->ready_jobs->empty()) {
+         if (jq->num_ready > 0) {
             Dmsg0(2300, "ready queue not empty start server\n");
             if (start_server(jq) != 0) {
                jq->num_workers--;
@@ -423,6 +642,15 @@ void *jobq_server(void *arg)
             }
          }
          jq->running_jobs->append(je);
+         if (!job_canceled(jcr)) {
+            /* Time from the scheduled start to now */
+            utime_t latency = MAX(time(NULL) - jcr->sched_time, 0);
+            jq->stats.started++;
+            jq->stats.total_latency += latency;
+            if (latency > jq->stats.max_latency) {
+               jq->stats.max_latency = latency;
+            }
+         }
 
          /* Attach jcr to this thread while we run the job */
          jcr->my_thread_id = pthread_self();
@@ -465,6 +693,11 @@ void *jobq_server(void *arg)
             }
             jcr->job->NumConcurrentJobs--;
             jcr->acquired_resource_locks = false;
+            /* Only the jobs waiting for these resources are checked again */
+            wake_waiters(jq, jcr->rstore);
+            wake_waiters(jq, jcr->wstore);
+            wake_waiters(jq, jcr->client);
+            wake_waiters(jq, jcr->job);
          }
 
          if (reschedule_job(jcr, jq, je)) {
@@ -518,6 +751,7 @@ void *jobq_server(void *arg)
             /* je is current job item on the queue, jn is the next one */
             JCR *jcr = je->jcr;
             jobq_item_t *jn = (jobq_item_t *)jq->waiting_jobs->next(je);
+            void *wait_res;
 
             Dmsg4(2300, "Examining Job=%d JobPri=%d want Pri=%d (%s)\n",
                   jcr->JobId, jcr->JobPriority, Priority,
@@ -531,9 +765,18 @@ void *jobq_server(void *arg)
                break;
             }
 
-            if (!acquire_resources(jcr)) {
+            /* Skip the jobs waiting for a resource not released yet */
+            if (je->wait_res && !job_canceled(jcr)) {
+               je = jn;
+               continue;
+            }
+            stop_waiting(jq, je);
+
+            jq->stats.checks++;
+            if (!acquire_resources(jcr, &wait_res)) {
                /* If resource conflict, job is canceled */
                if (!job_canceled(jcr)) {
+                  wait_for_resource(jq, je, wait_res);
                   je = jn;            /* point to next waiting job */
                   continue;
                }
@@ -546,7 +789,7 @@ void *jobq_server(void *arg)
              *    terminate.
              */
             jq->waiting_jobs->remove(je);
-            jq->ready_jobs->append(je);
+            ready_push(jq, je, job_canceled(jcr));
             Dmsg1(2300, "moved JobId=%d from wait to ready queue\n", je->jcr->JobId);
             je = jn;                  /* Point to next waiting job */
          } /* end for loop */
@@ -557,7 +800,7 @@ void *jobq_server(void *arg)
       /*
        * If no more ready work and we are asked to quit, then do it
        */
-      if (jq->ready_jobs->empty() && jq->quit) {
+      if (jq->num_ready == 0 && jq->quit) {
          jq->num_workers--;
          if (jq->num_workers == 0) {
             Dmsg0(2300, "Wake up destroy routine\n");
@@ -571,26 +814,32 @@ void *jobq_server(void *arg)
        * If no more work requests, and we waited long enough, quit
        */
       Dmsg2(2300, "timedout=%d read empty=%d\n", timedout,
-         jq->ready_jobs->empty());
-      if (jq->ready_jobs->empty() && timedout) {
+         jq->num_ready == 0);
+      if (jq->num_ready == 0 && timedout) {
          Dmsg0(2300, "break big loop\n");
          jq->num_workers--;
          break;
       }
 
-      work = !jq->ready_jobs->empty() || !jq->waiting_jobs->empty();
-      if (work) {
+      work = jq->num_ready > 0 || !jq->waiting_jobs->empty();
+      if (work && jq->num_ready == 0) {
          /*
-          * If a job is waiting on a Resource, don't consume all
-          *   the CPU time looping looking for work, and even more
-          *   important, release the lock so that a job that has
-          *   terminated can give us the resource.
+          * The waiting jobs need a resource or a priority that is
+          *   not available. Release the lock and sleep until a job
+          *   that has terminated gives us a resource, a new job is
+          *   queued, or it is time to check all of them again.
           */
-         V(jq->mutex);
-         bmicrosleep(2, 0);              /* pause for 2 seconds */
-         P(jq->mutex);
-         /* Recompute work as something may have changed in last 2 secs */
-         work = !jq->ready_jobs->empty() || !jq->waiting_jobs->empty();
+         gettimeofday(&tv, &tz);
+         timeout.tv_nsec = tv.tv_usec * 1000;
+         timeout.tv_sec = tv.tv_sec + jobq_recheck_interval;
+         jq->idle_workers++;
+         stat = pthread_cond_timedwait(&jq->work, &jq->mutex, &timeout);
+         jq->idle_workers--;
+         if (stat == ETIMEDOUT) {
+            wake_all_waiters(jq);
+         }
+         /* Recompute work as something may have changed */
+         work = jq->num_ready > 0 || !jq->waiting_jobs->empty();
       }
       Dmsg1(2300, "Loop again. work=%d\n", work);
    } /* end of big for loop */
@@ -724,13 +973,15 @@ static bool reschedule_job(JCR *jcr, jobq_t *jq, jobq_item_t *je)
  * See if we can acquire all the necessary resources for the job (JCR)
  *
  *  Returns: true  if successful
- *           false if resource failure
+ *           false if resource failure, wait_res is the resource
+ *                 that was not available
  */
-static bool acquire_resources(JCR *jcr)
+static bool acquire_resources(JCR *jcr, void **wait_res)
 {
    bool skip_this_jcr = false;
 
    jcr->acquired_resource_locks = false;
+   *wait_res = NULL;
 /*
  * Turning this code off is likely to cause some deadlocks,
  *   but we do not really have enough information here to
@@ -751,6 +1002,7 @@ static bool acquire_resources(JCR *jcr)
       Dmsg1(200, "Rstore=%s\n", jcr->rstore->name());
       if (!inc_read_store(jcr)) {
          Dmsg1(200, "Fail rncj=%d\n", jcr->rstore->NumConcurrentJobs);
+         *wait_res = jcr->rstore;
          jcr->setJobStatus(JS_WaitStoreRes);
          return false;
       }
@@ -770,6 +1022,7 @@ static bool acquire_resources(JCR *jcr)
       }
    }
    if (skip_this_jcr) {
+      *wait_res = jcr->wstore;
       jcr->setJobStatus(JS_WaitStoreRes);
       return false;
    }
@@ -781,6 +1034,7 @@ static bool acquire_resources(JCR *jcr)
          /* Back out previous locks */
          dec_write_store(jcr);
          dec_read_store(jcr);
+         *wait_res = jcr->client;
          jcr->setJobStatus(JS_WaitClientRes);
          return false;
       }
@@ -794,6 +1048,7 @@ static bool acquire_resources(JCR *jcr)
       if (jcr->client) {
          jcr->client->NumConcurrentJobs--;
       }
+      *wait_res = jcr->job;
       jcr->setJobStatus(JS_WaitJobRes);
       return false;
    }
@@ -34,6 +34,36 @@
 struct jobq_item_t {
    dlink link;
    JCR *jcr;
+   void *wait_res;                    /* resource the job waits for */
+   jobq_item_t *wait_prev;            /* other jobs waiting for wait_res */
+   jobq_item_t *wait_next;
+   int32_t priority;                  /* order in the ready heap */
+   uint64_t seq;                      /* order of arrival in the queue */
+};
+
+/*
+ * Jobs waiting for a resource (Storage, Client or Job)
+ */
+struct jobq_res_t {
+   hlink link;
+   void *res;                         /* resource */
+   jobq_item_t *first;                /* jobs waiting for it */
+   jobq_item_t *last;
+};
+
+/*
+ * Job queue statistics, see jobq_get_stats()
+ */
+struct jobq_stats_t {
+   int waiting;                       /* jobs in the wait queue */
+   int blocked;                       /* waiting for a resource */
+   int ready;                         /* jobs ready to run */
+   int running;                       /* jobs running */
+   uint64_t started;                  /* jobs started */
+   uint64_t checks;                   /* resource acquisition attempts */
+   uint64_t wakeups;                  /* jobs woken by a released resource */
+   utime_t total_latency;             /* sum of scheduled -> running times */
+   utime_t max_latency;               /* longest scheduled -> running time */
 };
 
 /*
@@ -45,7 +75,12 @@ struct jobq_t {
    pthread_attr_t    attr;            /* create detached threads */
    dlist            *waiting_jobs;    /* list of jobs waiting */
    dlist            *running_jobs;    /* jobs running */
-   dlist            *ready_jobs;      /* jobs ready to run */
+   jobq_item_t     **ready_jobs;      /* heap of the jobs ready to run */
+   int               num_ready;       /* jobs in ready_jobs */
+   int               max_ready;       /* size of ready_jobs */
+   htable           *res_waits;       /* jobq_res_t by resource */
+   uint64_t          seq;             /* last jobq_item_t seq */
+   jobq_stats_t      stats;           /* counters */
    int               valid;           /* queue initialized */
    bool              quit;            /* jobq should quit */
    int               max_workers;     /* max threads */
@@ -64,5 +99,7 @@ extern int jobq_init(
 extern int jobq_destroy(jobq_t *wq);
 extern int jobq_add(jobq_t *wq, JCR *jcr);
 extern int jobq_remove(jobq_t *wq, JCR *jcr);
+extern void jobq_release_resource(jobq_t *wq, void *res);
+extern void jobq_get_stats(jobq_t *wq, jobq_stats_t *stats);
 
 #endif /* __JOBQ_H */
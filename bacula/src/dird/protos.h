@@ -53,6 +53,7 @@ extern bool run_storage_and_start_message_thread(JCR *jcr, BSOCK *sd);
 extern bool send_client_addr_to_sd(JCR *jcr);
 extern bool send_store_addr_to_fd(JCR *jcr, STORE *store,
                char *store_address, uint32_t store_port);
+extern void update_bvfs_cache_in_background(JCR *jcr);
 
 /* vbackup.c */
 extern bool do_vbackup_init(JCR *jcr);
@@ -188,6 +189,9 @@ extern bool do_restore_init(JCR *jcr);
 extern void restore_cleanup(JCR *jcr, int TermCode);
 
 
+/* scheduler.c */
+int find_next_runs(time_t start, time_t end, sched_run **runs);
+
 /* ua_acl.c */
 bool acl_access_ok(UAContext *ua, int acl, const char *item);
 bool acl_access_ok(UAContext *ua, int acl, const char *item, int len);
@@ -37,6 +37,8 @@
 #include "dird.h"
 #include "lib/ini.h"
 
+extern jobq_t job_queue;              /* job queue */
+
 /* Commands sent to File daemon */
 static char restorecmd[]  = "restore %sreplace=%c prelinks=%d where=%s\n";
 static char restorecmdR[] = "restore %sreplace=%c prelinks=%d regexwhere=%s\n";
@@ -283,6 +285,7 @@ static bool select_rstore(JCR *jcr, bootstrap_info &info)
     * release current read storage and get a new one
     */
    dec_read_store(jcr);
+   jobq_release_resource(&job_queue, jcr->rstore);
    free_rstorage(jcr);
    set_rstorage(jcr, &ustore);
    jcr->setJobStatus(JS_WaitSD);
@@ -38,41 +38,60 @@
 const int dbglvl = DBGLVL;
 
 /* Local variables */
-struct job_item {
-   RUN *run;
+
+/*
+ * Each Job with a Schedule has one entry per Run directive, with
+ *  the next time it is to be run. The entries are kept in a heap
+ *  sorted by runtime and priority, so that the next job to run
+ *  is always the first one.
+ */
+struct sched_entry {
    JOB *job;
-   time_t runtime;
+   RUN *run;
+   time_t runtime;                    /* next time to run */
    int Priority;
-   dlink link;                        /* link for list */
 };
 
-/* List of jobs to be run. They were scheduled in this hour or the next */
-static dlist *jobs_to_run;               /* list of jobs to be run */
+static sched_entry *sched_heap = NULL;   /* heap of scheduled runs */
+static int num_entries = 0;              /* entries in heap */
+static int max_entries = 0;              /* size of heap */
+static bool sched_built = false;         /* set once the heap is built */
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
 
 /* Time interval in secs to sleep if nothing to be run */
 static int const next_check_secs = 60;
 
+/* Never look further than this for the next run of a schedule */
+static int const max_search_days = 8 * 366;
+
 /* Forward referenced subroutines */
-static void find_runs();
-static void add_job(JOB *job, RUN *run, time_t now, time_t runtime);
-static void dump_job(job_item *ji, const char *msg);
+static void build_schedule(time_t now);
+static time_t next_run_time(RUN *run, time_t from);
+static void add_entry(JOB *job, RUN *run, time_t runtime);
+static void update_first_entry(time_t runtime);
+static void dump_job(sched_entry *se, const char *msg);
 
 /* Imported subroutines */
 
 /* Imported variables */
 
 /*
- * called by reload_config to tell us that the schedules
- * we may have based our next jobs to run queues have been
- * invalidated.  In fact the schedules may not have changed
- * but the run object that we have recorded the last_run time
- * on are new and no longer have a valid last_run time which
- * causes us to double run schedules that get put into the list
- * because run_nh = 1.
+ * Called by reload_config (with the resources locked) to tell us
+ *  that the Jobs and Runs of the heap have been replaced. The heap
+ *  is rebuilt from the new resources, but the runs that did not
+ *  change keep the time they were due and their last run time, so
+ *  that a reload neither drops nor runs twice a job scheduled
+ *  around the reload.
  */
-static bool schedules_invalidated = false;
-void invalidate_schedules(void) {
-    schedules_invalidated = true;
+void invalidate_schedules(void)
+{
+   P(sched_mutex);
+   if (sched_built) {
+      build_schedule(time(NULL));
+      pthread_cond_signal(&sched_cond);
+   }
+   V(sched_mutex);
 }
 
 /*********************************************************************
@@ -87,13 +106,11 @@ JCR *wait_for_next_job(char *one_shot_job_to_run)
    RUN *run;
    time_t now, prev;
    static bool first = true;
-   job_item *next_job = NULL;
+   sched_entry next_job;
 
    Dmsg0(dbglvl, "Enter wait_for_next_job\n");
    if (first) {
       first = false;
-      /* Create scheduled jobs list */
-      jobs_to_run = New(dlist(next_job, &next_job->link));
       if (one_shot_job_to_run) {            /* one shot */
          job = (JOB *)GetResWithName(R_JOB, one_shot_job_to_run);
          if (!job) {
@@ -104,86 +121,80 @@ JCR *wait_for_next_job(char *one_shot_job_to_run)
          set_jcr_defaults(jcr, job);
          return jcr;
       }
+      LockRes();
+      P(sched_mutex);
+      build_schedule(time(NULL));
+      sched_built = true;
+      V(sched_mutex);
+      UnlockRes();
    }
 
-   /* Wait until we have something in the
-    * next hour or so.
-    */
 again:
-   while (jobs_to_run->empty()) {
-      find_runs();
-      if (!jobs_to_run->empty()) {
-         break;
-      }
-      bmicrosleep(next_check_secs, 0); /* recheck once per minute */
-   }
-
-#ifdef  list_chain
-   job_item *je;
-   foreach_dlist(je, jobs_to_run) {
-      dump_job(je, _("Walk queue"));
-   }
-#endif
-   /*
-    * Pull the first job to run (already sorted by runtime and
-    *  Priority, then wait around until it is time to run it.
-    */
-   next_job = (job_item *)jobs_to_run->first();
-   jobs_to_run->remove(next_job);
-
-   dump_job(next_job, _("Dequeued job"));
-
-   if (!next_job) {                /* we really should have something now */
-      Emsg0(M_ABORT, 0, _("Scheduler logic error\n"));
-   }
-
-   /* Now wait for the time to run the job */
+   /* Now wait for the time to run the first job */
+   P(sched_mutex);
    for (;;) {
+      struct timespec timeout;
       time_t twait;
-      /** discard scheduled queue and rebuild with new schedule objects. **/
-      lock_jobs();
-      if (schedules_invalidated) {
-          dump_job(next_job, "Invalidated job");
-          free(next_job);
-          while (!jobs_to_run->empty()) {
-              next_job = (job_item *)jobs_to_run->first();
-              jobs_to_run->remove(next_job);
-              dump_job(next_job, "Invalidated job");
-              free(next_job);
-          }
-          schedules_invalidated = false;
-          unlock_jobs();
-          goto again;
-      }
-      unlock_jobs();
+
       prev = now = time(NULL);
-      twait = next_job->runtime - now;
-      if (twait <= 0) {               /* time to run it */
-         break;
+      if (num_entries == 0) {
+         twait = next_check_secs;
+      } else {
+         twait = sched_heap[0].runtime - now;
+         if (twait <= 0) {               /* time to run it */
+            break;
+         }
+         dump_job(&sched_heap[0], _("Wait for job"));
       }
-      /* Recheck at least once per minute */
-      bmicrosleep((next_check_secs < twait)?next_check_secs:twait, 0);
+      /* Recheck at least once per minute, or when the schedules change */
+      timeout.tv_sec = now + MIN(twait, next_check_secs);
+      timeout.tv_nsec = 0;
+      pthread_cond_timedwait(&sched_cond, &sched_mutex, &timeout);
       /* Attempt to handle clock shift (but not daylight savings time changes)
-       * we allow a skew of 10 seconds before invalidating everything.
+       * we allow a skew of 10 seconds before recomputing everything.
        */
       now = time(NULL);
       if (now < prev-10 || now > (prev+next_check_secs+10)) {
-         schedules_invalidated = true;
+         Dmsg2(dbglvl, "Clock shift prev=%lld now=%lld\n", (utime_t)prev, (utime_t)now);
+         V(sched_mutex);
+         LockRes();
+         P(sched_mutex);
+         num_entries = 0;             /* forget the computed times */
+         build_schedule(now);
+         V(sched_mutex);
+         UnlockRes();
+         P(sched_mutex);
       }
    }
-   jcr = new_jcr(sizeof(JCR), dird_free_jcr);
-   run = next_job->run;               /* pick up needed values */
-   job = next_job->job;
-   if (job->enabled) {
-      dump_job(next_job, _("Run job"));
+   V(sched_mutex);
+
+   /*
+    * Keep the resources locked while we use the Job and the Run, a
+    *  reload may replace them as soon as the heap is unlocked.
+    */
+   LockRes();
+   P(sched_mutex);
+   now = time(NULL);
+   if (num_entries == 0 || sched_heap[0].runtime > now) {
+      V(sched_mutex);                 /* the schedules changed */
+      UnlockRes();
+      goto again;
    }
-   free(next_job);
+   next_job = sched_heap[0];
+   /* Don't run again this minute, we restart at the next one */
+   update_first_entry(next_run_time(next_job.run, next_job.runtime + 60));
+   next_job.run->last_run = now;      /* mark as run now */
+   V(sched_mutex);
+
+   job = next_job.job;
+   run = next_job.run;
    if (!job->enabled) {
-      free_jcr(jcr);
+      UnlockRes();
       goto again;                     /* ignore this job */
    }
-   run->last_run = now;               /* mark as run now */
+   dump_job(&next_job, _("Run job"));
 
+   jcr = new_jcr(sizeof(JCR), dird_free_jcr);
    ASSERT(job);
    set_jcr_defaults(jcr, job);
    if (run->level) {
@@ -233,6 +244,7 @@ again:
    if (run->MaxRunSchedTime_set) {
       jcr->MaxRunSchedTime = run->MaxRunSchedTime;
    }
+   UnlockRes();
    Dmsg0(dbglvl, "Leave wait_for_next_job()\n");
    return jcr;
 }
@@ -243,193 +255,322 @@ again:
  */
 void term_scheduler()
 {
-   if (jobs_to_run) {
-      delete jobs_to_run;
+   P(sched_mutex);
+   if (sched_heap) {
+      free(sched_heap);
+      sched_heap = NULL;
    }
+   num_entries = max_entries = 0;
+   sched_built = false;
+   V(sched_mutex);
 }
 
 /*
- * Find all jobs to be run this hour and the next hour.
+ * Heap order: by runtime, then by priority
  */
-static void find_runs()
+static bool entry_before(sched_entry *a, sched_entry *b)
 {
-   time_t now, next_hour, runtime;
-   RUN *run;
-   JOB *job;
-   SCHED *sched;
-   struct tm tm;
-   int hour, mday, wday, month, wom, woy, ldom;
-   /* Items corresponding to above at the next hour */
-   int nh_hour, nh_mday, nh_wday, nh_month, nh_wom, nh_woy, nh_ldom;
+   if (a->runtime != b->runtime) {
+      return a->runtime < b->runtime;
+   }
+   return a->Priority < b->Priority;
+}
 
-   Dmsg0(dbglvl, "enter find_runs()\n");
+static void sift_up(sched_entry *heap, int i)
+{
+   sched_entry se = heap[i];
+   int parent;
 
-   /* compute values for time now */
-   now = time(NULL);
-   (void)localtime_r(&now, &tm);
-   hour = tm.tm_hour;
-   mday = tm.tm_mday - 1;
-   wday = tm.tm_wday;
-   month = tm.tm_mon;
-   wom = mday / 7;
-   woy = tm_woy(now);                     /* get week of year */
-   ldom = tm_ldom(month, tm.tm_year + 1900);
-
-   Dmsg7(dbglvl, "now = %x: h=%d m=%d md=%d wd=%d wom=%d woy=%d\n",
-         now, hour, month, mday, wday, wom, woy);
+   for ( ; i > 0; i = parent) {
+      parent = (i - 1) / 2;
+      if (!entry_before(&se, &heap[parent])) {
+         break;
+      }
+      heap[i] = heap[parent];
+   }
+   heap[i] = se;
+}
+
+static void sift_down(sched_entry *heap, int num, int i)
+{
+   sched_entry se = heap[i];
+   int child;
+
+   for ( ; (child = 2 * i + 1) < num; i = child) {
+      if (child + 1 < num && entry_before(&heap[child + 1], &heap[child])) {
+         child++;
+      }
+      if (!entry_before(&heap[child], &se)) {
+         break;
+      }
+      heap[i] = heap[child];
+   }
+   heap[i] = se;
+}
+
+static void add_entry(JOB *job, RUN *run, time_t runtime)
+{
+   sched_entry *se;
+
+   if (num_entries == max_entries) {
+      max_entries = max_entries ? 2 * max_entries : 64;
+      sched_heap = (sched_entry *)realloc(sched_heap,
+                      max_entries * sizeof(sched_entry));
+   }
+   se = &sched_heap[num_entries];
+   se->job = job;
+   se->run = run;
+   se->runtime = runtime;
+   if (run->Priority) {
+      se->Priority = run->Priority;
+   } else {
+      se->Priority = job->Priority;
+   }
+   sift_up(sched_heap, num_entries++);
+   dump_job(se, _("Added job"));
+}
+
+/*
+ * Move the first entry to its next runtime, or drop it if the
+ *  Run will never fire again.
+ */
+static void update_first_entry(time_t runtime)
+{
+   if (runtime == 0) {
+      sched_heap[0] = sched_heap[--num_entries];
+   } else {
+      sched_heap[0].runtime = runtime;
+   }
+   if (num_entries > 0) {
+      sift_down(sched_heap, num_entries, 0);
+   }
+}
+
+/*
+ * Runs of the previous heap, indexed by Job name, so that
+ *  the unchanged runs keep their time after a reload.
+ */
+struct old_entry {
+   hlink link;
+   sched_entry *se;
+   old_entry *next;                   /* other runs of the same Job */
+};
+
+static bool same_run_time(RUN *a, RUN *b)
+{
+   return a->minute == b->minute &&
+      memcmp(a->hour, b->hour, sizeof(a->hour)) == 0 &&
+      memcmp(a->mday, b->mday, sizeof(a->mday)) == 0 &&
+      memcmp(a->month, b->month, sizeof(a->month)) == 0 &&
+      memcmp(a->wday, b->wday, sizeof(a->wday)) == 0 &&
+      memcmp(a->wom, b->wom, sizeof(a->wom)) == 0 &&
+      memcmp(a->woy, b->woy, sizeof(a->woy)) == 0;
+}
+
+/*
+ * (Re)build the heap from the Job resources. Called with the
+ *  resources and the heap locked.
+ */
+static void build_schedule(time_t now)
+{
+   sched_entry *old_heap = sched_heap;
+   int old_num = num_entries;
+   htable *old_runs = NULL;
+   old_entry *oe = NULL, *prev;
+   time_t runtime;
+   JOB *job;
+   RUN *run;
+   int i, nb_runs = 0, nb_kept = 0;
+
+   Dmsg0(dbglvl, "enter build_schedule()\n");
+   if (old_num > 0) {
+      old_runs = New(htable(oe, &oe->link, old_num));
+      for (i = 0; i < old_num; i++) {
+         char *name = old_heap[i].job->name();
+         oe = (old_entry *)old_runs->hash_malloc(sizeof(old_entry));
+         oe->se = &old_heap[i];
+         prev = (old_entry *)old_runs->lookup(name);
+         if (prev) {
+            oe->next = prev->next;    /* chain to the first one */
+            prev->next = oe;
+         } else {
+            oe->next = NULL;
+            old_runs->insert(name, oe);
+         }
+      }
+   }
+   sched_heap = NULL;
+   num_entries = max_entries = 0;
 
    /*
-    * Compute values for next hour from now.
-    * We do this to be sure we don't miss a job while
-    * sleeping.
+    * Jobs that are disabled are kept in the heap, they
+    *  are skipped when it is time to run them.
     */
-   next_hour = now + 3600;
-   (void)localtime_r(&next_hour, &tm);
-   nh_hour = tm.tm_hour;
-   nh_mday = tm.tm_mday - 1;
-   nh_wday = tm.tm_wday;
-   nh_month = tm.tm_mon;
-   nh_wom = nh_mday / 7;
-   nh_woy = tm_woy(next_hour);              /* get week of year */
-   nh_ldom = tm_ldom(nh_month, tm.tm_year + 1900);
-
-   Dmsg7(dbglvl, "nh = %x: h=%d m=%d md=%d wd=%d wom=%d woy=%d\n",
-         next_hour, nh_hour, nh_month, nh_mday, nh_wday, nh_wom, nh_woy);
-
-   /* Loop through all jobs */
-   LockRes();
    foreach_res(job, R_JOB) {
-      sched = job->schedule;
-      if (sched == NULL || !job->enabled) { /* scheduled? or enabled? */
+      if (job->schedule == NULL) {    /* scheduled? */
          continue;                    /* no, skip this job */
       }
-      Dmsg1(dbglvl, "Got job: %s\n", job->hdr.name);
-      for (run=sched->run; run; run=run->next) {
-         bool run_now, run_nh;
-         /*
-          * Find runs scheduled between now and the next hour.
-          */
-#ifdef xxxx
-         Dmsg0(000, "\n");
-         Dmsg7(000, "run h=%d m=%d md=%d wd=%d wom=%d woy=%d ldom=%d\n",
-            hour, month, mday, wday, wom, woy, ldom);
-         Dmsg7(000, "bitset bsh=%d bsm=%d bsmd=%d bswd=%d bswom=%d bswoy=%d bsldom=%d\n",
-            bit_is_set(hour, run->hour),
-            bit_is_set(month, run->month),
-            bit_is_set(mday, run->mday),
-            bit_is_set(wday, run->wday),
-            bit_is_set(wom, run->wom),
-            bit_is_set(woy, run->woy),
-            bit_is_set(31, run->mday));
-
-
-         Dmsg7(000, "nh_run h=%d m=%d md=%d wd=%d wom=%d woy=%d ldom=%d\n",
-            nh_hour, nh_month, nh_mday, nh_wday, nh_wom, nh_woy, nh_ldom);
-         Dmsg7(000, "nh_bitset bsh=%d bsm=%d bsmd=%d bswd=%d bswom=%d bswoy=%d bsldom=%d\n",
-            bit_is_set(nh_hour, run->hour),
-            bit_is_set(nh_month, run->month),
-            bit_is_set(nh_mday, run->mday),
-            bit_is_set(nh_wday, run->wday),
-            bit_is_set(nh_wom, run->wom),
-            bit_is_set(nh_woy, run->woy),
-            bit_is_set(31, run->mday));
-#endif
-
-         run_now = bit_is_set(hour, run->hour) &&
-            ((bit_is_set(mday, run->mday) &&
-              bit_is_set(wday, run->wday) &&
-              bit_is_set(month, run->month) &&
-              bit_is_set(wom, run->wom) &&
-              bit_is_set(woy, run->woy)) ||
-             (bit_is_set(month, run->month) &&
-              bit_is_set(31, run->mday) && mday == ldom));
-
-         run_nh = bit_is_set(nh_hour, run->hour) &&
-            ((bit_is_set(nh_mday, run->mday) &&
-              bit_is_set(nh_wday, run->wday) &&
-              bit_is_set(nh_month, run->month) &&
-              bit_is_set(nh_wom, run->wom) &&
-              bit_is_set(nh_woy, run->woy)) ||
-             (bit_is_set(nh_month, run->month) &&
-              bit_is_set(31, run->mday) && nh_mday == nh_ldom));
-
-         Dmsg3(dbglvl, "run@%p: run_now=%d run_nh=%d\n", run, run_now, run_nh);
-
-         if (run_now || run_nh) {
-           /* find time (time_t) job is to be run */
-           (void)localtime_r(&now, &tm);      /* reset tm structure */
-           tm.tm_min = run->minute;     /* set run minute */
-           tm.tm_sec = 0;               /* zero secs */
-           runtime = mktime(&tm);
-           if (run_now) {
-             add_job(job, run, now, runtime);
-           }
-           /* If job is to be run in the next hour schedule it */
-           if (run_nh) {
-             add_job(job, run, now, runtime + 3600);
-           }
+      oe = old_runs ? (old_entry *)old_runs->lookup(job->name()) : NULL;
+      for (run=job->schedule->run; run; run=run->next) {
+         nb_runs++;
+         for (prev = oe; prev; prev = prev->next) {
+            if (prev->se->job && same_run_time(prev->se->run, run)) {
+               break;
+            }
+         }
+         if (prev) {
+            runtime = prev->se->runtime;
+            run->last_run = prev->se->run->last_run;
+            prev->se->job = NULL;     /* do not use it twice */
+            nb_kept++;
+         } else {
+            /* Do run any job scheduled less than a minute ago */
+            runtime = next_run_time(run, now - 59);
+            if (runtime && (runtime - run->last_run) < 61) {
+               runtime = next_run_time(run, runtime + 60);
+            }
+         }
+         if (runtime) {
+            add_entry(job, run, runtime);
          }
       }
    }
-   UnlockRes();
-   Dmsg0(dbglvl, "Leave find_runs()\n");
+   if (old_runs) {
+      delete old_runs;
+   }
+   if (old_heap) {
+      free(old_heap);
+   }
+   Dmsg3(dbglvl, "Leave build_schedule() runs=%d scheduled=%d kept=%d\n",
+         nb_runs, num_entries, nb_kept);
 }
 
-static void add_job(JOB *job, RUN *run, time_t now, time_t runtime)
+/*
+ * Is the Run scheduled on the given day?
+ */
+static bool run_on_day(RUN *run, struct tm *tm, time_t day)
 {
-   job_item *ji;
-   bool inserted = false;
-   /*
-    * Don't run any job that ran less than a minute ago, but
-    *  do run any job scheduled less than a minute ago.
-    */
-   if (((runtime - run->last_run) < 61) || ((runtime+59) < now)) {
-#ifdef SCHED_DEBUG
-      Dmsg4(000, "Drop: Job=\"%s\" run=%lld. last_run=%lld. now=%lld\n", job->hdr.name,
-            (utime_t)runtime, (utime_t)run->last_run, (utime_t)now);
-      fflush(stdout);
-#endif
-      return;
-   }
-#ifdef SCHED_DEBUG
-   Dmsg4(000, "Add: Job=\"%s\" run=%lld last_run=%lld now=%lld\n", job->hdr.name,
-            (utime_t)runtime, (utime_t)run->last_run, (utime_t)now);
-#endif
-   /* accept to run this job */
-   job_item *je = (job_item *)malloc(sizeof(job_item));
-   je->run = run;
-   je->job = job;
-   je->runtime = runtime;
-   if (run->Priority) {
-      je->Priority = run->Priority;
-   } else {
-      je->Priority = job->Priority;
+   int mday = tm->tm_mday - 1;
+   int wday = tm->tm_wday;
+   int month = tm->tm_mon;
+   int wom = mday / 7;
+   int woy = tm_woy(day);                 /* get week of year */
+   int ldom = tm_ldom(month, tm->tm_year + 1900);
+
+   return (bit_is_set(mday, run->mday) &&
+           bit_is_set(wday, run->wday) &&
+           bit_is_set(month, run->month) &&
+           bit_is_set(wom, run->wom) &&
+           bit_is_set(woy, run->woy)) ||
+          (bit_is_set(month, run->month) &&
+           bit_is_set(31, run->mday) && mday == ldom);
+}
+
+/*
+ * Find the first time, at or after from, the Run is scheduled.
+ *
+ *  Returns: 0 if the Run is never scheduled
+ *           the time to run
+ */
+static time_t next_run_time(RUN *run, time_t from)
+{
+   struct tm day, tm;
+   time_t noon, runtime;
+   int i, hour;
+
+   (void)localtime_r(&from, &day);
+   for (i = 0; i < max_search_days; i++) {
+      /* The time of the day is noon, so that DST changes are no trouble */
+      day.tm_hour = 12;
+      day.tm_min = 0;
+      day.tm_sec = 0;
+      day.tm_isdst = -1;
+      noon = mktime(&day);            /* also normalizes the date */
+      if (!bit_is_set(day.tm_mon, run->month)) {
+         day.tm_mday = 1;             /* skip to the next month */
+         day.tm_mon++;
+         continue;
+      }
+      if (run_on_day(run, &day, noon)) {
+         for (hour = 0; hour < 24; hour++) {
+            if (!bit_is_set(hour, run->hour)) {
+               continue;
+            }
+            tm = day;
+            tm.tm_hour = hour;
+            tm.tm_min = run->minute;
+            tm.tm_sec = 0;
+            tm.tm_isdst = -1;
+            runtime = mktime(&tm);
+            if (runtime >= from) {
+               return runtime;
+            }
+         }
+      }
+      day.tm_mday++;                  /* next day */
    }
+   return 0;
+}
 
-   /* Add this job to the wait queue in runtime, priority sorted order */
-   foreach_dlist(ji, jobs_to_run) {
-      if (ji->runtime > je->runtime ||
-          (ji->runtime == je->runtime && ji->Priority > je->Priority)) {
-         jobs_to_run->insert_before(je, ji);
-         dump_job(je, _("Inserted job"));
-         inserted = true;
-         break;
+/*
+ * Find the runs scheduled between start and end, in the order the
+ *  jobs would be started. The heap gives the next run of each entry,
+ *  so we only compute the following runs of the entries returned.
+ *  Must be called with the resources locked, the caller frees runs.
+ *
+ *  Returns: number of runs
+ */
+int find_next_runs(time_t start, time_t end, sched_run **runs)
+{
+   sched_entry *heap;
+   sched_run *sr = NULL;
+   int i, num, nb = 0, max = 0;
+
+   P(sched_mutex);
+   num = num_entries;
+   heap = (sched_entry *)malloc((num + 1) * sizeof(sched_entry));
+   memcpy(heap, sched_heap, num * sizeof(sched_entry));
+   V(sched_mutex);
+
+   /* Entries late or due before the start move to their run after start */
+   for (i = 0; i < num; ) {
+      if (heap[i].runtime < start) {
+         heap[i].runtime = next_run_time(heap[i].run, start);
+         if (heap[i].runtime == 0) {
+            heap[i] = heap[--num];
+            continue;
+         }
       }
+      i++;
    }
-   /* If place not found in queue, append it */
-   if (!inserted) {
-      jobs_to_run->append(je);
-      dump_job(je, _("Appended job"));
+   for (i = num / 2 - 1; i >= 0; i--) {
+      sift_down(heap, num, i);
    }
-#ifdef SCHED_DEBUG
-   foreach_dlist(ji, jobs_to_run) {
-      dump_job(ji, _("Run queue"));
+
+   while (num > 0 && heap[0].runtime < end) {
+      if (nb == max) {
+         max = max ? 2 * max : 64;
+         sr = (sched_run *)realloc(sr, max * sizeof(sched_run));
+      }
+      sr[nb].job = heap[0].job;
+      sr[nb].run = heap[0].run;
+      sr[nb].runtime = heap[0].runtime;
+      sr[nb].Priority = heap[0].Priority;
+      nb++;
+      heap[0].runtime = next_run_time(heap[0].run, heap[0].runtime + 60);
+      if (heap[0].runtime == 0) {
+         heap[0] = heap[--num];
+      }
+      if (num > 0) {
+         sift_down(heap, num, 0);
+      }
    }
-   Dmsg0(000, "End run queue\n");
-#endif
+   free(heap);
+   *runs = sr;
+   return nb;
 }
 
-static void dump_job(job_item *ji, const char *msg)
+static void dump_job(sched_entry *se, const char *msg)
 {
 #ifdef SCHED_DEBUG
    char dt[MAX_TIME_LENGTH];
@@ -437,9 +578,9 @@ static void dump_job(job_item *ji, const char *msg)
    if (!chk_dbglvl(dbglvl)) {
       return;
    }
-   bstrftime_nc(dt, sizeof(dt), ji->runtime);
-   Dmsg4(dbglvl, "%s: Job=%s priority=%d run %s\n", msg, ji->job->hdr.name,
-      ji->Priority, dt);
+   bstrftime_nc(dt, sizeof(dt), se->runtime);
+   Dmsg4(dbglvl, "%s: Job=%s priority=%d run %s\n", msg, se->job->hdr.name,
+      se->Priority, dt);
    fflush(stdout);
    debug_level = save_debug;
 #endif
@@ -754,6 +754,7 @@ void do_messages(UAContext *ua, const char *cmd)
    if (ua->jcr) {
       dequeue_messages(ua->jcr);
    }
+   flush_message_queue();             /* let the dispatcher write them */
    Pw(con_lock);
    pthread_cleanup_push(con_lock_release, (void *)NULL);
    rewind(con_fd);
@@ -27,6 +27,7 @@
 
 extern void *start_heap;
 extern utime_t last_reload_time;
+extern jobq_t job_queue;              /* job queue */
 
 static void list_scheduled_jobs(UAContext *ua);
 static void llist_scheduled_jobs(UAContext *ua);
@@ -290,6 +291,7 @@ void list_dir_status_header(UAContext *ua)
 {
    char dt[MAX_TIME_LENGTH];
    char b1[35], b2[35], b3[35], b4[35], b5[35];
+   jobq_stats_t qs;
 
    ua->send_msg(_("%s Version: %s (%s) %s %s %s\n"), my_name, VERSION, BDATE,
             HOST_OS, DISTNAME, DISTVER);
@@ -303,6 +305,15 @@ void list_dir_status_header(UAContext *ua)
             edit_uint64_with_commas(sm_max_bytes, b3),
             edit_uint64_with_commas(sm_buffers, b4),
             edit_uint64_with_commas(sm_max_buffers, b5));
+   jobq_get_stats(&job_queue, &qs);
+   ua->send_msg(_(" Job queue: waiting=%d blocked=%d ready=%d running=%d "
+                  "started=%s checks=%s wakeups=%s latency avg=%ds max=%ds\n"),
+            qs.waiting, qs.blocked, qs.ready, qs.running,
+            edit_uint64_with_commas(qs.started, b1),
+            edit_uint64_with_commas(qs.checks, b2),
+            edit_uint64_with_commas(qs.wakeups, b3),
+            qs.started ? (int)(qs.total_latency / qs.started) : 0,
+            (int)qs.max_latency);
 
    /* TODO: use this function once for all daemons */
    if (bplugin_list->size() > 0) {
@@ -460,7 +471,6 @@ static void prt_lrunhdr(UAContext *ua)
 
 /* Scheduling packet */
 struct sched_pkt {
-   dlink link;                        /* keep this as first item!!! */
    JOB *job;
    int level;
    int priority;
@@ -701,42 +711,21 @@ get_out:
 }
 
 
-/*
- * Sort items by runtime, priority
- */
-static int my_compare(void *item1, void *item2)
-{
-   sched_pkt *p1 = (sched_pkt *)item1;
-   sched_pkt *p2 = (sched_pkt *)item2;
-   if (p1->runtime < p2->runtime) {
-      return -1;
-   } else if (p1->runtime > p2->runtime) {
-      return 1;
-   }
-   if (p1->priority < p2->priority) {
-      return -1;
-   } else if (p1->priority > p2->priority) {
-      return 1;
-   }
-   return 0;
-}
-
 /*
  * Find all jobs to be run in roughly the
  *  next 24 hours.
  */
 static void list_scheduled_jobs(UAContext *ua)
 {
-   utime_t runtime;
+   time_t now;
    RUN *run;
    JOB *job;
    int level, num_jobs = 0;
-   int priority;
    bool hdr_printed = false;
    char sched_name[MAX_NAME_LENGTH];
-   dlist sched;
-   sched_pkt *sp;
-   int days, i;
+   sched_run *runs;
+   sched_pkt sp;
+   int days, i, nb;
 
    Dmsg0(200, "enter list_sched_jobs()\n");
 
@@ -756,46 +745,43 @@ static void list_scheduled_jobs(UAContext *ua)
       sched_name[0] = 0;
    }
 
-   /* Loop through all jobs */
+   /* The scheduler gives the runs sorted by runtime and priority */
    LockRes();
-   foreach_res(job, R_JOB) {
+   now = time(NULL);
+   nb = find_next_runs(now + 1, now + days * 60 * 60 * 24, &runs);
+   for (i = 0; i < nb; i++) {
+      USTORE store;
+      job = runs[i].job;
+      run = runs[i].run;
       if (!acl_access_ok(ua, Job_ACL, job->name()) || !job->enabled) {
          continue;
       }
-      if (sched_name[0] && job->schedule &&
+      if (sched_name[0] &&
           strcasecmp(job->schedule->name(), sched_name) != 0) {
          continue;
       }
-      for (run=NULL; (run = find_next_run(run, job, runtime, days)); ) {
-         USTORE store;
-         level = job->JobLevel;
-         if (run->level) {
-            level = run->level;
-         }
-         priority = job->Priority;
-         if (run->Priority) {
-            priority = run->Priority;
-         }
-         if (!hdr_printed) {
-            prt_runhdr(ua);
-            hdr_printed = true;
-         }
-         sp = (sched_pkt *)malloc(sizeof(sched_pkt));
-         sp->job = job;
-         sp->level = level;
-         sp->priority = priority;
-         sp->runtime = runtime;
-         sp->pool = run->pool;
-         get_job_storage(&store, job, run);
-         sp->store = store.store;
-         Dmsg3(250, "job=%s store=%s MediaType=%s\n", job->name(), sp->store->name(), sp->store->media_type);
-         sched.binary_insert_multiple(sp, my_compare);
-         num_jobs++;
+      level = job->JobLevel;
+      if (run->level) {
+         level = run->level;
       }
-   } /* end for loop over resources */
+      if (!hdr_printed) {
+         prt_runhdr(ua);
+         hdr_printed = true;
+      }
+      sp.job = job;
+      sp.level = level;
+      sp.priority = runs[i].Priority;
+      sp.runtime = runs[i].runtime;
+      sp.pool = run->pool;
+      get_job_storage(&store, job, run);
+      sp.store = store.store;
+      Dmsg3(250, "job=%s store=%s MediaType=%s\n", job->name(), sp.store->name(), sp.store->media_type);
+      prt_runtime(ua, &sp);
+      num_jobs++;
+   }
    UnlockRes();
-   foreach_dlist(sp, &sched) {
-      prt_runtime(ua, sp);
+   if (runs) {
+      free(runs);
    }
    if (num_jobs == 0 && !ua->api) {
       ua->send_msg(_("No Scheduled Jobs.\n"));
@@ -497,6 +497,10 @@ void vbackup_cleanup(JCR *jcr, int TermCode)
         sd_term_msg,
         term_msg);
 
+   if (jcr->job->UpdateBvfsCache &&
+       (TermCode == JS_Terminated || TermCode == JS_Warnings)) {
+      update_bvfs_cache_in_background(jcr);
+   }
    Dmsg0(100, "Leave vbackup_cleanup()\n");
 }
 
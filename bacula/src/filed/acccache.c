@@ -0,0 +1,464 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Accurate cache
+ *
+ *  When the Client has Accurate Cache = yes, the File daemon keeps
+ *   the list of the files of its last backup of a FileSet: the
+ *   files sent to the catalog plus the unchanged files of the
+ *   accurate list.  The next job of the FileSet sends the JobIds
+ *   of its accurate list, and if they are the ones the cache was
+ *   made for, the Director does not send the list.
+ *
+ *  There is one file per FileSet in the working directory.  It has
+ *   a header followed by the records of the binary accurate list
+ *   (see baconfig.h) in blocks:
+ *     uint32  ACC_CACHE_MAGIC
+ *     uint32  ACC_CACHE_VERSION
+ *     string  MD5 of the FileSet
+ *     string  JobIds of the accurate list it replaces
+ *     uint32  number of files
+ *     uint32  length of a block, followed by its records
+ *     ...
+ *     uint32  0
+ *     ACC_MAX_RECORD_PAD zeroed bytes
+ *   and is read with mmap().
+ *
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#ifndef HAVE_WIN32
+#include <sys/mman.h>
+#endif
+
+static const int dbglvl = 100;
+
+#define ACC_CACHE_MAGIC    0x41434348   /* ACCH */
+#define ACC_CACHE_VERSION  1
+#define ACC_CACHE_HEADER   (4 + 4 + 1 + 1 + 4)
+
+/* Commands received from the Director */
+static char accuratecachecmd[] = "accuratecache files=%ld fileset=%127s jobids=";
+
+/* Responses sent to the Director */
+static char OKaccuratecache[] = "2000 OK accuratecache found=%d\n";
+
+/*
+ * Name of the cache file of a FileSet
+ */
+static char *accurate_cache_fname(POOLMEM *&fname, const char *fileset)
+{
+   char md5[128];
+   int i;
+
+   /* The MD5 is in base64, keep it usable as a file name */
+   for (i = 0; fileset[i] && i < (int)sizeof(md5) - 1; i++) {
+      md5[i] = B_ISALPHA(fileset[i]) || B_ISDIGIT(fileset[i]) ? fileset[i] : '_';
+   }
+   md5[i] = 0;
+   Mmsg(fname, "%s/%s.%s.acache", me->working_directory, my_name, md5);
+   return fname;
+}
+
+/* Get the string at ptr, NULL if it does not end before end */
+static char *unser_cache_string(uint8_t **ptr, uint8_t *end)
+{
+   char *str = (char *)*ptr;
+   uint8_t *p = (uint8_t *)memchr(*ptr, 0, end - *ptr);
+
+   if (!p) {
+      return NULL;
+   }
+   *ptr = p + 1;
+   return str;
+}
+
+/*
+ * Load the cache file in jcr->file_list if it was made for this
+ *  FileSet and these JobIds
+ */
+static bool accurate_cache_load(JCR *jcr, const char *fname, const char *fileset,
+                                const char *jobids)
+{
+   struct stat statp;
+   uint8_t *map = NULL, *end;
+   uint32_t magic, version, nfiles, len;
+   char *md5, *ids;
+   bool ok = false;
+   int fd;
+   ser_declare;
+
+   if ((fd = open(fname, O_RDONLY|O_BINARY)) < 0) {
+      Dmsg1(dbglvl, "No accurate cache %s\n", fname);
+      return false;
+   }
+   if (fstat(fd, &statp) < 0 ||
+       statp.st_size < ACC_CACHE_HEADER + 4 + ACC_MAX_RECORD_PAD) {
+      goto bail_out;
+   }
+#ifndef HAVE_WIN32
+   map = (uint8_t *)mmap(NULL, statp.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == (uint8_t *)MAP_FAILED) {
+      map = NULL;
+      goto bail_out;
+   }
+#else
+   map = (uint8_t *)malloc(statp.st_size);
+   if (read(fd, map, statp.st_size) != statp.st_size) {
+      goto bail_out;
+   }
+#endif
+   end = map + statp.st_size - ACC_MAX_RECORD_PAD;
+
+   unser_begin(map, statp.st_size);
+   unser_uint32(magic);
+   unser_uint32(version);
+   if (magic != ACC_CACHE_MAGIC || version != ACC_CACHE_VERSION) {
+      goto bail_out;
+   }
+   md5 = unser_cache_string(&ser_ptr, end);
+   ids = unser_cache_string(&ser_ptr, end);
+   if (!md5 || !ids || ser_ptr + 4 > end) {
+      goto bail_out;
+   }
+   if (strcmp(md5, fileset) != 0 || strcmp(ids, jobids) != 0) {
+      Dmsg2(dbglvl, "Accurate cache made for jobids=%s, not %s\n", ids, jobids);
+      goto bail_out;
+   }
+   unser_uint32(nfiles);
+
+   accurate_init(jcr, nfiles);
+   for ( ;; ) {
+      if (ser_ptr + 4 > end) {
+         goto bail_out;
+      }
+      unser_uint32(len);
+      if (len == 0) {
+         break;
+      }
+      if (len > (uint32_t)(end - ser_ptr) ||
+          !accurate_add_records(jcr, ser_ptr, ser_ptr + len)) {
+         goto bail_out;
+      }
+      ser_ptr += len;
+   }
+   ok = true;
+   Dmsg3(dbglvl, "Accurate cache %s loaded, files=%u jobids=%s\n", fname,
+         acc_table_size(jcr->file_list), jobids);
+
+bail_out:
+   if (!ok) {
+      accurate_free(jcr);
+   }
+   if (map) {
+#ifndef HAVE_WIN32
+      munmap(map, statp.st_size);
+#else
+      free(map);
+#endif
+   }
+   close(fd);
+   return ok;
+}
+
+/*
+ * Director -> FD: accuratecache files=xxx fileset=<md5> jobids=<jobids|none>
+ *
+ *  The jobids are the ones of the accurate list that the Director
+ *   would send for this job.  If our cache was made for them, it
+ *   becomes the accurate list and the Director sends nothing.
+ *   In any case, we start the cache of this job.
+ */
+int accurate_cache_cmd(JCR *jcr)
+{
+   BSOCK *dir = jcr->dir_bsock;
+   POOL_MEM jobids(PM_MESSAGE), fname(PM_FNAME), spill(PM_FNAME);
+   const char *spill_file = NULL;
+   char fileset[128], *p;
+   int32_t nb;
+   bool found = false;
+   ACC_CACHE *cache;
+
+   /* The jobids can be longer than what sscanf() takes for a %s */
+   if (sscanf(dir->msg, accuratecachecmd, &nb, fileset) != 2 ||
+       !(p = strstr(dir->msg, " jobids="))) {
+      dir->fsend(_("2991 Bad accuratecache command\n"));
+      return false;
+   }
+   pm_strcpy(jobids, p + 8);
+   strip_trailing_newline(jobids.c_str());
+   accurate_cache_free(jcr);
+   if (!me->AccurateCache || job_canceled(jcr)) {
+      return dir->fsend(OKaccuratecache, 0);
+   }
+
+   accurate_cache_fname(fname.addr(), fileset);
+   if (strcmp(jobids.c_str(), "none") != 0) {
+      found = accurate_cache_load(jcr, fname.c_str(), fileset, jobids.c_str());
+      if (found) {
+         jcr->accurate = true;
+         Jmsg(jcr, M_INFO, 0, _("Using the accurate list kept by the Client.\n"));
+      }
+   }
+
+   if (me->MaxAccurateMemoryFiles > 0 && nb > (int)me->MaxAccurateMemoryFiles) {
+      Mmsg(spill, "%s/%s.%d.acache-new", me->working_directory, my_name, jcr->JobId);
+      spill_file = spill.c_str();
+   }
+   cache = (ACC_CACHE *)malloc(sizeof(ACC_CACHE));
+   cache->table = new_acc_table(jcr, nb, spill_file);
+   cache->fileset = get_pool_memory(PM_FNAME);
+   cache->jobids = get_pool_memory(PM_MESSAGE);
+   pm_strcpy(cache->fileset, fileset);
+   if (strcmp(jobids.c_str(), "none") == 0) {
+      Mmsg(cache->jobids, "%d", jcr->JobId);
+   } else {
+      Mmsg(cache->jobids, "%s,%d", jobids.c_str(), jcr->JobId);
+   }
+   jcr->acc_cache = cache;
+
+   return dir->fsend(OKaccuratecache, found);
+}
+
+/* Stop the cache of this job, nothing will be saved */
+static void accurate_cache_drop(JCR *jcr, const char *fname)
+{
+   Jmsg(jcr, M_INFO, 0, _("Cannot add %s to the accurate cache, "
+        "it will not be saved.\n"), fname);
+   free_acc_table(jcr->acc_cache->table);
+   jcr->acc_cache->table = NULL;
+}
+
+/*
+ * Keep a file sent to the catalog, with its lstat fields as
+ *  encode_and_send_attributes() sends them and its digest
+ */
+void accurate_cache_add_file(JCR *jcr, FF_PKT *ff_pkt, int data_stream,
+                             char *digest, int digest_len)
+{
+   char attribs[MAXSTRING];
+   int64_t fields[ACC_STAT_FIELDS];
+   char *fname, *name;
+   int n;
+
+   if (!jcr->acc_cache || !jcr->acc_cache->table) {
+      return;
+   }
+   encode_stat(attribs, &ff_pkt->statp, sizeof(ff_pkt->statp), ff_pkt->LinkFI,
+               data_stream);
+   n = from_base64_list(fields, ACC_STAT_FIELDS, attribs);
+   memset(fields + n, 0, (ACC_STAT_FIELDS - n) * sizeof(int64_t));
+
+   strip_path(ff_pkt);
+   if (S_ISDIR(ff_pkt->statp.st_mode)) {
+      fname = ff_pkt->link;
+   } else {
+      fname = ff_pkt->fname;
+   }
+   name = strrchr(fname, '/');
+   name = name ? name + 1 : fname;
+   if (!acc_table_add_entry(jcr->acc_cache->table, fname, name - fname, name,
+                            fields, digest, digest_len, false, ff_pkt->delta_seq)) {
+      accurate_cache_drop(jcr, fname);
+   }
+   unstrip_path(ff_pkt);
+}
+
+/*
+ * Add the files of the accurate list that were seen but not sent
+ *  to the catalog.  Called before the list is freed.
+ */
+void accurate_cache_merge(JCR *jcr)
+{
+   ACC_TABLE *list = jcr->file_list;
+   ACC_ENTRY *elt;
+   int64_t fields[ACC_STAT_FIELDS];
+   const char *dir;
+   POOLMEM *fname;
+
+   if (!jcr->acc_cache || !jcr->acc_cache->table || !list) {
+      return;
+   }
+   fname = get_pool_memory(PM_FNAME);
+   foreach_acc_table(elt, list) {
+      if (!acc_table_is_seen(list, elt)) {
+         continue;
+      }
+      acc_entry_fname(list, elt, fname);
+      if (acc_table_lookup(jcr->acc_cache->table, fname)) {
+         continue;                    /* sent to the catalog */
+      }
+      acc_entry_fields(elt, fields);
+      dir = acc_entry_dir(list, elt);
+      if (!acc_table_add_entry(jcr->acc_cache->table, dir, strlen(dir), elt->name,
+                               fields, acc_entry_digest(elt), elt->digest_len,
+                               elt->digest_text, elt->delta_seq)) {
+         accurate_cache_drop(jcr, fname);
+         break;
+      }
+   }
+   free_pool_memory(fname);
+}
+
+/* Write the block and its length, start a new one */
+static bool write_cache_block(FILE *fp, POOLMEM *block, int32_t &len)
+{
+   uint8_t hdr[4];
+   ser_declare;
+
+   ser_begin(hdr, sizeof(hdr));
+   ser_uint32(len);
+   if (fwrite(hdr, sizeof(hdr), 1, fp) != 1 ||
+       (len > 0 && fwrite(block, len, 1, fp) != 1)) {
+      return false;
+   }
+   len = 0;
+   return true;
+}
+
+/*
+ * Write the cache of a job that ended well, then free it.  It is
+ *  written in a temporary file that replaces the previous one.
+ */
+bool accurate_cache_save(JCR *jcr)
+{
+   ACC_CACHE *cache = jcr->acc_cache;
+   ACC_TABLE *t;
+   ACC_ENTRY *elt;
+   POOL_MEM fname(PM_FNAME), tmp(PM_FNAME);
+   POOLMEM *block;
+   int64_t fields[ACC_STAT_FIELDS];
+   uint32_t last_dir = 0;
+   int32_t len = 0, need;
+   const char *dir;
+   bool ok = false;
+   FILE *fp;
+   ser_declare;
+
+   if (!cache || !cache->table) {
+      accurate_cache_free(jcr);
+      return false;
+   }
+   t = cache->table;
+   accurate_cache_fname(fname.addr(), cache->fileset);
+   Mmsg(tmp, "%s.%d.tmp", fname.c_str(), jcr->JobId);
+   if (!(fp = fopen(tmp.c_str(), "wb"))) {
+      berrno be;
+      Jmsg(jcr, M_INFO, 0, _("Cannot create accurate cache %s. ERR=%s\n"),
+           tmp.c_str(), be.bstrerror());
+      accurate_cache_free(jcr);
+      return false;
+   }
+
+   block = get_memory(ACC_BLOCK_SIZE);
+   block = check_pool_memory_size(block, ACC_CACHE_HEADER +
+                                  strlen(cache->fileset) + strlen(cache->jobids));
+   ser_begin(block, 0);
+   ser_uint32(ACC_CACHE_MAGIC);
+   ser_uint32(ACC_CACHE_VERSION);
+   ser_string(cache->fileset);
+   ser_string(cache->jobids);
+   ser_uint32(acc_table_size(t));
+   if (fwrite(block, ser_length(block), 1, fp) != 1) {
+      goto bail_out;
+   }
+
+   foreach_acc_table(elt, t) {
+      uint8_t flags = 0;
+
+      dir = acc_entry_dir(t, elt);
+      need = strlen(dir) + strlen(elt->name) + 2 + 2 + ACC_STAT_FIELDS * 10 + 5 + 1 +
+             elt->digest_len;
+      if (len > 0 && len + need > ACC_BLOCK_SIZE) {
+         if (!write_cache_block(fp, block, len)) {
+            goto bail_out;
+         }
+      }
+      block = check_pool_memory_size(block, len + need);
+      if (len == 0 || elt->dir != last_dir) {
+         flags |= ACC_REC_PATH;
+         last_dir = elt->dir;
+      }
+      if (elt->digest_len > 0) {
+         flags |= elt->digest_text ? ACC_REC_DIGEST_TEXT : ACC_REC_DIGEST;
+      }
+      acc_entry_fields(elt, fields);
+
+      ser_begin(block + len, need);
+      ser_uint8(flags);
+      if (flags & ACC_REC_PATH) {
+         ser_string(dir);
+      }
+      ser_string(elt->name);
+      ser_uint8(ACC_STAT_FIELDS);
+      for (int i = 0; i < ACC_STAT_FIELDS; i++) {
+         ser_svarint(fields[i]);
+      }
+      ser_varint((uint32_t)elt->delta_seq);
+      if (elt->digest_len > 0) {
+         ser_uint8(elt->digest_len);
+         ser_bytes(acc_entry_digest(elt), elt->digest_len);
+      }
+      len += ser_length(block + len);
+   }
+   if (len > 0 && !write_cache_block(fp, block, len)) {
+      goto bail_out;
+   }
+   block = check_pool_memory_size(block, ACC_MAX_RECORD_PAD);
+   memset(block, 0, ACC_MAX_RECORD_PAD);
+   if (!write_cache_block(fp, block, len) ||       /* end of the blocks */
+       fwrite(block, ACC_MAX_RECORD_PAD, 1, fp) != 1) {
+      goto bail_out;
+   }
+   ok = true;
+
+bail_out:
+   if (fclose(fp) != 0) {
+      ok = false;
+   }
+   if (ok && rename(tmp.c_str(), fname.c_str()) != 0) {
+      ok = false;
+   }
+   if (ok) {
+      Dmsg3(dbglvl, "Accurate cache %s saved, files=%u jobids=%s\n", fname.c_str(),
+            acc_table_size(t), cache->jobids);
+   } else {
+      berrno be;
+      Jmsg(jcr, M_INFO, 0, _("Cannot write accurate cache %s. ERR=%s\n"),
+           fname.c_str(), be.bstrerror());
+      unlink(tmp.c_str());
+   }
+   free_memory(block);
+   accurate_cache_free(jcr);
+   return ok;
+}
+
+void accurate_cache_free(JCR *jcr)
+{
+   ACC_CACHE *cache = jcr->acc_cache;
+
+   if (!cache) {
+      return;
+   }
+   jcr->acc_cache = NULL;
+   if (cache->table) {
+      free_acc_table(cache->table);
+   }
+   free_pool_memory(cache->fileset);
+   free_pool_memory(cache->jobids);
+   free(cache);
+}
@@ -0,0 +1,653 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  acctable.c  compact table of the files of the previous backups
+ *
+ *  A file name is split after its last '/'.  The directory part
+ *   is stored once in the directory arena and the entries refer
+ *   to it by number.  The entries are packed one after the other
+ *   in chunks of up to 16MB, and are found with an open addressing
+ *   hash index whose slots hold the location of the entry and a
+ *   part of its hash, so that most misses do not touch the
+ *   entries.
+ *
+ *  In spill mode the entry chunks and the hash index are mapped
+ *   from an unlinked file of the working directory.  The
+ *   directory names and the seen bitmap stay in memory.
+ *
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#ifndef HAVE_WIN32
+#include <sys/mman.h>
+#endif
+
+static const int dbglvl = 100;
+
+#define ACC_MIN_CHUNK   (64 * 1024)
+#define ACC_MAX_CHUNK   (16 * 1024 * 1024)
+#define ACC_MIN_BUCKETS 8192
+
+/*
+ * A slot of the hash index: 22 bits of hash, chunk number + 1
+ *  on 20 bits and offset / 4 in the chunk on 22 bits.
+ */
+#define ACC_MAX_CHUNKS  ((1 << 20) - 1)
+#define slot_tag(h)     ((h) >> 42)
+#define slot_make(tag, chunk, off) \
+   (((uint64_t)(tag) << 42) | ((uint64_t)((chunk) + 1) << 22) | ((off) >> 2))
+#define slot_chunk(s)   ((int)(((s) >> 22) & 0xFFFFF) - 1)
+#define slot_off(s)     ((uint32_t)((s) & 0x3FFFFF) << 2)
+
+/* Directory names are found with chunk << 32 | offset */
+#define dir_name(t, n) \
+   ((t)->dirs.chunks[(t)->dir_refs[n] >> 32].mem + ((t)->dir_refs[n] & 0xFFFFFFFF))
+
+/* Room for the encoding of the lstat fields */
+#define ACC_MAX_STAT    (ACC_STAT_FIELDS * 10)
+#define ACC_MAX_DIGEST  128
+
+/*
+ * Get a zeroed region, from the spill file if any.  If the
+ *  file cannot grow, go on in memory.
+ */
+static char *region_alloc(ACC_TABLE *t, ACC_ARENA *a, uint32_t size, bool *mapped)
+{
+   char *mem;
+
+   *mapped = false;
+#ifndef HAVE_WIN32
+   if (a->fd >= 0) {
+      int stat;
+#ifdef HAVE_LINUX_OS
+      stat = posix_fallocate(a->fd, a->fsize, size);
+#else
+      stat = ftruncate(a->fd, a->fsize + size) == 0 ? 0 : errno;
+#endif
+      if (stat == 0) {
+         mem = (char *)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+                            a->fd, a->fsize);
+         if (mem != MAP_FAILED) {
+            a->fsize += size;
+            *mapped = true;
+            return mem;
+         }
+         stat = errno;
+      }
+      berrno be;
+      Jmsg(t->jcr, M_WARNING, 0, _("Cannot extend the accurate spill file, "
+           "keeping the file list in memory. ERR=%s\n"), be.bstrerror(stat));
+      close(a->fd);
+      a->fd = -1;
+   }
+#endif
+   mem = (char *)malloc(size);
+   memset(mem, 0, size);
+   return mem;
+}
+
+static void region_free(char *mem, uint32_t size, bool mapped)
+{
+#ifndef HAVE_WIN32
+   if (mapped) {
+      munmap(mem, size);
+      return;
+   }
+#endif
+   free(mem);
+}
+
+/*
+ * Allocate len bytes in the arena, aligned on 4 bytes
+ */
+static char *arena_alloc(ACC_TABLE *t, ACC_ARENA *a, uint32_t len,
+                         int *chunk, uint32_t *off)
+{
+   ACC_CHUNK *c = a->nchunks > 0 ? &a->chunks[a->nchunks - 1] : NULL;
+
+   len = (len + 3) & ~3;
+   if (!c || c->used + len > c->size) {
+      uint32_t size = c ? MIN(2 * c->size, ACC_MAX_CHUNK) : ACC_MIN_CHUNK;
+
+      if (len > ACC_MAX_CHUNK || a->nchunks == ACC_MAX_CHUNKS) {
+         return NULL;
+      }
+      while (size < len) {
+         size *= 2;
+      }
+      if (a->nchunks == a->max_chunks) {
+         a->max_chunks = a->max_chunks ? 2 * a->max_chunks : 64;
+         a->chunks = (ACC_CHUNK *)realloc(a->chunks, a->max_chunks * sizeof(ACC_CHUNK));
+      }
+      c = &a->chunks[a->nchunks++];
+      c->mem = region_alloc(t, a, size, &c->mapped);
+      c->size = size;
+      c->used = 0;
+      a->bytes += size;
+   }
+   *chunk = a->nchunks - 1;
+   *off = c->used;
+   c->used += len;
+   return c->mem + *off;
+}
+
+static void arena_free(ACC_ARENA *a)
+{
+   for (int i = 0; i < a->nchunks; i++) {
+      region_free(a->chunks[i].mem, a->chunks[i].size, a->chunks[i].mapped);
+   }
+   if (a->chunks) {
+      free(a->chunks);
+   }
+#ifndef HAVE_WIN32
+   if (a->fd >= 0) {
+      close(a->fd);
+   }
+#endif
+   memset(a, 0, sizeof(ACC_ARENA));
+   a->fd = -1;
+}
+
+/* FNV-1a */
+static uint64_t acc_hash(uint32_t dir, const char *name)
+{
+   uint64_t h = 14695981039346656037ULL;
+
+   for (int i = 0; i < 4; i++) {
+      h ^= (dir >> (8 * i)) & 0xFF;
+      h *= 1099511628211ULL;
+   }
+   for ( ; *name; name++) {
+      h ^= (uint8_t)*name;
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+static uint32_t dir_hash(const char *dir, int len)
+{
+   uint32_t h = 2166136261U;
+
+   for (int i = 0; i < len; i++) {
+      h ^= (uint8_t)dir[i];
+      h *= 16777619U;
+   }
+   return h;
+}
+
+/*
+ * Encode the fields of the catalog lstat that we compare, they
+ *  are kept zigzag varint encoded.
+ */
+static int encode_acc_stat(uint8_t *p, int64_t *fields)
+{
+   ser_declare;
+
+   ser_begin(p, ACC_MAX_STAT);
+   for (int i = 0; i < ACC_STAT_FIELDS; i++) {
+      ser_svarint(fields[i]);
+   }
+   return ser_length(p);
+}
+
+/*
+ * Get the ACC_STAT_FIELDS lstat fields of an entry
+ */
+void acc_entry_fields(ACC_ENTRY *entry, int64_t *fields)
+{
+   ser_declare;
+
+   ser_ptr = (uint8_t *)entry->name + strlen(entry->name) + 1;
+   for (int i = 0; i < ACC_STAT_FIELDS; i++) {
+      unser_svarint(fields[i]);
+   }
+}
+
+/*
+ * Decode the stat of an entry, like decode_stat() of its lstat
+ */
+void acc_entry_stat(ACC_ENTRY *entry, struct stat *statp, int32_t *LinkFI)
+{
+   int64_t f[ACC_STAT_FIELDS];
+
+   acc_entry_fields(entry, f);
+   memset(statp, 0, sizeof(struct stat));
+   statp->st_dev = f[0];
+   statp->st_ino = f[1];
+   statp->st_mode = f[2];
+   statp->st_nlink = f[3];
+   statp->st_uid = f[4];
+   statp->st_gid = f[5];
+   statp->st_rdev = f[6];
+   statp->st_size = f[7];
+#ifndef HAVE_MINGW
+   statp->st_blksize = f[8];
+   statp->st_blocks = f[9];
+#endif
+   statp->st_atime = f[10];
+   statp->st_mtime = f[11];
+   statp->st_ctime = f[12];
+   *LinkFI = (int32_t)f[13];
+}
+
+/*
+ * The digest_len bytes of digest of the entry, base64 text if
+ *  digest_text is set
+ */
+const char *acc_entry_digest(ACC_ENTRY *entry)
+{
+   return entry->name + strlen(entry->name) + 1 + entry->stat_len;
+}
+
+bool acc_entry_has_digest(ACC_ENTRY *entry)
+{
+   return entry->digest_len > 0;
+}
+
+/*
+ * Compare the digest of the entry with the size bytes of md
+ */
+bool acc_entry_digest_equal(ACC_ENTRY *entry, char *md, int size)
+{
+   const char *digest = acc_entry_digest(entry);
+
+   if (entry->digest_text) {
+      char buf[ACC_MAX_DIGEST * 2];
+      int len = bin_to_base64(buf, sizeof(buf), md, size, true);
+      return len == entry->digest_len && memcmp(buf, digest, len) == 0;
+   }
+   return size == entry->digest_len && memcmp(md, digest, size) == 0;
+}
+
+/*
+ * Edit the digest of the entry in base64 like the catalog
+ */
+char *acc_entry_digest_edit(ACC_ENTRY *entry, char *buf, int buflen)
+{
+   const char *digest = acc_entry_digest(entry);
+
+   if (entry->digest_text) {
+      bstrncpy(buf, digest, MIN(buflen, entry->digest_len + 1));
+   } else {
+      bin_to_base64(buf, buflen, (char *)digest, entry->digest_len, true);
+   }
+   return buf;
+}
+
+/*
+ * Find the number of the directory of len bytes, add it if
+ *  asked.  Returns -1 if not found.
+ */
+static int64_t find_dir(ACC_TABLE *t, const char *dir, int len, bool add)
+{
+   uint32_t h, mask, i, n;
+   uint64_t ref;
+   char *name;
+   int chunk;
+   uint32_t off;
+
+   if (t->ndirs > 0 && t->last_dir_len == len &&
+       memcmp(dir_name(t, t->last_dir), dir, len) == 0) {
+      return t->last_dir;
+   }
+   h = dir_hash(dir, len);
+   mask = t->dir_hash_size - 1;
+   for (i = h & mask; (n = t->dir_hash[i]) != 0; i = (i + 1) & mask) {
+      name = dir_name(t, n - 1);
+      if (strncmp(name, dir, len) == 0 && name[len] == 0) {
+         t->last_dir = n - 1;
+         t->last_dir_len = len;
+         return n - 1;
+      }
+   }
+   if (!add) {
+      return -1;
+   }
+   name = arena_alloc(t, &t->dirs, len + 1, &chunk, &off);
+   if (!name) {
+      return -1;
+   }
+   memcpy(name, dir, len);
+   name[len] = 0;
+   ref = ((uint64_t)chunk << 32) | off;
+   if (t->ndirs == t->max_dirs) {
+      t->max_dirs = 2 * t->max_dirs;
+      t->dir_refs = (uint64_t *)realloc(t->dir_refs, t->max_dirs * sizeof(uint64_t));
+   }
+   t->dir_refs[t->ndirs] = ref;
+   t->dir_hash[i] = ++t->ndirs;
+
+   /* Keep the directory index half empty */
+   if (2 * t->ndirs > t->dir_hash_size) {
+      uint32_t size = 2 * t->dir_hash_size;
+      free(t->dir_hash);
+      t->dir_hash = (uint32_t *)malloc(size * sizeof(uint32_t));
+      memset(t->dir_hash, 0, size * sizeof(uint32_t));
+      t->dir_hash_size = size;
+      mask = size - 1;
+      for (n = 0; n < t->ndirs; n++) {
+         name = dir_name(t, n);
+         for (i = dir_hash(name, strlen(name)) & mask; t->dir_hash[i]; i = (i + 1) & mask)
+            { }
+         t->dir_hash[i] = n + 1;
+      }
+   }
+   t->last_dir = t->ndirs - 1;
+   t->last_dir_len = len;
+   return t->ndirs - 1;
+}
+
+static ACC_ENTRY *slot_entry(ACC_TABLE *t, uint64_t slot)
+{
+   return (ACC_ENTRY *)(t->entries.chunks[slot_chunk(slot)].mem + slot_off(slot));
+}
+
+static uint64_t *new_buckets(ACC_TABLE *t, uint64_t nbuckets, bool *mapped)
+{
+   return (uint64_t *)region_alloc(t, &t->entries, nbuckets * sizeof(uint64_t), mapped);
+}
+
+/*
+ * Double the hash index when it is 3/4 full
+ */
+static void grow_buckets(ACC_TABLE *t)
+{
+   uint64_t *old = t->buckets;
+   uint64_t oldn = t->nbuckets;
+   bool old_mapped = t->buckets_mapped;
+   uint64_t mask, i, j, h;
+   ACC_ENTRY *entry;
+
+   t->nbuckets = 2 * oldn;
+   t->buckets = new_buckets(t, t->nbuckets, &t->buckets_mapped);
+   mask = t->nbuckets - 1;
+   for (j = 0; j < oldn; j++) {
+      if (old[j] == 0) {
+         continue;
+      }
+      entry = slot_entry(t, old[j]);
+      h = acc_hash(entry->dir, entry->name);
+      for (i = h & mask; t->buckets[i]; i = (i + 1) & mask)
+         { }
+      t->buckets[i] = old[j];
+   }
+   region_free((char *)old, oldn * sizeof(uint64_t), old_mapped);
+   Dmsg1(dbglvl, "accurate hash index grown to %lld slots\n", t->nbuckets);
+}
+
+/*
+ * Create a table for about nbfile entries.  If spill_file is
+ *  given, the entries are kept in that file.
+ */
+ACC_TABLE *new_acc_table(JCR *jcr, int64_t nbfile, const char *spill_file)
+{
+   ACC_TABLE *t = (ACC_TABLE *)malloc(sizeof(ACC_TABLE));
+   uint64_t nbuckets = ACC_MIN_BUCKETS;
+
+   memset(t, 0, sizeof(ACC_TABLE));
+   t->jcr = jcr;
+   t->entries.fd = t->dirs.fd = -1;
+#ifndef HAVE_WIN32
+   if (spill_file) {
+      t->entries.fd = open(spill_file, O_RDWR|O_CREAT|O_TRUNC, 0600);
+      if (t->entries.fd < 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Cannot create accurate spill file %s, "
+              "keeping the file list in memory. ERR=%s\n"), spill_file, be.bstrerror());
+      } else {
+         unlink(spill_file);          /* released with the descriptor */
+         Dmsg1(dbglvl, "accurate file list spilled to %s\n", spill_file);
+      }
+   }
+#endif
+   while (nbuckets * 3 < (uint64_t)nbfile * 4) {
+      nbuckets *= 2;
+   }
+   t->nbuckets = nbuckets;
+   t->buckets = new_buckets(t, nbuckets, &t->buckets_mapped);
+   t->max_dirs = 1024;
+   t->dir_refs = (uint64_t *)malloc(t->max_dirs * sizeof(uint64_t));
+   t->dir_hash_size = 4096;
+   t->dir_hash = (uint32_t *)malloc(t->dir_hash_size * sizeof(uint32_t));
+   memset(t->dir_hash, 0, t->dir_hash_size * sizeof(uint32_t));
+   t->seen_size = MAX(nbfile / 8 + 1, 64);
+   t->seen = (uint8_t *)malloc(t->seen_size);
+   memset(t->seen, 0, t->seen_size);
+   return t;
+}
+
+void free_acc_table(ACC_TABLE *t)
+{
+   Dmsg4(dbglvl, "accurate table entries=%u dirs=%u bytes=%lld spilled=%d\n",
+         t->nentries, t->ndirs, acc_table_bytes(t), acc_table_spilled(t));
+   region_free((char *)t->buckets, t->nbuckets * sizeof(uint64_t), t->buckets_mapped);
+   arena_free(&t->entries);
+   arena_free(&t->dirs);
+   free(t->dir_refs);
+   free(t->dir_hash);
+   free(t->seen);
+   free(t);
+}
+
+/*
+ * Add a file from the text list sent by the Director
+ */
+bool acc_table_add(ACC_TABLE *t, char *fname, char *lstat, char *chksum,
+                   int32_t delta_seq)
+{
+   int64_t fields[ACC_STAT_FIELDS];
+   char md[ACC_MAX_DIGEST], buf[ACC_MAX_DIGEST * 2];
+   const char *name, *digest = NULL;
+   int n, len, digest_len = 0;
+   bool text = false;
+
+   name = strrchr(fname, '/');
+   name = name ? name + 1 : fname;
+   n = from_base64_list(fields, ACC_STAT_FIELDS, lstat);
+   memset(fields + n, 0, (ACC_STAT_FIELDS - n) * sizeof(int64_t));
+
+   /* Keep the checksum in binary if we can edit it back */
+   len = strlen(chksum);
+   if (len > 0 && len < ACC_MAX_DIGEST) {
+      digest_len = base64_to_bin(md, sizeof(md), chksum, len);
+      if (digest_len > 0 &&
+          bin_to_base64(buf, sizeof(buf), md, digest_len, true) == len &&
+          memcmp(buf, chksum, len) == 0) {
+         digest = md;
+      } else {
+         digest = chksum;
+         digest_len = len;
+         text = true;
+      }
+   }
+   return acc_table_add_entry(t, fname, name - fname, name, fields,
+                              digest, digest_len, text, delta_seq);
+}
+
+/*
+ * Add a file of the directory dir (dir_len bytes, with the
+ *  trailing slash), its lstat fields already decoded and its
+ *  digest in binary or, if text is set, in base64.
+ */
+bool acc_table_add_entry(ACC_TABLE *t, const char *dir, int dir_len,
+                         const char *name, int64_t *fields,
+                         const char *digest, int digest_len, bool text,
+                         int32_t delta_seq)
+{
+   uint8_t st[ACC_MAX_STAT];
+   int64_t dirno;
+   int stat_len, name_len, chunk, len;
+   uint32_t off;
+   uint64_t h, mask, i;
+   ACC_ENTRY *entry;
+
+   if (digest_len >= ACC_MAX_DIGEST) {
+      digest_len = 0;
+   }
+   name_len = strlen(name);
+   dirno = find_dir(t, dir, dir_len, true);
+   if (dirno < 0) {
+      return false;
+   }
+   stat_len = encode_acc_stat(st, fields);
+
+   if (4 * ((uint64_t)t->nentries + 1) > 3 * t->nbuckets) {
+      grow_buckets(t);
+   }
+   len = offsetof(ACC_ENTRY, name) + name_len + 1 + stat_len + digest_len;
+   entry = (ACC_ENTRY *)arena_alloc(t, &t->entries, len, &chunk, &off);
+   if (!entry) {
+      return false;
+   }
+   entry->index = t->nentries++;
+   entry->dir = dirno;
+   entry->delta_seq = delta_seq;
+   entry->stat_len = stat_len;
+   entry->digest_len = digest_len;
+   entry->digest_text = text;
+   memcpy(entry->name, name, name_len + 1);
+   memcpy(entry->name + name_len + 1, st, stat_len);
+   if (digest_len > 0) {
+      memcpy(entry->name + name_len + 1 + stat_len, digest, digest_len);
+   }
+
+   h = acc_hash(entry->dir, entry->name);
+   mask = t->nbuckets - 1;
+   for (i = h & mask; t->buckets[i]; i = (i + 1) & mask)
+      { }
+   t->buckets[i] = slot_make(slot_tag(h), chunk, off);
+
+   if (entry->index / 8 >= t->seen_size) {
+      uint32_t size = 2 * t->seen_size;
+      t->seen = (uint8_t *)realloc(t->seen, size);
+      memset(t->seen + t->seen_size, 0, size - t->seen_size);
+      t->seen_size = size;
+   }
+   return true;
+}
+
+/*
+ * Find a file by its full name
+ */
+ACC_ENTRY *acc_table_lookup(ACC_TABLE *t, char *fname)
+{
+   const char *name;
+   int64_t dir;
+   uint64_t h, mask, i, tag, slot;
+   ACC_ENTRY *entry;
+
+   name = strrchr(fname, '/');
+   name = name ? name + 1 : fname;
+   dir = find_dir(t, fname, name - fname, false);
+   if (dir < 0) {
+      return NULL;
+   }
+   h = acc_hash(dir, name);
+   tag = slot_tag(h);
+   mask = t->nbuckets - 1;
+   for (i = h & mask; (slot = t->buckets[i]) != 0; i = (i + 1) & mask) {
+      if (slot_tag(slot) != tag) {
+         continue;
+      }
+      entry = slot_entry(t, slot);
+      if (entry->dir == dir && strcmp(entry->name, name) == 0) {
+         return entry;
+      }
+   }
+   return NULL;
+}
+
+void acc_table_set_seen(ACC_TABLE *t, ACC_ENTRY *entry)
+{
+   t->seen[entry->index / 8] |= 1 << (entry->index % 8);
+}
+
+bool acc_table_is_seen(ACC_TABLE *t, ACC_ENTRY *entry)
+{
+   return (t->seen[entry->index / 8] & (1 << (entry->index % 8))) != 0;
+}
+
+/*
+ * Edit the full name of an entry in fname
+ */
+char *acc_entry_fname(ACC_TABLE *t, ACC_ENTRY *entry, POOLMEM *&fname)
+{
+   Mmsg(fname, "%s%s", dir_name(t, entry->dir), entry->name);
+   return fname;
+}
+
+/*
+ * Directory part of the name of an entry, with the trailing slash
+ */
+const char *acc_entry_dir(ACC_TABLE *t, ACC_ENTRY *entry)
+{
+   return dir_name(t, entry->dir);
+}
+
+static uint32_t entry_size(ACC_ENTRY *entry)
+{
+   uint32_t len = offsetof(ACC_ENTRY, name) + strlen(entry->name) + 1 +
+                  entry->stat_len + entry->digest_len;
+   return (len + 3) & ~3;
+}
+
+/*
+ * Walk the entries in the order they were added
+ */
+ACC_ENTRY *acc_table_first(ACC_TABLE *t)
+{
+   t->it_chunk = 0;
+   t->it_off = 0;
+   return acc_table_next(t);
+}
+
+ACC_ENTRY *acc_table_next(ACC_TABLE *t)
+{
+   ACC_ENTRY *entry;
+
+   while (t->it_chunk < t->entries.nchunks) {
+      ACC_CHUNK *c = &t->entries.chunks[t->it_chunk];
+      if (t->it_off < c->used) {
+         entry = (ACC_ENTRY *)(c->mem + t->it_off);
+         t->it_off += entry_size(entry);
+         return entry;
+      }
+      t->it_chunk++;
+      t->it_off = 0;
+   }
+   return NULL;
+}
+
+uint32_t acc_table_size(ACC_TABLE *t)
+{
+   return t->nentries;
+}
+
+/*
+ * Bytes used by the table, in memory or in the spill file
+ */
+uint64_t acc_table_bytes(ACC_TABLE *t)
+{
+   return t->entries.bytes + t->dirs.bytes + t->nbuckets * sizeof(uint64_t) +
+          t->seen_size + t->max_dirs * sizeof(uint64_t) +
+          t->dir_hash_size * sizeof(uint32_t) + sizeof(ACC_TABLE);
+}
+
+bool acc_table_spilled(ACC_TABLE *t)
+{
+   return t->entries.fd >= 0;
+}
@@ -0,0 +1,99 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Compact table of the files of the previous backups (accurate mode)
+ *
+ *  The entries are packed in large chunks: the directory part of
+ *  the file name is stored once per directory, the lstat field is
+ *  kept decoded and varint encoded, and the checksum is kept in
+ *  binary.  The seen flags are a bitmap.  When the table is
+ *  expected to be large, the chunks and the hash index are mapped
+ *  from a file in the working directory so that the kernel can
+ *  page them out.
+ */
+
+#ifndef __ACCTABLE_H
+#define __ACCTABLE_H
+
+/* lstat fields kept: dev ino mode nlink uid gid rdev size blksize
+ *  blocks atime mtime ctime LinkFI
+ */
+#define ACC_STAT_FIELDS 14
+
+/* Readable bytes needed after binary records, see accurate_add_records() */
+#define ACC_MAX_RECORD_PAD 512
+
+/* One file of the previous backups, followed by its data */
+struct ACC_ENTRY {
+   uint32_t index;                     /* entry number, bit in the seen bitmap */
+   uint32_t dir;                       /* directory number */
+   int32_t delta_seq;                  /* delta sequence */
+   uint8_t stat_len;                   /* bytes of encoded stat after the name */
+   uint8_t digest_len;                 /* bytes of digest after the stat */
+   uint8_t digest_text;                /* digest kept as base64 text */
+   uint8_t pad;
+   char name[1];                       /* name\0 stat digest */
+};
+
+/* A chunk of entries, in memory or mapped from the spill file */
+struct ACC_CHUNK {
+   char *mem;                          /* chunk data */
+   uint32_t size;                      /* allocated bytes */
+   uint32_t used;                      /* bytes used */
+   bool mapped;                        /* mapped from the spill file */
+};
+
+struct ACC_ARENA {
+   ACC_CHUNK *chunks;                  /* the chunks */
+   int nchunks;                        /* chunks in use */
+   int max_chunks;                     /* allocated chunk slots */
+   int fd;                             /* spill file, -1 in memory */
+   boffset_t fsize;                    /* size of the spill file */
+   uint64_t bytes;                     /* bytes allocated for the chunks */
+};
+
+struct ACC_TABLE {
+   JCR *jcr;
+   ACC_ARENA entries;                  /* the entries */
+   ACC_ARENA dirs;                     /* the directory names, in memory */
+   uint64_t *buckets;                  /* hash index of the entries */
+   uint64_t nbuckets;                  /* size of the index, power of 2 */
+   bool buckets_mapped;                /* index mapped from the spill file */
+   uint32_t nentries;                  /* number of entries */
+   uint8_t *seen;                      /* seen bitmap */
+   uint32_t seen_size;                 /* bytes of the bitmap */
+   uint64_t *dir_refs;                 /* directory number -> name */
+   uint32_t ndirs;                     /* number of directories */
+   uint32_t max_dirs;                  /* allocated dir_refs */
+   uint32_t *dir_hash;                 /* hash index of the directories */
+   uint32_t dir_hash_size;             /* size of the index, power of 2 */
+   uint32_t last_dir;                  /* directory of the last lookup */
+   int last_dir_len;                   /* ... length of its name */
+   int it_chunk;                       /* foreach_acc_table() position */
+   uint32_t it_off;
+};
+
+/* Files of the running job, saved for the next accurate job */
+struct ACC_CACHE {
+   ACC_TABLE *table;                   /* files sent to the catalog or unchanged */
+   POOLMEM *fileset;                   /* MD5 of the FileSet */
+   POOLMEM *jobids;                    /* jobids of the next accurate list */
+};
+
+#define foreach_acc_table(entry, table) \
+   for ((entry) = acc_table_first(table); (entry); (entry) = acc_table_next(table))
+
+#endif /* __ACCTABLE_H */
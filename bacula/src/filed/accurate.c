@@ -23,24 +23,15 @@
 
 static int dbglvl=100;
 
-typedef struct PrivateCurFile {
-   hlink link;
-   char *fname;
-   char *lstat;
-   char *chksum;
-   int32_t delta_seq;
-   bool seen;
-} CurFile;
 
 bool accurate_mark_file_as_seen(JCR *jcr, char *fname)
 {
    if (!jcr->accurate || !jcr->file_list) {
       return false;
    }
-   /* TODO: just use elt->seen = 1 */
-   CurFile *temp = (CurFile *)jcr->file_list->lookup(fname);
-   if (temp) {
-      temp->seen = 1;              /* records are in memory */
+   ACC_ENTRY *elt = acc_table_lookup(jcr->file_list, fname);
+   if (elt) {
+      acc_table_set_seen(jcr->file_list, elt);
       Dmsg1(dbglvl, "marked <%s> as seen\n", fname);
    } else {
       Dmsg1(dbglvl, "<%s> not found to be marked as seen\n", fname);
@@ -48,42 +39,27 @@ bool accurate_mark_file_as_seen(JCR *jcr, char *fname)
    return true;
 }
 
-static bool accurate_mark_file_as_seen(JCR *jcr, CurFile *elt)
+/*
+ * Large lists are kept in a file of the working directory
+ *  when the Client has a Maximum Accurate Memory Files.
+ */
+bool accurate_init(JCR *jcr, int nbfile)
 {
-   /* TODO: just use elt->seen = 1 */
-   CurFile *temp = (CurFile *)jcr->file_list->lookup(elt->fname);
-   if (temp) {
-      temp->seen = 1;              /* records are in memory */
-   }
-   return true;
-}
+   POOL_MEM spill(PM_FNAME);
+   const char *spill_file = NULL;
 
-static bool accurate_lookup(JCR *jcr, char *fname, CurFile *ret)
-{
-   bool found=false;
-   ret->seen = 0;
-
-   CurFile *temp = (CurFile *)jcr->file_list->lookup(fname);
-   if (temp) {
-      memcpy(ret, temp, sizeof(CurFile));
-      found=true;
-      Dmsg1(dbglvl, "lookup <%s> ok\n", fname);
+   if (me->MaxAccurateMemoryFiles > 0 && nbfile > (int)me->MaxAccurateMemoryFiles) {
+      Mmsg(spill, "%s/%s.%d.accurate", me->working_directory, my_name, jcr->JobId);
+      spill_file = spill.c_str();
    }
-
-   return found;
-}
-
-static bool accurate_init(JCR *jcr, int nbfile)
-{
-   CurFile *elt = NULL;
-   jcr->file_list = (htable *)malloc(sizeof(htable));
-   jcr->file_list->init(elt, &elt->link, nbfile);
+   jcr->file_list = new_acc_table(jcr, nbfile, spill_file);
    return true;
 }
 
 static bool accurate_send_base_file_list(JCR *jcr)
 {
-   CurFile *elt;
+   ACC_ENTRY *elt;
+   POOLMEM *fname;
    struct stat statc;
    int32_t LinkFIc;
    FF_PKT *ff_pkt;
@@ -99,19 +75,20 @@ static bool accurate_send_base_file_list(JCR *jcr)
 
    ff_pkt = init_find_files();
    ff_pkt->type = FT_BASE;
-
-   foreach_htable(elt, jcr->file_list) {
-      if (elt->seen) {
-         Dmsg2(dbglvl, "base file fname=%s seen=%i\n", elt->fname, elt->seen);
-         /* TODO: skip the decode and use directly the lstat field */
-         decode_stat(elt->lstat, &statc, sizeof(statc), &LinkFIc); /* decode catalog stat */
-         ff_pkt->fname = elt->fname;
+   fname = get_pool_memory(PM_FNAME);
+
+   foreach_acc_table(elt, jcr->file_list) {
+      if (acc_table_is_seen(jcr->file_list, elt)) {
+         acc_entry_fname(jcr->file_list, elt, fname);
+         Dmsg1(dbglvl, "base file fname=%s\n", fname);
+         acc_entry_stat(elt, &statc, &LinkFIc); /* catalog stat */
+         ff_pkt->fname = fname;
          ff_pkt->statp = statc;
          encode_and_send_attributes(jcr, ff_pkt, stream);
-//       free(elt->fname);
       }
    }
 
+   free_pool_memory(fname);
    term_find_files(ff_pkt);
    return true;
 }
@@ -123,7 +100,8 @@ static bool accurate_send_base_file_list(JCR *jcr)
  */
 static bool accurate_send_deleted_list(JCR *jcr)
 {
-   CurFile *elt;
+   ACC_ENTRY *elt;
+   POOLMEM *fname;
    struct stat statc;
    int32_t LinkFIc;
    FF_PKT *ff_pkt;
@@ -139,31 +117,42 @@ static bool accurate_send_deleted_list(JCR *jcr)
 
    ff_pkt = init_find_files();
    ff_pkt->type = FT_DELETED;
+   fname = get_pool_memory(PM_FNAME);
 
-   foreach_htable(elt, jcr->file_list) {
-      if (elt->seen || plugin_check_file(jcr, elt->fname)) {
+   foreach_acc_table(elt, jcr->file_list) {
+      if (acc_table_is_seen(jcr->file_list, elt)) {
          continue;
       }
-      Dmsg2(dbglvl, "deleted fname=%s seen=%i\n", elt->fname, elt->seen);
-      /* TODO: skip the decode and use directly the lstat field */
-      decode_stat(elt->lstat, &statc, sizeof(statc), &LinkFIc); /* decode catalog stat */
-      ff_pkt->fname = elt->fname;
+      acc_entry_fname(jcr->file_list, elt, fname);
+      if (plugin_check_file(jcr, fname)) {
+         continue;
+      }
+      Dmsg1(dbglvl, "deleted fname=%s\n", fname);
+      acc_entry_stat(elt, &statc, &LinkFIc); /* catalog stat */
+      ff_pkt->fname = fname;
       ff_pkt->statp.st_mtime = statc.st_mtime;
       ff_pkt->statp.st_ctime = statc.st_ctime;
       encode_and_send_attributes(jcr, ff_pkt, stream);
-//    free(elt->fname);
    }
 
+   free_pool_memory(fname);
    term_find_files(ff_pkt);
    return true;
 }
 
+/*
+ * The status thread looks at the table with the jcr locked
+ */
 void accurate_free(JCR *jcr)
 {
-   if (jcr->file_list) {
-      jcr->file_list->destroy();
-      free(jcr->file_list);
-      jcr->file_list = NULL;
+   ACC_TABLE *file_list;
+
+   jcr->lock();
+   file_list = jcr->file_list;
+   jcr->file_list = NULL;
+   jcr->unlock();
+   if (file_list) {
+      free_acc_table(file_list);
    }
 }
 
@@ -176,6 +165,7 @@ bool accurate_finish(JCR *jcr)
       accurate_free(jcr);
       return ret;
    }
+   accurate_cache_merge(jcr);         /* unchanged files go to the cache */
    if (jcr->accurate) {
       if (jcr->is_JobLevel(L_FULL)) {
          if (!jcr->rerunning) {
@@ -193,36 +183,145 @@ bool accurate_finish(JCR *jcr)
    return ret;
 }
 
-static bool accurate_add_file(JCR *jcr, uint32_t len,
-                              char *fname, char *lstat, char *chksum,
+static bool accurate_add_file(JCR *jcr, char *fname, char *lstat, char *chksum,
                               int32_t delta)
 {
-   bool ret = true;
-   CurFile *item;
-
-   /* we store CurFile, fname and ctime/mtime in the same chunk
-    * we need one extra byte to handle an empty chksum
-    */
-   item = (CurFile *)jcr->file_list->hash_malloc(sizeof(CurFile)+len+3);
-   item->seen = 0;
+   if (!acc_table_add(jcr->file_list, fname, lstat, chksum, delta)) {
+      Jmsg(jcr, M_FATAL, 0, _("Cannot add %s to the accurate file list\n"), fname);
+      return false;
+   }
+   Dmsg4(dbglvl, "add fname=<%s> lstat=%s  delta_seq=%i chksum=%s\n",
+         fname, lstat, delta, chksum);
+   return true;
+}
 
-   /* TODO: see if we can optimize this part with memcpy instead of strcpy */
-   item->fname  = (char *)item+sizeof(CurFile);
-   strcpy(item->fname, fname);
+/* Get the string at ser_ptr, NULL if it does not end before end */
+static char *unser_acc_string(uint8_t **ptr, uint8_t *end)
+{
+   char *str = (char *)*ptr;
+   uint8_t *p = (uint8_t *)memchr(*ptr, 0, end - *ptr);
 
-   item->lstat  = item->fname+strlen(item->fname)+1;
-   strcpy(item->lstat, lstat);
+   if (!p) {
+      return NULL;
+   }
+   *ptr = p + 1;
+   return str;
+}
 
-   item->chksum = item->lstat+strlen(item->lstat)+1;
-   strcpy(item->chksum, chksum);
+/*
+ * Add the binary records (see baconfig.h) from ptr to end.  They
+ *  must be followed by ACC_MAX_RECORD_PAD readable bytes so that a
+ *  bad varint cannot go too far.  Returns false if the records
+ *  are malformed or a file cannot be added.
+ */
+bool accurate_add_records(JCR *jcr, uint8_t *ptr, uint8_t *end)
+{
+   int64_t fields[ACC_STAT_FIELDS];
+   uint8_t flags, nfields, digest_len;
+   int32_t delta;
+   char *path = NULL, *name, *digest;
+   int i;
+   ser_declare;
+
+   ser_ptr = ptr;
+   while (ser_ptr < end) {
+      unser_uint8(flags);
+      if (flags & ACC_REC_PATH) {
+         path = unser_acc_string(&ser_ptr, end);
+      }
+      if (!path || !(name = unser_acc_string(&ser_ptr, end))) {
+         return false;
+      }
+      unser_uint8(nfields);
+      for (i = 0; i < nfields; i++) {
+         int64_t val;
+         unser_svarint(val);
+         if (i < ACC_STAT_FIELDS) {
+            fields[i] = val;
+         }
+      }
+      for ( ; i < ACC_STAT_FIELDS; i++) {
+         fields[i] = 0;
+      }
+      unser_varint(delta);
+      digest = NULL;
+      digest_len = 0;
+      if (flags & (ACC_REC_DIGEST|ACC_REC_DIGEST_TEXT)) {
+         unser_uint8(digest_len);
+         digest = (char *)ser_ptr;
+         ser_ptr += digest_len;
+      }
+      if (ser_ptr > end) {
+         return false;
+      }
+      if (!acc_table_add_entry(jcr->file_list, path, strlen(path), name, fields,
+                               digest, digest_len,
+                               (flags & ACC_REC_DIGEST_TEXT) != 0, delta)) {
+         Jmsg(jcr, M_FATAL, 0, _("Cannot add %s%s to the accurate file list\n"),
+              path, name);
+         return false;
+      }
+      Dmsg3(dbglvl, "add fname=<%s%s> delta_seq=%i\n", path, name, delta);
+   }
+   return true;
+}
 
-   item->delta_seq = delta;
+/*
+ * Add the files of a block of the binary list (accurate format=1),
+ *  see baconfig.h.  buf is used to uncompress the block.
+ */
+static bool accurate_add_block(JCR *jcr, BSOCK *dir, POOLMEM *&buf)
+{
+   uint8_t *ptr;
+   int len;
+#ifdef HAVE_LIBZ
+   uint32_t raw_len;
+   ser_declare;
+#endif
 
-   jcr->file_list->insert(item->fname, item);
+   if (dir->msglen < 1) {
+      goto bail_out;
+   }
+   switch (dir->msg[0]) {
+   case ACC_BLOCK_RAW:
+      /* Keep the records in the message, the pad stops a bad varint */
+      len = dir->msglen - 1;
+      dir->msg = check_pool_memory_size(dir->msg, dir->msglen + ACC_MAX_RECORD_PAD);
+      ptr = (uint8_t *)dir->msg + 1;
+      break;
+#ifdef HAVE_LIBZ
+   case ACC_BLOCK_ZLIB:
+      if (dir->msglen <= 5) {
+         goto bail_out;
+      }
+      unser_begin(dir->msg + 1, dir->msglen - 1);
+      unser_uint32(raw_len);
+      if (raw_len > ACC_BLOCK_MAX_SIZE) {
+         goto bail_out;
+      }
+      buf = check_pool_memory_size(buf, raw_len + ACC_MAX_RECORD_PAD);
+      len = raw_len;
+      if (Zinflate((char *)ser_ptr, dir->msglen - 5, buf, len) != Z_STREAM_END ||
+          len != (int)raw_len) {
+         goto bail_out;
+      }
+      ptr = (uint8_t *)buf;
+      break;
+#endif
+   default:
+      goto bail_out;
+   }
+   memset(ptr + len, 0, ACC_MAX_RECORD_PAD);
+   if (accurate_add_records(jcr, ptr, ptr + len)) {
+      return true;
+   }
+   if (job_canceled(jcr)) {
+      return false;
+   }
 
-   Dmsg4(dbglvl, "add fname=<%s> lstat=%s  delta_seq=%i chksum=%s\n",
-         fname, lstat, delta, chksum);
-   return ret;
+bail_out:
+   Jmsg(jcr, M_FATAL, 0, _("Malformed accurate file list block received from Director.\n"));
+   return false;
 }
 
 /*
@@ -244,7 +343,7 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
    bool stat = false;
    char *opts;
    char *fname;
-   CurFile elt;
+   ACC_ENTRY *elt;
 
    ff_pkt->delta_seq = 0;
    ff_pkt->accurate_found = false;
@@ -265,16 +364,18 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
       fname = ff_pkt->fname;
    }
 
-   if (!accurate_lookup(jcr, fname, &elt)) {
+   elt = acc_table_lookup(jcr->file_list, fname);
+   if (!elt) {
       Dmsg1(dbglvl, "accurate %s (not found)\n", fname);
       stat = true;
       goto bail_out;
    }
+   Dmsg1(dbglvl, "lookup <%s> ok\n", fname);
 
    ff_pkt->accurate_found = true;
-   ff_pkt->delta_seq = elt.delta_seq;
+   ff_pkt->delta_seq = elt->delta_seq;
 
-   decode_stat(elt.lstat, &statc, sizeof(statc), &LinkFIc); /* decode catalog stat */
+   acc_entry_stat(elt, &statc, &LinkFIc); /* catalog stat */
 
    if (!jcr->rerunning && (jcr->getJobLevel() == L_FULL)) {
       opts = ff_pkt->BaseJobOpts;
@@ -381,10 +482,10 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
           */
          if (!stat && ff_pkt->type != FT_LNKSAVED &&
              (S_ISREG(ff_pkt->statp.st_mode) &&
-              ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512)))
+              ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512|FO_XXH64)))
          {
 
-            if (!*elt.chksum && !jcr->rerunning) {
+            if (!acc_entry_has_digest(elt) && !jcr->rerunning) {
                Jmsg(jcr, M_WARNING, 0, _("Cannot verify checksum for %s\n"),
                     ff_pkt->fname);
                stat = true;
@@ -410,6 +511,10 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
             } else if (ff_pkt->flags & FO_SHA512) {
                digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
                digest_stream = STREAM_SHA512_DIGEST;
+
+            } else if (ff_pkt->flags & FO_XXH64) {
+               digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+               digest_stream = STREAM_XXH64_DIGEST;
             }
 
             /* Did digest initialization fail? */
@@ -429,24 +534,19 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
                   jcr->JobErrors++;
 
                } else if (crypto_digest_finalize(digest, (uint8_t *)md, &size)) {
-                  char *digest_buf;
-                  const char *digest_name;
-
-                  digest_buf = (char *)malloc(BASE64_SIZE(size));
-                  digest_name = crypto_digest_name(digest);
-
-                  bin_to_base64(digest_buf, BASE64_SIZE(size), md, size, true);
-
-                  if (strcmp(digest_buf, elt.chksum)) {
-                     Dmsg4(dbglvl,"%s      %s chksum  diff. Cat: %s File: %s\n",
-                           fname,
-                           digest_name,
-                           elt.chksum,
-                           digest_buf);
+                  if (!acc_entry_digest_equal(elt, md, size)) {
+                     if (debug_level >= dbglvl) {
+                        char ed1[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
+                        char ed2[BASE64_SIZE(CRYPTO_DIGEST_MAX_SIZE)];
+                        bin_to_base64(ed2, sizeof(ed2), md, size, true);
+                        Dmsg4(dbglvl,"%s      %s chksum  diff. Cat: %s File: %s\n",
+                              fname,
+                              crypto_digest_name(digest),
+                              acc_entry_digest_edit(elt, ed1, sizeof(ed1)),
+                              ed2);
+                     }
                      stat = true;
                   }
-
-                  free(digest_buf);
                }
                crypto_digest_free(digest);
             }
@@ -468,10 +568,10 @@ bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt)
       if (!stat) {
          /* compute space saved with basefile */
          jcr->base_size += ff_pkt->statp.st_size;
-         accurate_mark_file_as_seen(jcr, &elt);
+         acc_table_set_seen(jcr->file_list, elt);
       }
    } else {
-      accurate_mark_file_as_seen(jcr, &elt);
+      acc_table_set_seen(jcr->file_list, elt);
    }
 
 bail_out:
@@ -479,20 +579,19 @@ bail_out:
    return stat;
 }
 
-/*
- * TODO: use big buffer from htable
- */
 int accurate_cmd(JCR *jcr)
 {
    BSOCK *dir = jcr->dir_bsock;
    int lstat_pos, chksum_pos;
    int32_t nb;
+   int format = 0;
    uint16_t delta_seq;
+   bool ok = true;
 
    if (job_canceled(jcr)) {
       return true;
    }
-   if (sscanf(dir->msg, "accurate files=%ld", &nb) != 1) {
+   if (sscanf(dir->msg, "accurate files=%ld format=%d", &nb, &format) < 1) {
       dir->fsend(_("2991 Bad accurate command\n"));
       return false;
    }
@@ -502,11 +601,33 @@ int accurate_cmd(JCR *jcr)
    accurate_init(jcr, nb);
 
    /*
-    * buffer = sizeof(CurFile) + dirmsg
+    * A Director that asks for a format waits for our answer, then
+    *  sends the list in blocks of binary records, compressed if
+    *  we can inflate them.
+    */
+   if (format > 0) {
+      POOLMEM *buf;
+#ifdef HAVE_LIBZ
+      int compress = 1;
+#else
+      int compress = 0;
+#endif
+      format = MIN(format, 1);
+      dir->fsend("2000 OK accurate format=%d compress=%d\n", format, compress);
+      buf = get_pool_memory(PM_MESSAGE);
+      while (dir->recv() >= 0) {
+         if (ok && format == 1) {
+            ok = accurate_add_block(jcr, dir, buf);
+         }
+      }
+      free_pool_memory(buf);
+   }
+
+   /*
     * dirmsg = fname + \0 + lstat + \0 + checksum + \0 + delta_seq + \0
     */
    /* get current files */
-   while (dir->recv() >= 0) {
+   while (format == 0 && dir->recv() >= 0) {
       lstat_pos = strlen(dir->msg) + 1;
       if (lstat_pos < dir->msglen) {
          chksum_pos = lstat_pos + strlen(dir->msg + lstat_pos) + 1;
@@ -520,14 +641,18 @@ int accurate_cmd(JCR *jcr)
                                      strlen(dir->msg + chksum_pos) + 1);
          }
 
-         accurate_add_file(jcr, dir->msglen,
-                           dir->msg,               /* Path */
+         accurate_add_file(jcr, dir->msg,               /* Path */
                            dir->msg + lstat_pos,   /* LStat */
                            dir->msg + chksum_pos,  /* CheckSum */
                            delta_seq);             /* Delta Sequence */
       }
    }
 
+   Dmsg4(dbglvl, "accurate files=%u bytes=%lld bytes/file=%lld spilled=%d\n",
+         acc_table_size(jcr->file_list), acc_table_bytes(jcr->file_list),
+         acc_table_bytes(jcr->file_list) / MAX(acc_table_size(jcr->file_list), 1),
+         acc_table_spilled(jcr->file_list));
+
 #ifdef DEBUG
    extern void *start_heap;
 
@@ -540,5 +665,5 @@ int accurate_cmd(JCR *jcr)
          edit_uint64_with_commas(sm_max_buffers, b5));
 #endif
 
-   return true;
+   return ok;
 }
@@ -34,8 +34,10 @@ const int dbglvl = 50;
  *   3 03Sep10 - added the restore object command for vss plugin 4.0
  *   4 25Nov10 - added bandwidth command 5.1
  *   5 01Jan14 - added SD Calls Client and api version to status command
+ *   6 18Oct26 - added binary accurate file list (accurate format=1)
+ *   7 18Oct26 - added accuratecache command
  */
-#define FD_VERSION 5
+#define FD_VERSION 7
 
 static char hello_sd[]  = "Hello Bacula SD: Start Job %s %d\n";
 
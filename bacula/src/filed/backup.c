@@ -43,9 +43,19 @@ const bool have_xattr = true;
 const bool have_xattr = false;
 #endif
 
+#ifdef HAVE_LZ4
+static const bool have_lz4 = true;
+#else
+static const bool have_lz4 = false;
+#endif
+
 /* Forward referenced functions */
 int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level);
 static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest, DIGEST *signature_digest);
+static int send_data_record(JCR *jcr, FF_PKT *ff_pkt, CIPHER_CONTEXT *cipher_ctx,
+                            char *wbuf, const uint8_t *cipher_input, uint32_t cipher_input_len);
+static bool send_data_pipelined(JCR *jcr, FF_PKT *ff_pkt, int32_t rsize, DIGEST *digest,
+                                DIGEST *signing_digest, CIPHER_CONTEXT *cipher_ctx);
 bool encode_and_send_attributes(JCR *jcr, FF_PKT *ff_pkt, int &data_stream);
 static bool crypto_session_start(JCR *jcr);
 static void crypto_session_end(JCR *jcr);
@@ -101,14 +111,15 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
     *
     *  For LZO1X compression the recommended value is :
     *                  output_block_size = input_block_size + (input_block_size / 16) + 64 + 3 + sizeof(comp_stream_header)
+    *  It also covers the worst case of zstd and LZ4.
     *
     * The zlib compression workset is initialized here to minimize
     *  the "per file" load. The jcr member is only set, if the init
     *  was successful.
     *
-    *  For the same reason, lzo compression is initialized here.
+    *  For the same reason, lzo and zstd compression are initialized here.
     */
-#ifdef HAVE_LZO
+#if defined(HAVE_LZO) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
    jcr->compress_buf_size = MAX(jcr->buf_size + (jcr->buf_size / 16) + 67 + (int)sizeof(comp_stream_header), jcr->buf_size + ((jcr->buf_size+999) / 1000) + 30);
    jcr->compress_buf = get_memory(jcr->compress_buf_size);
 #else
@@ -143,11 +154,29 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
    }
 #endif
 
+#ifdef HAVE_ZSTD
+   jcr->ZSTD_compress_workset = ZSTD_createCCtx();
+#endif
+
+   /**
+    * Start the compression workers if the blocks of a file may be
+    *  compressed in parallel.
+    */
+   if (client && client->MaxCompressThreads > 0 &&
+       (jcr->pZLIB_compress_workset || jcr->LZO_compress_workset ||
+        jcr->ZSTD_compress_workset || have_lz4)) {
+      jcr->compress_pipe = new_compress_pipe(jcr, client->MaxCompressThreads,
+                              jcr->buf_size, jcr->compress_buf_size);
+   }
+
    if (!crypto_session_start(jcr)) {
       return false;
    }
 
    set_find_options((FF_PKT *)jcr->ff, jcr->incremental, jcr->mtime);
+   if (client) {
+      set_find_scan_threads((FF_PKT *)jcr->ff, client->MaxDirScanThreads);
+   }
 
    /** in accurate mode, we overload the find_one check function */
    if (jcr->accurate) {
@@ -172,6 +201,9 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
       jcr->xattr_data->u.build->content = get_pool_memory(PM_MESSAGE);
    }
 
+   /** Queue the small records, send them with the data blocks */
+   sd->begin_batch();
+
    /** Subroutine save_file() is called for each file */
    if (!find_files(jcr, (FF_PKT *)jcr->ff, save_file, plugin_save)) {
       ok = false;                     /* error */
@@ -194,6 +226,7 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
    stop_heartbeat_monitor(jcr);
 
    sd->signal(BNET_EOD);            /* end of sending data */
+   sd->end_batch();
 
    if (have_acl && jcr->acl_data) {
       free_pool_memory(jcr->acl_data->u.build->content);
@@ -211,6 +244,10 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
       free(jcr->big_buf);
       jcr->big_buf = NULL;
    }
+   if (jcr->compress_pipe) {
+      free_compress_pipe(jcr->compress_pipe);
+      jcr->compress_pipe = NULL;
+   }
    if (jcr->compress_buf) {
       free_pool_memory(jcr->compress_buf);
       jcr->compress_buf = NULL;
@@ -227,6 +264,12 @@ bool blast_data_to_storage_daemon(JCR *jcr, char *addr)
       free (jcr->LZO_compress_workset);
       jcr->LZO_compress_workset = NULL;
    }
+#ifdef HAVE_ZSTD
+   if (jcr->ZSTD_compress_workset) {
+      ZSTD_freeCCtx((ZSTD_CCtx *)jcr->ZSTD_compress_workset);
+      jcr->ZSTD_compress_workset = NULL;
+   }
+#endif
 
    crypto_session_end(jcr);
 
@@ -334,6 +377,8 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
    DIGEST *digest = NULL;
    DIGEST *signing_digest = NULL;
    int digest_stream = STREAM_NONE;
+   char md[CRYPTO_DIGEST_MAX_SIZE];   /* digest sent to the catalog */
+   int md_len = 0;
    SIGNATURE *sig = NULL;
    bool has_file_data = false;
    struct save_pkt sp;          /* use by option plugin */
@@ -474,7 +519,7 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
    if (has_file_data) {
       /**
        * Setup for digest handling. If this fails, the digest will be set to NULL
-       * and not used. Note, the digest (file hash) can be any one of the four
+       * and not used. Note, the digest (file hash) can be any one of the five
        * algorithms below.
        *
        * The signing digest is a single algorithm depending on
@@ -498,6 +543,10 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
       } else if (ff_pkt->flags & FO_SHA512) {
          digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
          digest_stream = STREAM_SHA512_DIGEST;
+
+      } else if (ff_pkt->flags & FO_XXH64) {
+         digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+         digest_stream = STREAM_XXH64_DIGEST;
       }
 
       /** Did digest initialization fail? */
@@ -820,6 +869,10 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
 
       sd->msglen = size;
       sd->send();
+      if (jcr->acc_cache && size <= sizeof(md)) {
+         memcpy(md, sd->msg, size);
+         md_len = size;
+      }
       sd->signal(BNET_EOD);              /* end of checksum */
    }
 
@@ -836,6 +889,16 @@ int save_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
       sd->signal(BNET_EOD);              /* end of hardlink record */
    }
 
+   /* Keep the file for the next accurate job */
+   if (jcr->acc_cache) {
+      if (ff_pkt->type == FT_LNKSAVED && ff_pkt->digest) {
+         accurate_cache_add_file(jcr, ff_pkt, data_stream, ff_pkt->digest,
+                                 ff_pkt->digest_len);
+      } else {
+         accurate_cache_add_file(jcr, ff_pkt, data_stream, md, md_len);
+      }
+   }
+
 good_rtn:
    rtnstat = 1;
 
@@ -865,6 +928,103 @@ bail_out:
    return rtnstat;
 }
 
+/**
+ * Check if the data of ff_pkt is compressed with zstd or LZ4,
+ *  i.e. the algorithm was selected and is built in.
+ */
+static bool use_zstd_lz4(FF_PKT *ff_pkt)
+{
+   if (!(ff_pkt->flags & FO_COMPRESS)) {
+      return false;
+   }
+#ifdef HAVE_ZSTD
+   if (ff_pkt->Compress_algo == COMPRESS_ZSTD) {
+      return true;
+   }
+#endif
+#ifdef HAVE_LZ4
+   if (ff_pkt->Compress_algo == COMPRESS_LZ4) {
+      return true;
+   }
+#endif
+   return false;
+}
+
+/**
+ * Check if a block read from a sparse file is all zeros and can
+ *  be skipped. Only full blocks that are not at the end of the
+ *  file are checked.
+ */
+static bool is_sparse_block_zero(FF_PKT *ff_pkt, char *rbuf, int32_t len,
+                                 int32_t rsize, uint64_t fileAddr)
+{
+   if ((len == rsize &&
+        fileAddr+len < (uint64_t)ff_pkt->statp.st_size) ||
+       ((ff_pkt->type == FT_RAW || ff_pkt->type == FT_FIFO) &&
+         (uint64_t)ff_pkt->statp.st_size == 0)) {
+      return is_buf_zero(rbuf, rsize);
+   }
+   return false;
+}
+
+/**
+ * Skip the blocks of a sparse file that are entirely in a hole.
+ *  Called before each read of rsize bytes at fileAddr. When the file
+ *  system can tell where the data of a regular file is (SEEK_DATA
+ *  and SEEK_HOLE), the file and fileAddr are moved to the block of
+ *  the next data extent, so that the holes are never read. Blocks
+ *  stay aligned on rsize, the blocks read are the ones a full read
+ *  would not drop with is_sparse_block_zero(), and the records and
+ *  digests do not change. Otherwise the whole file is read.
+ *
+ *  holeAddr is the end of the current data extent, 0 to start.
+ *
+ * Returns: false on seek error
+ */
+bool sparse_skip_holes(FF_PKT *ff_pkt, BFILE *bfd, int32_t rsize,
+                       uint64_t *fileAddr, uint64_t *holeAddr)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+   uint64_t size = (uint64_t)ff_pkt->statp.st_size;
+   boffset_t data, hole;
+
+   if (!(ff_pkt->flags & FO_SPARSE) || *fileAddr < *holeAddr) {
+      return true;
+   }
+   if (ff_pkt->type != FT_REG || bfd->cmd_plugin || *fileAddr >= size) {
+      goto read_all;
+   }
+   if ((data = blseek(bfd, (boffset_t)*fileAddr, SEEK_DATA)) < 0) {
+      if (bfd->berrno != ENXIO) {
+         goto read_all;               /* not supported here */
+      }
+      data = size;                    /* hole up to the end of file */
+   }
+   if ((uint64_t)data >= size) {
+      /* The last block is always sent, it gives the size of the file */
+      data = size - 1;
+      hole = size;
+   } else if ((hole = blseek(bfd, data, SEEK_HOLE)) < 0) {
+      hole = size;
+   }
+   data -= data % rsize;
+   if (blseek(bfd, data, SEEK_SET) < 0) {
+      return false;
+   }
+   if ((uint64_t)data > *fileAddr) {
+      Dmsg2(400, "Skip hole of %lld bytes at %lld\n", (int64_t)data - *fileAddr,
+            (int64_t)*fileAddr);
+      *fileAddr = data;
+   }
+   *holeAddr = hole;
+   return true;
+
+read_all:
+   *holeAddr = UINT64_MAX;
+#endif
+   return true;
+}
+
 /**
  * Send data read from an already open file descriptor.
  *
@@ -881,6 +1041,7 @@ static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest,
 {
    BSOCK *sd = jcr->store_bsock;
    uint64_t fileAddr = 0;             /* file address */
+   uint64_t holeAddr = 0;             /* end of the data extent */
    char *rbuf, *wbuf;
    int32_t rsize = jcr->buf_size;      /* read buffer size */
    POOLMEM *msgsave;
@@ -889,6 +1050,7 @@ static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest,
    uint32_t cipher_input_len;
    uint32_t cipher_block_size;
    uint32_t encrypted_len;
+   bool use_pipe;
 #ifdef FD_NO_SEND_TEST
    return 1;
 #endif
@@ -959,8 +1121,25 @@ static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest,
       cipher_input = (uint8_t *)jcr->compress_buf; /* encrypt compressed data */
    }
  #endif
-#else
-   const uint32_t max_compress_len = 0;
+#endif
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+   char *zcbuf;
+   uint32_t zmax;
+
+   if (use_zstd_lz4(ff_pkt)) {
+      if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
+         zcbuf = jcr->compress_buf + OFFSET_FADDR_SIZE;
+         zmax = jcr->compress_buf_size - OFFSET_FADDR_SIZE;
+      } else {
+         zcbuf = jcr->compress_buf;
+         zmax = jcr->compress_buf_size;
+      }
+      wbuf = jcr->compress_buf;    /* compressed output here */
+      cipher_input = (uint8_t *)jcr->compress_buf; /* encrypt compressed data */
+   } else {
+      zcbuf = NULL;
+      zmax = 0;
+   }
 #endif
 
    if (ff_pkt->flags & FO_ENCRYPT) {
@@ -981,10 +1160,10 @@ static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest,
        * crypto_cipher_update() will buffer up to (cipher_block_size - 1).
        * We grow crypto_buf to the maximum number of blocks that
        * could be returned for the given read buffer size.
-       * (Using the larger of either rsize or max_compress_len)
+       * (Using the larger of either rsize or the compression buffer size)
        */
       jcr->crypto.crypto_buf = check_pool_memory_size(jcr->crypto.crypto_buf,
-           (MAX(rsize + (int)sizeof(uint32_t), (int32_t)max_compress_len) +
+           (MAX(rsize + (int)sizeof(uint32_t), jcr->compress_buf_size) +
             cipher_block_size - 1) / cipher_block_size * cipher_block_size);
 
       wbuf = jcr->crypto.crypto_buf; /* Encrypted, possibly compressed output here. */
@@ -1027,186 +1206,158 @@ static int send_data(JCR *jcr, int stream, FF_PKT *ff_pkt, DIGEST *digest,
 #endif
 
    /**
-    * Read the file data
+    * Files of more than one block are compressed by the pipeline
+    *  workers when they are available.
     */
-   while ((sd->msglen=(uint32_t)bread(&ff_pkt->bfd, rbuf, rsize)) > 0) {
+   use_pipe = jcr->compress_pipe && (ff_pkt->flags & FO_COMPRESS) &&
+      ((ff_pkt->Compress_algo == COMPRESS_GZIP && jcr->pZLIB_compress_workset) ||
+       (ff_pkt->Compress_algo == COMPRESS_LZO1X && jcr->LZO_compress_workset) ||
+       use_zstd_lz4(ff_pkt)) &&
+      (uint64_t)ff_pkt->statp.st_size > (uint64_t)rsize;
 
-      /** Check for sparse blocks */
-      if (ff_pkt->flags & FO_SPARSE) {
-         ser_declare;
-         bool allZeros = false;
-         if ((sd->msglen == rsize &&
-              fileAddr+sd->msglen < (uint64_t)ff_pkt->statp.st_size) ||
-             ((ff_pkt->type == FT_RAW || ff_pkt->type == FT_FIFO) &&
-               (uint64_t)ff_pkt->statp.st_size == 0)) {
-            allZeros = is_buf_zero(rbuf, rsize);
+   /**
+    * Read the file data
+    */
+   if (use_pipe) {
+      if (!send_data_pipelined(jcr, ff_pkt, rsize, digest, signing_digest, cipher_ctx)) {
+         goto err;
+      }
+   } else {
+      for ( ;; ) {
+         if (!sparse_skip_holes(ff_pkt, &ff_pkt->bfd, rsize, &fileAddr, &holeAddr)) {
+            sd->msglen = -1;
+            break;
          }
-         if (!allZeros) {
-            /** Put file address as first data in buffer */
-            ser_begin(wbuf, OFFSET_FADDR_SIZE);
-            ser_uint64(fileAddr);     /* store fileAddr in begin of buffer */
+         if ((sd->msglen=(uint32_t)bread(&ff_pkt->bfd, rbuf, rsize)) <= 0) {
+            break;
          }
-         fileAddr += sd->msglen;      /* update file address */
-         /** Skip block of all zeros */
-         if (allZeros) {
-            continue;                 /* skip block of zeros */
+
+         /** Check for sparse blocks */
+         if (ff_pkt->flags & FO_SPARSE) {
+            ser_declare;
+            bool allZeros = is_sparse_block_zero(ff_pkt, rbuf, sd->msglen, rsize, fileAddr);
+            if (!allZeros) {
+               /** Put file address as first data in buffer */
+               ser_begin(wbuf, OFFSET_FADDR_SIZE);
+               ser_uint64(fileAddr);     /* store fileAddr in begin of buffer */
+            }
+            fileAddr += sd->msglen;      /* update file address */
+            /** Skip block of all zeros */
+            if (allZeros) {
+               continue;                 /* skip block of zeros */
+            }
+         } else if (ff_pkt->flags & FO_OFFSETS) {
+            ser_declare;
+            ser_begin(wbuf, OFFSET_FADDR_SIZE);
+            ser_uint64(ff_pkt->bfd.offset);     /* store offset in begin of buffer */
          }
-      } else if (ff_pkt->flags & FO_OFFSETS) {
-         ser_declare;
-         ser_begin(wbuf, OFFSET_FADDR_SIZE);
-         ser_uint64(ff_pkt->bfd.offset);     /* store offset in begin of buffer */
-      }
 
-      jcr->ReadBytes += sd->msglen;         /* count bytes read */
+         jcr->ReadBytes += sd->msglen;         /* count bytes read */
 
-      /** Uncompressed cipher input length */
-      cipher_input_len = sd->msglen;
+         /** Uncompressed cipher input length */
+         cipher_input_len = sd->msglen;
 
-      /** Update checksum if requested */
-      if (digest) {
-         crypto_digest_update(digest, (uint8_t *)rbuf, sd->msglen);
-      }
+         /** Update checksum if requested */
+         if (digest) {
+            crypto_digest_update(digest, (uint8_t *)rbuf, sd->msglen);
+         }
 
-      /** Update signing digest if requested */
-      if (signing_digest) {
-         crypto_digest_update(signing_digest, (uint8_t *)rbuf, sd->msglen);
-      }
+         /** Update signing digest if requested */
+         if (signing_digest) {
+            crypto_digest_update(signing_digest, (uint8_t *)rbuf, sd->msglen);
+         }
 
 #ifdef HAVE_LIBZ
-      /** Do compression if turned on */
-      if (ff_pkt->flags & FO_COMPRESS && ff_pkt->Compress_algo == COMPRESS_GZIP && jcr->pZLIB_compress_workset) {
-         Dmsg3(400, "cbuf=0x%x rbuf=0x%x len=%u\n", cbuf, rbuf, sd->msglen);
+         /** Do compression if turned on */
+         if (ff_pkt->flags & FO_COMPRESS && ff_pkt->Compress_algo == COMPRESS_GZIP && jcr->pZLIB_compress_workset) {
+            Dmsg3(400, "cbuf=0x%x rbuf=0x%x len=%u\n", cbuf, rbuf, sd->msglen);
+
+            ((z_stream*)jcr->pZLIB_compress_workset)->next_in   = (Bytef *)rbuf;
+                   ((z_stream*)jcr->pZLIB_compress_workset)->avail_in  = sd->msglen;
+            ((z_stream*)jcr->pZLIB_compress_workset)->next_out  = (Bytef *)cbuf;
+                   ((z_stream*)jcr->pZLIB_compress_workset)->avail_out = max_compress_len;
+
+            if ((zstat=deflate((z_stream*)jcr->pZLIB_compress_workset, Z_FINISH)) != Z_STREAM_END) {
+               Jmsg(jcr, M_FATAL, 0, _("Compression deflate error: %d\n"), zstat);
+               jcr->setJobStatus(JS_ErrorTerminated);
+               goto err;
+            }
+            compress_len = ((z_stream*)jcr->pZLIB_compress_workset)->total_out;
+            /** reset zlib stream to be able to begin from scratch again */
+            if ((zstat=deflateReset((z_stream*)jcr->pZLIB_compress_workset)) != Z_OK) {
+               Jmsg(jcr, M_FATAL, 0, _("Compression deflateReset error: %d\n"), zstat);
+               jcr->setJobStatus(JS_ErrorTerminated);
+               goto err;
+            }
 
-         ((z_stream*)jcr->pZLIB_compress_workset)->next_in   = (Bytef *)rbuf;
-                ((z_stream*)jcr->pZLIB_compress_workset)->avail_in  = sd->msglen;
-         ((z_stream*)jcr->pZLIB_compress_workset)->next_out  = (Bytef *)cbuf;
-                ((z_stream*)jcr->pZLIB_compress_workset)->avail_out = max_compress_len;
+            Dmsg2(400, "GZIP compressed len=%d uncompressed len=%d\n", compress_len,
+                  sd->msglen);
 
-         if ((zstat=deflate((z_stream*)jcr->pZLIB_compress_workset, Z_FINISH)) != Z_STREAM_END) {
-            Jmsg(jcr, M_FATAL, 0, _("Compression deflate error: %d\n"), zstat);
-            jcr->setJobStatus(JS_ErrorTerminated);
-            goto err;
+            sd->msglen = compress_len;      /* set compressed length */
+            cipher_input_len = compress_len;
          }
-         compress_len = ((z_stream*)jcr->pZLIB_compress_workset)->total_out;
-         /** reset zlib stream to be able to begin from scratch again */
-         if ((zstat=deflateReset((z_stream*)jcr->pZLIB_compress_workset)) != Z_OK) {
-            Jmsg(jcr, M_FATAL, 0, _("Compression deflateReset error: %d\n"), zstat);
-            jcr->setJobStatus(JS_ErrorTerminated);
-            goto err;
-         }
-
-         Dmsg2(400, "GZIP compressed len=%d uncompressed len=%d\n", compress_len,
-               sd->msglen);
-
-         sd->msglen = compress_len;      /* set compressed length */
-         cipher_input_len = compress_len;
-      }
 #endif
 #ifdef HAVE_LZO
-      /** Do compression if turned on */
-      if (ff_pkt->flags & FO_COMPRESS && ff_pkt->Compress_algo == COMPRESS_LZO1X && jcr->LZO_compress_workset) {
-         lzo_uint len;          /* TODO: See with the latest patch how to handle lzo_uint with 64bit */
-
-         ser_declare;
-         ser_begin(cbuf, sizeof(comp_stream_header));
-
-         Dmsg3(400, "cbuf=0x%x rbuf=0x%x len=%u\n", cbuf, rbuf, sd->msglen);
-
-         lzores = lzo1x_1_compress((const unsigned char*)rbuf, sd->msglen, cbuf2,
-                                   &len, jcr->LZO_compress_workset);
-         compress_len = len;
-         if (lzores == LZO_E_OK && compress_len <= max_compress_len) {
-            /* complete header */
-            ser_uint32(COMPRESS_LZO1X);
-            ser_uint32(compress_len);
-            ser_uint16(ch.level);
-            ser_uint16(ch.version);
-         } else {
-            /** this should NEVER happen */
-            Jmsg(jcr, M_FATAL, 0, _("Compression LZO error: %d\n"), lzores);
-            jcr->setJobStatus(JS_ErrorTerminated);
-            goto err;
-         }
-
-         Dmsg2(400, "LZO compressed len=%d uncompressed len=%d\n", compress_len,
-               sd->msglen);
-
-         compress_len += sizeof(comp_stream_header); /* add size of header */
-         sd->msglen = compress_len;      /* set compressed length */
-         cipher_input_len = compress_len;
-      }
-#endif
-
-      /**
-       * Note, here we prepend the current record length to the beginning
-       *  of the encrypted data. This is because both sparse and compression
-       *  restore handling want records returned to them with exactly the
-       *  same number of bytes that were processed in the backup handling.
-       *  That is, both are block filters rather than a stream.  When doing
-       *  compression, the compression routines may buffer data, so that for
-       *  any one record compressed, when it is decompressed the same size
-       *  will not be obtained. Of course, the buffered data eventually comes
-       *  out in subsequent crypto_cipher_update() calls or at least
-       *  when crypto_cipher_finalize() is called.  Unfortunately, this
-       *  "feature" of encryption enormously complicates the restore code.
-       */
-      if (ff_pkt->flags & FO_ENCRYPT) {
-         uint32_t initial_len = 0;
-         ser_declare;
-
-         if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
-            cipher_input_len += OFFSET_FADDR_SIZE;
-         }
-
-         /** Encrypt the length of the input block */
-         uint8_t packet_len[sizeof(uint32_t)];
+         /** Do compression if turned on */
+         if (ff_pkt->flags & FO_COMPRESS && ff_pkt->Compress_algo == COMPRESS_LZO1X && jcr->LZO_compress_workset) {
+            lzo_uint len;          /* TODO: See with the latest patch how to handle lzo_uint with 64bit */
+
+            ser_declare;
+            ser_begin(cbuf, sizeof(comp_stream_header));
+
+            Dmsg3(400, "cbuf=0x%x rbuf=0x%x len=%u\n", cbuf, rbuf, sd->msglen);
+
+            lzores = lzo1x_1_compress((const unsigned char*)rbuf, sd->msglen, cbuf2,
+                                      &len, jcr->LZO_compress_workset);
+            compress_len = len;
+            if (lzores == LZO_E_OK && compress_len <= max_compress_len) {
+               /* complete header */
+               ser_uint32(COMPRESS_LZO1X);
+               ser_uint32(compress_len);
+               ser_uint16(ch.level);
+               ser_uint16(ch.version);
+            } else {
+               /** this should NEVER happen */
+               Jmsg(jcr, M_FATAL, 0, _("Compression LZO error: %d\n"), lzores);
+               jcr->setJobStatus(JS_ErrorTerminated);
+               goto err;
+            }
 
-         ser_begin(packet_len, sizeof(uint32_t));
-         ser_uint32(cipher_input_len);    /* store data len in begin of buffer */
-         Dmsg1(20, "Encrypt len=%d\n", cipher_input_len);
+            Dmsg2(400, "LZO compressed len=%d uncompressed len=%d\n", compress_len,
+                  sd->msglen);
 
-         if (!crypto_cipher_update(cipher_ctx, packet_len, sizeof(packet_len),
-             (uint8_t *)jcr->crypto.crypto_buf, &initial_len)) {
-            /** Encryption failed. Shouldn't happen. */
-            Jmsg(jcr, M_FATAL, 0, _("Encryption error\n"));
-            goto err;
+            compress_len += sizeof(comp_stream_header); /* add size of header */
+            sd->msglen = compress_len;      /* set compressed length */
+            cipher_input_len = compress_len;
          }
-
-         /** Encrypt the input block */
-         if (crypto_cipher_update(cipher_ctx, cipher_input, cipher_input_len,
-             (uint8_t *)&jcr->crypto.crypto_buf[initial_len], &encrypted_len)) {
-            if ((initial_len + encrypted_len) == 0) {
-               /** No full block of data available, read more data */
-               continue;
+#endif
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+         /** Do compression if turned on */
+         if (zcbuf) {
+            const char *errmsg;
+            int32_t zlen = compress_zstd_lz4(ff_pkt->Compress_algo,
+                              ff_pkt->Compress_level, jcr->ZSTD_compress_workset,
+                              rbuf, sd->msglen, zcbuf, zmax, &errmsg);
+            if (zlen < 0) {
+               Jmsg(jcr, M_FATAL, 0, _("Compression %s error: %s\n"),
+                    ff_pkt->Compress_algo == COMPRESS_ZSTD ? "zstd" : "LZ4", errmsg);
+               jcr->setJobStatus(JS_ErrorTerminated);
+               goto err;
             }
-            Dmsg2(400, "encrypted len=%d unencrypted len=%d\n", encrypted_len,
+            Dmsg2(400, "zstd/LZ4 compressed len=%d uncompressed len=%d\n", zlen,
                   sd->msglen);
-            sd->msglen = initial_len + encrypted_len; /* set encrypted length */
-         } else {
-            /** Encryption failed. Shouldn't happen. */
-            Jmsg(jcr, M_FATAL, 0, _("Encryption error\n"));
-            goto err;
+            sd->msglen = zlen;              /* set compressed length */
+            cipher_input_len = zlen;
          }
-      }
+#endif
 
-      /* Send the buffer to the Storage daemon */
-      if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
-         sd->msglen += OFFSET_FADDR_SIZE; /* include fileAddr in size */
-      }
-      sd->msg = wbuf;              /* set correct write buffer */
-      if (!sd->send()) {
-         if (!jcr->is_job_canceled()) {
-            Jmsg1(jcr, M_FATAL, 0, _("Network send error to SD. ERR=%s\n"),
-                  sd->bstrerror());
+         /* Send the buffer to the Storage daemon */
+         if (send_data_record(jcr, ff_pkt, cipher_ctx, wbuf, cipher_input,
+                              cipher_input_len) == 0) {
+            goto err;
          }
-         goto err;
-      }
-      Dmsg1(130, "Send data to SD len=%d\n", sd->msglen);
-      /*          #endif */
-      jcr->JobBytes += sd->msglen;      /* count bytes saved possibly compressed/encrypted */
-      sd->msg = msgsave;                /* restore read buffer */
-
-   } /* end while read file data */
+      } /* end while read file data */
+   }
 
    if (sd->msglen < 0) {                 /* error */
       berrno be;
@@ -1269,6 +1420,207 @@ err:
    return 0;
 }
 
+/**
+ * Encrypt a data record if requested and send it to the SD.
+ *  wbuf is the record to send when there is no encryption, with
+ *  the file address in front when sparse or offsets are on, and
+ *  cipher_input/cipher_input_len is the data to encrypt.
+ *
+ * Returns 1 on success, 0 on error, and -1 when the cipher kept
+ *  all of the input and there is nothing to send yet.
+ */
+static int send_data_record(JCR *jcr, FF_PKT *ff_pkt, CIPHER_CONTEXT *cipher_ctx,
+                            char *wbuf, const uint8_t *cipher_input,
+                            uint32_t cipher_input_len)
+{
+   BSOCK *sd = jcr->store_bsock;
+   POOLMEM *msgsave = sd->msg;
+   uint32_t encrypted_len;
+
+   sd->msglen = cipher_input_len;
+
+   /**
+    * Note, here we prepend the current record length to the beginning
+    *  of the encrypted data. This is because both sparse and compression
+    *  restore handling want records returned to them with exactly the
+    *  same number of bytes that were processed in the backup handling.
+    *  That is, both are block filters rather than a stream.  When doing
+    *  compression, the compression routines may buffer data, so that for
+    *  any one record compressed, when it is decompressed the same size
+    *  will not be obtained. Of course, the buffered data eventually comes
+    *  out in subsequent crypto_cipher_update() calls or at least
+    *  when crypto_cipher_finalize() is called.  Unfortunately, this
+    *  "feature" of encryption enormously complicates the restore code.
+    */
+   if (ff_pkt->flags & FO_ENCRYPT) {
+      uint32_t initial_len = 0;
+      ser_declare;
+
+      if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
+         cipher_input_len += OFFSET_FADDR_SIZE;
+      }
+
+      /** Encrypt the length of the input block */
+      uint8_t packet_len[sizeof(uint32_t)];
+
+      ser_begin(packet_len, sizeof(uint32_t));
+      ser_uint32(cipher_input_len);    /* store data len in begin of buffer */
+      Dmsg1(20, "Encrypt len=%d\n", cipher_input_len);
+
+      if (!crypto_cipher_update(cipher_ctx, packet_len, sizeof(packet_len),
+          (uint8_t *)jcr->crypto.crypto_buf, &initial_len)) {
+         /** Encryption failed. Shouldn't happen. */
+         Jmsg(jcr, M_FATAL, 0, _("Encryption error\n"));
+         return 0;
+      }
+
+      /** Encrypt the input block */
+      if (crypto_cipher_update(cipher_ctx, cipher_input, cipher_input_len,
+          (uint8_t *)&jcr->crypto.crypto_buf[initial_len], &encrypted_len)) {
+         if ((initial_len + encrypted_len) == 0) {
+            /** No full block of data available, read more data */
+            return -1;
+         }
+         Dmsg2(400, "encrypted len=%d unencrypted len=%d\n", encrypted_len,
+               sd->msglen);
+         sd->msglen = initial_len + encrypted_len; /* set encrypted length */
+         wbuf = jcr->crypto.crypto_buf;
+      } else {
+         /** Encryption failed. Shouldn't happen. */
+         Jmsg(jcr, M_FATAL, 0, _("Encryption error\n"));
+         return 0;
+      }
+   }
+
+   /* Send the buffer to the Storage daemon */
+   if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
+      sd->msglen += OFFSET_FADDR_SIZE; /* include fileAddr in size */
+   }
+   sd->msg = wbuf;              /* set correct write buffer */
+   if (!sd->send()) {
+      if (!jcr->is_job_canceled()) {
+         Jmsg1(jcr, M_FATAL, 0, _("Network send error to SD. ERR=%s\n"),
+               sd->bstrerror());
+      }
+      sd->msg = msgsave;
+      return 0;
+   }
+   Dmsg1(130, "Send data to SD len=%d\n", sd->msglen);
+   jcr->JobBytes += sd->msglen;      /* count bytes saved possibly compressed/encrypted */
+   sd->msg = msgsave;                /* restore read buffer */
+   return 1;
+}
+
+/**
+ * Send the oldest block of the compression pipeline to the SD.
+ */
+static bool send_compressed_block(JCR *jcr, FF_PKT *ff_pkt, CIPHER_CONTEXT *cipher_ctx)
+{
+   COMPRESS_PIPE *pipe = jcr->compress_pipe;
+   CP_BLOCK *blk = compress_pipe_get_done(pipe);
+   char *cbuf = blk->cbuf + OFFSET_FADDR_SIZE;
+   char *wbuf = cbuf;
+   int stat;
+
+   if (blk->stat != 0) {
+      Jmsg(jcr, M_FATAL, 0, _("Compression error: %d\n"), blk->stat);
+      jcr->setJobStatus(JS_ErrorTerminated);
+      compress_pipe_release(pipe, blk);
+      return false;
+   }
+   Dmsg2(400, "Pipeline compressed len=%d uncompressed len=%d\n", blk->clen,
+         blk->rlen);
+   if ((ff_pkt->flags & FO_SPARSE) || (ff_pkt->flags & FO_OFFSETS)) {
+      wbuf = blk->cbuf;            /* file address is in front */
+   }
+   stat = send_data_record(jcr, ff_pkt, cipher_ctx, wbuf, (uint8_t *)cbuf,
+                           blk->clen);
+   compress_pipe_release(pipe, blk);
+   return stat != 0;
+}
+
+/**
+ * Read loop of send_data() when the compression pipeline is used.
+ *  The blocks are read, checked for holes and digested here in
+ *  file order, compressed by the pipeline workers, then sent to
+ *  the SD in the order they were read.
+ *
+ * Returns false on error. The status of the last bread() is
+ *  left in sd->msglen as in the serial loop.
+ */
+static bool send_data_pipelined(JCR *jcr, FF_PKT *ff_pkt, int32_t rsize,
+                                DIGEST *digest, DIGEST *signing_digest,
+                                CIPHER_CONTEXT *cipher_ctx)
+{
+   BSOCK *sd = jcr->store_bsock;
+   COMPRESS_PIPE *pipe = jcr->compress_pipe;
+   uint64_t fileAddr = 0;             /* file address */
+   uint64_t holeAddr = 0;             /* end of the data extent */
+   CP_BLOCK *blk;
+   int32_t nread = 0;
+   char *rbuf;
+
+   for ( ;; ) {
+      /** Make room in the ring by sending the oldest block */
+      while ((blk = compress_pipe_get_free(pipe)) == NULL) {
+         if (!send_compressed_block(jcr, ff_pkt, cipher_ctx)) {
+            goto bail_out;
+         }
+      }
+      rbuf = blk->rbuf + OFFSET_FADDR_SIZE;
+      if (!sparse_skip_holes(ff_pkt, &ff_pkt->bfd, rsize, &fileAddr, &holeAddr)) {
+         nread = -1;
+         break;
+      }
+      if ((nread = (int32_t)bread(&ff_pkt->bfd, rbuf, rsize)) <= 0) {
+         break;
+      }
+
+      /** Check for sparse blocks */
+      if (ff_pkt->flags & FO_SPARSE) {
+         ser_declare;
+         if (is_sparse_block_zero(ff_pkt, rbuf, nread, rsize, fileAddr)) {
+            fileAddr += nread;
+            continue;                 /* skip block of zeros */
+         }
+         ser_begin(blk->cbuf, OFFSET_FADDR_SIZE);
+         ser_uint64(fileAddr);        /* store fileAddr in begin of buffer */
+         fileAddr += nread;
+      } else if (ff_pkt->flags & FO_OFFSETS) {
+         ser_declare;
+         ser_begin(blk->cbuf, OFFSET_FADDR_SIZE);
+         ser_uint64(ff_pkt->bfd.offset);     /* store offset in begin of buffer */
+      }
+
+      jcr->ReadBytes += nread;         /* count bytes read */
+
+      if (digest) {
+         crypto_digest_update(digest, (uint8_t *)rbuf, nread);
+      }
+      if (signing_digest) {
+         crypto_digest_update(signing_digest, (uint8_t *)rbuf, nread);
+      }
+      compress_pipe_submit(pipe, blk, nread, ff_pkt->Compress_algo,
+                           ff_pkt->Compress_level);
+   }
+
+   /** Send what is left in the ring */
+   while (compress_pipe_get_done(pipe)) {
+      if (!send_compressed_block(jcr, ff_pkt, cipher_ctx)) {
+         goto bail_out;
+      }
+   }
+   sd->msglen = nread;
+   return true;
+
+bail_out:
+   /** Wait for the workers and drop the blocks not yet sent */
+   while ((blk = compress_pipe_get_done(pipe)) != NULL) {
+      compress_pipe_release(pipe, blk);
+   }
+   return false;
+}
+
 bool encode_and_send_attributes(JCR *jcr, FF_PKT *ff_pkt, int &data_stream)
 {
    BSOCK *sd = jcr->store_bsock;
@@ -0,0 +1,367 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  Bacula File Daemon  compress_pipe.c  compress the blocks of a
+ *   file on several threads while keeping the record order.
+ *
+ *  Each block is compressed independently (the GZIP stream is
+ *   reset after every block, the LZO, zstd and LZ4 blocks have
+ *   their own header),
+ *   so the blocks of one file can be handed to different workers.
+ *   The ring is filled by the job thread in read order, and
+ *   the job thread only ever sends the oldest block, so the
+ *   records reach the SD in exactly the same order as with the
+ *   serial code.
+ *
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#include "ch.h"
+
+extern "C" void *compress_pipe_worker(void *arg);
+
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+/*
+ * Compress len bytes of in with zstd or LZ4 into out, behind a
+ *  comp_stream_header. The LZ4 data is preceded by the uncompressed
+ *  length, the decompressor needs it to size its buffer, a zstd
+ *  frame already records it. Used by send_data() and the workers.
+ *
+ * Returns: the length written to out
+ *          -1 on error with *errmsg set
+ */
+int32_t compress_zstd_lz4(uint32_t algo, int32_t level, void *zstd_ctx,
+                          const char *in, uint32_t len, char *out,
+                          uint32_t out_size, const char **errmsg)
+{
+   const uint32_t hlen = sizeof(comp_stream_header);
+   uint32_t clen;
+   ser_declare;
+
+   switch (algo) {
+#ifdef HAVE_ZSTD
+   case COMPRESS_ZSTD: {
+      size_t zstat;
+      if (!zstd_ctx) {
+         *errmsg = _("no zstd context");
+         return -1;
+      }
+      zstat = ZSTD_compressCCtx((ZSTD_CCtx *)zstd_ctx, out + hlen, out_size - hlen,
+                                in, len, level);
+      if (ZSTD_isError(zstat)) {
+         *errmsg = ZSTD_getErrorName(zstat);
+         return -1;
+      }
+      clen = zstat;
+      break;
+   }
+#endif
+#ifdef HAVE_LZ4
+   case COMPRESS_LZ4: {
+      int lz4len;
+      ser_begin(out + hlen, sizeof(uint32_t));
+      ser_uint32(len);
+      lz4len = LZ4_compress_default(in, out + hlen + sizeof(uint32_t), len,
+                                    out_size - hlen - sizeof(uint32_t));
+      if (lz4len <= 0) {
+         *errmsg = _("output buffer too small");
+         return -1;
+      }
+      clen = lz4len + sizeof(uint32_t);
+      break;
+   }
+#endif
+   default:
+      *errmsg = _("algorithm not supported");
+      return -1;
+   }
+   ser_begin(out, hlen);
+   ser_uint32(algo);
+   ser_uint32(clen);
+   ser_uint16(level);
+   ser_uint16(COMP_HEAD_VERSION);
+   return clen + hlen;
+}
+#endif
+
+/*
+ * Compress one block with the worker's private compression state.
+ *  The output is written after the OFFSET_FADDR_SIZE prefix of cbuf.
+ */
+static void compress_block(COMPRESS_PIPE *pipe, CP_BLOCK *blk, void *zws,
+                           int *zlevel, void *lzows, void *zstdws)
+{
+   uint8_t *cbuf = (uint8_t *)blk->cbuf + OFFSET_FADDR_SIZE;
+   uint32_t max_compress_len = pipe->compress_buf_size - OFFSET_FADDR_SIZE;
+
+   blk->stat = 0;
+   blk->clen = 0;
+#ifdef HAVE_LIBZ
+   if (blk->algo == COMPRESS_GZIP) {
+      z_stream *strm = (z_stream *)zws;
+      if (*zlevel != blk->level) {
+         if ((blk->stat=deflateParams(strm, blk->level, Z_DEFAULT_STRATEGY)) != Z_OK) {
+            return;
+         }
+         *zlevel = blk->level;
+      }
+      strm->next_in   = (Bytef *)blk->rbuf + OFFSET_FADDR_SIZE;
+      strm->avail_in  = blk->rlen;
+      strm->next_out  = (Bytef *)cbuf;
+      strm->avail_out = max_compress_len;
+      if ((blk->stat=deflate(strm, Z_FINISH)) != Z_STREAM_END) {
+         return;
+      }
+      blk->clen = strm->total_out;
+      if ((blk->stat=deflateReset(strm)) != Z_OK) {
+         return;
+      }
+      blk->stat = 0;
+   }
+#endif
+#ifdef HAVE_LZO
+   if (blk->algo == COMPRESS_LZO1X) {
+      lzo_uint len;
+      ser_declare;
+
+      blk->stat = lzo1x_1_compress((const unsigned char *)blk->rbuf + OFFSET_FADDR_SIZE,
+                     blk->rlen, cbuf + sizeof(comp_stream_header), &len, lzows);
+      if (blk->stat != LZO_E_OK || len > max_compress_len) {
+         if (blk->stat == LZO_E_OK) {
+            blk->stat = LZO_E_ERROR;
+         }
+         return;
+      }
+      ser_begin(cbuf, sizeof(comp_stream_header));
+      ser_uint32(COMPRESS_LZO1X);
+      ser_uint32(len);
+      ser_uint16(0);
+      ser_uint16(COMP_HEAD_VERSION);
+      blk->clen = len + sizeof(comp_stream_header);
+   }
+#endif
+#if defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+   if (blk->algo == COMPRESS_ZSTD || blk->algo == COMPRESS_LZ4) {
+      const char *errmsg;
+      int32_t len = compress_zstd_lz4(blk->algo, blk->level, zstdws,
+                       blk->rbuf + OFFSET_FADDR_SIZE, blk->rlen, (char *)cbuf,
+                       max_compress_len, &errmsg);
+      if (len < 0) {
+         Dmsg1(50, "Compression error: %s\n", errmsg);
+         blk->stat = -1;
+         return;
+      }
+      blk->clen = len;
+   }
+#endif
+}
+
+/*
+ * Worker thread: pick the queued blocks in read order and
+ *  compress them.
+ */
+extern "C" void *compress_pipe_worker(void *arg)
+{
+   COMPRESS_PIPE *pipe = (COMPRESS_PIPE *)arg;
+   void *zws = NULL;
+   void *lzows = NULL;
+   void *zstdws = NULL;               /* one zstd context per worker */
+   int zlevel = -1;                   /* Z_DEFAULT_COMPRESSION */
+   CP_BLOCK *blk;
+
+#ifdef HAVE_LIBZ
+   z_stream *strm = (z_stream *)malloc(sizeof(z_stream));
+   memset(strm, 0, sizeof(z_stream));
+   if (deflateInit(strm, Z_DEFAULT_COMPRESSION) == Z_OK) {
+      zws = strm;
+   } else {
+      free(strm);
+   }
+#endif
+#ifdef HAVE_LZO
+   lzows = malloc(LZO1X_1_MEM_COMPRESS);
+#endif
+#ifdef HAVE_ZSTD
+   zstdws = ZSTD_createCCtx();
+#endif
+
+   P(pipe->mutex);
+   for ( ;; ) {
+      while (!pipe->quit && pipe->blocks[pipe->next].state != CP_QUEUED) {
+         pthread_cond_wait(&pipe->work, &pipe->mutex);
+      }
+      if (pipe->quit) {
+         break;
+      }
+      blk = &pipe->blocks[pipe->next];
+      blk->state = CP_BUSY;
+      pipe->next = (pipe->next + 1) % pipe->nblocks;
+      V(pipe->mutex);
+
+      if ((blk->algo == COMPRESS_GZIP && !zws) ||
+          (blk->algo == COMPRESS_LZO1X && !lzows) ||
+          (blk->algo == COMPRESS_ZSTD && !zstdws)) {
+         blk->stat = -1;              /* no workset, report an error */
+      } else {
+         compress_block(pipe, blk, zws, &zlevel, lzows, zstdws);
+      }
+
+      P(pipe->mutex);
+      blk->state = CP_DONE;
+      pipe->nb_blocks++;
+      pthread_cond_broadcast(&pipe->done);
+   }
+   V(pipe->mutex);
+
+#ifdef HAVE_LIBZ
+   if (zws) {
+      deflateEnd((z_stream *)zws);
+      free(zws);
+   }
+#endif
+   if (lzows) {
+      free(lzows);
+   }
+#ifdef HAVE_ZSTD
+   if (zstdws) {
+      ZSTD_freeCCtx((ZSTD_CCtx *)zstdws);
+   }
+#endif
+   return NULL;
+}
+
+/*
+ * Create the pipeline and start the workers.
+ *  buf_size and compress_buf_size are the sizes computed by
+ *  blast_data_to_storage_daemon() for the serial buffers.
+ */
+COMPRESS_PIPE *new_compress_pipe(JCR *jcr, int nthreads, int32_t buf_size,
+                                 int32_t compress_buf_size)
+{
+   COMPRESS_PIPE *pipe;
+   int i, stat;
+
+   pipe = (COMPRESS_PIPE *)malloc(sizeof(COMPRESS_PIPE));
+   memset(pipe, 0, sizeof(COMPRESS_PIPE));
+   pthread_mutex_init(&pipe->mutex, NULL);
+   pthread_cond_init(&pipe->work, NULL);
+   pthread_cond_init(&pipe->done, NULL);
+   pipe->buf_size = buf_size;
+   pipe->compress_buf_size = compress_buf_size;
+   /* Two blocks per worker keep every worker busy while we send */
+   pipe->nblocks = 2 * nthreads;
+   pipe->blocks = (CP_BLOCK *)malloc(pipe->nblocks * sizeof(CP_BLOCK));
+   memset(pipe->blocks, 0, pipe->nblocks * sizeof(CP_BLOCK));
+   for (i = 0; i < pipe->nblocks; i++) {
+      pipe->blocks[i].rbuf = get_memory(buf_size + OFFSET_FADDR_SIZE);
+      pipe->blocks[i].cbuf = get_memory(compress_buf_size);
+   }
+   pipe->threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+   for (i = 0; i < nthreads; i++) {
+      if ((stat = pthread_create(&pipe->threads[i], NULL, compress_pipe_worker,
+                                 pipe)) != 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Cannot create compression thread: ERR=%s\n"),
+              be.bstrerror(stat));
+         break;
+      }
+   }
+   pipe->nthreads = i;
+   if (pipe->nthreads == 0) {
+      free_compress_pipe(pipe);
+      return NULL;
+   }
+   Dmsg2(100, "Compression pipeline started threads=%d blocks=%d\n",
+         pipe->nthreads, pipe->nblocks);
+   return pipe;
+}
+
+/* Stop the workers and release the ring */
+void free_compress_pipe(COMPRESS_PIPE *pipe)
+{
+   int i;
+
+   P(pipe->mutex);
+   pipe->quit = true;
+   pthread_cond_broadcast(&pipe->work);
+   V(pipe->mutex);
+   for (i = 0; i < pipe->nthreads; i++) {
+      pthread_join(pipe->threads[i], NULL);
+   }
+   Dmsg2(100, "Compression pipeline stopped threads=%d blocks=%lld\n",
+         pipe->nthreads, pipe->nb_blocks);
+   for (i = 0; i < pipe->nblocks; i++) {
+      free_pool_memory(pipe->blocks[i].rbuf);
+      free_pool_memory(pipe->blocks[i].cbuf);
+   }
+   free(pipe->blocks);
+   free(pipe->threads);
+   pthread_cond_destroy(&pipe->work);
+   pthread_cond_destroy(&pipe->done);
+   pthread_mutex_destroy(&pipe->mutex);
+   free(pipe);
+}
+
+/*
+ * Return the next free slot of the ring, or NULL if the ring is
+ *  full and the oldest block must be sent first.
+ */
+CP_BLOCK *compress_pipe_get_free(COMPRESS_PIPE *pipe)
+{
+   CP_BLOCK *blk = &pipe->blocks[pipe->head];
+   return blk->state == CP_FREE ? blk : NULL;
+}
+
+/* Hand the slot returned by compress_pipe_get_free() to the workers */
+void compress_pipe_submit(COMPRESS_PIPE *pipe, CP_BLOCK *blk, uint32_t len,
+                          uint32_t algo, int32_t level)
+{
+   blk->rlen = len;
+   blk->algo = algo;
+   blk->level = level;
+   P(pipe->mutex);
+   blk->state = CP_QUEUED;
+   pipe->head = (pipe->head + 1) % pipe->nblocks;
+   pthread_cond_signal(&pipe->work);
+   V(pipe->mutex);
+}
+
+/*
+ * Wait for the oldest submitted block to be compressed.
+ *  Returns NULL when nothing is pending.
+ */
+CP_BLOCK *compress_pipe_get_done(COMPRESS_PIPE *pipe)
+{
+   CP_BLOCK *blk = &pipe->blocks[pipe->tail];
+
+   if (blk->state == CP_FREE) {
+      return NULL;
+   }
+   P(pipe->mutex);
+   while (blk->state != CP_DONE) {
+      pthread_cond_wait(&pipe->done, &pipe->mutex);
+   }
+   V(pipe->mutex);
+   return blk;
+}
+
+/* The block returned by compress_pipe_get_done() has been sent */
+void compress_pipe_release(COMPRESS_PIPE *pipe, CP_BLOCK *blk)
+{
+   blk->state = CP_FREE;
+   pipe->tail = (pipe->tail + 1) % pipe->nblocks;
+}
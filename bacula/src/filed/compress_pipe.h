@@ -0,0 +1,68 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Multi-threaded compression pipeline used by send_data()
+ *
+ *  The job thread reads and digests the file, a pool of worker
+ *  threads compresses the blocks, and the job thread sends them
+ *  to the SD in the order they were read.
+ */
+
+#ifndef __COMPRESS_PIPE_H
+#define __COMPRESS_PIPE_H
+
+/* State of one slot of the ring */
+enum {
+   CP_FREE = 0,                        /* available to the reader */
+   CP_QUEUED,                          /* waiting for a worker */
+   CP_BUSY,                            /* being compressed */
+   CP_DONE                             /* compressed, waiting to be sent */
+};
+
+/*
+ * One slot of the compression ring.  Both buffers keep
+ *  OFFSET_FADDR_SIZE bytes free in front so that the sparse
+ *  or offset file address can be stored there by the reader.
+ */
+struct CP_BLOCK {
+   POOLMEM *rbuf;                      /* uncompressed data */
+   POOLMEM *cbuf;                      /* compressed data */
+   uint32_t rlen;                      /* uncompressed length */
+   uint32_t clen;                      /* compressed length */
+   uint32_t algo;                      /* COMPRESS_xxx */
+   int32_t level;                      /* compression level */
+   int32_t stat;                       /* compressor error code, 0 if OK */
+   int state;                          /* CP_xxx */
+};
+
+struct COMPRESS_PIPE {
+   pthread_mutex_t mutex;
+   pthread_cond_t work;                /* signaled when a block is queued */
+   pthread_cond_t done;                /* signaled when a block is compressed */
+   pthread_t *threads;                 /* worker threads */
+   int nthreads;                       /* number of workers */
+   int nblocks;                        /* slots in the ring */
+   CP_BLOCK *blocks;                   /* the ring */
+   int head;                           /* next slot to fill */
+   int tail;                           /* oldest slot not yet sent */
+   int next;                           /* next slot for a worker */
+   int32_t buf_size;                   /* uncompressed data size */
+   int32_t compress_buf_size;          /* compressed data size */
+   uint64_t nb_blocks;                 /* blocks compressed by the workers */
+   bool quit;                          /* workers must terminate */
+};
+
+#endif /* __COMPRESS_PIPE_H */
@@ -238,6 +238,7 @@ int main (int argc, char *argv[])
    me += 1000000;
 #endif
 
+   start_message_dispatcher();        /* deliver messages in background */
    if (!no_signals) {
       start_watchdog();               /* start watchdog thread */
       init_jcr_subsystem();           /* start JCR watchdogs etc. */
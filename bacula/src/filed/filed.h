@@ -55,6 +55,9 @@ typedef enum {
 #include "findlib/find.h"
 #include "acl.h"
 #include "xattr.h"
+#include "compress_pipe.h"
+#include "restore_pool.h"
+#include "acctable.h"
 #include "jcr.h"
 #include "protos.h"                   /* file daemon prototypes */
 #include "lib/runscript.h"
@@ -68,6 +71,12 @@ typedef enum {
 #include <lzo/lzoconf.h>
 #include <lzo/lzo1x.h>
 #endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
 extern CLIENT *me;                    /* "Global" Client resource */
 extern bool win32decomp;              /* Use decomposition of BackupRead data */
@@ -94,6 +94,11 @@ static RES_ITEM cli_items[] = {
    {"sdconnecttimeout", store_time,ITEM(res_client.SDConnectTimeout), 0, ITEM_DEFAULT, 60 * 30},
    {"heartbeatinterval", store_time, ITEM(res_client.heartbeat_interval), 0, ITEM_DEFAULT, 0},
    {"maximumnetworkbuffersize", store_pint32, ITEM(res_client.max_network_buffer_size), 0, 0, 0},
+   {"maximumcompressionthreads", store_pint32, ITEM(res_client.MaxCompressThreads), 0, ITEM_DEFAULT, 0},
+   {"maximumdirectoryscanthreads", store_pint32, ITEM(res_client.MaxDirScanThreads), 0, ITEM_DEFAULT, 0},
+   {"maximumrestorethreads", store_pint32, ITEM(res_client.MaxRestoreThreads), 0, ITEM_DEFAULT, 0},
+   {"maximumaccuratememoryfiles", store_pint32, ITEM(res_client.MaxAccurateMemoryFiles), 0, ITEM_DEFAULT, 0},
+   {"accuratecache", store_bool, ITEM(res_client.AccurateCache), 0, ITEM_DEFAULT, 0},
 #ifdef DATA_ENCRYPTION
    {"pkisignatures",         store_bool,    ITEM(res_client.pki_sign), 0, ITEM_DEFAULT, 0},
    {"pkiencryption",         store_bool,    ITEM(res_client.pki_encrypt), 0, ITEM_DEFAULT, 0},
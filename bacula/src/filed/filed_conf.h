@@ -75,6 +75,11 @@ struct CLIENT {
    utime_t SDConnectTimeout;          /* timeout in seconds */
    utime_t heartbeat_interval;        /* Interval to send heartbeats */
    uint32_t max_network_buffer_size;  /* max network buf size */
+   uint32_t MaxCompressThreads;       /* compression threads per job, 0 = serial */
+   uint32_t MaxDirScanThreads;        /* directory scan threads per job, 0 = serial */
+   uint32_t MaxRestoreThreads;        /* restore writer threads per job, 0 = serial */
+   uint32_t MaxAccurateMemoryFiles;   /* larger accurate lists go to disk, 0 = never */
+   bool AccurateCache;                /* keep the accurate list of the last job */
    bool pki_sign;                     /* Enable Data Integrity Verification via Digital Signatures */
    bool pki_encrypt;                  /* Enable Data Encryption */
    char *pki_keypair_file;            /* PKI Key Pair File */
@@ -114,6 +114,7 @@ struct s_cmds cmds[] = {
    {"RunBeforeJob", runbefore_cmd, 0},
    {"RunAfterJob",  runafter_cmd,  0},
    {"Run",          runscript_cmd, 0},
+   {"accuratecache", accurate_cache_cmd, 0},
    {"accurate",     accurate_cmd,  0},
    {"restoreobject", restore_object_cmd, 0},
    {"sm_dump",      sm_dump_cmd, 0},
@@ -1517,6 +1518,10 @@ static int set_options(findFOPTS *fo, const char *opts)
             p++;
             break;
 #endif
+         case '4':
+            fo->flags |= FO_XXH64;
+            p++;
+            break;
          default:
             /*
              * If 2 or 3 is seen here, SHA2 is not configured, so
@@ -1603,6 +1608,20 @@ static int set_options(findFOPTS *fo, const char *opts)
             fo->Compress_algo = COMPRESS_LZO1X;
             fo->Compress_level = 1; /* not used with LZO */
          }
+         else if (*p == 'l') {
+            fo->flags |= FO_COMPRESS;
+            fo->Compress_algo = COMPRESS_LZ4;
+            fo->Compress_level = 1; /* not used with LZ4 */
+         }
+         else if (*p == 'z') {
+            fo->flags |= FO_COMPRESS;
+            fo->Compress_algo = COMPRESS_ZSTD;
+            fo->Compress_level = 0;
+            while (B_ISDIGIT(p[1])) {
+               p++;
+               fo->Compress_level = fo->Compress_level * 10 + *p - '0';
+            }
+         }
          break;
       case 'K':
          fo->flags |= FO_NOATIME;
@@ -2081,6 +2100,8 @@ static int backup_cmd(JCR *jcr)
       if (!(SDJobStatus == JS_Terminated || SDJobStatus == JS_Warnings)) {
          Jmsg(jcr, M_FATAL, 0, _("Bad status %d %c returned from Storage Daemon.\n"),
             SDJobStatus, (char)SDJobStatus);
+      } else if (jcr->JobStatus == JS_Terminated || jcr->JobStatus == JS_Warnings) {
+         accurate_cache_save(jcr);    /* for the next accurate job */
       }
    }
 
@@ -2408,6 +2429,7 @@ static void filed_free_jcr(JCR *jcr)
    free_runscripts(jcr->RunScripts);
    delete jcr->RunScripts;
    free_path_list(jcr);
+   accurate_cache_free(jcr);
 
    if (jcr->JobId != 0)
       write_state_file(me->working_directory, "bacula-fd", get_first_port_host_order(me->FDaddrs));
@@ -40,15 +40,79 @@ bacl_exit_code build_acl_streams(JCR *jcr, FF_PKT *ff_pkt);
 bacl_exit_code parse_acl_streams(JCR *jcr, int stream, char *content, uint32_t content_length);
 
 /* from accurate.c */
+bool accurate_init(JCR *jcr, int nbfile);
+bool accurate_add_records(JCR *jcr, uint8_t *ptr, uint8_t *end);
 bool accurate_finish(JCR *jcr);
 bool accurate_check_file(JCR *jcr, FF_PKT *ff_pkt);
 bool accurate_mark_file_as_seen(JCR *jcr, char *fname);
 void accurate_free(JCR *jcr);
 
+/* from acccache.c */
+int accurate_cache_cmd(JCR *jcr);
+void accurate_cache_add_file(JCR *jcr, FF_PKT *ff_pkt, int data_stream,
+                             char *digest, int digest_len);
+void accurate_cache_merge(JCR *jcr);
+bool accurate_cache_save(JCR *jcr);
+void accurate_cache_free(JCR *jcr);
+
+/* from acctable.c */
+ACC_TABLE *new_acc_table(JCR *jcr, int64_t nbfile, const char *spill_file);
+void free_acc_table(ACC_TABLE *t);
+bool acc_table_add(ACC_TABLE *t, char *fname, char *lstat, char *chksum,
+                   int32_t delta_seq);
+bool acc_table_add_entry(ACC_TABLE *t, const char *dir, int dir_len,
+                         const char *name, int64_t *fields,
+                         const char *digest, int digest_len, bool text,
+                         int32_t delta_seq);
+ACC_ENTRY *acc_table_lookup(ACC_TABLE *t, char *fname);
+void acc_table_set_seen(ACC_TABLE *t, ACC_ENTRY *entry);
+bool acc_table_is_seen(ACC_TABLE *t, ACC_ENTRY *entry);
+ACC_ENTRY *acc_table_first(ACC_TABLE *t);
+ACC_ENTRY *acc_table_next(ACC_TABLE *t);
+uint32_t acc_table_size(ACC_TABLE *t);
+uint64_t acc_table_bytes(ACC_TABLE *t);
+bool acc_table_spilled(ACC_TABLE *t);
+void acc_entry_fields(ACC_ENTRY *entry, int64_t *fields);
+void acc_entry_stat(ACC_ENTRY *entry, struct stat *statp, int32_t *LinkFI);
+const char *acc_entry_digest(ACC_ENTRY *entry);
+bool acc_entry_has_digest(ACC_ENTRY *entry);
+bool acc_entry_digest_equal(ACC_ENTRY *entry, char *md, int size);
+char *acc_entry_digest_edit(ACC_ENTRY *entry, char *buf, int buflen);
+char *acc_entry_fname(ACC_TABLE *t, ACC_ENTRY *entry, POOLMEM *&fname);
+const char *acc_entry_dir(ACC_TABLE *t, ACC_ENTRY *entry);
+
+/* from compress_pipe.c */
+COMPRESS_PIPE *new_compress_pipe(JCR *jcr, int nthreads, int32_t buf_size,
+                                 int32_t compress_buf_size);
+void free_compress_pipe(COMPRESS_PIPE *pipe);
+CP_BLOCK *compress_pipe_get_free(COMPRESS_PIPE *pipe);
+void compress_pipe_submit(COMPRESS_PIPE *pipe, CP_BLOCK *blk, uint32_t len,
+                          uint32_t algo, int32_t level);
+CP_BLOCK *compress_pipe_get_done(COMPRESS_PIPE *pipe);
+void compress_pipe_release(COMPRESS_PIPE *pipe, CP_BLOCK *blk);
+int32_t compress_zstd_lz4(uint32_t algo, int32_t level, void *zstd_ctx,
+                          const char *in, uint32_t len, char *out,
+                          uint32_t out_size, const char **errmsg);
+
+/* from restore_pool.c */
+RESTORE_POOL *new_restore_pool(JCR *jcr, int nwriters, int32_t buf_size);
+void free_restore_pool(RESTORE_POOL *pool);
+RP_FILE *restore_pool_new_file(RESTORE_POOL *pool, BFILE *bfd, ATTR *attr);
+void restore_pool_write(RESTORE_POOL *pool, RP_FILE *file, char *data,
+                        int32_t len, int flags, int32_t stream);
+void restore_pool_end_file(RESTORE_POOL *pool, RP_FILE *file, bool ok,
+                           alist *delayed_streams);
+RP_FILE *restore_pool_get_done(RESTORE_POOL *pool, bool wait);
+void restore_pool_free_file(RP_FILE *file);
+void restore_pool_times(RESTORE_POOL *pool, btime_t *data, btime_t *attr,
+                        btime_t *wait);
+
 /* from backup.c */
 bool encode_and_send_attributes(JCR *jcr, FF_PKT *ff_pkt, int &data_stream);
 void strip_path(FF_PKT *ff_pkt);
 void unstrip_path(FF_PKT *ff_pkt);
+bool sparse_skip_holes(FF_PKT *ff_pkt, BFILE *bfd, int32_t rsize,
+                       uint64_t *fileAddr, uint64_t *holeAddr);
 
 /* from xattr.c */
 bxattr_exit_code build_xattr_streams(JCR *jcr, FF_PKT *ff_pkt);
@@ -75,6 +75,16 @@ const bool have_lzo = true;
 #else
 const bool have_lzo = false;
 #endif
+#ifdef HAVE_ZSTD
+const bool have_zstd = true;
+#else
+const bool have_zstd = false;
+#endif
+#ifdef HAVE_LZ4
+const bool have_lz4 = true;
+#else
+const bool have_lz4 = false;
+#endif
 
 static void deallocate_cipher(r_ctx &rctx);
 static void deallocate_fork_cipher(r_ctx &rctx);
@@ -82,9 +92,7 @@ static void free_signature(r_ctx &rctx);
 static void free_session(r_ctx &rctx);
 static bool close_previous_stream(JCR *jcr, r_ctx &rctx);
 static bool verify_signature(JCR *jcr, r_ctx &rctx);
-int32_t extract_data(JCR *jcr, BFILE *bfd, POOLMEM *buf, int32_t buflen,
-                     uint64_t *addr, int flags, int32_t stream, RESTORE_CIPHER_CTX *cipher_ctx);
-bool flush_cipher(JCR *jcr, BFILE *bfd, uint64_t *addr, int flags, int32_t stream,
+bool flush_cipher(r_ctx &rctx, BFILE *bfd, uint64_t *addr, int flags, int32_t stream,
                   RESTORE_CIPHER_CTX *cipher_ctx);
 
 /*
@@ -141,22 +149,22 @@ static bool restore_finderinfo(JCR *jcr, POOLMEM *buf, int32_t buflen)
  * Cleanup of delayed restore stack with streams for later
  * processing.
  */
-static inline void drop_delayed_restore_streams(r_ctx &rctx, bool reuse)
+static inline void drop_delayed_restore_streams(alist *delayed_streams, bool reuse)
 {
    RESTORE_DATA_STREAM *rds;
 
-   if (!rctx.delayed_streams ||
-       rctx.delayed_streams->empty()) {
+   if (!delayed_streams ||
+       delayed_streams->empty()) {
       return;
    }
 
-   foreach_alist(rds, rctx.delayed_streams) {
+   foreach_alist(rds, delayed_streams) {
       free(rds->content);
    }
 
-   rctx.delayed_streams->destroy();
+   delayed_streams->destroy();
    if (reuse) {
-      rctx.delayed_streams->init(10, owned_by_alist);
+      delayed_streams->init(10, owned_by_alist);
    }
 }
 
@@ -245,15 +253,15 @@ static inline bool do_restore_xattr(JCR *jcr,
  * attributes otherwise we might clear some security flags
  * by setting the attributes.
  */
-static inline bool pop_delayed_data_streams(JCR *jcr, r_ctx &rctx)
+static inline bool pop_delayed_data_streams(JCR *jcr, alist *delayed_streams)
 {
    RESTORE_DATA_STREAM *rds;
 
    /*
     * See if there is anything todo.
     */
-   if (!rctx.delayed_streams ||
-        rctx.delayed_streams->empty()) {
+   if (!delayed_streams ||
+        delayed_streams->empty()) {
       return true;
    }
 
@@ -268,7 +276,7 @@ static inline bool pop_delayed_data_streams(JCR *jcr, r_ctx &rctx)
     * - *_ACL_*
     * - *_XATTR_*
     */
-   foreach_alist(rds, rctx.delayed_streams) {
+   foreach_alist(rds, delayed_streams) {
       switch (rds->stream) {
       case STREAM_UNIX_ACCESS_ACL:
       case STREAM_UNIX_DEFAULT_ACL:
@@ -322,12 +330,12 @@ static inline bool pop_delayed_data_streams(JCR *jcr, r_ctx &rctx)
    /*
     * We processed the stack so we can destroy it.
     */
-   rctx.delayed_streams->destroy();
+   delayed_streams->destroy();
 
    /*
     * (Re)Initialize the stack for a new use.
     */
-   rctx.delayed_streams->init(10, owned_by_alist);
+   delayed_streams->init(10, owned_by_alist);
 
    return true;
 
@@ -336,11 +344,84 @@ bail_out:
    /*
     * Destroy the content of the stack and (re)initialize it for a new use.
     */
-   drop_delayed_restore_streams(rctx, true);
+   drop_delayed_restore_streams(delayed_streams, true);
 
    return false;
 }
 
+/*
+ * Read a record from the Storage daemon, counting the time
+ *  spent waiting for it.
+ */
+static inline int restore_get_msg(BSOCK *sd, r_ctx &rctx)
+{
+   btime_t start = get_current_btime();
+   int n = bget_msg(sd);
+   rctx.times.receive += get_current_btime() - start;
+   return n;
+}
+
+/*
+ * Restore the delayed streams of the files closed by the restore
+ *  writers. With wait, wait for all the files handed to them.
+ */
+static bool pop_restore_pool(JCR *jcr, r_ctx &rctx, bool wait)
+{
+   RP_FILE *file, *next;
+   POOLMEM *fname;
+   int32_t type;
+   bool ok = true;
+
+   for (file = restore_pool_get_done(rctx.pool, wait); file; file = next) {
+      next = file->next;
+      if (ok && !file->failed && file->delayed_streams &&
+          !file->delayed_streams->empty()) {
+         btime_t start = get_current_btime();
+         /*
+          * The acl and xattr code works on jcr->last_fname, point it
+          *  to the file for the time of the restore.
+          */
+         jcr->lock();
+         fname = jcr->last_fname;
+         type = jcr->last_type;
+         jcr->last_fname = file->fname;
+         jcr->last_type = file->attr->type;
+         jcr->unlock();
+         ok = pop_delayed_data_streams(jcr, file->delayed_streams);
+         jcr->lock();
+         jcr->last_fname = fname;
+         jcr->last_type = type;
+         jcr->unlock();
+         rctx.times.delayed += get_current_btime() - start;
+      }
+      restore_pool_free_file(file);
+   }
+   return ok;
+}
+
+/*
+ * Stop the restore writers. The file being restored, if any, and
+ *  the files not yet returned are closed without their delayed
+ *  streams.
+ */
+static void stop_restore_pool(r_ctx &rctx, btime_t *data, btime_t *attr)
+{
+   RP_FILE *file, *next;
+
+   if (rctx.rfile) {
+      restore_pool_end_file(rctx.pool, rctx.rfile, false, rctx.delayed_streams);
+      rctx.delayed_streams = NULL;
+      rctx.rfile = NULL;
+   }
+   for (file = restore_pool_get_done(rctx.pool, true); file; file = next) {
+      next = file->next;
+      restore_pool_free_file(file);
+   }
+   restore_pool_times(rctx.pool, data, attr, &rctx.times.wait);
+   free_restore_pool(rctx.pool);
+   rctx.pool = NULL;
+}
+
 /*
  * Restore the requested files.
  */
@@ -353,6 +434,8 @@ void do_restore(JCR *jcr)
    uint32_t buf_size;                 /* client buffer size */
    int stat;
    int64_t rsrc_len = 0;              /* Original length of resource fork */
+   int nwriters = 0;                  /* restore writer threads */
+   btime_t start, wdata = 0, wattr = 0;
    r_ctx rctx;
    ATTR *attr;
    /* ***FIXME*** make configurable */
@@ -360,6 +443,7 @@ void do_restore(JCR *jcr)
                                        CRYPTO_DIGEST_SHA256 : CRYPTO_DIGEST_SHA1;
    memset(&rctx, 0, sizeof(rctx));
    rctx.jcr = jcr;
+   rctx.fname = jcr->last_fname;
 
    /*
     * The following variables keep track of "known unknowns"
@@ -394,12 +478,7 @@ void do_restore(JCR *jcr)
     * St Bernard code goes here if implemented -- see end of file
     */
 
-   /* use the same buffer size to decompress both gzip and lzo */
-   if (have_libz || have_lzo) {
-      uint32_t compress_buf_size = jcr->buf_size + 12 + ((jcr->buf_size+999) / 1000) + 100;
-      jcr->compress_buf = get_memory(compress_buf_size);
-      jcr->compress_buf_size = compress_buf_size;
-   }
+   init_decompress(rctx, jcr->buf_size);
 
 #ifdef HAVE_LZO
    if (lzo_init() != LZO_E_OK) {
@@ -415,6 +494,19 @@ void do_restore(JCR *jcr)
       }
    }
 
+   /*
+    * The regular files can be written by a pool of threads. The
+    *  decryption, the signature verification and the resource
+    *  forks are handled by the serial code.
+    */
+   if (client && client->MaxRestoreThreads > 0 && !have_darwin_os &&
+       !jcr->crypto.pki_sign && !jcr->crypto.pki_recipients) {
+      rctx.pool = new_restore_pool(jcr, client->MaxRestoreThreads, jcr->buf_size);
+      if (rctx.pool) {
+         nwriters = rctx.pool->nwriters;
+      }
+   }
+
    /*
     * Get a record from the Storage daemon. We are guaranteed to
     *   receive records in the following order:
@@ -460,7 +552,7 @@ void do_restore(JCR *jcr)
       memset(jcr->xattr_data->u.parse, 0, sizeof(xattr_parse_data_t));
    }
 
-   while (bget_msg(sd) >= 0 && !job_canceled(jcr)) {
+   while (restore_get_msg(sd, rctx) >= 0 && !job_canceled(jcr)) {
       /*
        * Remember previous stream type
        */
@@ -482,7 +574,7 @@ void do_restore(JCR *jcr)
       /*
        * Now we expect the Stream Data
        */
-      if (bget_msg(sd) < 0) {
+      if (restore_get_msg(sd, rctx) < 0) {
          Jmsg1(jcr, M_FATAL, 0, _("Data record error. ERR=%s\n"), sd->bstrerror());
          goto bail_out;
       }
@@ -523,6 +615,9 @@ void do_restore(JCR *jcr)
          if (!close_previous_stream(jcr, rctx)) {
             goto bail_out;
          }
+         if (rctx.pool && !pop_restore_pool(jcr, rctx, false)) {
+            goto bail_out;
+         }
 
          /*
           * TODO: manage deleted files
@@ -572,6 +667,7 @@ void do_restore(JCR *jcr)
          jcr->num_files_examined++;
          rctx.extract = false;
          stat = CF_CORE;        /* By default, let Bacula's core handle it */
+         start = get_current_btime();
 
          if (jcr->plugin) {
             stat = plugin_create_file(jcr, attr, &rctx.bfd, jcr->replace);
@@ -580,10 +676,12 @@ void do_restore(JCR *jcr)
          if (stat == CF_CORE) {
             stat = create_file(jcr, attr, &rctx.bfd, jcr->replace);
          }
+         rctx.times.create += get_current_btime() - start;
          jcr->lock();
          pm_strcpy(jcr->last_fname, attr->ofname);
          jcr->last_type = attr->type;
          jcr->unlock();
+         rctx.fname = jcr->last_fname;
          Dmsg2(130, "Outfile=%s create_file stat=%d\n", attr->ofname, stat);
          switch (stat) {
          case CF_ERROR:
@@ -628,11 +726,19 @@ void do_restore(JCR *jcr)
                /*
                 * set attributes now because file will not be extracted
                 */
+               start = get_current_btime();
                if (jcr->plugin) {
                   plugin_set_attributes(jcr, attr, &rctx.bfd);
                } else {
                   set_attributes(jcr, attr, &rctx.bfd);
                }
+               rctx.times.attributes += get_current_btime() - start;
+            } else if (rctx.pool && !jcr->plugin &&
+                       (attr->type == FT_REG || attr->type == FT_REGE)) {
+               /*
+                * From now on the file belongs to a restore writer
+                */
+               rctx.rfile = restore_pool_new_file(rctx.pool, &rctx.bfd, attr);
             }
             break;
          }
@@ -791,15 +897,28 @@ void do_restore(JCR *jcr)
 
             if (is_win32_stream(rctx.stream) &&
                 (win32decomp || !have_win32_api())) {
-               set_portable_backup(&rctx.bfd);
+               if (!rctx.rfile) {
+                  set_portable_backup(&rctx.bfd);
+               }
                /*
                 * "decompose" BackupWrite data
                 */
                rctx.flags |= FO_WIN32DECOMP;
             }
 
-            if (extract_data(jcr, &rctx.bfd, sd->msg, sd->msglen, &rctx.fileAddr,
-                             rctx.flags, rctx.stream, &rctx.cipher_ctx) < 0) {
+            if (rctx.rfile) {
+               /*
+                * The writer of the file decompresses and writes the data
+                */
+               restore_pool_write(rctx.pool, rctx.rfile, sd->msg, sd->msglen,
+                                  rctx.flags, rctx.stream);
+               break;
+            }
+            start = get_current_btime();
+            stat = extract_data(rctx, &rctx.bfd, sd->msg, sd->msglen, &rctx.fileAddr,
+                                rctx.flags, rctx.stream, &rctx.cipher_ctx);
+            rctx.times.data += get_current_btime() - start;
+            if (stat < 0) {
                rctx.extract = false;
                bclose(&rctx.bfd);
                continue;
@@ -853,7 +972,7 @@ void do_restore(JCR *jcr)
                   Dmsg0(130, "Restoring resource fork\n");
                }
 
-               if (extract_data(jcr, &rctx.forkbfd, sd->msg, sd->msglen, &rctx.fork_addr, rctx.fork_flags,
+               if (extract_data(rctx, &rctx.forkbfd, sd->msg, sd->msglen, &rctx.fork_addr, rctx.fork_flags,
                                 rctx.stream, &rctx.fork_cipher_ctx) < 0) {
                   rctx.extract = false;
                   bclose(&rctx.forkbfd);
@@ -916,9 +1035,11 @@ void do_restore(JCR *jcr)
             if (jcr->last_type != FT_DIREND) {
                push_delayed_restore_stream(rctx, sd);
             } else {
+               start = get_current_btime();
                if (!do_restore_acl(jcr, rctx.stream, sd->msg, sd->msglen)) {
                   goto bail_out;
                }
+               rctx.times.delayed += get_current_btime() - start;
             }
          } else {
             non_support_acl++;
@@ -954,9 +1075,11 @@ void do_restore(JCR *jcr)
             if (jcr->last_type != FT_DIREND) {
                push_delayed_restore_stream(rctx, sd);
             } else {
+               start = get_current_btime();
                if (!do_restore_xattr(jcr, rctx.stream, sd->msg, sd->msglen)) {
                   goto bail_out;
                }
+               rctx.times.delayed += get_current_btime() - start;
             }
          } else {
             non_support_xattr++;
@@ -1005,6 +1128,7 @@ void do_restore(JCR *jcr)
       case STREAM_SHA1_DIGEST:
       case STREAM_SHA256_DIGEST:
       case STREAM_SHA512_DIGEST:
+      case STREAM_XXH64_DIGEST:
          break;
 
       case STREAM_PROGRAM_NAMES:
@@ -1048,6 +1172,9 @@ void do_restore(JCR *jcr)
    if (!close_previous_stream(jcr, rctx)) {
       goto bail_out;
    }
+   if (rctx.pool && !pop_restore_pool(jcr, rctx, true)) {
+      goto bail_out;
+   }
    jcr->setJobStatus(JS_Terminated);
    goto ok_out;
 
@@ -1055,11 +1182,24 @@ bail_out:
    jcr->setJobStatus(JS_ErrorTerminated);
 
 ok_out:
+   if (rctx.pool) {
+      stop_restore_pool(rctx, &wdata, &wattr);
+   }
+
    /*
     * First output the statistics.
     */
    Dmsg2(10, "End Do Restore. Files=%d Bytes=%s\n", jcr->JobFiles,
       edit_uint64(jcr->JobBytes, ec1));
+   Jmsg(jcr, M_INFO, 0, _("Restore times: receive=%.3fs create=%.3fs data=%.3fs attributes=%.3fs acl/xattr=%.3fs\n"),
+        rctx.times.receive / 1000000.0, rctx.times.create / 1000000.0,
+        rctx.times.data / 1000000.0, rctx.times.attributes / 1000000.0,
+        rctx.times.delayed / 1000000.0);
+   if (nwriters > 0) {
+      Jmsg(jcr, M_INFO, 0, _("Restore writers=%d: data=%.3fs attributes=%.3fs wait=%.3fs\n"),
+           nwriters, wdata / 1000000.0, wattr / 1000000.0,
+           rctx.times.wait / 1000000.0);
+   }
    if (have_acl && jcr->acl_data->u.parse->nr_errors > 0) {
       Jmsg(jcr, M_WARNING, 0, _("Encountered %ld acl errors while doing restore\n"),
            jcr->acl_data->u.parse->nr_errors);
@@ -1123,11 +1263,7 @@ ok_out:
       rctx.fork_cipher_ctx.buf = NULL;
    }
 
-   if (jcr->compress_buf) {
-      free_pool_memory(jcr->compress_buf);
-      jcr->compress_buf = NULL;
-      jcr->compress_buf_size = 0;
-   }
+   term_decompress(rctx);
 
    if (have_acl && jcr->acl_data) {
       free(jcr->acl_data->u.parse);
@@ -1145,7 +1281,7 @@ ok_out:
     * Free the delayed stream stack list.
     */
    if (rctx.delayed_streams) {
-      drop_delayed_restore_streams(rctx, false);
+      drop_delayed_restore_streams(rctx.delayed_streams, false);
       delete rctx.delayed_streams;
    }
 
@@ -1321,7 +1457,7 @@ bail_out:
    return false;
 }
 
-bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *length)
+bool sparse_data(r_ctx &rctx, BFILE *bfd, uint64_t *addr, char **data, uint32_t *length)
 {
       unser_declare;
       uint64_t faddr;
@@ -1332,8 +1468,8 @@ bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *le
          *addr = faddr;
          if (blseek(bfd, (boffset_t)*addr, SEEK_SET) < 0) {
             berrno be;
-            Jmsg3(jcr, M_ERROR, 0, _("Seek to %s error on %s: ERR=%s\n"),
-                  edit_uint64(*addr, ec1), jcr->last_fname,
+            Jmsg3(rctx.jcr, M_ERROR, 0, _("Seek to %s error on %s: ERR=%s\n"),
+                  edit_uint64(*addr, ec1), rctx.fname,
                   be.bstrerror(bfd->berrno));
             return false;
          }
@@ -1343,9 +1479,10 @@ bool sparse_data(JCR *jcr, BFILE *bfd, uint64_t *addr, char **data, uint32_t *le
       return true;
 }
 
-bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
+bool decompress_data(r_ctx &rctx, int32_t stream, char **data, uint32_t *length)
 {
-#if defined(HAVE_LZO) || defined(HAVE_LIBZ)
+   JCR *jcr = rctx.jcr;
+#if defined(HAVE_LZO) || defined(HAVE_LIBZ) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
    char ec1[50]; /* Buffer printing huge values */
 #endif
 
@@ -1385,30 +1522,103 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
       switch(comp_magic) {
 #ifdef HAVE_LZO
          case COMPRESS_LZO1X:
-            compress_len = jcr->compress_buf_size;
+            compress_len = rctx.decomp_buf_size;
             cbuf = (const unsigned char*)*data + sizeof(comp_stream_header);
             real_compress_len = *length - sizeof(comp_stream_header);
             Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
             while ((r=lzo1x_decompress_safe(cbuf, real_compress_len,
-                                            (unsigned char *)jcr->compress_buf, &compress_len, NULL)) == LZO_E_OUTPUT_OVERRUN)
+                                            (unsigned char *)rctx.decomp_buf, &compress_len, NULL)) == LZO_E_OUTPUT_OVERRUN)
             {
                /*
                 * The buffer size is too small, try with a bigger one
                 */
-               compress_len = jcr->compress_buf_size = jcr->compress_buf_size + (jcr->compress_buf_size >> 1);
+               compress_len = rctx.decomp_buf_size = rctx.decomp_buf_size + (rctx.decomp_buf_size >> 1);
                Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-               jcr->compress_buf = check_pool_memory_size(jcr->compress_buf,
+               rctx.decomp_buf = check_pool_memory_size(rctx.decomp_buf,
                                                     compress_len);
             }
             if (r != LZO_E_OK) {
                Qmsg(jcr, M_ERROR, 0, _("LZO uncompression error on file %s. ERR=%d\n"),
-                    jcr->last_fname, r);
+                    rctx.fname, r);
                return false;
             }
-            *data = jcr->compress_buf;
+            *data = rctx.decomp_buf;
             *length = compress_len;
             Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", compress_len, edit_uint64(jcr->JobBytes, ec1));
             return true;
+#endif
+#ifdef HAVE_ZSTD
+         case COMPRESS_ZSTD: {
+            const char *zbuf = *data + sizeof(comp_stream_header);
+            unsigned long long zsize;
+            size_t zstat;
+
+            if (!rctx.zstd_dctx) {
+               rctx.zstd_dctx = ZSTD_createDCtx();
+               if (!rctx.zstd_dctx) {
+                  Qmsg(jcr, M_ERROR, 0, _("zstd decompression context allocation failed\n"));
+                  return false;
+               }
+            }
+            /* The frame records the uncompressed size, make room for it */
+            zsize = ZSTD_getFrameContentSize(zbuf, comp_len);
+            if (zsize == ZSTD_CONTENTSIZE_ERROR || zsize == ZSTD_CONTENTSIZE_UNKNOWN ||
+                zsize > 0x7fffffff) {
+               Qmsg(jcr, M_ERROR, 0, _("zstd uncompression error on file %s. ERR=bad frame header\n"),
+                    rctx.fname);
+               return false;
+            }
+            if ((int32_t)zsize > rctx.decomp_buf_size) {
+               rctx.decomp_buf_size = zsize;
+               rctx.decomp_buf = check_pool_memory_size(rctx.decomp_buf, zsize);
+            }
+            zstat = ZSTD_decompressDCtx((ZSTD_DCtx *)rctx.zstd_dctx,
+                       rctx.decomp_buf, rctx.decomp_buf_size, zbuf, comp_len);
+            if (ZSTD_isError(zstat)) {
+               Qmsg(jcr, M_ERROR, 0, _("zstd uncompression error on file %s. ERR=%s\n"),
+                    rctx.fname, ZSTD_getErrorName(zstat));
+               return false;
+            }
+            *data = rctx.decomp_buf;
+            *length = zstat;
+            Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", *length, edit_uint64(jcr->JobBytes, ec1));
+            return true;
+         }
+#endif
+#ifdef HAVE_LZ4
+         case COMPRESS_LZ4: {
+            uint32_t lz4size;
+            int lz4len;
+
+            /* The LZ4 block is preceded by its uncompressed size */
+            if (comp_len < sizeof(uint32_t)) {
+               Qmsg(jcr, M_ERROR, 0, _("LZ4 uncompression error on file %s. ERR=short block\n"),
+                    rctx.fname);
+               return false;
+            }
+            unser_begin(*data + sizeof(comp_stream_header), sizeof(uint32_t));
+            unser_uint32(lz4size);
+            if (lz4size > 0x7fffffff) {
+               Qmsg(jcr, M_ERROR, 0, _("LZ4 uncompression error on file %s. ERR=bad size %u\n"),
+                    rctx.fname, lz4size);
+               return false;
+            }
+            if ((int32_t)lz4size > rctx.decomp_buf_size) {
+               rctx.decomp_buf_size = lz4size;
+               rctx.decomp_buf = check_pool_memory_size(rctx.decomp_buf, lz4size);
+            }
+            lz4len = LZ4_decompress_safe(*data + sizeof(comp_stream_header) + sizeof(uint32_t),
+                        rctx.decomp_buf, comp_len - sizeof(uint32_t), lz4size);
+            if (lz4len < 0 || (uint32_t)lz4len != lz4size) {
+               Qmsg(jcr, M_ERROR, 0, _("LZ4 uncompression error on file %s. ERR=%d\n"),
+                    rctx.fname, lz4len);
+               return false;
+            }
+            *data = rctx.decomp_buf;
+            *length = lz4size;
+            Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", *length, edit_uint64(jcr->JobBytes, ec1));
+            return true;
+         }
 #endif
          default:
             Qmsg(jcr, M_ERROR, 0, _("Compression algorithm 0x%x found, but not supported!\n"), comp_magic);
@@ -1424,25 +1634,25 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
        * needed by the zlib routines, they should not otherwise
        * be used in Bacula.
        */
-      compress_len = jcr->compress_buf_size;
+      compress_len = rctx.decomp_buf_size;
       Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-      while ((stat=uncompress((Byte *)jcr->compress_buf, &compress_len,
+      while ((stat=uncompress((Byte *)rctx.decomp_buf, &compress_len,
                               (const Byte *)*data, (uLong)*length)) == Z_BUF_ERROR)
       {
          /*
           * The buffer size is too small, try with a bigger one
           */
-         compress_len = jcr->compress_buf_size = jcr->compress_buf_size + (jcr->compress_buf_size >> 1);
+         compress_len = rctx.decomp_buf_size = rctx.decomp_buf_size + (rctx.decomp_buf_size >> 1);
          Dmsg2(200, "Comp_len=%d msglen=%d\n", compress_len, *length);
-         jcr->compress_buf = check_pool_memory_size(jcr->compress_buf,
+         rctx.decomp_buf = check_pool_memory_size(rctx.decomp_buf,
                                                     compress_len);
       }
       if (stat != Z_OK) {
          Qmsg(jcr, M_ERROR, 0, _("Uncompression error on file %s. ERR=%s\n"),
-              jcr->last_fname, zlib_strerror(stat));
+              rctx.fname, zlib_strerror(stat));
          return false;
       }
-      *data = jcr->compress_buf;
+      *data = rctx.decomp_buf;
       *length = compress_len;
       Dmsg2(200, "Write uncompressed %d bytes, total before write=%s\n", compress_len, edit_uint64(jcr->JobBytes, ec1));
       return true;
@@ -1453,6 +1663,34 @@ bool decompress_data(JCR *jcr, int32_t stream, char **data, uint32_t *length)
    }
 }
 
+/*
+ * Allocate the decompression buffer of a restore context. The same
+ *  buffer size is used to decompress gzip, lzo, zstd and lz4, it
+ *  grows when a block does not fit.
+ */
+void init_decompress(r_ctx &rctx, int32_t buf_size)
+{
+   if (have_libz || have_lzo || have_zstd || have_lz4) {
+      rctx.decomp_buf_size = buf_size + 12 + ((buf_size+999) / 1000) + 100;
+      rctx.decomp_buf = get_memory(rctx.decomp_buf_size);
+   }
+}
+
+void term_decompress(r_ctx &rctx)
+{
+   if (rctx.decomp_buf) {
+      free_pool_memory(rctx.decomp_buf);
+      rctx.decomp_buf = NULL;
+      rctx.decomp_buf_size = 0;
+   }
+#ifdef HAVE_ZSTD
+   if (rctx.zstd_dctx) {
+      ZSTD_freeDCtx((ZSTD_DCtx *)rctx.zstd_dctx);
+      rctx.zstd_dctx = NULL;
+   }
+#endif
+}
+
 static void unser_crypto_packet_len(RESTORE_CIPHER_CTX *ctx)
 {
    unser_declare;
@@ -1463,8 +1701,9 @@ static void unser_crypto_packet_len(RESTORE_CIPHER_CTX *ctx)
    }
 }
 
-bool store_data(JCR *jcr, BFILE *bfd, char *data, const int32_t length, bool win32_decomp)
+bool store_data(r_ctx &rctx, BFILE *bfd, char *data, const int32_t length, bool win32_decomp)
 {
+   JCR *jcr = rctx.jcr;
    ssize_t wstat;
 
    if (jcr->crypto.digest) {
@@ -1474,13 +1713,13 @@ bool store_data(JCR *jcr, BFILE *bfd, char *data, const int32_t length, bool win
       if (!processWin32BackupAPIBlock(bfd, data, length)) {
          berrno be;
          Jmsg2(jcr, M_ERROR, 0, _("Write error in Win32 Block Decomposition on %s: %s\n"),
-               jcr->last_fname, be.bstrerror(bfd->berrno));
+               rctx.fname, be.bstrerror(bfd->berrno));
          return false;
       }
    } else if ((wstat=bwrite(bfd, data, length)) != (ssize_t)length) {
       berrno be;
       int type = M_ERROR;
-      int len = strlen(jcr->last_fname);
+      int len = strlen(rctx.fname);
       /*
        * If this is the first write and the "file" is a directory
        *  or a drive letter, then only issue a warning as we are
@@ -1488,8 +1727,8 @@ bool store_data(JCR *jcr, BFILE *bfd, char *data, const int32_t length, bool win
        * If the above is true and we have an error code 91
        *  (directory not empty), supress the error entirely.
        */
-      if (bfd->block == 0 && len >= 2 && (jcr->last_fname[len-1] == '/' ||
-          jcr->last_fname[len-1] == ':')) {
+      if (bfd->block == 0 && len >= 2 && (rctx.fname[len-1] == '/' ||
+          rctx.fname[len-1] == ':')) {
          type = M_WARNING;
          if (bfd->lerror == 91) {  /* Directory not empty */
             type = 0;              /* suppress error */
@@ -1504,7 +1743,7 @@ bool store_data(JCR *jcr, BFILE *bfd, char *data, const int32_t length, bool win
             /* Error */
             Jmsg6(jcr, type, 0, _("Write write error at %lld block=%d write_len=%d lerror=%d on %s: ERR=%s\n"),
                bfd->total_bytes, bfd->block, length, bfd->lerror,
-               jcr->last_fname, be.bstrerror(bfd->berrno));
+               rctx.fname, be.bstrerror(bfd->berrno));
          }
       }
 
@@ -1518,14 +1757,65 @@ bool store_data(JCR *jcr, BFILE *bfd, char *data, const int32_t length, bool win
 }
 
 /*
- * In the context of jcr, write data to bfd.
+ * Make a hole of len bytes at addr in a sparse file instead of
+ *  writing a block of zeros. The file is extended when the hole is
+ *  at its end, and what was already written there is punched out.
+ *
+ * Returns: true if done, false if the zeros must be written
+ */
+static bool sparse_hole(BFILE *bfd, uint64_t addr, uint32_t len)
+{
+#ifndef HAVE_WIN32
+   struct stat statp;
+   uint64_t end = addr + len;
+
+   if (bfd->cmd_plugin || fstat(bfd->fid, &statp) != 0 || !S_ISREG(statp.st_mode)) {
+      return false;
+   }
+   if ((uint64_t)statp.st_size > addr) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+      if (fallocate(bfd->fid, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, addr,
+                    MIN(end, (uint64_t)statp.st_size) - addr) != 0) {
+         return false;
+      }
+#else
+      return false;
+#endif
+   }
+   if ((uint64_t)statp.st_size < end && ftruncate(bfd->fid, end) != 0) {
+      return false;
+   }
+   return blseek(bfd, (boffset_t)end, SEEK_SET) >= 0;
+#else
+   return false;
+#endif
+}
+
+/*
+ * Add len to a byte counter of the job. The counters are shared
+ *  with the restore writers when there are some.
+ */
+static inline void add_restore_bytes(r_ctx &rctx, uint64_t *counter, uint32_t len)
+{
+   if (rctx.writer || rctx.pool) {
+      rctx.jcr->lock();
+      *counter += len;
+      rctx.jcr->unlock();
+   } else {
+      *counter += len;
+   }
+}
+
+/*
+ * In the context of rctx, write data to bfd.
  * We write buflen bytes in buf at addr. addr is updated in place.
  * The flags specify whether to use sparse files or compression.
  * Return value is the number of bytes written, or -1 on errors.
  */
-int32_t extract_data(JCR *jcr, BFILE *bfd, POOLMEM *buf, int32_t buflen,
+int32_t extract_data(r_ctx &rctx, BFILE *bfd, POOLMEM *buf, int32_t buflen,
                      uint64_t *addr, int flags, int32_t stream, RESTORE_CIPHER_CTX *cipher_ctx)
 {
+   JCR *jcr = rctx.jcr;
    char *wbuf;                 /* write buffer */
    uint32_t wsize;             /* write size */
    uint32_t rsize;             /* read size */
@@ -1533,7 +1823,7 @@ int32_t extract_data(JCR *jcr, BFILE *bfd, POOLMEM *buf, int32_t buflen,
    char ec1[50];               /* Buffer printing huge values */
 
    rsize = buflen;
-   jcr->ReadBytes += rsize;
+   add_restore_bytes(rctx, &jcr->ReadBytes, rsize);
    wsize = rsize;
    wbuf = buf;
 
@@ -1604,21 +1894,28 @@ int32_t extract_data(JCR *jcr, BFILE *bfd, POOLMEM *buf, int32_t buflen,
    }
 
    if ((flags & FO_SPARSE) || (flags & FO_OFFSETS)) {
-      if (!sparse_data(jcr, bfd, addr, &wbuf, &wsize)) {
+      if (!sparse_data(rctx, bfd, addr, &wbuf, &wsize)) {
          goto bail_out;
       }
    }
 
    if (flags & FO_COMPRESS) {
-      if (!decompress_data(jcr, stream, &wbuf, &wsize)) {
+      if (!decompress_data(rctx, stream, &wbuf, &wsize)) {
          goto bail_out;
       }
    }
 
-   if (!store_data(jcr, bfd, wbuf, wsize, (flags & FO_WIN32DECOMP) != 0)) {
+   /*
+    * The blocks of zeros of a sparse file are not sent, except the
+    *  last one that gives the size of the file. Make a hole there too.
+    */
+   if ((flags & FO_SPARSE) && is_buf_zero(wbuf, wsize) &&
+       sparse_hole(bfd, *addr, wsize)) {
+      Dmsg2(130, "Hole of %u bytes at %s\n", wsize, edit_uint64(*addr, ec1));
+   } else if (!store_data(rctx, bfd, wbuf, wsize, (flags & FO_WIN32DECOMP) != 0)) {
       goto bail_out;
    }
-   jcr->JobBytes += wsize;
+   add_restore_bytes(rctx, &jcr->JobBytes, wsize);
    *addr += wsize;
    Dmsg2(130, "Write %u bytes, JobBytes=%s\n", wsize, edit_uint64(jcr->JobBytes, ec1));
 
@@ -1649,6 +1946,25 @@ bail_out:
  */
 static bool close_previous_stream(JCR *jcr, r_ctx &rctx)
 {
+   btime_t start;
+
+   /*
+    * The file was given to a restore writer, it sets the attributes
+    * and closes the file. The delayed streams go with the file, they
+    * are restored once it comes back from the writer.
+    */
+   if (rctx.rfile) {
+      restore_pool_end_file(rctx.pool, rctx.rfile, rctx.extract, rctx.delayed_streams);
+      rctx.delayed_streams = NULL;
+      rctx.rfile = NULL;
+      rctx.extract = false;
+      free_signature(rctx);
+      free_session(rctx);
+      rctx.jcr->ff->flags = 0;
+      Dmsg0(130, "Stop extracting, file given to a restore writer.\n");
+      return true;
+   }
+
    /*
     * If extracting, it was from previous stream, so
     * close the output file and validate the signature.
@@ -1665,19 +1981,23 @@ static bool close_previous_stream(JCR *jcr, r_ctx &rctx)
          deallocate_fork_cipher(rctx);
       }
 
+      start = get_current_btime();
       if (rctx.jcr->plugin) {
          plugin_set_attributes(rctx.jcr, rctx.attr, &rctx.bfd);
       } else {
          set_attributes(rctx.jcr, rctx.attr, &rctx.bfd);
       }
       rctx.extract = false;
+      rctx.times.attributes += get_current_btime() - start;
 
       /*
        * Now perform the delayed restore of some specific data streams.
        */
-      if (!pop_delayed_data_streams(jcr, rctx)) {
+      start = get_current_btime();
+      if (!pop_delayed_data_streams(jcr, rctx.delayed_streams)) {
          return false;
       }
+      rctx.times.delayed += get_current_btime() - start;
 
       /*
        * Verify the cryptographic signature, if any
@@ -1702,13 +2022,14 @@ static bool close_previous_stream(JCR *jcr, r_ctx &rctx)
 }
 
 /*
- * In the context of jcr, flush any remaining data from the cipher context,
+ * In the context of rctx, flush any remaining data from the cipher context,
  * writing it to bfd.
  * Return value is true on success, false on failure.
  */
-bool flush_cipher(JCR *jcr, BFILE *bfd, uint64_t *addr, int flags, int32_t stream,
+bool flush_cipher(r_ctx &rctx, BFILE *bfd, uint64_t *addr, int flags, int32_t stream,
                   RESTORE_CIPHER_CTX *cipher_ctx)
 {
+   JCR *jcr = rctx.jcr;
    uint32_t decrypted_len = 0;
    char *wbuf;                        /* write buffer */
    uint32_t wsize;                    /* write size */
@@ -1728,7 +2049,7 @@ again:
        * Writing out the final, buffered block failed. Shouldn't happen.
        */
       Jmsg3(jcr, M_ERROR, 0, _("Decryption error. buf_len=%d decrypt_len=%d on file %s\n"),
-            cipher_ctx->buf_len, decrypted_len, jcr->last_fname);
+            cipher_ctx->buf_len, decrypted_len, rctx.fname);
    }
 
    Dmsg2(130, "Flush decrypt len=%d buf_len=%d\n", decrypted_len, cipher_ctx->buf_len);
@@ -1752,22 +2073,22 @@ again:
    Dmsg2(130, "Encryption writing full block, %u bytes, remaining %u bytes in buffer\n", wsize, cipher_ctx->buf_len);
 
    if ((flags & FO_SPARSE) || (flags & FO_OFFSETS)) {
-      if (!sparse_data(jcr, bfd, addr, &wbuf, &wsize)) {
+      if (!sparse_data(rctx, bfd, addr, &wbuf, &wsize)) {
          return false;
       }
    }
 
    if (flags & FO_COMPRESS) {
-      if (!decompress_data(jcr, stream, &wbuf, &wsize)) {
+      if (!decompress_data(rctx, stream, &wbuf, &wsize)) {
          return false;
       }
    }
 
    Dmsg0(130, "Call store_data\n");
-   if (!store_data(jcr, bfd, wbuf, wsize, (flags & FO_WIN32DECOMP) != 0)) {
+   if (!store_data(rctx, bfd, wbuf, wsize, (flags & FO_WIN32DECOMP) != 0)) {
       return false;
    }
-   jcr->JobBytes += wsize;
+   add_restore_bytes(rctx, &jcr->JobBytes, wsize);
    Dmsg2(130, "Flush write %u bytes, JobBytes=%s\n", wsize, edit_uint64(jcr->JobBytes, ec1));
 
    /*
@@ -1804,7 +2125,7 @@ static void deallocate_cipher(r_ctx &rctx)
     * Flush and deallocate previous stream's cipher context
     */
    if (rctx.cipher_ctx.cipher) {
-      flush_cipher(rctx.jcr, &rctx.bfd, &rctx.fileAddr, rctx.flags, rctx.comp_stream, &rctx.cipher_ctx);
+      flush_cipher(rctx, &rctx.bfd, &rctx.fileAddr, rctx.flags, rctx.comp_stream, &rctx.cipher_ctx);
       crypto_cipher_free(rctx.cipher_ctx.cipher);
       rctx.cipher_ctx.cipher = NULL;
    }
@@ -1817,7 +2138,7 @@ static void deallocate_fork_cipher(r_ctx &rctx)
     * Flush and deallocate previous stream's fork cipher context
     */
    if (rctx.fork_cipher_ctx.cipher) {
-      flush_cipher(rctx.jcr, &rctx.forkbfd, &rctx.fork_addr, rctx.fork_flags, rctx.comp_stream, &rctx.fork_cipher_ctx);
+      flush_cipher(rctx, &rctx.forkbfd, &rctx.fork_addr, rctx.fork_flags, rctx.comp_stream, &rctx.fork_cipher_ctx);
       crypto_cipher_free(rctx.fork_cipher_ctx.cipher);
       rctx.fork_cipher_ctx.cipher = NULL;
    }
@@ -32,6 +32,16 @@ struct RESTORE_CIPHER_CTX {
    int32_t packet_len;                 /* Total bytes in packet */
 };
 
+/* Time spent in each phase of a restore, in microseconds */
+struct RESTORE_TIMES {
+   btime_t receive;                    /* waiting for the records of the SD */
+   btime_t create;                     /* create_file() */
+   btime_t data;                       /* decrypt, decompress and write, or queue to a writer */
+   btime_t attributes;                 /* set_attributes() */
+   btime_t delayed;                    /* ACL and xattr streams */
+   btime_t wait;                       /* waiting for the restore writers */
+};
+
 struct r_ctx {
    JCR *jcr;
    int32_t stream;                     /* stream less new bits */
@@ -55,6 +65,21 @@ struct r_ctx {
    CRYPTO_SESSION *cs;                 /* Cryptographic session data (if any) for file */
    RESTORE_CIPHER_CTX cipher_ctx;      /* Cryptographic restore context (if any) for file */
    RESTORE_CIPHER_CTX fork_cipher_ctx; /* Cryptographic restore context (if any) for alternative stream */
+
+   const char *fname;                  /* output file name for the messages */
+   POOLMEM *decomp_buf;                /* Decompression buffer */
+   int32_t decomp_buf_size;            /* Length of decompression buffer */
+   void *zstd_dctx;                    /* zstd decompression context */
+   bool writer;                        /* set in the context of a restore writer */
+   RESTORE_POOL *pool;                 /* restore writers, if any */
+   RP_FILE *rfile;                     /* file handed to the restore writers */
+   RESTORE_TIMES times;                /* time spent in each phase */
 };
 
+/* from restore.c, also used by the restore writers */
+void init_decompress(r_ctx &rctx, int32_t buf_size);
+void term_decompress(r_ctx &rctx);
+int32_t extract_data(r_ctx &rctx, BFILE *bfd, POOLMEM *buf, int32_t buflen,
+                     uint64_t *addr, int flags, int32_t stream, RESTORE_CIPHER_CTX *cipher_ctx);
+
 #endif
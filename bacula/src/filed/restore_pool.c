@@ -0,0 +1,372 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  Bacula File Daemon  restore_pool.c  write the restored files
+ *   on several threads.
+ *
+ *  The job thread still reads every record and creates every
+ *   file, so the replace checks, the hard links and the
+ *   directories are handled in archive order as before. When a
+ *   file is opened for extraction, it is given to the writer
+ *   with the shortest queue and all its data records follow it
+ *   there. The writer closes the file and sets its attributes,
+ *   then returns it to the job thread that restores the delayed
+ *   ACL and xattr streams.
+ *
+ */
+
+#include "bacula.h"
+#include "filed.h"
+#include "restore.h"
+
+extern "C" void *restore_pool_worker(void *arg);
+
+/* Records queued per writer before the job thread has to wait */
+static const int rp_max_queued = 32;
+
+/* Write one record of a file, or close the file at the end */
+static void write_item(RP_WRITER *w, r_ctx &wctx, RP_ITEM *item)
+{
+   RP_FILE *file = item->file;
+   JCR *jcr = w->pool->jcr;
+   btime_t start = get_current_btime();
+
+   if (!file->failed && job_canceled(jcr)) {
+      file->failed = true;
+      bclose(&file->bfd);
+   }
+   wctx.fname = file->fname;
+   if (item->len >= 0) {
+      if (file->failed) {
+         return;
+      }
+      if (item->flags & FO_WIN32DECOMP) {
+         set_portable_backup(&file->bfd);
+      }
+      if (extract_data(wctx, &file->bfd, item->data, item->len, &file->fileAddr,
+                       item->flags, item->stream, NULL) < 0) {
+         file->failed = true;
+         bclose(&file->bfd);
+      }
+      w->data_time += get_current_btime() - start;
+   } else {
+      if (item->len == RP_ABORT) {
+         file->failed = true;
+      }
+      if (file->failed) {
+         bclose(&file->bfd);
+      } else {
+         set_attributes(jcr, file->attr, &file->bfd);
+      }
+      w->attr_time += get_current_btime() - start;
+   }
+}
+
+/*
+ * Writer thread: write the records of its queue in order.
+ */
+extern "C" void *restore_pool_worker(void *arg)
+{
+   RP_WRITER *w = (RP_WRITER *)arg;
+   RESTORE_POOL *pool = w->pool;
+   RP_ITEM *item;
+   r_ctx wctx;
+
+   memset(&wctx, 0, sizeof(wctx));
+   wctx.jcr = pool->jcr;
+   wctx.writer = true;
+   init_decompress(wctx, pool->buf_size);
+
+   P(pool->mutex);
+   for ( ;; ) {
+      while (!pool->quit && !w->head) {
+         pthread_cond_wait(&w->work, &pool->mutex);
+      }
+      if (!w->head) {
+         break;                       /* quit and nothing left */
+      }
+      item = w->head;
+      w->head = item->next;
+      if (!w->head) {
+         w->tail = NULL;
+      }
+      V(pool->mutex);
+
+      write_item(w, wctx, item);
+
+      P(pool->mutex);
+      if (item->len < 0) {
+         item->file->next = pool->done;
+         pool->done = item->file;
+         pool->pending--;
+      }
+      item->next = pool->free_items;
+      pool->free_items = item;
+      w->count--;
+      pthread_cond_broadcast(&pool->room);
+   }
+   V(pool->mutex);
+
+   term_decompress(wctx);
+   return NULL;
+}
+
+/*
+ * Create the pool and start the writers.
+ *  buf_size is the network buffer size of the job, it is the
+ *  initial size of the decompression buffers.
+ */
+RESTORE_POOL *new_restore_pool(JCR *jcr, int nwriters, int32_t buf_size)
+{
+   RESTORE_POOL *pool;
+   int i, stat;
+
+   pool = (RESTORE_POOL *)malloc(sizeof(RESTORE_POOL));
+   memset(pool, 0, sizeof(RESTORE_POOL));
+   pool->jcr = jcr;
+   pthread_mutex_init(&pool->mutex, NULL);
+   pthread_cond_init(&pool->room, NULL);
+   pool->buf_size = buf_size;
+   pool->max_queued = rp_max_queued;
+   pool->writers = (RP_WRITER *)malloc(nwriters * sizeof(RP_WRITER));
+   memset(pool->writers, 0, nwriters * sizeof(RP_WRITER));
+
+   /* The writers report their errors to the Director too */
+   jcr->dir_bsock->set_locking();
+
+   for (i = 0; i < nwriters; i++) {
+      RP_WRITER *w = &pool->writers[i];
+      w->pool = pool;
+      pthread_cond_init(&w->work, NULL);
+      if ((stat = pthread_create(&w->tid, NULL, restore_pool_worker, w)) != 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Cannot create restore thread: ERR=%s\n"),
+              be.bstrerror(stat));
+         pthread_cond_destroy(&w->work);
+         break;
+      }
+   }
+   pool->nwriters = i;
+   if (pool->nwriters == 0) {
+      free_restore_pool(pool);
+      return NULL;
+   }
+   Dmsg1(100, "Restore writers started threads=%d\n", pool->nwriters);
+   return pool;
+}
+
+/*
+ * Stop the writers once their queues are empty and release the
+ *  pool. The files not yet returned by restore_pool_get_done()
+ *  are released without restoring their delayed streams.
+ */
+void free_restore_pool(RESTORE_POOL *pool)
+{
+   RP_ITEM *item;
+   RP_FILE *file;
+   int i;
+
+   P(pool->mutex);
+   pool->quit = true;
+   for (i = 0; i < pool->nwriters; i++) {
+      pthread_cond_signal(&pool->writers[i].work);
+   }
+   V(pool->mutex);
+   for (i = 0; i < pool->nwriters; i++) {
+      pthread_join(pool->writers[i].tid, NULL);
+      pthread_cond_destroy(&pool->writers[i].work);
+   }
+   Dmsg1(100, "Restore writers stopped threads=%d\n", pool->nwriters);
+   while ((file = pool->done)) {
+      pool->done = file->next;
+      restore_pool_free_file(file);
+   }
+   while ((item = pool->free_items)) {
+      pool->free_items = item->next;
+      free_and_null_pool_memory(item->data);
+      free(item);
+   }
+   free(pool->writers);
+   pthread_cond_destroy(&pool->room);
+   pthread_mutex_destroy(&pool->mutex);
+   free(pool);
+}
+
+/*
+ * Take over the file opened by create_file() in bfd. The
+ *  attributes are copied, attr is reused for the next file.
+ */
+RP_FILE *restore_pool_new_file(RESTORE_POOL *pool, BFILE *bfd, ATTR *attr)
+{
+   RP_FILE *file;
+   int i, best, n;
+
+   file = (RP_FILE *)malloc(sizeof(RP_FILE));
+   memset(file, 0, sizeof(RP_FILE));
+   memcpy(&file->bfd, bfd, sizeof(BFILE));
+   binit(bfd);
+   file->attr = new_attr(pool->jcr);
+   file->attr->stream = attr->stream;
+   file->attr->data_stream = attr->data_stream;
+   file->attr->type = attr->type;
+   file->attr->file_index = attr->file_index;
+   file->attr->LinkFI = attr->LinkFI;
+   file->attr->delta_seq = attr->delta_seq;
+   file->attr->uid = attr->uid;
+   memcpy(&file->attr->statp, &attr->statp, sizeof(struct stat));
+   pm_strcpy(file->attr->attrEx, attr->attrEx);
+   pm_strcpy(file->attr->ofname, attr->ofname);
+   pm_strcpy(file->attr->olname, attr->olname);
+   /* set_attributes() clears ofname, keep the name for the delayed streams */
+   file->fname = get_pool_memory(PM_FNAME);
+   pm_strcpy(file->fname, attr->ofname);
+
+   /* Give it to the writer with the shortest queue */
+   P(pool->mutex);
+   best = pool->next;
+   for (i = 1; i < pool->nwriters; i++) {
+      n = (pool->next + i) % pool->nwriters;
+      if (pool->writers[n].count < pool->writers[best].count) {
+         best = n;
+      }
+   }
+   pool->next = (best + 1) % pool->nwriters;
+   file->writer = best;
+   pool->pending++;
+   V(pool->mutex);
+   return file;
+}
+
+/*
+ * Hand a record of file to its writer, len is the length of the
+ *  data or RP_CLOSE/RP_ABORT at the end of the file. The job thread
+ *  waits when the queue of the writer is full.
+ */
+void restore_pool_write(RESTORE_POOL *pool, RP_FILE *file, char *data,
+                        int32_t len, int flags, int32_t stream)
+{
+   RP_WRITER *w = &pool->writers[file->writer];
+   RP_ITEM *item;
+
+   P(pool->mutex);
+   if (w->count >= pool->max_queued) {
+      btime_t start = get_current_btime();
+      while (w->count >= pool->max_queued) {
+         pthread_cond_wait(&pool->room, &pool->mutex);
+      }
+      pool->wait_time += get_current_btime() - start;
+   }
+   if ((item = pool->free_items)) {
+      pool->free_items = item->next;
+   }
+   w->count++;
+   V(pool->mutex);
+
+   if (!item) {
+      item = (RP_ITEM *)malloc(sizeof(RP_ITEM));
+      item->data = get_pool_memory(PM_MESSAGE);
+   }
+   item->next = NULL;
+   item->file = file;
+   item->len = len;
+   item->flags = flags;
+   item->stream = stream;
+   if (len > 0) {
+      item->data = check_pool_memory_size(item->data, len);
+      memcpy(item->data, data, len);
+   }
+
+   P(pool->mutex);
+   if (w->tail) {
+      w->tail->next = item;
+   } else {
+      w->head = item;
+   }
+   w->tail = item;
+   pthread_cond_signal(&w->work);
+   V(pool->mutex);
+}
+
+/*
+ * No more data for file. The writer sets the attributes and closes
+ *  it, or only closes it if ok is false. The delayed streams are
+ *  restored by the job thread when the file comes back from
+ *  restore_pool_get_done().
+ */
+void restore_pool_end_file(RESTORE_POOL *pool, RP_FILE *file, bool ok,
+                           alist *delayed_streams)
+{
+   file->delayed_streams = delayed_streams;
+   restore_pool_write(pool, file, NULL, ok ? RP_CLOSE : RP_ABORT, 0, 0);
+}
+
+/*
+ * Return the list of the files closed by the writers, linked by
+ *  their next field. With wait, wait until every file is closed.
+ */
+RP_FILE *restore_pool_get_done(RESTORE_POOL *pool, bool wait)
+{
+   RP_FILE *file;
+
+   P(pool->mutex);
+   if (wait && pool->pending > 0) {
+      btime_t start = get_current_btime();
+      while (pool->pending > 0) {
+         pthread_cond_wait(&pool->room, &pool->mutex);
+      }
+      pool->wait_time += get_current_btime() - start;
+   }
+   file = pool->done;
+   pool->done = NULL;
+   V(pool->mutex);
+   return file;
+}
+
+/* Release a file returned by restore_pool_get_done() */
+void restore_pool_free_file(RP_FILE *file)
+{
+   RESTORE_DATA_STREAM *rds;
+
+   if (file->delayed_streams) {
+      foreach_alist(rds, file->delayed_streams) {
+         free(rds->content);
+      }
+      delete file->delayed_streams;
+   }
+   free_attr(file->attr);
+   free_pool_memory(file->fname);
+   free(file);
+}
+
+/*
+ * Time spent by the writers writing data and setting attributes,
+ *  summed over all the writers, and by the job thread waiting for
+ *  them.
+ */
+void restore_pool_times(RESTORE_POOL *pool, btime_t *data, btime_t *attr,
+                        btime_t *wait)
+{
+   int i;
+
+   *data = *attr = 0;
+   P(pool->mutex);
+   for (i = 0; i < pool->nwriters; i++) {
+      *data += pool->writers[i].data_time;
+      *attr += pool->writers[i].attr_time;
+   }
+   *wait = pool->wait_time;
+   V(pool->mutex);
+}
@@ -0,0 +1,87 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Restore writers used by do_restore()
+ *
+ *  The job thread reads the records from the SD and creates the
+ *  files, a pool of writer threads decompresses and writes the
+ *  file data and sets the attributes. All the records of a file
+ *  go to the same writer, in the order they were received.
+ */
+
+#ifndef __RESTORE_POOL_H
+#define __RESTORE_POOL_H
+
+struct RP_FILE;
+struct RESTORE_POOL;
+
+/* Length of the records that end a file */
+enum {
+   RP_CLOSE = -1,                      /* set the attributes and close */
+   RP_ABORT = -2                       /* extraction failed, only close */
+};
+
+/* One record of a file handed to a writer */
+struct RP_ITEM {
+   RP_ITEM *next;                      /* next record of the writer */
+   RP_FILE *file;                      /* file the record belongs to */
+   POOLMEM *data;                      /* copy of the record */
+   int32_t len;                        /* length of the record or RP_xxx */
+   int32_t stream;                     /* stream less new bits */
+   int flags;                          /* Options for extract_data() */
+};
+
+/* A file written by a writer */
+struct RP_FILE {
+   RP_FILE *next;                      /* in the list of finished files */
+   BFILE bfd;                          /* file opened by create_file() */
+   ATTR *attr;                         /* copy of the attributes */
+   POOLMEM *fname;                     /* output file name */
+   uint64_t fileAddr;                  /* file write address */
+   alist *delayed_streams;             /* ACL and xattr restored once closed */
+   int writer;                         /* index of the writer */
+   bool failed;                        /* write error, skip the rest */
+};
+
+/* Queue of one writer thread */
+struct RP_WRITER {
+   RESTORE_POOL *pool;
+   pthread_t tid;
+   pthread_cond_t work;                /* signaled when a record is queued */
+   RP_ITEM *head;                      /* records to write in order */
+   RP_ITEM *tail;
+   int count;                          /* records queued */
+   btime_t data_time;                  /* time spent writing data */
+   btime_t attr_time;                  /* time spent in set_attributes() */
+};
+
+struct RESTORE_POOL {
+   JCR *jcr;
+   pthread_mutex_t mutex;
+   pthread_cond_t room;                /* signaled when a record is written */
+   RP_WRITER *writers;
+   int nwriters;                       /* number of writers */
+   int max_queued;                     /* records queued per writer */
+   int32_t buf_size;                   /* decompression buffer size */
+   RP_ITEM *free_items;                /* records ready for reuse */
+   RP_FILE *done;                      /* files closed by the writers */
+   int pending;                        /* files not yet closed by the writers */
+   int next;                           /* first writer to look at */
+   btime_t wait_time;                  /* time the job thread waited for room */
+   bool quit;                          /* writers must terminate */
+};
+
+#endif /* __RESTORE_POOL_H */
@@ -262,10 +262,25 @@ static void  list_running_jobs_plain(STATUS_PKT *sp)
          sendit(msg.c_str(), len, sp);
       }
 
+      njcr->lock();
+      if (njcr->file_list && acc_table_size(njcr->file_list) > 0) {
+         len = Mmsg(msg, _("    Accurate files=%s bytes=%s bytes/file=%s%s\n"),
+               edit_uint64_with_commas(acc_table_size(njcr->file_list), b1),
+               edit_uint64_with_commas(acc_table_bytes(njcr->file_list), b2),
+               edit_uint64_with_commas(acc_table_bytes(njcr->file_list) /
+                                       acc_table_size(njcr->file_list), b3),
+               acc_table_spilled(njcr->file_list) ? _(" on disk") : "");
+         njcr->unlock();
+         sendit(msg.c_str(), len, sp);
+      } else {
+         njcr->unlock();
+      }
+
       found = true;
       if (njcr->store_bsock) {
-         len = Mmsg(msg, "    SDReadSeqNo=%" lld " fd=%d\n",
-             njcr->store_bsock->read_seqno, njcr->store_bsock->m_fd);
+         len = Mmsg(msg, "    SDReadSeqNo=%" lld " fd=%d SDWriteCalls/MB=%.2f\n",
+             njcr->store_bsock->read_seqno, njcr->store_bsock->m_fd,
+             njcr->store_bsock->write_calls_per_mb());
          sendit(msg.c_str(), len, sp);
       } else {
          len = Mmsg(msg, _("    SDSocket closed.\n"));
@@ -335,9 +350,22 @@ static void  list_running_jobs_api(STATUS_PKT *sp)
          sendit(msg.c_str(), len, sp);
       }
 
+      njcr->lock();
+      if (njcr->file_list && acc_table_size(njcr->file_list) > 0) {
+         len = Mmsg(msg, " AccurateFiles=%u\n AccurateBytes=%" lld "\n AccurateBytesPerFile=%" lld "\n AccurateOnDisk=%d\n",
+               acc_table_size(njcr->file_list), acc_table_bytes(njcr->file_list),
+               acc_table_bytes(njcr->file_list) / acc_table_size(njcr->file_list),
+               acc_table_spilled(njcr->file_list));
+         njcr->unlock();
+         sendit(msg.c_str(), len, sp);
+      } else {
+         njcr->unlock();
+      }
+
       if (njcr->store_bsock) {
-         len = Mmsg(msg, " SDReadSeqNo=%" lld "\n fd=%d\n",
-             njcr->store_bsock->read_seqno, njcr->store_bsock->m_fd);
+         len = Mmsg(msg, " SDReadSeqNo=%" lld "\n fd=%d\n SDWriteCallsPerMB=%.2f\n",
+             njcr->store_bsock->read_seqno, njcr->store_bsock->m_fd,
+             njcr->store_bsock->write_calls_per_mb());
          sendit(msg.c_str(), len, sp);
       } else {
          len = Mmsg(msg, _(" SDSocket=closed\n"));
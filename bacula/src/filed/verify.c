@@ -208,7 +208,7 @@ static int verify_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
     * First we initialise, then we read files, other streams and Finder Info.
     */
    if (ff_pkt->type != FT_LNKSAVED && (S_ISREG(ff_pkt->statp.st_mode) &&
-            ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512))) {
+            ff_pkt->flags & (FO_MD5|FO_SHA1|FO_SHA256|FO_SHA512|FO_XXH64))) {
       /*
        * Create our digest context. If this fails, the digest will be set to NULL
        * and not used.
@@ -228,6 +228,10 @@ static int verify_file(JCR *jcr, FF_PKT *ff_pkt, bool top_level)
       } else if (ff_pkt->flags & FO_SHA512) {
          digest = crypto_digest_new(jcr, CRYPTO_DIGEST_SHA512);
          digest_stream = STREAM_SHA512_DIGEST;
+
+      } else if (ff_pkt->flags & FO_XXH64) {
+         digest = crypto_digest_new(jcr, CRYPTO_DIGEST_XXH64);
+         digest_stream = STREAM_XXH64_DIGEST;
       }
 
       /* Did digest initialization fail? */
@@ -337,10 +341,18 @@ static int read_digest(BFILE *bfd, DIGEST *digest, JCR *jcr)
    int64_t bufsiz = (int64_t)sizeof(buf);
    FF_PKT *ff_pkt = (FF_PKT *)jcr->ff;
    uint64_t fileAddr = 0;             /* file address */
+   uint64_t holeAddr = 0;             /* end of the data extent */
 
 
    Dmsg0(50, "=== read_digest\n");
-   while ((n=bread(bfd, buf, bufsiz)) > 0) {
+   for ( ;; ) {
+      if (!sparse_skip_holes(ff_pkt, bfd, bufsiz, &fileAddr, &holeAddr)) {
+         n = -1;
+         break;
+      }
+      if ((n=bread(bfd, buf, bufsiz)) <= 0) {
+         break;
+      }
       /* Check for sparse blocks */
       if (ff_pkt->flags & FO_SPARSE) {
          bool allZeros = false;
@@ -228,6 +228,14 @@ void do_verify_volume(JCR *jcr)
          Dmsg2(20, "bfiled>bdird: SHA512 len=%d: msg=%s\n", dir->msglen, dir->msg);
          break;
 
+      case STREAM_XXH64_DIGEST:
+         bin_to_base64(digest, sizeof(digest), (char *)sd->msg, CRYPTO_DIGEST_XXH64_SIZE, true);
+         Dmsg2(400, "send inx=%d XXH64=%s\n", jcr->JobFiles, digest);
+         dir->fsend("%d %d %s *XXH64-%d*", jcr->JobFiles, STREAM_XXH64_DIGEST,
+                    digest, jcr->JobFiles);
+         Dmsg2(20, "bfiled>bdird: XXH64 len=%d: msg=%s\n", dir->msglen, dir->msg);
+         break;
+
       /*
        * Restore stream object is counted, but not restored here
        */
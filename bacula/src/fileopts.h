@@ -60,5 +60,6 @@
 #define FO_DELTA         (1<<28)      /* Delta data -- i.e. all copies returned on restore */
 #define FO_PLUGIN        (1<<29)      /* Plugin data stream -- return to plugin on restore */
 #define FO_OFFSETS       (1<<30)      /* Keep I/O file offsets */
+#define FO_XXH64         ((uint32_t)1<<31) /* Do XXH64 checksum */
 
 #endif /* __BFILEOPTSS_H */
@@ -123,6 +123,8 @@ const char *stream_to_ascii(int stream)
       return _("SHA256 digest");
    case STREAM_SHA512_DIGEST:
       return _("SHA512 digest");
+   case STREAM_XXH64_DIGEST:
+      return _("XXH64 digest");
    case STREAM_SIGNED_DIGEST:
       return _("Signed digest");
    case STREAM_ENCRYPTED_FILE_DATA:
@@ -429,7 +431,7 @@ bool is_restore_stream_supported(int stream)
    case STREAM_SPARSE_GZIP_DATA:
    case STREAM_WIN32_GZIP_DATA:
 #endif
-#ifndef HAVE_LZO
+#if !defined(HAVE_LZO) && !defined(HAVE_ZSTD) && !defined(HAVE_LZ4)
    case STREAM_COMPRESSED_DATA:
    case STREAM_SPARSE_COMPRESSED_DATA:
    case STREAM_WIN32_COMPRESSED_DATA:
@@ -448,7 +450,7 @@ bool is_restore_stream_supported(int stream)
    case STREAM_SPARSE_GZIP_DATA:
    case STREAM_WIN32_GZIP_DATA:
 #endif
-#ifdef HAVE_LZO
+#if defined(HAVE_LZO) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
    case STREAM_COMPRESSED_DATA:
    case STREAM_SPARSE_COMPRESSED_DATA:
    case STREAM_WIN32_COMPRESSED_DATA:
@@ -464,6 +466,7 @@ bool is_restore_stream_supported(int stream)
    case STREAM_PROGRAM_NAMES:
    case STREAM_PROGRAM_DATA:
    case STREAM_SHA1_DIGEST:
+   case STREAM_XXH64_DIGEST:
 #ifdef HAVE_SHA2
    case STREAM_SHA256_DIGEST:
    case STREAM_SHA512_DIGEST:
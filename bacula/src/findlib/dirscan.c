@@ -0,0 +1,373 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  dirscan.c  read the directories ahead of find_one_file()
+ *
+ *  When find_one_file() enters a directory, it hands the list of
+ *   the subdirectories it will descend into to the scanner.  The
+ *   worker threads read them (opendir/readdir and lstat of every
+ *   entry) while the walker is busy with the current directory.
+ *   The subdirectories of the most recent directory are put in
+ *   front of the queue, so the workers follow the depth-first
+ *   order of the walker.
+ *
+ *  The walker still does all the callbacks, the hard link
+ *   detection and the FileIndex assignment on the job thread, so
+ *   the result is identical to a serial walk.  If the listing
+ *   that the walker needs is not ready, the walker waits for the
+ *   worker that is reading it, or reads it itself if no worker
+ *   picked it up yet.
+ *
+ */
+
+#include "bacula.h"
+#include "find.h"
+
+extern int32_t name_max;              /* filename max length */
+
+extern "C" void *dirscan_worker(void *arg);
+
+static const int dbglvl = 450;
+
+/* Entries read ahead per worker before the workers pause */
+#define DS_CACHED_PER_THREAD 20000
+
+static DS_DIR *new_ds_dir(const char *path)
+{
+   DS_DIR *dsd = (DS_DIR *)malloc(sizeof(DS_DIR));
+   memset(dsd, 0, sizeof(DS_DIR));
+   dsd->path = bstrdup(path);
+   return dsd;
+}
+
+static void free_ds_dir(DS_DIR *dsd)
+{
+   free(dsd->path);
+   if (dsd->children) {
+      free(dsd->children);
+   }
+   if (dsd->entries) {
+      free(dsd->entries);
+   }
+   if (dsd->names) {
+      free_pool_memory(dsd->names);
+   }
+   free(dsd);
+}
+
+/*
+ * Read one directory and lstat() all its entries.
+ *  Called by the workers, and by the walker when it cannot wait.
+ */
+static void read_dir(DIRSCAN *ds, DS_DIR *dsd)
+{
+   DIR *directory;
+   struct dirent *entry, *result;
+   POOLMEM *fname;
+   int len, status;
+
+   errno = 0;
+   if ((directory = opendir(dsd->path)) == NULL) {
+      dsd->open_errno = errno;
+      return;
+   }
+   dsd->opened = true;
+   dsd->names = get_pool_memory(PM_FNAME);
+
+   /* Build a canonical directory name with a trailing slash */
+   fname = get_pool_memory(PM_FNAME);
+   pm_strcpy(fname, dsd->path);
+   len = strlen(fname);
+   while (len >= 1 && IsPathSeparator(fname[len - 1])) {
+      len--;
+   }
+   fname[len++] = '/';
+   fname[len] = 0;
+
+   entry = (struct dirent *)malloc(sizeof(struct dirent) + name_max + 100);
+   for ( ; !job_canceled(ds->jcr); ) {
+      DS_ENTRY *e;
+      char *p;
+      int nlen;
+
+      status = readdir_r(directory, entry, &result);
+      if (status != 0 || result == NULL) {
+         break;
+      }
+      p = entry->d_name;
+      /* Skip `.' and `..' */
+      if (p[0] == '\0' || (p[0] == '.' && (p[1] == '\0' ||
+          (p[1] == '.' && p[2] == '\0')))) {
+         continue;
+      }
+      nlen = NAMELEN(entry);
+      if (dsd->nentries == dsd->max_entries) {
+         dsd->max_entries = dsd->max_entries ? 2 * dsd->max_entries : 64;
+         dsd->entries = (DS_ENTRY *)realloc(dsd->entries,
+                                dsd->max_entries * sizeof(DS_ENTRY));
+      }
+      e = &dsd->entries[dsd->nentries++];
+      e->name = dsd->names_len;
+      e->excluded = false;
+      dsd->names = check_pool_memory_size(dsd->names, dsd->names_len + nlen + 1);
+      memcpy(dsd->names + dsd->names_len, p, nlen);
+      dsd->names[dsd->names_len + nlen] = 0;
+      dsd->names_len += nlen + 1;
+
+      fname = check_pool_memory_size(fname, len + nlen + 1);
+      memcpy(fname + len, p, nlen + 1);
+      if (lstat(fname, &e->statp) != 0) {
+         e->stat_errno = errno;
+      } else {
+         e->stat_errno = 0;
+      }
+   }
+   closedir(directory);
+   free(entry);
+   free_pool_memory(fname);
+}
+
+/*
+ * Worker thread: read the queued directories, newest
+ *  subdirectories first.
+ */
+extern "C" void *dirscan_worker(void *arg)
+{
+   DIRSCAN *ds = (DIRSCAN *)arg;
+   DS_DIR *dsd;
+
+   P(ds->mutex);
+   for ( ;; ) {
+      while (!ds->quit && (ds->queue->empty() || ds->cached >= ds->max_cached)) {
+         pthread_cond_wait(&ds->work, &ds->mutex);
+      }
+      if (ds->quit) {
+         break;
+      }
+      dsd = (DS_DIR *)ds->queue->first();
+      ds->queue->remove(dsd);
+      dsd->state = DS_BUSY;
+      V(ds->mutex);
+
+      read_dir(ds, dsd);
+
+      P(ds->mutex);
+      ds->nb_prefetched++;
+      if (dsd->orphan) {
+         ds->nb_dropped++;
+         free_ds_dir(dsd);
+      } else {
+         dsd->state = DS_DONE;
+         ds->cached += dsd->nentries;
+         pthread_cond_broadcast(&ds->done);
+      }
+   }
+   V(ds->mutex);
+   return NULL;
+}
+
+/*
+ * Start the scanner threads
+ */
+DIRSCAN *new_dirscan(JCR *jcr, int nthreads)
+{
+   DIRSCAN *ds;
+   DS_DIR *dsd = NULL;
+   int i, stat;
+
+   ds = (DIRSCAN *)malloc(sizeof(DIRSCAN));
+   memset(ds, 0, sizeof(DIRSCAN));
+   ds->jcr = jcr;
+   pthread_mutex_init(&ds->mutex, NULL);
+   pthread_cond_init(&ds->work, NULL);
+   pthread_cond_init(&ds->done, NULL);
+   ds->queue = New(dlist(dsd, &dsd->link));
+   ds->max_cached = (int64_t)nthreads * DS_CACHED_PER_THREAD;
+   ds->threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+   for (i = 0; i < nthreads; i++) {
+      if ((stat = pthread_create(&ds->threads[i], NULL, dirscan_worker, ds)) != 0) {
+         berrno be;
+         Jmsg(jcr, M_WARNING, 0, _("Cannot create directory scan thread: ERR=%s\n"),
+              be.bstrerror(stat));
+         break;
+      }
+   }
+   ds->nthreads = i;
+   if (ds->nthreads == 0) {
+      free_dirscan(ds);
+      return NULL;
+   }
+   Dmsg1(dbglvl, "Directory scanner started threads=%d\n", ds->nthreads);
+   return ds;
+}
+
+/*
+ * Stop the scanner threads.  The walker must have released
+ *  all its listings.
+ */
+void free_dirscan(DIRSCAN *ds)
+{
+   DS_DIR *dsd;
+   int i;
+
+   P(ds->mutex);
+   ds->quit = true;
+   pthread_cond_broadcast(&ds->work);
+   V(ds->mutex);
+   for (i = 0; i < ds->nthreads; i++) {
+      pthread_join(ds->threads[i], NULL);
+   }
+   Dmsg5(dbglvl, "Directory scanner stopped threads=%d prefetched=%lld "
+         "waited=%lld inline=%lld dropped=%lld\n", ds->nthreads,
+         ds->nb_prefetched, ds->nb_waited, ds->nb_inline, ds->nb_dropped);
+   while ((dsd = (DS_DIR *)ds->queue->first())) {
+      ds->queue->remove(dsd);
+      free_ds_dir(dsd);
+   }
+   delete ds->queue;
+   free(ds->threads);
+   pthread_cond_destroy(&ds->work);
+   pthread_cond_destroy(&ds->done);
+   pthread_mutex_destroy(&ds->mutex);
+   free(ds);
+}
+
+/*
+ * Forget a subdirectory that the walker did not descend into.
+ *  Called with the mutex locked.
+ */
+static void drop_child(DIRSCAN *ds, DS_DIR *dsd)
+{
+   switch (dsd->state) {
+   case DS_QUEUED:
+      ds->queue->remove(dsd);
+      free_ds_dir(dsd);
+      break;
+   case DS_BUSY:
+      dsd->orphan = true;             /* the worker will free it */
+      break;
+   case DS_DONE:
+      ds->cached -= dsd->nentries;
+      ds->nb_dropped++;
+      free_ds_dir(dsd);
+      pthread_cond_broadcast(&ds->work);
+      break;
+   }
+}
+
+/*
+ * Get the listing of the directory path that the walker is
+ *  entering.  If it is a subdirectory queued by the current
+ *  listing, use the worker's result, otherwise read it now.
+ */
+DS_DIR *dirscan_get(DIRSCAN *ds, const char *path)
+{
+   DS_DIR *dsd = NULL, *cur = ds->cur;
+   bool ready = false;
+   int i;
+
+   if (cur) {
+      for (i = cur->next_child; i < cur->nchildren; i++) {
+         if (strcmp(cur->children[i]->path, path) == 0) {
+            break;
+         }
+      }
+      if (i < cur->nchildren) {
+         P(ds->mutex);
+         /* The subdirectories we passed were not wanted */
+         for ( ; cur->next_child < i; cur->next_child++) {
+            drop_child(ds, cur->children[cur->next_child]);
+         }
+         dsd = cur->children[cur->next_child++];
+         if (dsd->state == DS_QUEUED) {
+            ds->queue->remove(dsd);     /* no worker took it, read it below */
+         } else {
+            if (dsd->state == DS_BUSY) {
+               ds->nb_waited++;
+               while (dsd->state != DS_DONE) {
+                  pthread_cond_wait(&ds->done, &ds->mutex);
+               }
+            }
+            ds->cached -= dsd->nentries;
+            pthread_cond_broadcast(&ds->work);
+            ready = true;
+         }
+         dsd->state = DS_TAKEN;
+         V(ds->mutex);
+      }
+   }
+   if (!dsd) {
+      dsd = new_ds_dir(path);
+      dsd->state = DS_TAKEN;
+   }
+   if (!ready) {
+      ds->nb_inline++;
+      read_dir(ds, dsd);
+   }
+   dsd->parent = cur;
+   ds->cur = dsd;
+   return dsd;
+}
+
+/*
+ * Remember a subdirectory of dsd that the walker will probably
+ *  descend into.  The directories are queued by dirscan_start().
+ */
+void dirscan_add_child(DIRSCAN *ds, DS_DIR *dsd, const char *path)
+{
+   if (dsd->nchildren % 64 == 0) {
+      dsd->children = (DS_DIR **)realloc(dsd->children,
+                            (dsd->nchildren + 64) * sizeof(DS_DIR *));
+   }
+   dsd->children[dsd->nchildren++] = new_ds_dir(path);
+}
+
+/*
+ * Queue the subdirectories of dsd in front of the older ones,
+ *  keeping the readdir() order among them.
+ */
+void dirscan_start(DIRSCAN *ds, DS_DIR *dsd)
+{
+   int i;
+
+   if (dsd->nchildren == 0) {
+      return;
+   }
+   P(ds->mutex);
+   for (i = dsd->nchildren - 1; i >= 0; i--) {
+      dsd->children[i]->state = DS_QUEUED;
+      ds->queue->prepend(dsd->children[i]);
+   }
+   pthread_cond_broadcast(&ds->work);
+   V(ds->mutex);
+}
+
+/*
+ * The walker is done with dsd, forget the subdirectories that
+ *  were not visited and go back to the parent listing.
+ */
+void dirscan_release(DIRSCAN *ds, DS_DIR *dsd)
+{
+   if (dsd->next_child < dsd->nchildren) {
+      P(ds->mutex);
+      for ( ; dsd->next_child < dsd->nchildren; dsd->next_child++) {
+         drop_child(ds, dsd->children[dsd->next_child]);
+      }
+      V(ds->mutex);
+   }
+   ds->cur = dsd->parent;
+   free_ds_dir(dsd);
+}
@@ -0,0 +1,87 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Directory scanner threads used by find_one_file()
+ *
+ *  The worker threads read the directories that the walker is
+ *  about to visit (readdir() + lstat() of every entry), so that
+ *  the metadata latency is paid in parallel.  The walker itself
+ *  stays single threaded, the files are still handed to the
+ *  callback in the same order as without the scanner.
+ */
+
+#ifndef __DIRSCAN_H
+#define __DIRSCAN_H
+
+/* State of a directory listing */
+enum {
+   DS_QUEUED = 0,                      /* waiting for a worker */
+   DS_BUSY,                            /* being read by a worker */
+   DS_DONE,                            /* read, waiting for the walker */
+   DS_TAKEN                            /* owned by the walker */
+};
+
+/* One entry of a directory listing */
+struct DS_ENTRY {
+   uint32_t name;                      /* offset of the name in DS_DIR.names */
+   int stat_errno;                     /* lstat() errno, 0 if statp is valid */
+   bool excluded;                      /* set by the walker */
+   struct stat statp;                  /* lstat() of the entry */
+};
+
+struct DS_DIR {
+   dlink link;                         /* scan queue link */
+   char *path;                         /* directory name */
+   DS_DIR *parent;                     /* listing walked before this one */
+   DS_DIR **children;                  /* subdirectories queued by the walker */
+   int nchildren;                      /* number of children */
+   int next_child;                     /* first child not yet consumed */
+   DS_ENTRY *entries;                  /* the listing */
+   int nentries;                       /* entries in the listing */
+   int max_entries;                    /* allocated entries */
+   POOLMEM *names;                     /* entry names, '\0' separated */
+   uint32_t names_len;                 /* used bytes of names */
+   int open_errno;                     /* opendir() errno */
+   bool opened;                        /* opendir() succeeded */
+   bool orphan;                        /* not wanted anymore */
+   int state;                          /* DS_xxx */
+};
+
+struct DIRSCAN {
+   JCR *jcr;
+   pthread_mutex_t mutex;
+   pthread_cond_t work;                /* signaled when a directory is queued */
+   pthread_cond_t done;                /* signaled when a directory is read */
+   pthread_t *threads;                 /* worker threads */
+   int nthreads;                       /* number of workers */
+   dlist *queue;                       /* directories to read */
+   DS_DIR *cur;                        /* listing walked by the job thread */
+   int64_t cached;                     /* entries read and not yet walked */
+   int64_t max_cached;                 /* workers pause above this */
+   uint64_t nb_prefetched;             /* directories read by a worker */
+   uint64_t nb_waited;                 /* ... that the walker had to wait for */
+   uint64_t nb_inline;                 /* directories read by the walker */
+   uint64_t nb_dropped;                /* directories read for nothing */
+   bool quit;                          /* workers must terminate */
+};
+
+/* Name of an entry of a listing */
+inline const char *ds_entry_name(DS_DIR *dsd, DS_ENTRY *entry)
+{
+   return dsd->names + entry->name;
+}
+
+#endif /* __DIRSCAN_H */
@@ -155,6 +155,31 @@ bool set_mod_own_time(JCR *jcr, BFILE *ofd, ATTR *attr)
    return ok;
 }
 
+#if defined(HAVE_LZO) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+/*
+ * Return true if the algorithm is built in and sends its blocks
+ *  in the STREAM_xxx_COMPRESSED_DATA streams, behind a
+ *  comp_stream_header
+ */
+static bool is_comp_header_algo(uint32_t algo)
+{
+   switch (algo) {
+#ifdef HAVE_LZO
+   case COMPRESS_LZO1X:
+#endif
+#ifdef HAVE_ZSTD
+   case COMPRESS_ZSTD:
+#endif
+#ifdef HAVE_LZ4
+   case COMPRESS_LZ4:
+#endif
+      return true;
+   default:
+      return false;
+   }
+}
+#endif
+
 /*
  * Return the data stream that will be used
  */
@@ -203,7 +228,7 @@ int select_data_stream(FF_PKT *ff_pkt)
    /**
     * Handle compression and encryption options
     */
-#if defined(HAVE_LIBZ) || defined(HAVE_LZO)
+#if defined(HAVE_LIBZ) || defined(HAVE_LZO) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
    if (ff_pkt->flags & FO_COMPRESS) {
       #ifdef HAVE_LIBZ
          if(ff_pkt->Compress_algo == COMPRESS_GZIP) {
@@ -227,8 +252,8 @@ int select_data_stream(FF_PKT *ff_pkt)
             }
          }
       #endif
-      #ifdef HAVE_LZO
-         if(ff_pkt->Compress_algo == COMPRESS_LZO1X) {
+      #if defined(HAVE_LZO) || defined(HAVE_ZSTD) || defined(HAVE_LZ4)
+         if (is_comp_header_algo(ff_pkt->Compress_algo)) {
             switch (stream) {
             case STREAM_WIN32_DATA:
                   stream = STREAM_WIN32_COMPRESSED_DATA;
@@ -547,7 +572,6 @@ int32_t decode_LinkFI(char *buf, struct stat *statp, int stat_size)
  */
 bool set_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
 {
-   mode_t old_mask;
    bool ok = true;
    boffset_t fsize;
 
@@ -557,7 +581,6 @@ bool set_attributes(JCR *jcr, ATTR *attr, BFILE *ofd)
       uid_set = true;
    }
 
-   old_mask = umask(0);
    if (is_bopen(ofd)) {
       char ec1[50], ec2[50];
       fsize = blseek(ofd, 0, SEEK_END);
@@ -618,7 +641,6 @@ bail_out:
       bclose(ofd);
    }
    pm_strcpy(attr->ofname, "*none*");
-   umask(old_mask);
    return ok;
 }
 
@@ -91,6 +91,16 @@ set_find_changed_function(FF_PKT *ff, bool check_fct(JCR *jcr, FF_PKT *ff))
    ff->check_fct = check_fct;
 }
 
+/*
+ * Read the directories ahead of the walker with nthreads
+ *  threads, 0 means the walker reads them itself.
+ */
+void
+set_find_scan_threads(FF_PKT *ff, int nthreads)
+{
+   ff->scan_threads = nthreads;
+}
+
 /*
  * For VSS we need to know which windows drives
  * are used, because we create a snapshot of all used
@@ -122,6 +132,10 @@ find_files(JCR *jcr, FF_PKT *ff, int file_save(JCR *jcr, FF_PKT *ff_pkt, bool to
    ff->file_save = file_save;
    ff->plugin_save = plugin_save;
 
+   if (ff->scan_threads > 0 && !ff->dirscan) {
+      ff->dirscan = new_dirscan(jcr, ff->scan_threads);
+   }
+
    /* This is the new way */
    findFILESET *fileset = ff->fileset;
    if (fileset) {
@@ -465,6 +479,9 @@ term_find_files(FF_PKT *ff)
    if (ff->ignoredir_fname) {
       free_pool_memory(ff->ignoredir_fname);
    }
+   if (ff->dirscan) {
+      free_dirscan(ff->dirscan);
+   }
    hard_links = term_find_one(ff);
    free(ff);
    return hard_links;
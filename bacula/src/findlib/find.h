@@ -177,6 +177,8 @@ struct FF_PKT {
    bool dereference;                  /* follow links (not implemented) */
    bool null_output_device;           /* using null output device */
    bool incremental;                  /* incremental save */
+   int scan_threads;                  /* directory scan threads, 0 = none */
+   struct DIRSCAN *dirscan;           /* directory scanner if scan_threads */
    bool no_read;                      /* Do not read this file when using Plugin */
    char VerifyOpts[20];
    char AccurateOpts[20];
@@ -210,6 +212,7 @@ struct FF_PKT {
 };
 
 
+#include "dirscan.h"
 #include "protos.h"
 
 #endif /* __FILES_H */
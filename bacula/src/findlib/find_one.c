@@ -92,6 +92,7 @@ static FF_PKT *new_dir_ff_pkt(FF_PKT *ff_pkt)
    dir_ff_pkt->fname_save = NULL;
    dir_ff_pkt->link_save = NULL;
    dir_ff_pkt->ignoredir_fname = NULL;
+   dir_ff_pkt->dirscan = NULL;
    return dir_ff_pkt;
 }
 
@@ -115,6 +116,26 @@ static void free_dir_ff_pkt(FF_PKT *dir_ff_pkt)
    free(dir_ff_pkt);
 }
 
+static int find_one_file_entry(JCR *jcr, FF_PKT *ff_pkt,
+               int handle_file(JCR *jcr, FF_PKT *ff, bool top_level),
+               char *fname, dev_t parent_device, bool top_level,
+               DS_ENTRY *ds_entry);
+
+/*
+ * Put name after the directory name of len bytes in link,
+ *  growing link if needed.
+ */
+static void set_link_name(char **link, int *link_len, int len, const char *name)
+{
+   int nlen = strlen(name);
+
+   if (nlen + len >= *link_len) {
+      *link_len = len + nlen + 1;
+      *link = (char *)brealloc(*link, *link_len + 1);
+   }
+   memcpy(*link + len, name, nlen + 1);
+}
+
 /*
  * Check to see if we allow the file system type of a file or directory.
  * If we do not have a list of file system types, we accept anything.
@@ -330,6 +351,66 @@ ff_pkt_set_link_digest(FF_PKT *ff_pkt,
    }
 }
 
+/*
+ * Walk the directory fname with the listing read by the directory
+ *  scanner.  link holds the directory name with a trailing slash
+ *  (len bytes).  Returns false with ff_errno set if the directory
+ *  cannot be opened, otherwise rtn_stat is the status of the last
+ *  file.
+ */
+static bool
+find_scanned_dir(JCR *jcr, FF_PKT *ff_pkt,
+                 int handle_file(JCR *jcr, FF_PKT *ff, bool top_level),
+                 char *fname, dev_t our_device, char **link, int len,
+                 int *link_len, int *rtn_stat)
+{
+   DIRSCAN *ds = ff_pkt->dirscan;
+   DS_DIR *dsd;
+   DS_ENTRY *entry;
+   int i;
+
+   dsd = dirscan_get(ds, fname);
+   if (!dsd->opened) {
+      ff_pkt->ff_errno = dsd->open_errno;
+      dirscan_release(ds, dsd);
+      return false;
+   }
+
+   /*
+    * Apply the exclusions, and let the scanner read the
+    *  subdirectories that we will probably descend into
+    *  while we handle the files of this one.
+    */
+   for (i = 0; i < dsd->nentries; i++) {
+      entry = &dsd->entries[i];
+      set_link_name(link, link_len, len, ds_entry_name(dsd, entry));
+      entry->excluded = file_is_excluded(ff_pkt, *link);
+      if (!entry->excluded && entry->stat_errno == 0 &&
+          S_ISDIR(entry->statp.st_mode) &&
+          !(ff_pkt->flags & FO_NO_RECURSION) &&
+          (entry->statp.st_dev == our_device || ff_pkt->flags & FO_MULTIFS)) {
+         dirscan_add_child(ds, dsd, *link);
+      }
+   }
+   dirscan_start(ds, dsd);
+
+   *rtn_stat = 1;
+   for (i = 0; i < dsd->nentries && !job_canceled(jcr); i++) {
+      entry = &dsd->entries[i];
+      if (entry->excluded) {
+         continue;
+      }
+      set_link_name(link, link_len, len, ds_entry_name(dsd, entry));
+      *rtn_stat = find_one_file_entry(jcr, ff_pkt, handle_file, *link,
+                                      our_device, false, entry);
+      if (ff_pkt->linked) {
+         ff_pkt->linked->FileIndex = ff_pkt->FileIndex;
+      }
+   }
+   dirscan_release(ds, dsd);
+   return true;
+}
+
 /*
  * Find a single file.
  * handle_file is the callback for handling the file.
@@ -342,6 +423,20 @@ int
 find_one_file(JCR *jcr, FF_PKT *ff_pkt,
                int handle_file(JCR *jcr, FF_PKT *ff, bool top_level),
                char *fname, dev_t parent_device, bool top_level)
+{
+   return find_one_file_entry(jcr, ff_pkt, handle_file, fname, parent_device,
+                              top_level, NULL);
+}
+
+/*
+ * Same as find_one_file(), but when entry is set, the lstat()
+ *  of the file was already done by the directory scanner.
+ */
+static int
+find_one_file_entry(JCR *jcr, FF_PKT *ff_pkt,
+               int handle_file(JCR *jcr, FF_PKT *ff, bool top_level),
+               char *fname, dev_t parent_device, bool top_level,
+               DS_ENTRY *ds_entry)
 {
    struct utimbuf restore_times;
    int rtn_stat;
@@ -349,7 +444,14 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
 
    ff_pkt->fname = ff_pkt->link = fname;
 
-   if (lstat(fname, &ff_pkt->statp) != 0) {
+   if (ds_entry) {
+      memcpy(&ff_pkt->statp, &ds_entry->statp, sizeof(struct stat));
+      errno = ds_entry->stat_errno;
+      rtn_stat = errno == 0 ? 0 : -1;
+   } else {
+      rtn_stat = lstat(fname, &ff_pkt->statp);
+   }
+   if (rtn_stat != 0) {
        /* Cannot stat file */
        ff_pkt->type = FT_NOSTAT;
        ff_pkt->ff_errno = errno;
@@ -665,6 +767,26 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
 
       ff_pkt->link = ff_pkt->fname;     /* reset "link" */
 
+      /*
+       * If the directory scanner is running, walk the listing
+       *   that it read for us.
+       */
+      if (ff_pkt->dirscan) {
+         bool opened = find_scanned_dir(jcr, ff_pkt, handle_file, fname,
+                          our_device, &link, len, &link_len, &rtn_stat);
+         free(link);
+         if (!opened) {
+            ff_pkt->type = FT_NOOPEN;
+            rtn_stat = handle_file(jcr, ff_pkt, top_level);
+            if (ff_pkt->linked) {
+               ff_pkt->linked->FileIndex = ff_pkt->FileIndex;
+            }
+            free_dir_ff_pkt(dir_ff_pkt);
+            return rtn_stat;
+         }
+         goto dir_done;
+      }
+
       /*
        * Descend into or "recurse" into the directory to read
        *   all the files in it.
@@ -727,6 +849,8 @@ find_one_file(JCR *jcr, FF_PKT *ff_pkt,
       free(link);
       free(entry);
 
+dir_done:
+
       /*
        * Now that we have recursed through all the files in the
        *  directory, we "save" the directory so that after all
@@ -186,6 +186,20 @@ void add_fname_to_include_list(FF_PKT *ff, int prefixed, const char *fname)
                inc->algo = COMPRESS_LZO1X;
                inc->level = 1; /* not used with LZO */
             }
+            else if (*rp == 'l') {
+               inc->options |= FO_COMPRESS;
+               inc->algo = COMPRESS_LZ4;
+               inc->level = 1; /* not used with LZ4 */
+            }
+            else if (*rp == 'z') {
+               inc->options |= FO_COMPRESS;
+               inc->algo = COMPRESS_ZSTD;
+               inc->level = 0;
+               while (B_ISDIGIT(rp[1])) {
+                  rp++;
+                  inc->level = inc->level * 10 + *rp - '0';
+               }
+            }
             Dmsg2(200, "Compression alg=%d level=%d\n", inc->algo, inc->level);
             break;
          case 'K':
@@ -33,6 +33,7 @@ int    create_file       (JCR *jcr, ATTR *attr, BFILE *ofd, int replace);
 FF_PKT *init_find_files();
 void  set_find_options(FF_PKT *ff, int incremental, time_t mtime);
 void set_find_changed_function(FF_PKT *ff, bool check_fct(JCR *jcr, FF_PKT *ff));
+void  set_find_scan_threads(FF_PKT *ff, int nthreads);
 int   find_files(JCR *jcr, FF_PKT *ff, int file_sub(JCR *, FF_PKT *ff_pkt, bool),
                  int plugin_sub(JCR *, FF_PKT *ff_pkt, bool));
 int   match_files(JCR *jcr, FF_PKT *ff, int sub(JCR *, FF_PKT *ff_pkt, bool));
@@ -41,6 +42,14 @@ int   get_win32_driveletters(FF_PKT *ff, char* szDrives);
 bool  is_in_fileset(FF_PKT *ff);
 bool accept_file(FF_PKT *ff);
 
+/* From dirscan.c */
+DIRSCAN *new_dirscan(JCR *jcr, int nthreads);
+void  free_dirscan(DIRSCAN *ds);
+DS_DIR *dirscan_get(DIRSCAN *ds, const char *path);
+void  dirscan_add_child(DIRSCAN *ds, DS_DIR *dsd, const char *path);
+void  dirscan_start(DIRSCAN *ds, DS_DIR *dsd);
+void  dirscan_release(DIRSCAN *ds, DS_DIR *dsd);
+
 /* From match.c */
 void  init_include_exclude_files(FF_PKT *ff);
 void  term_include_exclude_files(FF_PKT *ff);
@@ -144,6 +144,9 @@ struct xattr_private_data_t;
 class htable;
 struct acl_data_t;
 struct xattr_data_t;
+struct COMPRESS_PIPE;
+struct ACC_TABLE;
+struct ACC_CACHE;
 
 struct CRYPTO_CTX {
    bool pki_sign;                     /* Enable PKI Signatures? */
@@ -398,6 +401,8 @@ public:
    int32_t compress_buf_size;         /* Length of compression buffer */
    void *pZLIB_compress_workset;      /* zlib compression session data */
    void *LZO_compress_workset;        /* lzo compression session data */
+   void *ZSTD_compress_workset;       /* zstd compression context */
+   COMPRESS_PIPE *compress_pipe;      /* multi-threaded compression, if any */
    int32_t replace;                   /* Replace options */
    int32_t buf_size;                  /* length of buffer */
    FF_PKT *ff;                        /* Find Files packet */
@@ -418,7 +423,8 @@ public:
    bool VSS;                          /* VSS used by FD */
    bool got_metadata;                 /* set when found job_metatdata */
    bool multi_restore;                /* Dir can do multiple storage restore */
-   htable *file_list;                 /* Previous file list (accurate mode) */
+   ACC_TABLE *file_list;              /* Previous file list (accurate mode) */
+   ACC_CACHE *acc_cache;              /* File list of this job, kept for the next one */
    uint64_t base_size;                /* compute space saved with base job */
 #endif /* FILE_DAEMON */
 
@@ -463,6 +469,11 @@ public:
    bool Resched;                      /* Job may be rescheduled */
    bool bscan_insert_jobmedia_records; /*Bscan: needs to insert job media records */
    bool sd_client;                    /* Set if acting as client */
+   uint64_t CopyBlockBytes;           /* Copy/Migration bytes passed block by block */
+   uint64_t CopyRecordBytes;          /* Copy/Migration bytes copied record by record */
+   btime_t CopyBlockTime;             /* time spent in each mode */
+   btime_t CopyRecordTime;
+   btime_t CopyLastTime;
 
    /* Parmaters for Open Read Session */
    BSR *bsr;                          /* Bootstrap record -- has everything */
@@ -123,6 +123,27 @@ from_base64(int64_t *value, char *where)
    return i;
 }
 
+/*
+ * Convert the space separated Base 64 values in where
+ *  (an lstat packet) to at most max values.
+ *
+ * Returns the number of values.
+ */
+int
+from_base64_list(int64_t *values, int max, char *where)
+{
+   char *p = where;
+   int n = 0;
+
+   while (n < max && *p) {
+      p += from_base64(&values[n++], p);
+      if (*p == ' ') {
+         p++;
+      }
+   }
+   return n;
+}
+
 
 /*
  * Encode binary data in bin of len bytes into
@@ -28,9 +28,9 @@
  *  output buffer sufficiently long and the length of the
  *  output buffer. Generally, if the output buffer is the
  *  same size as the input buffer, it should work (at least
- *  for text).
+ *  for text).  level is the zlib compression level.
  */
-int Zdeflate(char *in, int in_len, char *out, int &out_len)
+int Zdeflate(char *in, int in_len, char *out, int &out_len, int level)
 {
 #ifdef HAVE_LIBZ
    z_stream strm;
@@ -40,7 +40,7 @@ int Zdeflate(char *in, int in_len, char *out, int &out_len)
    strm.zalloc = Z_NULL;
    strm.zfree = Z_NULL;
    strm.opaque = Z_NULL;
-   ret = deflateInit(&strm, 9);
+   ret = deflateInit(&strm, level);
    if (ret != Z_OK) {
       Dmsg0(200, "deflateInit error\n");
       (void)deflateEnd(&strm);
@@ -27,6 +27,9 @@
 #include "bacula.h"
 #include "jcr.h"
 #include <netdb.h>
+#ifndef HAVE_WIN32
+#include <sys/uio.h>
+#endif
 
 #ifndef   INADDR_NONE
 #define   INADDR_NONE    -1
@@ -187,6 +190,8 @@ int32_t write_nbytes(BSOCK * bsock, char *ptr, int32_t nbytes)
       if (nwritten <= 0) {
          return -1;                /* error */
       }
+      bsock->write_calls++;
+      bsock->write_bytes += nwritten;
       nleft -= nwritten;
       ptr += nwritten;
       if (bsock->use_bwlimit()) {
@@ -196,6 +201,66 @@ int32_t write_nbytes(BSOCK * bsock, char *ptr, int32_t nbytes)
    return nbytes - nleft;
 }
 
+#ifndef HAVE_WIN32
+/*
+ * Write the iovcnt buffers of iov to the network, usually with
+ *  a single writev().  The iov array is modified.  Not used when
+ *  spooling or with TLS, see BSOCK::send().
+ */
+int32_t writev_nbytes(BSOCK * bsock, struct iovec *iov, int iovcnt)
+{
+   int32_t nbytes = 0, nleft;
+   ssize_t nwritten;
+   int i;
+
+   for (i = 0; i < iovcnt; i++) {
+      nbytes += iov[i].iov_len;
+   }
+   nleft = nbytes;
+   while (nleft > 0) {
+      do {
+         errno = 0;
+         nwritten = writev(bsock->m_fd, iov, iovcnt);
+         if (bsock->is_timed_out() || bsock->is_terminated()) {
+            return -1;
+         }
+      } while (nwritten == -1 && errno == EINTR);
+      /* Non-blocking connection, see write_nbytes() */
+      if (nwritten == -1 && errno == EAGAIN) {
+         fd_set fdset;
+         struct timeval tv;
+
+         FD_ZERO(&fdset);
+         FD_SET((unsigned)bsock->m_fd, &fdset);
+         tv.tv_sec = 1;
+         tv.tv_usec = 0;
+         select(bsock->m_fd + 1, NULL, &fdset, NULL, &tv);
+         continue;
+      }
+      if (nwritten <= 0) {
+         return -1;                /* error */
+      }
+      bsock->write_calls++;
+      bsock->write_bytes += nwritten;
+      nleft -= nwritten;
+      if (bsock->use_bwlimit()) {
+         bsock->control_bwlimit(nwritten);
+      }
+      /* Skip what was written, for a short write */
+      while (iovcnt > 0 && (size_t)nwritten >= iov->iov_len) {
+         nwritten -= iov->iov_len;
+         iov++;
+         iovcnt--;
+      }
+      if (iovcnt > 0) {
+         iov->iov_base = (char *)iov->iov_base + nwritten;
+         iov->iov_len -= nwritten;
+      }
+   }
+   return nbytes - nleft;
+}
+#endif
+
 /*
  * Establish a TLS connection -- server side
  *  Returns: true  on success
@@ -587,6 +652,7 @@ BSOCK *dup_bsock(BSOCK *osock)
    BSOCK *bsock = (BSOCK *)malloc(sizeof(BSOCK));
    memcpy(bsock, osock, sizeof(BSOCK));
    bsock->msg = get_pool_memory(PM_BSOCK);
+   bsock->clear_batch();            /* the batch queue is not shared */
    bsock->errmsg = get_pool_memory(PM_MESSAGE);
    if (osock->who()) {
       bsock->set_who(bstrdup(osock->who()));
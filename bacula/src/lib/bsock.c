@@ -24,6 +24,9 @@
 #include "jcr.h"
 #include <netdb.h>
 #include <netinet/tcp.h>
+#ifndef HAVE_WIN32
+#include <sys/uio.h>
+#endif
 
 #ifndef ENODATA                    /* not defined on BSD systems */
 #define ENODATA EPIPE
@@ -409,8 +412,13 @@ bool BSOCK::send()
    /* send data packet */
    timer_start = watchdog_time;  /* start timer */
    clear_timed_out();
-   /* Full I/O done in one write */
-   rc = write_nbytes(this, (char *)hdr, pktsiz);
+   if ((m_batch_size > 0 || m_batch_len > 0) && !m_spool) {
+      /* Queued, or written with the queued packets */
+      rc = send_batched(hdr, pktsiz);
+   } else {
+      /* Full I/O done in one write */
+      rc = write_nbytes(this, (char *)hdr, pktsiz);
+   }
    timer_start = 0;         /* clear timer */
    if (rc != pktsiz) {
       errors++;
@@ -439,6 +447,146 @@ bool BSOCK::send()
    return ok;
 }
 
+/*
+ * Batch mode: the small packets given to send() are queued and
+ *  written together with the next packet that does not fit in
+ *  the queue, using a single writev() and without copying that
+ *  packet.  The queue is written when we wait for a reply in
+ *  recv(), and by flush(), end_batch() and close().
+ *
+ * Batch mode is not used with TLS, and is not available on Win32.
+ */
+void BSOCK::begin_batch(int32_t size)
+{
+#ifndef HAVE_WIN32
+   if (tls || size <= 0) {
+      return;
+   }
+   if (m_use_locking) P(m_mutex);
+   if (!m_batch) {
+      m_batch = get_pool_memory(PM_BSOCK);
+   }
+   m_batch = check_pool_memory_size(m_batch, size);
+   m_batch_size = size;
+   if (m_use_locking) V(m_mutex);
+#endif
+}
+
+/*
+ * Write the queued packets and leave batch mode
+ *
+ * Returns: false on failure
+ *          true  on success
+ */
+bool BSOCK::end_batch()
+{
+   bool ok;
+
+   if (m_use_locking) P(m_mutex);
+   ok = write_batch();
+   m_batch_size = 0;
+   if (m_batch) {
+      free_pool_memory(m_batch);
+      m_batch = NULL;
+   }
+   if (m_use_locking) V(m_mutex);
+   Dmsg4(DT_NETWORK|200, "%s:%s:%d write calls=%.2f per MB\n", m_who, m_host,
+         m_port, write_calls_per_mb());
+   return ok;
+}
+
+/*
+ * Write the queued packets if any
+ *
+ * Returns: false on failure
+ *          true  on success
+ */
+bool BSOCK::flush()
+{
+   bool ok;
+
+   if (m_batch_len == 0) {
+      return true;
+   }
+   if (m_use_locking) P(m_mutex);
+   ok = write_batch();
+   if (m_use_locking) V(m_mutex);
+   return ok;
+}
+
+/*
+ * Queue the packet hdr of pktsiz bytes, or write it with the
+ *  queued packets.  Called by send() with the lock held.
+ *
+ * Returns: pktsiz on success
+ *          -1 on error
+ */
+int32_t BSOCK::send_batched(int32_t *hdr, int32_t pktsiz)
+{
+#ifndef HAVE_WIN32
+   struct iovec iov[2];
+   int32_t rc, len = m_batch_len;
+   int cnt = 0;
+
+   if (m_batch_size > 0 && len + pktsiz <= m_batch_size) {
+      memcpy(m_batch + len, hdr, pktsiz);
+      m_batch_len += pktsiz;
+      return pktsiz;
+   }
+   if (len > 0) {
+      iov[cnt].iov_base = m_batch;
+      iov[cnt++].iov_len = len;
+   }
+   iov[cnt].iov_base = hdr;
+   iov[cnt++].iov_len = pktsiz;
+   m_batch_len = 0;
+   rc = writev_nbytes(this, iov, cnt);
+   if (rc != len + pktsiz) {
+      return -1;
+   }
+   return pktsiz;
+#else
+   return write_nbytes(this, (char *)hdr, pktsiz);
+#endif
+}
+
+/*
+ * Write the queued packets.  Called with the lock held.
+ */
+bool BSOCK::write_batch()
+{
+#ifndef HAVE_WIN32
+   struct iovec iov;
+   int32_t rc, len = m_batch_len;
+
+   if (len == 0) {
+      return true;
+   }
+   m_batch_len = 0;
+   iov.iov_base = m_batch;
+   iov.iov_len = len;
+   timer_start = watchdog_time;  /* start timer */
+   clear_timed_out();
+   rc = writev_nbytes(this, &iov, 1);
+   timer_start = 0;         /* clear timer */
+   if (rc != len) {
+      errors++;
+      if (errno == 0) {
+         b_errno = EIO;
+      } else {
+         b_errno = errno;
+      }
+      if (!m_suppress_error_msgs) {
+         Qmsg5(m_jcr, M_ERROR, 0,
+               _("Write error sending %d bytes to %s:%s:%d: ERR=%s\n"),
+               len, m_who, m_host, m_port, this->bstrerror());
+      }
+      return false;
+   }
+#endif
+   return true;
+}
+
 /*
  * Format and send a message
  *  Returns: false on error
@@ -498,6 +646,10 @@ int32_t BSOCK::recv()
    if (errors || is_terminated() || is_closed()) {
       return BNET_HARDEOF;
    }
+   /* The peer cannot answer what we did not send yet */
+   if (m_batch_len > 0 && !flush()) {
+      return BNET_HARDEOF;
+   }
 
    if (m_use_locking) {
       P(m_mutex);
@@ -959,6 +1111,9 @@ void BSOCK::close()
    if (bsock->is_closed()) {
       return;
    }
+   if (m_batch_len > 0 && !errors && !is_terminated()) {
+      flush();
+   }
    if (!m_duped) {
       clear_locking();
    }
@@ -1008,6 +1163,10 @@ void BSOCK::destroy()
       free_pool_memory(errmsg);
       errmsg = NULL;
    }
+   if (m_batch) {
+      free_pool_memory(m_batch);
+      m_batch = NULL;
+   }
    if (m_who) {
       free(m_who);
       m_who = NULL;
@@ -35,6 +35,8 @@ struct btimer_t;                      /* forward reference */
 class BSOCK;
 /* Effectively disable the bsock time out */
 #define BSOCK_TIMEOUT  3600 * 24 * 200;  /* default 200 days */
+/* Packets queued by send() in batch mode before a write */
+#define BSOCK_BATCH_SIZE 65536
 btimer_t *start_bsock_timer(BSOCK *bs, uint32_t wait);
 void stop_bsock_timer(btimer_t *wid);
 
@@ -46,6 +48,8 @@ class BSOCK {
  */
 public:
    uint64_t read_seqno;               /* read sequence number */
+   uint64_t write_calls;              /* write system calls on the socket */
+   uint64_t write_bytes;              /* bytes written by those calls */
    POOLMEM *msg;                      /* message pool buffer */
    POOLMEM *errmsg;                   /* edited error message */
    RES *res;                          /* Resource to which we are connected */
@@ -89,10 +93,16 @@ private:
    int64_t m_nb_bytes;                /* bytes sent/recv since the last tick */
    btime_t m_last_tick;               /* last tick used by bwlimit */
 
+   POOLMEM *m_batch;                  /* packets queued by send() in batch mode */
+   int32_t m_batch_len;               /* bytes queued in m_batch */
+   int32_t m_batch_size;              /* batch mode if > 0, queue limit */
+
    void fin_init(JCR * jcr, int sockfd, const char *who, const char *host, int port,
                struct sockaddr *lclient_addr);
    bool open(JCR *jcr, const char *name, char *host, char *service,
                int port, utime_t heart_beat, int *fatal);
+   int32_t send_batched(int32_t *hdr, int32_t pktsiz);
+   bool write_batch();
 
 public:
    /* methods -- in bsock.c */
@@ -123,6 +133,9 @@ public:
    void clear_locking();              /* in bsock.c */
    void set_source_address(dlist *src_addr_list);
    void control_bwlimit(int bytes);   /* in bsock.c */
+   void begin_batch(int32_t size=BSOCK_BATCH_SIZE); /* in bsock.c */
+   bool end_batch();                  /* in bsock.c */
+   bool flush();                      /* in bsock.c */
 
    /* Inline functions */
    void suppress_error_messages(bool flag) { m_suppress_error_msgs = flag; };
@@ -155,6 +168,11 @@ public:
    int32_t get_lastFileIndex() { return m_lastFileIndex; };
    void set_bwlimit(int64_t maxspeed) { m_bwlimit = maxspeed; };
    bool use_bwlimit() { return m_bwlimit > 0;};
+   bool is_batching() const { return m_batch_size > 0; };
+   void clear_batch() { m_batch = NULL; m_batch_len = m_batch_size = 0; };
+   /* Write system calls per MB sent, for the status output */
+   double write_calls_per_mb() const { return write_bytes ?
+          (double)write_calls * 1048576.0 / (double)write_bytes : 0.0; };
    void set_spooling() { m_spool = true; };
    void clear_spooling() { m_spool = false; };
    void set_duped() { m_duped = true; };
@@ -229,6 +247,10 @@ enum {
 
 int32_t read_nbytes(BSOCK * bsock, char *ptr, int32_t nbytes);
 int32_t write_nbytes(BSOCK * bsock, char *ptr, int32_t nbytes);
+#ifndef HAVE_WIN32
+struct iovec;
+int32_t writev_nbytes(BSOCK * bsock, struct iovec *iov, int iovcnt);
+#endif
 
 BSOCK *new_bsock();
 /*
@@ -354,9 +354,10 @@ tole(0xccb0a91fL), tole(0x740cce7aL), tole(0x66b96194L), tole(0xde0506f1L)},
 };
 
 /*
- * Calculate the PNG 32 bit CRC on a buffer
+ * Slice-by-4 table kernel, works everywhere.
+ *  crc is the running CRC register (not inverted).
  */
-uint32_t bcrc32(unsigned char*buf, int len)
+static uint32_t crc32_slice4(uint32_t crc, const uint8_t *buf, int len)
 {
 # ifdef HAVE_LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255 ] ^ (crc >> 8)
@@ -373,8 +374,8 @@ uint32_t bcrc32(unsigned char*buf, int len)
 # endif
         const uint32_t *b;
         size_t    rem_len;
-        uint32_t crc = tole(~0);
 
+        crc = tole(crc);
         /* Align it */
         if ((intptr_t)buf & 3 && len) {
                 do {
@@ -397,7 +398,223 @@ uint32_t bcrc32(unsigned char*buf, int len)
                         DO_CRC(*++p); /* use pre increment for speed */
                 } while (--len);
         }
-        return tole(crc) ^ ~0;
+        return tole(crc);
+}
+
+/*
+ * x86 kernel: fold the buffer 64 bytes at a time with carry-less
+ *  multiplications (PCLMULQDQ), then Barrett reduce to 32 bits.
+ *  See "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ *  Instruction", Intel, 2009.  The constants are the bit-reflected
+ *  ones for the PNG polynomial 0xedb88320.
+ *
+ *  Note, the SSE4.2 crc32 instruction computes the Castagnoli CRC,
+ *  not this one, so it cannot be used here.
+ */
+#if defined(HAVE_LITTLE_ENDIAN) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32_PCLMUL
+#include <immintrin.h>
+
+static const uint64_t crc_k1k2[2] __attribute__((aligned(16))) =
+   { 0x0154442bd4ULL, 0x01c6e41596ULL };
+static const uint64_t crc_k3k4[2] __attribute__((aligned(16))) =
+   { 0x01751997d0ULL, 0x00ccaa009eULL };
+static const uint64_t crc_k5k0[2] __attribute__((aligned(16))) =
+   { 0x0163cd6124ULL, 0x0000000000ULL };
+static const uint64_t crc_poly[2] __attribute__((aligned(16))) =
+   { 0x01db710641ULL, 0x01f7011641ULL };
+
+/* len must be a multiple of 16 and at least 64 */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t crc, const uint8_t *buf, int len)
+{
+   __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+   x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+   x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+   x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+   x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+   x0 = _mm_load_si128((const __m128i *)crc_k1k2);
+   buf += 64;
+   len -= 64;
+
+   /* Fold 4 x 128 bits in parallel */
+   while (len >= 64) {
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+      y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+      y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+      y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+      y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+      buf += 64;
+      len -= 64;
+   }
+
+   /* Fold the 4 registers into one */
+   x0 = _mm_load_si128((const __m128i *)crc_k3k4);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+   x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+   /* Remaining 16 byte blocks */
+   while (len >= 16) {
+      x2 = _mm_loadu_si128((const __m128i *)buf);
+      x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+      buf += 16;
+      len -= 16;
+   }
+
+   /* 128 bits to 64 bits */
+   x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+   x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+   x1 = _mm_srli_si128(x1, 8);
+   x1 = _mm_xor_si128(x1, x2);
+   x0 = _mm_loadl_epi64((const __m128i *)crc_k5k0);
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_and_si128(x1, x3);
+   x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   /* Barrett reduction to 32 bits */
+   x0 = _mm_load_si128((const __m128i *)crc_poly);
+   x2 = _mm_and_si128(x1, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+   x2 = _mm_and_si128(x2, x3);
+   x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+   return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *buf, int len)
+{
+   if (len >= 64) {
+      int n = len & ~15;
+      crc = crc32_pclmul_fold(crc, buf, n);
+      buf += n;
+      len -= n;
+   }
+   return crc32_slice4(crc, buf, len);
+}
+
+static bool crc32_pclmul_supported()
+{
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+/*
+ * ARMv8 kernel: the optional CRC32 instructions implement the
+ *  PNG polynomial directly, 8 bytes per instruction.
+ */
+#if defined(HAVE_LITTLE_ENDIAN) && defined(__GNUC__) && \
+    defined(__aarch64__) && defined(HAVE_LINUX_OS)
+#define HAVE_CRC32_ARMV8
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+__attribute__((target("+crc")))
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *buf, int len)
+{
+   while (len > 0 && ((intptr_t)buf & 7)) {
+      crc = __crc32b(crc, *buf++);
+      len--;
+   }
+   while (len >= 32) {
+      crc = __crc32d(crc, *(const uint64_t *)(buf));
+      crc = __crc32d(crc, *(const uint64_t *)(buf + 8));
+      crc = __crc32d(crc, *(const uint64_t *)(buf + 16));
+      crc = __crc32d(crc, *(const uint64_t *)(buf + 24));
+      buf += 32;
+      len -= 32;
+   }
+   while (len >= 8) {
+      crc = __crc32d(crc, *(const uint64_t *)buf);
+      buf += 8;
+      len -= 8;
+   }
+   while (len > 0) {
+      crc = __crc32b(crc, *buf++);
+      len--;
+   }
+   return crc;
+}
+
+static bool crc32_armv8_supported()
+{
+   return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#endif
+
+typedef uint32_t (crc32_kernel_t)(uint32_t crc, const uint8_t *buf, int len);
+
+/*
+ * All the kernels built in, the first supported one in this
+ *  list is used.
+ */
+static struct {
+   const char *name;
+   crc32_kernel_t *fct;
+   bool (*supported)();
+} crc32_kernels[] = {
+#ifdef HAVE_CRC32_PCLMUL
+   { "pclmul", crc32_pclmul, crc32_pclmul_supported },
+#endif
+#ifdef HAVE_CRC32_ARMV8
+   { "armv8",  crc32_armv8,  crc32_armv8_supported },
+#endif
+   { "slice4", crc32_slice4, NULL },
+   { NULL, NULL, NULL }
+};
+
+static crc32_kernel_t *crc32_kernel = NULL;
+
+/* Pick the fastest kernel that this CPU can run */
+static crc32_kernel_t *crc32_select_kernel()
+{
+   int i;
+
+   for (i = 0; crc32_kernels[i].name; i++) {
+      if (!crc32_kernels[i].supported || crc32_kernels[i].supported()) {
+         Dmsg1(100, "Using the %s CRC32 kernel\n", crc32_kernels[i].name);
+         return crc32_kernels[i].fct;
+      }
+   }
+   return crc32_slice4;
+}
+
+/*
+ * Calculate the PNG 32 bit CRC on a buffer
+ */
+uint32_t bcrc32(unsigned char*buf, int len)
+{
+   if (!crc32_kernel) {
+      crc32_kernel = crc32_select_kernel();
+   }
+   return crc32_kernel(~0, buf, len) ^ ~0;
 }
 
 
@@ -408,12 +625,95 @@ static void usage()
    fprintf(stderr,
 "\n"
 "Usage: crc32 <data-file>\n"
+"       crc32 -b [<MB per size>]  benchmark the CRC32 kernels\n"
+"       crc32 -t          check the kernels against each other\n"
 "       -?          print this message.\n"
 "\n\n");
 
    exit(1);
 }
 
+/*
+ * Compare every kernel supported by this CPU with the table
+ *  kernel for all the lengths and alignments of small buffers
+ *  and for a few large ones.
+ */
+static int check_kernels()
+{
+   int i, len, off, kerrors, errors = 0;
+   int maxlen = 4 * 1024 * 1024 + 64;
+   uint8_t *buf = (uint8_t *)malloc(maxlen + 16);
+
+   for (i = 0; i < maxlen + 16; i++) {
+      buf[i] = (uint8_t)(random() >> 8);
+   }
+   for (i = 0; crc32_kernels[i].name; i++) {
+      if (crc32_kernels[i].supported && !crc32_kernels[i].supported()) {
+         printf("%-8s not supported by this CPU\n", crc32_kernels[i].name);
+         continue;
+      }
+      kerrors = 0;
+      for (len = 0; len < maxlen; len = len < 1024 ? len + 1 : len * 2 + 13) {
+         for (off = 0; off < 16; off++) {
+            uint32_t ref = crc32_slice4(~0, buf + off, len) ^ ~0;
+            uint32_t crc = crc32_kernels[i].fct(~0, buf + off, len) ^ ~0;
+            if (crc != ref) {
+               printf("%-8s len=%d off=%d crc=%08x expected %08x\n",
+                      crc32_kernels[i].name, len, off, crc, ref);
+               kerrors++;
+            }
+         }
+      }
+      printf("%-8s %s\n", crc32_kernels[i].name, kerrors ? "FAILED" : "OK");
+      errors += kerrors;
+   }
+   /* "123456789" is the standard check value of this CRC */
+   if (bcrc32((uint8_t *)"123456789", 9) != 0xcbf43926) {
+      printf("bcrc32 check value FAILED\n");
+      errors++;
+   }
+   free(buf);
+   return errors ? 1 : 0;
+}
+
+/*
+ * Run each kernel on blocks of 64KB to 16MB, mb MB per block size
+ */
+static int bench_kernels(int mb)
+{
+   static const int sizes[] = { 64 * 1024, 256 * 1024, 1024 * 1024,
+                                4 * 1024 * 1024, 16 * 1024 * 1024, 0 };
+   int i, j, n, loops;
+   uint8_t *buf = (uint8_t *)malloc(sizes[4]);
+   btime_t start, end;
+   uint32_t crc = 0;
+
+   for (i = 0; i < sizes[4]; i++) {
+      buf[i] = (uint8_t)(random() >> 8);
+   }
+   printf("%-8s %10s %10s\n", "kernel", "block", "MB/s");
+   for (i = 0; crc32_kernels[i].name; i++) {
+      if (crc32_kernels[i].supported && !crc32_kernels[i].supported()) {
+         continue;
+      }
+      for (j = 0; sizes[j]; j++) {
+         loops = (int)(((int64_t)mb * 1024 * 1024) / sizes[j]);
+         if (loops < 1) {
+            loops = 1;
+         }
+         start = get_current_btime();
+         for (n = 0; n < loops; n++) {
+            crc ^= crc32_kernels[i].fct(~0, buf, sizes[j]);
+         }
+         end = get_current_btime();
+         printf("%-8s %9dK %10.0f\n", crc32_kernels[i].name, sizes[j] / 1024,
+                end > start ? ((double)loops * sizes[j]) / (end - start) : 0.0);
+      }
+   }
+   free(buf);
+   return crc == 0x12345678;          /* keep the loops */
+}
+
 /*
  * Reads a single ASCII file and prints the HEX md5 sum.
  */
@@ -423,9 +723,16 @@ int main(int argc, char *argv[])
    FILE *fd;
    char buf[5000];
    int ch;
+   bool bench = false, check = false;
 
-   while ((ch = getopt(argc, argv, "h?")) != -1) {
+   while ((ch = getopt(argc, argv, "bth?")) != -1) {
       switch (ch) {
+      case 'b':
+         bench = true;
+         break;
+      case 't':
+         check = true;
+         break;
       case 'h':
       case '?':
       default:
@@ -436,6 +743,12 @@ int main(int argc, char *argv[])
    argc -= optind;
    argv += optind;
 
+   if (check) {
+      return check_kernels();
+   }
+   if (bench) {
+      return bench_kernels(argc > 0 ? atoi(argv[0]) : 256);
+   }
    if (argc < 1) {
       printf("Must have filename\n");
       exit(1);
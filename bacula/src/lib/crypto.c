@@ -271,6 +271,7 @@ struct Digest {
    crypto_digest_t type;
    JCR *jcr;
    EVP_MD_CTX ctx;
+   XXH64Context xxh64;                /* OpenSSL has no XXH64 */
 };
 
 /* Message Signature Structure */
@@ -599,6 +600,9 @@ DIGEST *crypto_digest_new(JCR *jcr, crypto_digest_t type)
 
    /* Determine the correct OpenSSL message digest type */
    switch (type) {
+   case CRYPTO_DIGEST_XXH64:
+      XXH64Init(&digest->xxh64, 0);
+      return digest;
    case CRYPTO_DIGEST_MD5:
       md = EVP_md5();
       break;
@@ -640,6 +644,10 @@ err:
  */
 bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
 {
+   if (digest->type == CRYPTO_DIGEST_XXH64) {
+      XXH64Update(&digest->xxh64, data, length);
+      return true;
+   }
    if (EVP_DigestUpdate(&digest->ctx, data, length) == 0) {
       Dmsg0(150, "digest update failed\n");
       openssl_post_errors(digest->jcr, M_ERROR, _("OpenSSL digest update failed"));
@@ -658,6 +666,12 @@ bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
  */
 bool crypto_digest_finalize(DIGEST *digest, uint8_t *dest, uint32_t *length)
 {
+   if (digest->type == CRYPTO_DIGEST_XXH64) {
+      assert(*length >= CRYPTO_DIGEST_XXH64_SIZE);
+      *length = CRYPTO_DIGEST_XXH64_SIZE;
+      XXH64Final(dest, &digest->xxh64);
+      return true;
+   }
    if (!EVP_DigestFinal(&digest->ctx, dest, (unsigned int *)length)) {
       Dmsg0(150, "digest finalize failed\n");
       openssl_post_errors(digest->jcr, M_ERROR, _("OpenSSL digest finalize failed"));
@@ -1453,6 +1467,7 @@ struct Digest {
    union {
       SHA1Context sha1;
       MD5Context md5;
+      XXH64Context xxh64;
    };
 };
 
@@ -1476,6 +1491,9 @@ DIGEST *crypto_digest_new(JCR *jcr, crypto_digest_t type)
    case CRYPTO_DIGEST_SHA1:
       SHA1Init(&digest->sha1);
       break;
+   case CRYPTO_DIGEST_XXH64:
+      XXH64Init(&digest->xxh64, 0);
+      break;
    default:
       Jmsg1(jcr, M_ERROR, 0, _("Unsupported digest type=%d specified\n"), type);
       free(digest);
@@ -1501,6 +1519,9 @@ bool crypto_digest_update(DIGEST *digest, const uint8_t *data, uint32_t length)
          return false;
       }
       break;
+   case CRYPTO_DIGEST_XXH64:
+      XXH64Update(&digest->xxh64, data, length);
+      return true;
    default:
       return false;
    }
@@ -1528,6 +1549,11 @@ bool crypto_digest_finalize(DIGEST *digest, uint8_t *dest, uint32_t *length)
          return false;
       }
       break;
+   case CRYPTO_DIGEST_XXH64:
+      assert(*length >= CRYPTO_DIGEST_XXH64_SIZE);
+      *length = CRYPTO_DIGEST_XXH64_SIZE;
+      XXH64Final(dest, &digest->xxh64);
+      return true;
    default:
       return false;
    }
@@ -1605,6 +1631,8 @@ const char *crypto_digest_name(DIGEST *digest)
       return "SHA256";
    case CRYPTO_DIGEST_SHA512:
       return "SHA512";
+   case CRYPTO_DIGEST_XXH64:
+      return "XXH64";
    case CRYPTO_DIGEST_NONE:
       return "None";
    default:
@@ -1628,6 +1656,8 @@ crypto_digest_t crypto_digest_stream_type(int stream)
       return CRYPTO_DIGEST_SHA256;
    case STREAM_SHA512_DIGEST:
       return CRYPTO_DIGEST_SHA512;
+   case STREAM_XXH64_DIGEST:
+      return CRYPTO_DIGEST_XXH64;
    default:
       return CRYPTO_DIGEST_NONE;
    }
@@ -48,6 +48,7 @@
 #endif
 #include "md5.h"
 #include "sha1.h"
+#include "xxhash.h"
 #include "tree.h"
 #include "watchdog.h"
 #include "btimers.h"
@@ -41,12 +41,23 @@
 extern "C" int malloc_trim (size_t pad);
 #endif
 
+/* Counters of a pool, also kept by each thread cache */
+struct s_pool_stats {
+   uint64_t gets;                     /* buffers requested */
+   uint64_t hits;                     /* given from a thread cache */
+   uint64_t allocs;                   /* allocated, nothing free in the pool */
+};
+
 struct s_pool_ctl {
    int32_t size;                      /* default size */
    int32_t max_allocated;             /* max allocated */
    int32_t max_used;                  /* max buffers used */
    int32_t in_use;                    /* number in use */
    struct abufhead *free_buf;         /* pointer to free buffers */
+   int32_t nfree;                     /* buffers in free_buf */
+   uint64_t refills;                  /* batches given to the thread caches */
+   uint64_t returns;                  /* batches returned by the thread caches */
+   s_pool_stats stats;                /* of the threads that are gone */
 };
 
 /* Bacula Name length plus extra */
@@ -89,6 +100,285 @@ struct abufhead {
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Thread caches
+ *
+ *  Each thread keeps the pooled buffers it frees in a small cache
+ *   of its own, and takes its buffers from there. The cache is
+ *   refilled from the free list of the pool, or gives buffers back
+ *   to it, by batches of cache_batch buffers, so the global mutex
+ *   is taken once every cache_batch calls instead of on each one.
+ *
+ *  The mutex of a cache is taken by its thread on each call, it is
+ *   only contended when the caches are drained or their statistics
+ *   are printed, so it is taken with the real lock calls to keep
+ *   the lock manager out of the fast path. The lock order is
+ *   caches_mutex, then the mutex of a cache, then the global mutex.
+ *
+ *  The in_use and statistics counters of a cache are added to the
+ *   pool when it exchanges buffers with it, so max_used is only
+ *   updated then.
+ */
+struct s_pool_cache {
+   s_pool_cache *next;                /* in the list of the caches */
+   s_pool_cache *prev;
+   pthread_mutex_t mutex;             /* see above */
+   struct abufhead *free_buf[PM_MAX+1]; /* free buffers of each pool */
+   int32_t count[PM_MAX+1];           /* buffers in free_buf */
+   int32_t in_use[PM_MAX+1];          /* given less freed, not in pool_ctl */
+   s_pool_stats stats[PM_MAX+1];      /* not yet in pool_ctl */
+};
+
+static const int32_t cache_batch = 16;          /* buffers moved at once */
+static const int32_t cache_max = 2 * cache_batch; /* buffers kept per pool */
+static const int32_t cache_max_size = 64 * 1024;  /* larger ones go to the pool */
+
+static bool use_thread_cache = true;  /* cleared only by the benchmark */
+static s_pool_cache *caches = NULL;   /* caches of the threads */
+static pthread_mutex_t caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/* Add the counters of the cache to the pool, called with both locks */
+static void fold_cache_stats(s_pool_cache *cache, int pool)
+{
+   s_pool_ctl *ctl = &pool_ctl[pool];
+   s_pool_stats *stats = &cache->stats[pool];
+
+   ctl->in_use += cache->in_use[pool];
+   if (ctl->in_use > ctl->max_used) {
+      ctl->max_used = ctl->in_use;
+   }
+   cache->in_use[pool] = 0;
+   ctl->stats.gets += stats->gets;
+   ctl->stats.hits += stats->hits;
+   ctl->stats.allocs += stats->allocs;
+   memset(stats, 0, sizeof(s_pool_stats));
+}
+
+/* Give all the buffers of the cache back, called with both locks */
+static void drain_cache(s_pool_cache *cache)
+{
+   struct abufhead *buf;
+
+   for (int pool=1; pool<=PM_MAX; pool++) {
+      while ((buf = cache->free_buf[pool])) {
+         cache->free_buf[pool] = buf->next;
+         buf->next = pool_ctl[pool].free_buf;
+         pool_ctl[pool].free_buf = buf;
+         pool_ctl[pool].nfree++;
+      }
+      cache->count[pool] = 0;
+      fold_cache_stats(cache, pool);
+   }
+}
+
+/*
+ * Called when a thread exits. The lock manager data of the thread
+ *  may already be released, so the mutexes are taken with the real
+ *  lock calls. Nobody else can use the cache once it is unlinked.
+ */
+static void release_pool_cache(void *arg)
+{
+   s_pool_cache *cache = (s_pool_cache *)arg;
+
+   real_P(caches_mutex);
+   if (cache->prev) {
+      cache->prev->next = cache->next;
+   } else {
+      caches = cache->next;
+   }
+   if (cache->next) {
+      cache->next->prev = cache->prev;
+   }
+   real_P(mutex);
+   drain_cache(cache);
+   real_V(mutex);
+   real_V(caches_mutex);
+   pthread_mutex_destroy(&cache->mutex);
+   actuallyfree(cache);
+}
+
+static void create_cache_key()
+{
+   int status = pthread_key_create(&cache_key, release_pool_cache);
+   if (status != 0) {
+      berrno be;
+      Emsg1(M_ABORT, 0, _("pthread key create failed: ERR=%s\n"),
+            be.bstrerror(status));
+   }
+}
+
+/*
+ * Return the cache of the calling thread, created on first use.
+ *  It is not known to smartalloc, the buffers it holds are.
+ */
+static s_pool_cache *get_pool_cache()
+{
+   s_pool_cache *cache;
+
+   pthread_once(&cache_key_once, create_cache_key);
+   if ((cache = (s_pool_cache *)pthread_getspecific(cache_key)) != NULL) {
+      return cache;
+   }
+   if ((cache = (s_pool_cache *)actuallymalloc(sizeof(s_pool_cache))) == NULL) {
+      Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), sizeof(s_pool_cache));
+   }
+   memset(cache, 0, sizeof(s_pool_cache));
+   pthread_mutex_init(&cache->mutex, NULL);
+   P(caches_mutex);
+   cache->next = caches;
+   if (caches) {
+      caches->prev = cache;
+   }
+   caches = cache;
+   V(caches_mutex);
+   pthread_setspecific(cache_key, cache);
+   return cache;
+}
+
+/*
+ * Take a free buffer of the pool, from the cache of the thread that
+ *  is refilled from the pool when empty.
+ *  Returns: the buffer
+ *           NULL if the pool has none, the caller allocates it
+ */
+static struct abufhead *take_free_buf(int pool)
+{
+   s_pool_ctl *ctl = &pool_ctl[pool];
+   s_pool_cache *cache;
+   struct abufhead *buf;
+   int32_t n;
+
+   if (!use_thread_cache) {
+      P(mutex);
+      ctl->stats.gets++;
+      if ((buf = ctl->free_buf)) {
+         ctl->free_buf = buf->next;
+         ctl->nfree--;
+      } else {
+         ctl->stats.allocs++;
+      }
+      ctl->in_use++;
+      if (ctl->in_use > ctl->max_used) {
+         ctl->max_used = ctl->in_use;
+      }
+      V(mutex);
+      return buf;
+   }
+
+   cache = get_pool_cache();
+   real_P(cache->mutex);
+   cache->stats[pool].gets++;
+   cache->in_use[pool]++;
+   if (cache->free_buf[pool]) {
+      cache->stats[pool].hits++;
+   } else {
+      P(mutex);
+      for (n=0; n < cache_batch && ctl->free_buf; n++) {
+         buf = ctl->free_buf;
+         ctl->free_buf = buf->next;
+         buf->next = cache->free_buf[pool];
+         cache->free_buf[pool] = buf;
+      }
+      ctl->nfree -= n;
+      cache->count[pool] += n;
+      if (n > 0) {
+         ctl->refills++;
+      } else {
+         cache->stats[pool].allocs++;
+      }
+      fold_cache_stats(cache, pool);
+      V(mutex);
+   }
+   if ((buf = cache->free_buf[pool])) {
+      cache->free_buf[pool] = buf->next;
+      cache->count[pool]--;
+   }
+   real_V(cache->mutex);
+   return buf;
+}
+
+/*
+ * Put a freed buffer in the cache of the thread. When the cache is
+ *  full, the buffers freed first go back to the pool, the last
+ *  cache_batch ones are kept.
+ */
+static void put_free_buf(struct abufhead *buf)
+{
+   int pool = buf->pool;
+   s_pool_ctl *ctl = &pool_ctl[pool];
+   s_pool_cache *cache;
+   struct abufhead *last, *next;
+   int32_t n;
+
+   if (!use_thread_cache) {
+      P(mutex);
+      ctl->in_use--;
+      buf->next = ctl->free_buf;
+      ctl->free_buf = buf;
+      ctl->nfree++;
+      V(mutex);
+      return;
+   }
+
+   cache = get_pool_cache();
+   real_P(cache->mutex);
+#if defined(DEBUG) && !defined(SMARTALLOC)
+   /* Don't let him free the same buffer twice */
+   for (next=cache->free_buf[pool]; next; next=next->next) {
+      if (next == buf) {
+         real_V(cache->mutex);
+         ASSERT(next != buf);         /* attempt to free twice */
+      }
+   }
+#endif
+   cache->in_use[pool]--;
+   if (buf->ablen > cache_max_size) {
+      /* Do not keep big buffers aside in a thread */
+      P(mutex);
+      buf->next = ctl->free_buf;
+      ctl->free_buf = buf;
+      ctl->nfree++;
+      V(mutex);
+      real_V(cache->mutex);
+      return;
+   }
+   buf->next = cache->free_buf[pool];
+   cache->free_buf[pool] = buf;
+   if (++cache->count[pool] > cache_max) {
+      last = cache->free_buf[pool];
+      for (n=1; n < cache_batch; n++) {
+         last = last->next;
+      }
+      P(mutex);
+      for (buf = last->next; buf; buf = next) {
+         next = buf->next;
+         buf->next = ctl->free_buf;
+         ctl->free_buf = buf;
+         ctl->nfree++;
+      }
+      ctl->returns++;
+      fold_cache_stats(cache, pool);
+      V(mutex);
+      last->next = NULL;
+      cache->count[pool] = cache_batch;
+   }
+   real_V(cache->mutex);
+}
+
+/* Record the size of a pool buffer that was just reallocated */
+static void set_max_allocated(int pool, int32_t size)
+{
+   if (size > pool_ctl[pool].max_allocated) {
+      P(mutex);
+      if (size > pool_ctl[pool].max_allocated) {
+         pool_ctl[pool].max_allocated = size;
+      }
+      V(mutex);
+   }
+}
+
 #ifdef SMARTALLOC
 
 #define HEAD_SIZE BALIGN(sizeof(struct abufhead))
@@ -100,31 +390,17 @@ POOLMEM *sm_get_pool_memory(const char *fname, int lineno, int pool)
    if (pool > PM_MAX) {
       Emsg2(M_ABORT, 0, _("MemPool index %d larger than max %d\n"), pool, PM_MAX);
    }
-   P(mutex);
-   if (pool_ctl[pool].free_buf) {
-      buf = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf->next;
-      pool_ctl[pool].in_use++;
-      if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-         pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-      }
-      V(mutex);
+   if ((buf = take_free_buf(pool))) {
       Dmsg3(dbglvl, "sm_get_pool_memory reuse %p to %s:%d\n", buf, fname, lineno);
       sm_new_owner(fname, lineno, (char *)buf);
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf = (struct abufhead *)sm_malloc(fname, lineno, pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   }
-   V(mutex);
    Dmsg3(dbglvl, "sm_get_pool_memory give %p to %s:%d\n", buf, fname, lineno);
    return (POOLMEM *)((char *)buf+HEAD_SIZE);
 }
@@ -164,22 +440,15 @@ POOLMEM *sm_realloc_pool_memory(const char *fname, int lineno, POOLMEM *obuf, in
 {
    char *cp = (char *)obuf;
    void *buf;
-   int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = sm_realloc(fname, lineno, cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
-   V(mutex);
+   set_max_allocated(((struct abufhead *)buf)->pool, size);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -199,32 +468,17 @@ void sm_free_pool_memory(const char *fname, int lineno, POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
    if (pool == 0) {
+      P(mutex);
+      pool_ctl[pool].in_use--;
+      V(mutex);
       free((char *)buf);              /* free nonpooled memory */
    } else {                           /* otherwise link it to the free pool chain */
-
-   /* Disabled because it hangs in #5507 */
-#ifdef xDEBUG
-      struct abufhead *next;
-      /* Don't let him free the same buffer twice */
-      for (next=pool_ctl[pool].free_buf; next; next=next->next) {
-         if (next == buf) {
-            Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            Dmsg4(dbglvl, "bad free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-            V(mutex);                 /* unblock the pool */
-            ASSERT(next != buf);      /* attempt to free twice */
-         }
-      }
-#endif
-      buf->next = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf;
+      put_free_buf(buf);
    }
-   Dmsg4(dbglvl, "free_pool_memory %p pool=%d from %s:%d\n", buf, pool, fname, lineno);
-   V(mutex);
 }
 
 #else
@@ -235,26 +489,16 @@ POOLMEM *get_pool_memory(int pool)
 {
    struct abufhead *buf;
 
-   P(mutex);
-   if (pool_ctl[pool].free_buf) {
-      buf = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf->next;
-      V(mutex);
+   if ((buf = take_free_buf(pool))) {
       return (POOLMEM *)((char *)buf+HEAD_SIZE);
    }
 
    if ((buf=malloc(pool_ctl[pool].size+HEAD_SIZE)) == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), pool_ctl[pool].size);
    }
    buf->ablen = pool_ctl[pool].size;
    buf->pool = pool;
    buf->next = NULL;
-   pool_ctl[pool].in_use++;
-   if (pool_ctl[pool].in_use > pool_ctl[pool].max_used) {
-      pool_ctl[pool].max_used = pool_ctl[pool].in_use;
-   }
-   V(mutex);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -292,22 +536,15 @@ POOLMEM *realloc_pool_memory(POOLMEM *obuf, int32_t size)
 {
    char *cp = (char *)obuf;
    void *buf;
-   int pool;
 
    ASSERT(obuf);
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = realloc(cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
-   V(mutex);
+   set_max_allocated(((struct abufhead *)buf)->pool, size);
    return (POOLMEM *)(((char *)buf)+HEAD_SIZE);
 }
 
@@ -327,28 +564,17 @@ void free_pool_memory(POOLMEM *obuf)
    int pool;
 
    ASSERT(obuf);
-   P(mutex);
    buf = (struct abufhead *)((char *)obuf - HEAD_SIZE);
    pool = buf->pool;
-   pool_ctl[pool].in_use--;
+   Dmsg2(dbglvl, "free_pool_memory %p pool=%d\n", buf, pool);
    if (pool == 0) {
+      P(mutex);
+      pool_ctl[pool].in_use--;
+      V(mutex);
       free((char *)buf);              /* free nonpooled memory */
    } else {                           /* otherwise link it to the free pool chain */
-#ifdef DEBUG
-      struct abufhead *next;
-      /* Don't let him free the same buffer twice */
-      for (next=pool_ctl[pool].free_buf; next; next=next->next) {
-         if (next == buf) {
-            V(mutex);
-            ASSERT(next != buf);  /* attempt to free twice */
-         }
-      }
-#endif
-      buf->next = pool_ctl[pool].free_buf;
-      pool_ctl[pool].free_buf = buf;
+      put_free_buf(buf);
    }
-   Dmsg2(dbglvl, "free_pool_memory %p pool=%d\n", buf, pool);
-   V(mutex);
 }
 #endif /* SMARTALLOC */
 
@@ -380,6 +606,20 @@ void garbage_collect_memory_pool()
    }
 }
 
+/* Give back the buffers kept by all the thread caches */
+static void drain_pool_caches()
+{
+   P(caches_mutex);
+   for (s_pool_cache *cache = caches; cache; cache = cache->next) {
+      real_P(cache->mutex);
+      P(mutex);
+      drain_cache(cache);
+      V(mutex);
+      real_V(cache->mutex);
+   }
+   V(caches_mutex);
+}
+
 /* Release all freed pooled memory */
 void close_memory_pool()
 {
@@ -389,6 +629,7 @@ void close_memory_pool()
    char ed1[50];
 
    sm_check(__FILE__, __LINE__, false);
+   drain_pool_caches();
    P(mutex);
    for (int i=1; i<=PM_MAX; i++) {
       buf = pool_ctl[i].free_buf;
@@ -400,13 +641,13 @@ void close_memory_pool()
          buf = next;
       }
       pool_ctl[i].free_buf = NULL;
+      pool_ctl[i].nfree = 0;
    }
+   V(mutex);
    Dmsg2(DT_MEMORY|001, "Freed mem_pool count=%d size=%s\n", count, edit_uint64_with_commas(bytes, ed1));
    if (chk_dbglvl(DT_MEMORY|1)) {
       print_memory_pool_stats();
    }
-   V(mutex);
-
 }
 
 /*
@@ -438,14 +679,43 @@ static const char *pool_name(int pool)
 }
 
 /* Print staticstics on memory pool usage
+ *  Free is the number of buffers in the pool free list, Cached
+ *  the number kept by the thread caches. Hits are the Gets served
+ *  by a thread cache, Allocs the ones that needed a new buffer.
  */
 void print_memory_pool_stats()
 {
-   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse\n");
-   for (int i=0; i<=PM_MAX; i++)
-      Pmsg4(-1, "%5s  %7d  %7d  %5d\n", pool_name(i), pool_ctl[i].max_allocated,
-         pool_ctl[i].max_used, pool_ctl[i].in_use);
+   s_pool_ctl ctl[PM_MAX+1];
+   int32_t cached[PM_MAX+1];
+   char ed1[50], ed2[50], ed3[50];
 
+   /* Take a snapshot and add the counters not yet folded by the caches */
+   P(mutex);
+   memcpy(ctl, pool_ctl, sizeof(ctl));
+   V(mutex);
+   memset(cached, 0, sizeof(cached));
+   P(caches_mutex);
+   for (s_pool_cache *cache = caches; cache; cache = cache->next) {
+      real_P(cache->mutex);
+      for (int i=0; i<=PM_MAX; i++) {
+         cached[i] += cache->count[i];
+         ctl[i].in_use += cache->in_use[i];
+         ctl[i].stats.gets += cache->stats[i].gets;
+         ctl[i].stats.hits += cache->stats[i].hits;
+         ctl[i].stats.allocs += cache->stats[i].allocs;
+      }
+      real_V(cache->mutex);
+   }
+   V(caches_mutex);
+   Pmsg0(-1, "Pool   Maxsize  Maxused  Inuse   Free  Cached          Gets          Hits        Allocs  Refills  Returns\n");
+   for (int i=0; i<=PM_MAX; i++) {
+      Pmsg11(-1, "%5s  %7d  %7d  %5d  %5d  %6d  %12s  %12s  %12s  %7lld  %7lld\n",
+         pool_name(i), ctl[i].max_allocated, ctl[i].max_used, ctl[i].in_use,
+         ctl[i].nfree, cached[i],
+         edit_uint64(ctl[i].stats.gets, ed1), edit_uint64(ctl[i].stats.hits, ed2),
+         edit_uint64(ctl[i].stats.allocs, ed3),
+         (long long)ctl[i].refills, (long long)ctl[i].returns);
+   }
    Pmsg0(-1, "\n");
 }
 
@@ -604,23 +874,16 @@ void POOL_MEM::realloc_pm(int32_t size)
 {
    char *cp = mem;
    char *buf;
-   int pool;
 
-   P(mutex);
    cp -= HEAD_SIZE;
    buf = (char *)realloc(cp, size+HEAD_SIZE);
    if (buf == NULL) {
-      V(mutex);
       Emsg1(M_ABORT, 0, _("Out of memory requesting %d bytes\n"), size);
    }
    Dmsg2(900, "Old buf=%p new buf=%p\n", cp, buf);
    ((struct abufhead *)buf)->ablen = size;
-   pool = ((struct abufhead *)buf)->pool;
-   if (size > pool_ctl[pool].max_allocated) {
-      pool_ctl[pool].max_allocated = size;
-   }
+   set_max_allocated(((struct abufhead *)buf)->pool, size);
    mem = buf+HEAD_SIZE;
-   V(mutex);
    Dmsg3(900, "Old buf=%p new buf=%p mem=%p\n", cp, buf, mem);
 }
 
@@ -648,3 +911,126 @@ int POOL_MEM::strcpy(const char *str)
    memcpy(mem, str, len);
    return len - 1;
 }
+
+#ifdef BUILD_TEST_PROGRAM
+
+/*
+ * Memory pool benchmark
+ *
+ *  Each thread takes and frees pool buffers of the usual sizes the
+ *  way the daemons do, keeping a few of them at a time. The number
+ *  of operations per second is reported for 1 to -t threads, with
+ *  and without the thread caches.
+ */
+
+static int nb_ops = 1000000;
+static int working_set = 8;
+
+static void *bench_thread(void *arg)
+{
+   static const int pools[] = {PM_FNAME, PM_MESSAGE, PM_EMSG, PM_BSOCK, PM_FNAME, PM_MESSAGE};
+   POOLMEM *bufs[working_set];
+   uint32_t seed = (uint32_t)(intptr_t)arg;
+   int i, j;
+
+   for (j = 0; j < working_set; j++) {
+      bufs[j] = get_pool_memory(pools[j % 6]);
+   }
+   for (i = 0; i < nb_ops; i++) {
+      seed = seed * 1103515245 + 12345;
+      j = (seed >> 16) % working_set;
+      free_pool_memory(bufs[j]);
+      bufs[j] = get_pool_memory(pools[(seed >> 8) % 6]);
+      *bufs[j] = 0;
+   }
+   for (j = 0; j < working_set; j++) {
+      free_pool_memory(bufs[j]);
+   }
+   return NULL;
+}
+
+static double run_bench(int nb_threads)
+{
+   pthread_t thids[nb_threads];
+   btime_t start, elapsed;
+   int i;
+
+   start = get_current_btime();
+   for (i = 0; i < nb_threads; i++) {
+      pthread_create(&thids[i], NULL, bench_thread, (void *)(intptr_t)(i + 1));
+   }
+   for (i = 0; i < nb_threads; i++) {
+      pthread_join(thids[i], NULL);
+   }
+   elapsed = get_current_btime() - start;
+   return elapsed ? (double)nb_threads * nb_ops * 1000000.0 / elapsed : 0.0;
+}
+
+static void usage()
+{
+   fprintf(stderr,
+"Usage: mem_pool_test [-n ops] [-t threads] [-s]\n"
+"       -n <nb>     get/free per thread, default 1000000\n"
+"       -t <nb>     maximum number of threads, default 64\n"
+"       -s          print the pool statistics at the end\n"
+"       -?          print this message.\n"
+"\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+   int max_threads = 64;
+   bool stats = false;
+   double global, cached;
+   int ch, n, errors = 0;
+
+   lmgr_init_thread();
+   my_name_is(argc, argv, "mem_pool_test");
+   init_msg(NULL, NULL);
+
+   while ((ch = getopt(argc, argv, "n:st:?")) != -1) {
+      switch (ch) {
+      case 'n':
+         nb_ops = MAX(atoi(optarg), 1);
+         break;
+      case 's':
+         stats = true;
+         break;
+      case 't':
+         max_threads = MAX(atoi(optarg), 1);
+         break;
+      case '?':
+      default:
+         usage();
+      }
+   }
+
+   printf("Threads  Global ops/s  Cached ops/s  Speedup\n");
+   for (n = 1; n <= max_threads; n *= 2) {
+      use_thread_cache = false;
+      global = run_bench(n);
+      use_thread_cache = true;
+      cached = run_bench(n);
+      printf("%7d  %12.0f  %12.0f  %7.2f\n", n, global, cached,
+             global > 0 ? cached / global : 0.0);
+   }
+
+   /* All the buffers must be back, whatever the threads did */
+   for (n = 0; n <= PM_MAX; n++) {
+      if (pool_ctl[n].in_use != 0) {
+         printf("ERR: pool %d has %d buffers in use\n", n, pool_ctl[n].in_use);
+         errors++;
+      }
+   }
+   if (stats) {
+      print_memory_pool_stats();
+   }
+   term_msg();
+   close_memory_pool();
+   lmgr_cleanup_main();
+   sm_dump(false);
+   return errors ? 1 : 0;
+}
+
+#endif
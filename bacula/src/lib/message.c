@@ -392,6 +392,7 @@ init_msg(JCR *jcr, MSGS *msg, job_code_callback_t job_code_callback)
    } else {
       /* If we have default values, release them now */
       if (daemon_msgs) {
+         flush_message_queue();
          free_msgs_res(daemon_msgs);
       }
       daemon_msgs = (MSGS *)malloc(sizeof(MSGS));
@@ -558,6 +559,9 @@ void close_msg(JCR *jcr)
 
    Dmsg1(580, "Close_msg jcr=%p\n", jcr);
 
+   /* The queued messages may use the jcr and the destinations */
+   flush_message_queue();
+
    if (jcr == NULL) {                /* NULL -> global chain */
       msgs = daemon_msgs;
    } else {
@@ -735,6 +739,7 @@ void free_msgs_res(MSGS *msgs)
 void term_msg()
 {
    Dmsg0(850, "Enter term_msg\n");
+   stop_message_dispatcher();         /* deliver queued messages */
    close_msg(NULL);                   /* close global chain */
    free_msgs_res(daemon_msgs);        /* free the resources */
    daemon_msgs = NULL;
@@ -795,6 +800,421 @@ static void send_to_syslog(int mode, const char *msg)
    }
 }
 
+/*
+ * Message dispatcher
+ *
+ *  Once start_message_dispatcher() is called, the destinations that
+ *   may block on I/O (files, mail, operator, syslog, console, stdout
+ *   and stderr) are written by a dispatcher thread, so a job that
+ *   generates many messages does not wait for them. The Director
+ *   and catalog destinations are still written by the calling
+ *   thread, they use the socket and the database connection of the
+ *   job.
+ *
+ *  The dispatcher takes all the queued messages at once and delivers
+ *   them in the order they were queued, flushing the console and
+ *   stdout once per batch. The queue is bounded, when it is full the
+ *   caller waits for the dispatcher, nothing is dropped. Fatal
+ *   messages, close_msg() and a new daemon message resource first
+ *   wait for all the queued messages to be delivered, see also
+ *   flush_message_queue().
+ */
+struct DISPATCH_ITEM {
+   DISPATCH_ITEM *next;
+   JCR *jcr;                          /* kept until close_msg(jcr) */
+   MSGS *msgs;
+   int type;
+   utime_t mtime;
+   int dtlen;
+   char dt[MAX_TIME_LENGTH];
+   char msg[1];
+};
+
+/* Flags telling what the dispatcher must flush after a batch */
+#define DF_CONSOLE  (1<<0)
+#define DF_STDOUT   (1<<1)
+
+static const int dispatch_queue_max = 1000;  /* messages waiting */
+
+static pthread_mutex_t dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dispatch_work = PTHREAD_COND_INITIALIZER; /* queue not empty */
+static pthread_cond_t dispatch_done = PTHREAD_COND_INITIALIZER; /* room or delivered */
+static pthread_t dispatch_tid;
+static bool dispatch_running = false;
+static bool dispatch_quit = false;
+static DISPATCH_ITEM *dispatch_head = NULL;
+static DISPATCH_ITEM *dispatch_tail = NULL;
+static int dispatch_count = 0;        /* messages in the queue */
+static uint64_t dispatch_queued = 0;  /* messages queued since start */
+static uint64_t dispatch_delivered = 0; /* messages delivered since start */
+static uint64_t dispatch_waits = 0;   /* callers that waited for room */
+
+/* Destinations written by the dispatcher thread */
+static bool is_async_dest(int dest_code)
+{
+   switch (dest_code) {
+   case MD_DIRECTOR:
+   case MD_CATALOG:
+      return false;
+   default:
+      return true;
+   }
+}
+
+/*
+ * Send the message to one destination.
+ *  In a batch, the console and stdout are flushed by the caller.
+ */
+static void send_to_dest(JCR *jcr, MSGS *msgs, DEST *d, int type, utime_t mtime,
+                         const char *dt, int dtlen, const char *msg, int *flush)
+{
+    POOLMEM *mcmd;
+    int len;
+    BPIPE *bpipe;
+    const char *mode;
+
+    switch (d->dest_code) {
+       case MD_CATALOG:
+          char ed1[50], sqldt[MAX_TIME_LENGTH];
+          if (!jcr || !jcr->db) {
+             break;
+          }
+          if (p_sql_query && p_sql_escape) {
+             POOLMEM *cmd = get_pool_memory(PM_MESSAGE);
+             POOLMEM *esc_msg = get_pool_memory(PM_MESSAGE);
+
+             int len = strlen(msg) + 1;
+             esc_msg = check_pool_memory_size(esc_msg, len * 2 + 1);
+             if (p_sql_escape(jcr, jcr->db, esc_msg, (char *)msg, len)) {
+                bstrutime(sqldt, sizeof(sqldt), mtime);
+                Mmsg(cmd, "INSERT INTO Log (JobId, Time, LogText) VALUES (%s,'%s','%s')",
+                      edit_int64(jcr->JobId, ed1), sqldt, esc_msg);
+                if (!p_sql_query(jcr, cmd)) {
+                   delivery_error(_("Msg delivery error: Unable to store data in database.\n"));
+                }
+             } else {
+                delivery_error(_("Msg delivery error: Unable to store data in database.\n"));
+             }
+
+             free_pool_memory(cmd);
+             free_pool_memory(esc_msg);
+          }
+          break;
+       case MD_CONSOLE:
+          Dmsg1(850, "CONSOLE for following msg: %s", msg);
+          if (!con_fd) {
+             con_fd = fopen(con_fname, "a+b");
+             Dmsg0(850, "Console file not open.\n");
+          }
+          if (con_fd) {
+             Pw(con_lock);      /* get write lock on console message file */
+             errno = 0;
+             if (dtlen) {
+                (void)fwrite(dt, dtlen, 1, con_fd);
+             }
+             len = strlen(msg);
+             if (len > 0) {
+                (void)fwrite(msg, len, 1, con_fd);
+                if (msg[len-1] != '\n') {
+                   (void)fwrite("\n", 2, 1, con_fd);
+                }
+             } else {
+                (void)fwrite("\n", 2, 1, con_fd);
+             }
+             if (flush) {
+                *flush |= DF_CONSOLE;
+             } else {
+                fflush(con_fd);
+             }
+             console_msg_pending = true;
+             Vw(con_lock);
+          }
+          break;
+       case MD_SYSLOG:
+          Dmsg1(850, "SYSLOG for following msg: %s\n", msg);
+          /*
+           * We really should do an openlog() here.
+           */
+          send_to_syslog(LOG_DAEMON|LOG_ERR, msg);
+          break;
+       case MD_OPERATOR:
+          Dmsg1(850, "OPERATOR for following msg: %s\n", msg);
+          mcmd = get_pool_memory(PM_MESSAGE);
+          if ((bpipe=open_mail_pipe(jcr, mcmd, d))) {
+             int stat;
+             fputs(dt, bpipe->wfd);
+             fputs(msg, bpipe->wfd);
+             /* Messages to the operator go one at a time */
+             stat = close_bpipe(bpipe);
+             if (stat != 0) {
+                berrno be;
+                be.set_errno(stat);
+                delivery_error(_("Msg delivery error: Operator mail program terminated in error.\n"
+                      "CMD=%s\n"
+                      "ERR=%s\n"), mcmd, be.bstrerror());
+             }
+          }
+          free_pool_memory(mcmd);
+          break;
+       case MD_MAIL:
+       case MD_MAIL_ON_ERROR:
+       case MD_MAIL_ON_SUCCESS:
+          Dmsg1(850, "MAIL for following msg: %s", msg);
+          if (msgs->is_closing()) {
+             break;
+          }
+          msgs->set_in_use();
+          if (!d->fd) {
+             POOLMEM *name = get_pool_memory(PM_MESSAGE);
+             make_unique_mail_filename(jcr, name, d);
+             d->fd = fopen(name, "w+b");
+             if (!d->fd) {
+                berrno be;
+                delivery_error(_("Msg delivery error: fopen %s failed: ERR=%s\n"), name,
+                      be.bstrerror());
+                free_pool_memory(name);
+                msgs->clear_in_use();
+                break;
+             }
+             d->mail_filename = name;
+          }
+          fputs(dt, d->fd);
+          len = strlen(msg) + dtlen;;
+          if (len > d->max_len) {
+             d->max_len = len;      /* keep max line length */
+          }
+          fputs(msg, d->fd);
+          msgs->clear_in_use();
+          break;
+       case MD_APPEND:
+          Dmsg1(850, "APPEND for following msg: %s", msg);
+          mode = "ab";
+          goto send_to_file;
+       case MD_FILE:
+          Dmsg1(850, "FILE for following msg: %s", msg);
+          mode = "w+b";
+send_to_file:
+          if (msgs->is_closing()) {
+             break;
+          }
+          msgs->set_in_use();
+          if (!d->fd && !open_dest_file(jcr, d, mode)) {
+             msgs->clear_in_use();
+             break;
+          }
+          fputs(dt, d->fd);
+          fputs(msg, d->fd);
+          /* On error, we close and reopen to handle log rotation */
+          if (ferror(d->fd)) {
+             fclose(d->fd);
+             d->fd = NULL;
+             if (open_dest_file(jcr, d, mode)) {
+                fputs(dt, d->fd);
+                fputs(msg, d->fd);
+             }
+          }
+          msgs->clear_in_use();
+          break;
+       case MD_DIRECTOR:
+          Dmsg1(850, "DIRECTOR for following msg: %s", msg);
+          if (jcr && jcr->dir_bsock && !jcr->dir_bsock->errors) {
+             jcr->dir_bsock->fsend("Jmsg Job=%s type=%d level=%lld %s",
+                jcr->Job, type, mtime, msg);
+          } else {
+             Dmsg1(800, "no jcr for following msg: %s", msg);
+          }
+          break;
+       case MD_STDOUT:
+          Dmsg1(850, "STDOUT for following msg: %s", msg);
+          if (type != M_ABORT && type != M_ERROR_TERM) { /* already printed */
+             fputs(dt, stdout);
+             fputs(msg, stdout);
+             if (flush) {
+                *flush |= DF_STDOUT;
+             } else {
+                fflush(stdout);
+             }
+          }
+          break;
+       case MD_STDERR:
+          Dmsg1(850, "STDERR for following msg: %s", msg);
+          fputs(dt, stderr);
+          fputs(msg, stderr);
+          if (flush) {
+             *flush |= DF_STDOUT;
+          } else {
+             fflush(stdout);
+          }
+          break;
+       default:
+          break;
+    }
+}
+
+/*
+ * Give the message to the dispatcher thread.
+ *  Returns: true  if queued
+ *           false if the caller must deliver it
+ */
+static bool queue_message(JCR *jcr, MSGS *msgs, int type, utime_t mtime,
+                          const char *dt, int dtlen, const char *msg)
+{
+   DISPATCH_ITEM *item;
+   int len = strlen(msg);
+
+   P(dispatch_mutex);
+   if (!dispatch_running || dispatch_quit ||
+       pthread_equal(pthread_self(), dispatch_tid)) {
+      V(dispatch_mutex);
+      return false;
+   }
+   /* Back pressure, wait for the dispatcher to take the queue */
+   while (dispatch_count >= dispatch_queue_max && !dispatch_quit) {
+      dispatch_waits++;
+      pthread_cond_wait(&dispatch_done, &dispatch_mutex);
+   }
+   if (dispatch_quit) {
+      V(dispatch_mutex);
+      return false;
+   }
+   item = (DISPATCH_ITEM *)malloc(sizeof(DISPATCH_ITEM) + len);
+   item->next = NULL;
+   item->jcr = jcr;
+   item->msgs = msgs;
+   item->type = type;
+   item->mtime = mtime;
+   item->dtlen = dtlen;
+   memcpy(item->dt, dt, dtlen + 1);
+   memcpy(item->msg, msg, len + 1);
+   if (dispatch_tail) {
+      dispatch_tail->next = item;
+   } else {
+      dispatch_head = item;
+   }
+   dispatch_tail = item;
+   dispatch_count++;
+   dispatch_queued++;
+   pthread_cond_signal(&dispatch_work);
+   V(dispatch_mutex);
+   return true;
+}
+
+/*
+ * Wait until the messages queued so far are delivered
+ */
+void flush_message_queue()
+{
+   uint64_t target;
+
+   P(dispatch_mutex);
+   if (dispatch_running && !pthread_equal(pthread_self(), dispatch_tid)) {
+      target = dispatch_queued;
+      while (dispatch_delivered < target) {
+         pthread_cond_wait(&dispatch_done, &dispatch_mutex);
+      }
+   }
+   V(dispatch_mutex);
+}
+
+extern "C" void *message_dispatcher(void *arg)
+{
+   DISPATCH_ITEM *batch, *item;
+   DEST *d;
+   int nb, flush;
+
+   P(dispatch_mutex);
+   for ( ;; ) {
+      while (!dispatch_head && !dispatch_quit) {
+         pthread_cond_wait(&dispatch_work, &dispatch_mutex);
+      }
+      if (!dispatch_head) {
+         break;                       /* quit and nothing left */
+      }
+      batch = dispatch_head;
+      nb = dispatch_count;
+      dispatch_head = dispatch_tail = NULL;
+      dispatch_count = 0;
+      pthread_cond_broadcast(&dispatch_done);   /* room for the callers */
+      V(dispatch_mutex);
+
+      flush = 0;
+      while ((item = batch)) {
+         batch = item->next;
+         for (d=item->msgs->dest_chain; d; d=d->next) {
+            if (bit_is_set(item->type, d->msg_types) && is_async_dest(d->dest_code)) {
+               send_to_dest(item->jcr, item->msgs, d, item->type, item->mtime,
+                            item->dt, item->dtlen, item->msg, &flush);
+            }
+         }
+         free(item);
+      }
+      if ((flush & DF_CONSOLE) && con_fd) {
+         Pw(con_lock);
+         fflush(con_fd);
+         Vw(con_lock);
+      }
+      if (flush & DF_STDOUT) {
+         fflush(stdout);
+      }
+
+      P(dispatch_mutex);
+      dispatch_delivered += nb;
+      pthread_cond_broadcast(&dispatch_done);
+   }
+   V(dispatch_mutex);
+   return NULL;
+}
+
+/*
+ * Start the thread that delivers the messages of the daemon.
+ *  Must be called after daemon_start(), the thread is not forked.
+ */
+void start_message_dispatcher()
+{
+   int status;
+
+   P(dispatch_mutex);
+   if (dispatch_running) {
+      V(dispatch_mutex);
+      return;
+   }
+   if ((status = pthread_create(&dispatch_tid, NULL, message_dispatcher, NULL)) != 0) {
+      V(dispatch_mutex);
+      berrno be;
+      Emsg1(M_ERROR, 0, _("Cannot start message dispatcher thread: ERR=%s\n"),
+            be.bstrerror(status));
+      return;
+   }
+   dispatch_running = true;
+   V(dispatch_mutex);
+}
+
+/*
+ * Deliver the queued messages and stop the dispatcher thread,
+ *  the messages are then delivered by the calling threads.
+ */
+void stop_message_dispatcher()
+{
+   P(dispatch_mutex);
+   if (!dispatch_running || dispatch_quit) {
+      V(dispatch_mutex);
+      return;
+   }
+   dispatch_quit = true;
+   pthread_cond_broadcast(&dispatch_work);
+   pthread_cond_broadcast(&dispatch_done);
+   V(dispatch_mutex);
+   if (!pthread_equal(pthread_self(), dispatch_tid)) {
+      pthread_join(dispatch_tid, NULL);
+   }
+   P(dispatch_mutex);
+   dispatch_running = false;
+   dispatch_quit = false;
+   V(dispatch_mutex);
+   Dmsg2(200, "Message dispatcher stopped. delivered=%lld waits=%lld\n",
+         dispatch_delivered, dispatch_waits);
+}
+
 /*
  * Handle sending the message to the appropriate place
  */
@@ -802,11 +1222,9 @@ void dispatch_message(JCR *jcr, int type, utime_t mtime, char *msg)
 {
     DEST *d;
     char dt[MAX_TIME_LENGTH];
-    POOLMEM *mcmd;
-    int len, dtlen;
+    int dtlen;
     MSGS *msgs;
-    BPIPE *bpipe;
-    const char *mode;
+    bool async, queue = false;
 
     Dmsg2(850, "Enter dispatch_msg type=%d msg=%s", type, msg);
 
@@ -836,6 +1254,15 @@ void dispatch_message(JCR *jcr, int type, utime_t mtime, char *msg)
        return;
     }
 
+    /* Serious errors are delivered after the queued messages */
+    async = dispatch_running;
+    if (type == M_ABORT || type == M_ERROR_TERM || type == M_FATAL) {
+       if (async) {
+          flush_message_queue();
+       }
+       async = false;
+    }
+
     /* For serious errors make sure message is printed or logged */
     if (type == M_ABORT || type == M_ERROR_TERM) {
        fputs(dt, stdout);
@@ -872,169 +1299,18 @@ void dispatch_message(JCR *jcr, int type, utime_t mtime, char *msg)
 
     for (d=msgs->dest_chain; d; d=d->next) {
        if (bit_is_set(type, d->msg_types)) {
-          switch (d->dest_code) {
-             case MD_CATALOG:
-                char ed1[50];
-                if (!jcr || !jcr->db) {
-                   break;
-                }
-                if (p_sql_query && p_sql_escape) {
-                   POOLMEM *cmd = get_pool_memory(PM_MESSAGE);
-                   POOLMEM *esc_msg = get_pool_memory(PM_MESSAGE);
-
-                   int len = strlen(msg) + 1;
-                   esc_msg = check_pool_memory_size(esc_msg, len * 2 + 1);
-                   if (p_sql_escape(jcr, jcr->db, esc_msg, msg, len)) {
-                      bstrutime(dt, sizeof(dt), mtime);
-                      Mmsg(cmd, "INSERT INTO Log (JobId, Time, LogText) VALUES (%s,'%s','%s')",
-                            edit_int64(jcr->JobId, ed1), dt, esc_msg);
-                      if (!p_sql_query(jcr, cmd)) {
-                         delivery_error(_("Msg delivery error: Unable to store data in database.\n"));
-                      }
-                   } else {
-                      delivery_error(_("Msg delivery error: Unable to store data in database.\n"));
-                   }
-
-                   free_pool_memory(cmd);
-                   free_pool_memory(esc_msg);
-                }
-                break;
-             case MD_CONSOLE:
-                Dmsg1(850, "CONSOLE for following msg: %s", msg);
-                if (!con_fd) {
-                   con_fd = fopen(con_fname, "a+b");
-                   Dmsg0(850, "Console file not open.\n");
-                }
-                if (con_fd) {
-                   Pw(con_lock);      /* get write lock on console message file */
-                   errno = 0;
-                   if (dtlen) {
-                      (void)fwrite(dt, dtlen, 1, con_fd);
-                   }
-                   len = strlen(msg);
-                   if (len > 0) {
-                      (void)fwrite(msg, len, 1, con_fd);
-                      if (msg[len-1] != '\n') {
-                         (void)fwrite("\n", 2, 1, con_fd);
-                      }
-                   } else {
-                      (void)fwrite("\n", 2, 1, con_fd);
-                   }
-                   fflush(con_fd);
-                   console_msg_pending = true;
-                   Vw(con_lock);
-                }
-                break;
-             case MD_SYSLOG:
-                Dmsg1(850, "SYSLOG for following msg: %s\n", msg);
-                /*
-                 * We really should do an openlog() here.
-                 */
-                send_to_syslog(LOG_DAEMON|LOG_ERR, msg);
-                break;
-             case MD_OPERATOR:
-                Dmsg1(850, "OPERATOR for following msg: %s\n", msg);
-                mcmd = get_pool_memory(PM_MESSAGE);
-                if ((bpipe=open_mail_pipe(jcr, mcmd, d))) {
-                   int stat;
-                   fputs(dt, bpipe->wfd);
-                   fputs(msg, bpipe->wfd);
-                   /* Messages to the operator go one at a time */
-                   stat = close_bpipe(bpipe);
-                   if (stat != 0) {
-                      berrno be;
-                      be.set_errno(stat);
-                      delivery_error(_("Msg delivery error: Operator mail program terminated in error.\n"
-                            "CMD=%s\n"
-                            "ERR=%s\n"), mcmd, be.bstrerror());
-                   }
-                }
-                free_pool_memory(mcmd);
-                break;
-             case MD_MAIL:
-             case MD_MAIL_ON_ERROR:
-             case MD_MAIL_ON_SUCCESS:
-                Dmsg1(850, "MAIL for following msg: %s", msg);
-                if (msgs->is_closing()) {
-                   break;
-                }
-                msgs->set_in_use();
-                if (!d->fd) {
-                   POOLMEM *name = get_pool_memory(PM_MESSAGE);
-                   make_unique_mail_filename(jcr, name, d);
-                   d->fd = fopen(name, "w+b");
-                   if (!d->fd) {
-                      berrno be;
-                      delivery_error(_("Msg delivery error: fopen %s failed: ERR=%s\n"), name,
-                            be.bstrerror());
-                      free_pool_memory(name);
-                      msgs->clear_in_use();
-                      break;
-                   }
-                   d->mail_filename = name;
-                }
-                fputs(dt, d->fd);
-                len = strlen(msg) + dtlen;;
-                if (len > d->max_len) {
-                   d->max_len = len;      /* keep max line length */
-                }
-                fputs(msg, d->fd);
-                msgs->clear_in_use();
-                break;
-             case MD_APPEND:
-                Dmsg1(850, "APPEND for following msg: %s", msg);
-                mode = "ab";
-                goto send_to_file;
-             case MD_FILE:
-                Dmsg1(850, "FILE for following msg: %s", msg);
-                mode = "w+b";
-send_to_file:
-                if (msgs->is_closing()) {
-                   break;
-                }
-                msgs->set_in_use();
-                if (!d->fd && !open_dest_file(jcr, d, mode)) {
-                   msgs->clear_in_use();
-                   break;
-                }
-                fputs(dt, d->fd);
-                fputs(msg, d->fd);
-                /* On error, we close and reopen to handle log rotation */
-                if (ferror(d->fd)) {
-                   fclose(d->fd);
-                   d->fd = NULL;
-                   if (open_dest_file(jcr, d, mode)) {
-                      fputs(dt, d->fd);
-                      fputs(msg, d->fd);
-                   }
-                }
-                msgs->clear_in_use();
-                break;
-             case MD_DIRECTOR:
-                Dmsg1(850, "DIRECTOR for following msg: %s", msg);
-                if (jcr && jcr->dir_bsock && !jcr->dir_bsock->errors) {
-                   jcr->dir_bsock->fsend("Jmsg Job=%s type=%d level=%lld %s",
-                      jcr->Job, type, mtime, msg);
-                } else {
-                   Dmsg1(800, "no jcr for following msg: %s", msg);
-                }
-                break;
-             case MD_STDOUT:
-                Dmsg1(850, "STDOUT for following msg: %s", msg);
-                if (type != M_ABORT && type != M_ERROR_TERM) { /* already printed */
-                   fputs(dt, stdout);
-                   fputs(msg, stdout);
-                   fflush(stdout);
-                }
-                break;
-             case MD_STDERR:
-                Dmsg1(850, "STDERR for following msg: %s", msg);
-                fputs(dt, stderr);
-                fputs(msg, stderr);
-                fflush(stdout);
-                break;
-             default:
-                break;
+          if (async && is_async_dest(d->dest_code)) {
+             queue = true;            /* for the dispatcher */
+          } else {
+             send_to_dest(jcr, msgs, d, type, mtime, dt, dtlen, msg, NULL);
+          }
+       }
+    }
+    if (queue && !queue_message(jcr, msgs, type, mtime, dt, dtlen, msg)) {
+       /* The dispatcher is stopping or it is the caller */
+       for (d=msgs->dest_chain; d; d=d->next) {
+          if (bit_is_set(type, d->msg_types) && is_async_dest(d->dest_code)) {
+             send_to_dest(jcr, msgs, d, type, mtime, dt, dtlen, msg, NULL);
           }
        }
     }
@@ -37,6 +37,7 @@ void      print_ls_output(JCR *jcr, ATTR *attr);
 void      base64_init            (void);
 int       to_base64              (int64_t value, char *where);
 int       from_base64            (int64_t *value, char *where);
+int       from_base64_list       (int64_t *values, int max, char *where);
 int       bin_to_base64          (char *buf, int buflen, char *bin, int binlen,
                                   int compatible);
 int       base64_to_bin(char *dest, int destlen, char *src, int srclen);
@@ -74,7 +75,7 @@ long long int strtoll            (const char *ptr, char **endptr, int base);
 void      read_state_file(char *dir, const char *progname, int port);
 int       b_strerror(int errnum, char *buf, size_t bufsiz);
 char     *escape_filename(const char *file_path);
-int       Zdeflate(char *in, int in_len, char *out, int &out_len);
+int       Zdeflate(char *in, int in_len, char *out, int &out_len, int level=9);
 int       Zinflate(char *in, int in_len, char *out, int &out_len);
 void      stack_trace();
 int       safer_unlink(const char *pathname, const char *regex);
@@ -216,6 +217,9 @@ void       my_name_is            (int argc, char *argv[], const char *name);
 void       init_msg              (JCR *jcr, MSGS *msg, job_code_callback_t job_code_callback = NULL);
 void       term_msg              (void);
 void       close_msg             (JCR *jcr);
+void       start_message_dispatcher(void);
+void       stop_message_dispatcher(void);
+void       flush_message_queue   (void);
 void       add_msg_dest          (MSGS *msg, int dest, int type, char *where, char *dest_code);
 void       rem_msg_dest          (MSGS *msg, int dest, int type, char *where);
 void       Jmsg                  (JCR *jcr, int type, utime_t mtime, const char *fmt, ...);
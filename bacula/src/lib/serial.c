@@ -172,6 +172,30 @@ void serial_string(uint8_t * * const ptr, const char * const str)
 }
 
 
+/*
+ * serial_varint  --  Serialise an unsigned integer on 7 bits
+ *                    per byte, low bits first.  The high bit of a
+ *                    byte is set when more bytes follow.
+ */
+
+void serial_varint(uint8_t * * const ptr, uint64_t v)
+{
+    while (v >= 0x80) {
+        *(*ptr)++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *(*ptr)++ = (uint8_t)v;
+}
+
+/*  serial_svarint  --  Serialise a signed integer, small negative
+                        values are kept short (zigzag encoding).  */
+
+void serial_svarint(uint8_t * * const ptr, const int64_t v)
+{
+    serial_varint(ptr, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+
 /*  unserial_int16  --  Unserialise a signed 16 bit integer.  */
 
 int16_t unserial_int16(uint8_t * * const ptr)
@@ -304,3 +328,31 @@ void unserial_string(uint8_t * * const ptr, char * const str, int max)
    *ptr += i;                /* update pointer */
 // Dmsg2(000, "unser src=%s dest=%s\n", src, dest);
 }
+
+/*  unserial_varint  --  Unserialise an unsigned integer written
+                         by serial_varint().  */
+
+uint64_t unserial_varint(uint8_t * * const ptr)
+{
+    uint64_t v = 0;
+    int shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        uint8_t b = *(*ptr)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    return v;
+}
+
+/*  unserial_svarint  --  Unserialise a signed integer written
+                          by serial_svarint().  */
+
+int64_t unserial_svarint(uint8_t * * const ptr)
+{
+    uint64_t v = unserial_varint(ptr);
+
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
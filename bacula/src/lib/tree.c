@@ -27,6 +27,7 @@
 #define B_PAGE_SIZE 4096
 #define MAX_PAGES 2400
 #define MAX_BUF_SIZE (MAX_PAGES * B_PAGE_SIZE)  /* approx 10MB */
+#define MAX_NODES (MAX_BUF_SIZE / sizeof(TREE_NODE))
 
 /* Forward referenced subroutines */
 static TREE_NODE *search_and_insert_tree_node(char *fname, int type,
@@ -45,6 +46,24 @@ static char *tree_alloc(TREE_ROOT *root, int size);
 #define Dmsg2(n,f,a1,a2)
 #define Dmsg3(n,f,a1,a2,a3)
 
+/*
+ * Hash a name with its parent, the children of all the
+ *  directories share the same table.
+ */
+static inline uint32_t name_index(TREE_ROOT *root, TREE_NODE *parent,
+                                  const char *fname, int len)
+{
+   uint64_t hash = (uint64_t)(intptr_t)parent;
+   const char *p;
+
+   for (p = fname; p < fname + len; p++) {
+      hash += ((hash << 5) | (hash >> (sizeof(hash)*8-5))) + (uint32_t)*p;
+   }
+   /* Multiply by large prime number, take top bits */
+   hash *= (uint64_t)0x9E3779B97F4A7C15ULL;
+   return (uint32_t)(hash >> 32) & root->names_mask;
+}
+
 /*
  * This subroutine gets a big buffer.
  */
@@ -62,10 +81,63 @@ static void malloc_buf(TREE_ROOT *root, int size)
    Dmsg2(200, "malloc buf size=%d rem=%d\n", size, mem->rem);
 }
 
+/*
+ * Get a new array of nodes. The last node of the previous
+ *  array is not used, it points to the first node of the
+ *  new one so that the tree can be walked in insertion order.
+ */
+static void malloc_nodes(TREE_ROOT *root, uint32_t count)
+{
+   struct s_node_mem *nodes;
+   uint32_t size = sizeof(struct s_node_mem) + (count - 1) * sizeof(TREE_NODE);
+
+   nodes = (struct s_node_mem *)malloc(size);
+   memset(nodes, 0, size);
+   root->total_size += size;
+   root->blocks++;
+   nodes->size = count;
+   if (root->nodes) {
+      root->nodes->node[root->nodes->size - 1].parent = nodes->node;
+   }
+   nodes->next = root->nodes;
+   root->nodes = nodes;
+}
 
 /*
- * Note, we allocate a big buffer in the tree root
- *  from which we allocate nodes. This runs more
+ * (Re)size the hash of the nodes by parent and name
+ */
+static void resize_names(TREE_ROOT *root, uint32_t nb_buckets)
+{
+   TREE_NODE **old = root->names;
+   uint32_t old_size = old ? root->names_mask + 1 : 0;
+   uint32_t size = 1024;
+   TREE_NODE *node, *next;
+   uint32_t i, index;
+
+   while (size < nb_buckets) {
+      size <<= 1;
+   }
+   root->names = (TREE_NODE **)malloc(size * sizeof(TREE_NODE *));
+   memset(root->names, 0, size * sizeof(TREE_NODE *));
+   root->names_mask = size - 1;
+   root->total_size += (size - old_size) * sizeof(TREE_NODE *);
+
+   for (i = 0; i < old_size; i++) {
+      for (node = old[i]; node; node = next) {
+         next = node->hnext;
+         index = name_index(root, node->parent, node->fname, node->fname_len);
+         node->hnext = root->names[index];
+         root->names[index] = node;
+      }
+   }
+   if (old) {
+      free(old);
+   }
+}
+
+/*
+ * Note, we allocate big buffers in the tree root
+ *  from which we allocate nodes and names. This runs more
  *  than 100 times as fast as directly using malloc()
  *  for each of the nodes.
  */
@@ -79,13 +151,15 @@ TREE_ROOT *new_tree(int count)
    }
    root = (TREE_ROOT *)malloc(sizeof(TREE_ROOT));
    memset(root, 0, sizeof(TREE_ROOT));
-   /* Assume filename + node  = 40 characters average length */
-   size = count * (BALIGN(sizeof(TREE_NODE)) + 40);
+   /* Assume filename = 16 characters average length */
+   size = count * 16;
    if (count > 1000000 || size > (MAX_BUF_SIZE / 2)) {
       size = MAX_BUF_SIZE;
    }
    Dmsg2(400, "count=%d size=%d\n", count, size);
    malloc_buf(root, size);
+   malloc_nodes(root, MIN((uint32_t)count + 1, MAX_NODES));
+   root->expected_count = count;
    root->cached_path_len = -1;
    root->cached_path = get_pool_memory(PM_FNAME);
    root->type = TN_ROOT;
@@ -101,10 +175,17 @@ TREE_ROOT *new_tree(int count)
 static TREE_NODE *new_tree_node(TREE_ROOT *root)
 {
    TREE_NODE *node;
-   int size = sizeof(TREE_NODE);
-   node = (TREE_NODE *)tree_alloc(root, size);
-   memset(node, 0, size);
+
+   /* Keep the last node of the array to link the next one */
+   if (root->nodes->used == root->nodes->size - 1) {
+      malloc_nodes(root, MAX_NODES);
+   }
+   node = &root->nodes->node[root->nodes->used++];
    node->delta_seq = -1;
+   if (!root->first) {
+      root->first = node;
+   }
+   root->node_count++;
    return node;
 }
 
@@ -114,16 +195,40 @@ static TREE_NODE *new_tree_node(TREE_ROOT *root)
  */
 static void free_tree_node(TREE_ROOT *root)
 {
-   int asize = BALIGN(sizeof(TREE_NODE));
-   root->mem->rem += asize;
-   root->mem->mem -= asize;
+   TREE_NODE *node = &root->nodes->node[--root->nodes->used];
+   memset(node, 0, sizeof(TREE_NODE));
+   if (root->first == node) {
+      root->first = NULL;
+   }
+   root->node_count--;
 }
 
 void tree_remove_node(TREE_ROOT *root, TREE_NODE *node)
 {
-   int asize = BALIGN(sizeof(TREE_NODE));
-   node->parent->child.remove(node);
-   if ((root->mem->mem - asize) == (char *)node) {
+   TREE_NODE *parent = node->parent;
+   TREE_NODE **np, *prev;
+
+   /* Unlink it from the name hash */
+   if (root->names) {
+      for (np = &root->names[name_index(root, parent, node->fname, node->fname_len)];
+           *np != node; np = &(*np)->hnext)
+         { }
+      *np = node->hnext;
+   }
+
+   /* and from the children of the parent */
+   for (prev = node; prev->sibling != node; prev = prev->sibling)
+      { }
+   if (prev == node) {
+      parent->child = NULL;
+   } else {
+      prev->sibling = node->sibling;
+      if (parent->child == node) {
+         parent->child = prev;
+      }
+   }
+
+   if (root->nodes->used > 0 && &root->nodes->node[root->nodes->used - 1] == node) {
       free_tree_node(root);
    } else {
       Dmsg0(0, "Can't release tree node\n");
@@ -131,7 +236,19 @@ void tree_remove_node(TREE_ROOT *root, TREE_NODE *node)
 }
 
 /*
- * Allocate bytes for filename in tree structure.
+ * Get a new buffer when the current one is full
+ */
+static void tree_new_buf(TREE_ROOT *root)
+{
+   if (root->total_size >= (MAX_BUF_SIZE / 2)) {
+      malloc_buf(root, MAX_BUF_SIZE);
+   } else {
+      malloc_buf(root, MAX_BUF_SIZE / 2);
+   }
+}
+
+/*
+ * Allocate bytes for the delta parts in tree structure.
  *  Keep the pointers properly aligned by allocating
  *  sizes that are aligned.
  */
@@ -141,13 +258,7 @@ static char *tree_alloc(TREE_ROOT *root, int size)
    int asize = BALIGN(size);
 
    if (root->mem->rem < asize) {
-      uint32_t mb_size;
-      if (root->total_size >= (MAX_BUF_SIZE / 2)) {
-         mb_size = MAX_BUF_SIZE;
-      } else {
-         mb_size = MAX_BUF_SIZE / 2;
-      }
-      malloc_buf(root, mb_size);
+      tree_new_buf(root);
    }
    root->mem->rem -= asize;
    buf = root->mem->mem;
@@ -155,11 +266,30 @@ static char *tree_alloc(TREE_ROOT *root, int size)
    return buf;
 }
 
+/*
+ * Copy a filename in the tree. The names need no alignment,
+ *  they are packed from the end of the current buffer while
+ *  the aligned allocations are done from its start.
+ */
+static char *tree_alloc_name(TREE_ROOT *root, const char *fname, int len)
+{
+   char *buf;
+
+   if (root->mem->rem < len + 1) {
+      tree_new_buf(root);
+   }
+   root->mem->rem -= len + 1;
+   buf = root->mem->mem + root->mem->rem;
+   memcpy(buf, fname, len + 1);
+   return buf;
+}
+
 
 /* This routine frees the whole tree */
 void free_tree(TREE_ROOT *root)
 {
    struct s_mem *mem, *rel;
+   struct s_node_mem *nodes, *nrel;
    uint32_t freed_blocks = 0;
 
    root->hardlinks.destroy();
@@ -169,11 +299,20 @@ void free_tree(TREE_ROOT *root)
       free(rel);
       freed_blocks++;
    }
+   for (nodes=root->nodes; nodes; ) {
+      nrel = nodes;
+      nodes = nodes->next;
+      free(nrel);
+      freed_blocks++;
+   }
+   if (root->names) {
+      free(root->names);
+   }
    if (root->cached_path) {
       free_pool_memory(root->cached_path);
       root->cached_path = NULL;
    }
-   Dmsg3(100, "Total size=%u blocks=%u freed_blocks=%u\n", root->total_size, root->blocks, freed_blocks);
+   Dmsg3(100, "Total size=%llu blocks=%u freed_blocks=%u\n", root->total_size, root->blocks, freed_blocks);
    free(root);
    garbage_collect_memory();
    return;
@@ -292,16 +431,108 @@ TREE_NODE *make_tree_path(char *path, TREE_ROOT *root)
    return node;
 }
 
-static int node_compare(void *item1, void *item2)
+static int name_compare(const char *fname1, const char *fname2)
 {
-   TREE_NODE *tn1 = (TREE_NODE *)item1;
-   TREE_NODE *tn2 = (TREE_NODE *)item2;
-   if (tn1->fname[0] > tn2->fname[0]) {
+   if (fname1[0] > fname2[0]) {
       return 1;
-   } else if (tn1->fname[0] < tn2->fname[0]) {
+   } else if (fname1[0] < fname2[0]) {
       return -1;
    }
-   return strcmp(tn1->fname, tn2->fname);
+   return strcmp(fname1, fname2);
+}
+
+static int node_compare(TREE_NODE *tn1, TREE_NODE *tn2)
+{
+   return name_compare(tn1->fname, tn2->fname);
+}
+
+/*
+ * Merge sort a NULL terminated list of siblings by name
+ */
+static TREE_NODE *sort_siblings(TREE_NODE *list)
+{
+   TREE_NODE *half, *end, *head, **tail;
+
+   if (!list || !list->sibling) {
+      return list;
+   }
+   /* Split the list in two halves */
+   for (half = list, end = list->sibling; end && end->sibling; end = end->sibling->sibling) {
+      half = half->sibling;
+   }
+   end = half->sibling;
+   half->sibling = NULL;
+   list = sort_siblings(list);
+   end = sort_siblings(end);
+
+   /* and merge them */
+   for (tail = &head; list && end; tail = &(*tail)->sibling) {
+      if (node_compare(list, end) <= 0) {
+         *tail = list;
+         list = list->sibling;
+      } else {
+         *tail = end;
+         end = end->sibling;
+      }
+   }
+   *tail = list ? list : end;
+   return head;
+}
+
+/*
+ * Walk the children of a node in name order. Returns the
+ *  child that follows child, or the first one when child is NULL.
+ */
+TREE_NODE *tree_next_child(TREE_NODE *parent, TREE_NODE *child)
+{
+   TREE_NODE *first, *last;
+
+   if (!parent->child || child == parent->child) {
+      return NULL;
+   }
+   if (child) {
+      return child->sibling;
+   }
+   if (parent->unsorted) {
+      first = parent->child->sibling;
+      parent->child->sibling = NULL;
+      first = sort_siblings(first);
+      for (last = first; last->sibling; last = last->sibling)
+         { }
+      last->sibling = first;
+      parent->child = last;
+      parent->unsorted = false;
+   }
+   return parent->child->sibling;
+}
+
+/*
+ * Walk the nodes of the tree in insertion order
+ */
+TREE_NODE *tree_next_node(TREE_NODE *node)
+{
+   node++;
+   if (!node->fname && node->parent) { /* end of a node array */
+      node = node->parent;
+   }
+   return node->fname ? node : NULL;
+}
+
+/*
+ * Put all the nodes of the tree in the name hash. It is
+ *  only needed once a name is looked up out of order.
+ */
+static void hash_tree_names(TREE_ROOT *root)
+{
+   TREE_NODE *node;
+   uint32_t index;
+
+   resize_names(root, MAX(root->expected_count, 2 * root->node_count));
+   for (node = first_tree_node(root); node; node = next_tree_node(node)) {
+      index = name_index(root, node->parent, node->fname, node->fname_len);
+      node->hnext = root->names[index];
+      root->names[index] = node;
+   }
 }
 
 /*
@@ -310,33 +541,62 @@ static int node_compare(void *item1, void *item2)
 static TREE_NODE *search_and_insert_tree_node(char *fname, int type,
                TREE_ROOT *root, TREE_NODE *parent)
 {
-   TREE_NODE *node, *found_node;
+   TREE_NODE *node, *last;
+   int len = strlen(fname);
+   uint32_t index;
+   int cmp = 0;
+
+   /*
+    * The catalog returns the files ordered by path, so they
+    *  are normally appended in name order and a name greater
+    *  than the last child cannot be in the tree. If not, we
+    *  look for it in the name hash, and the children will be
+    *  sorted when they are listed.
+    */
+   last = parent->child;
+   if (last && (cmp = name_compare(last->fname, fname)) == 0) {
+      last->inserted = false;         /* already in list */
+      return last;
+   }
+   if (last && (parent->unsorted || cmp > 0)) {
+      if (!root->names) {
+         hash_tree_names(root);
+      }
+      index = name_index(root, parent, fname, len);
+      for (node = root->names[index]; node; node = node->hnext) {
+         if (node->parent == parent && node->fname_len == len &&
+             memcmp(node->fname, fname, len) == 0) {
+            node->inserted = false;   /* already in list */
+            return node;
+         }
+      }
+      parent->unsorted = true;
+   }
+
+   /* It was not found, insert it */
    node = new_tree_node(root);
-   node->fname = fname;
-   found_node = (TREE_NODE *)parent->child.insert(node, node_compare);
-   if (found_node != node) {          /* already in list */
-      free_tree_node(root);           /* free node allocated above */
-      found_node->inserted = false;
-      return found_node;
-   }
-   /* It was not found, but is now inserted */
-   node->fname_len = strlen(fname);
-   node->fname = tree_alloc(root, node->fname_len + 1);
-   strcpy(node->fname, fname);
+   node->fname_len = len;
+   node->fname = tree_alloc_name(root, fname, len);
    node->parent = parent;
    node->type = type;
-
-   /* Maintain a linear chain of nodes */
-   if (!root->first) {
-      root->first = node;
-      root->last = node;
+   if (last) {
+      node->sibling = last->sibling;
+      last->sibling = node;
    } else {
-      root->last->next = node;
-      root->last = node;
+      node->sibling = node;
+   }
+   parent->child = node;
+
+   if (root->names) {
+      if (root->node_count > root->names_mask) {
+         resize_names(root, 2 * (root->names_mask + 1));
+      }
+      index = name_index(root, parent, fname, len);
+      node->hnext = root->names[index];
+      root->names[index] = node;
    }
    node->inserted = true;             /* inserted into tree */
    return node;
-
 }
 
 int tree_getpath(TREE_NODE *node, char *buf, int buf_size)
@@ -413,19 +673,31 @@ TREE_NODE *tree_relcwd(char *path, TREE_ROOT *root, TREE_NODE *node)
       len = strlen(path);
    }
    Dmsg2(100, "tree_relcwd: len=%d path=%s\n", len, path);
-   foreach_child(cd, node) {
-      Dmsg1(100, "tree_relcwd: test cd=%s\n", cd->fname);
-      if (cd->fname[0] == path[0] && len == (int)strlen(cd->fname)
-          && strncmp(cd->fname, path, len) == 0) {
-         break;
+   /* Try the exact name first, then the wild-cards */
+   cd = NULL;
+   if (root->names) {
+      for (cd = root->names[name_index(root, node, path, len)]; cd; cd = cd->hnext) {
+         if (cd->parent == node && cd->fname_len == len &&
+             strncmp(cd->fname, path, len) == 0) {
+            break;
+         }
       }
-      /* fnmatch has no len in call so we truncate the string */
-      save_char = path[len];
-      path[len] = 0;
-      match = fnmatch(path, cd->fname, 0) == 0;
-      path[len] = save_char;
-      if (match) {
-         break;
+   }
+   if (!cd) {
+      foreach_child(cd, node) {
+         Dmsg1(100, "tree_relcwd: test cd=%s\n", cd->fname);
+         if (cd->fname[0] == path[0] && len == (int)cd->fname_len
+             && strncmp(cd->fname, path, len) == 0) {
+            break;
+         }
+         /* fnmatch has no len in call so we truncate the string */
+         save_char = path[len];
+         path[len] = 0;
+         match = fnmatch(path, cd->fname, 0) == 0;
+         path[len] = save_char;
+         if (match) {
+            break;
+         }
       }
    }
    if (!cd || (cd->type == TN_FILE && !tree_node_has_child(cd))) {
@@ -444,154 +716,201 @@ TREE_NODE *tree_relcwd(char *path, TREE_ROOT *root, TREE_NODE *node)
 
 #ifdef BUILD_TEST_PROGRAM
 
-void FillDirectoryTree(char *path, TREE_ROOT *root, TREE_NODE *parent);
-
-static uint32_t FileIndex = 0;
 /*
- * Simple test program for tree routines
+ * Tree benchmark
+ *
+ *  Build a tree the same way the restore command does, from
+ *  path/filename entries ordered by path, then report the build
+ *  time, the memory used by each node and the time to walk the
+ *  tree and to list all the directories.
+ *
+ *  Without a directory, a synthetic tree of -n files in
+ *  directories of -f files is built. With -r the files of each
+ *  directory come in reverse name order, as with a database
+ *  collation that does not follow strcmp().
  */
-int main(int argc, char *argv[])
+
+struct tree_entry {
+   char *path;
+   char *fname;
+};
+
+static tree_entry *entries = NULL;
+static int nb_entries = 0;
+static int max_entries = 0;
+
+static void add_entry(const char *path, const char *fname)
 {
-    TREE_ROOT *root;
-    TREE_NODE *node;
-    char buf[MAXPATHLEN];
-
-    root = new_tree();
-    root->fname = tree_alloc(root, 1);
-    *root->fname = 0;
-    root->fname_len = 0;
-
-    FillDirectoryTree("/home/kern/bacula/k", root, NULL);
-
-    for (node = first_tree_node(root); node; node=next_tree_node(node)) {
-       tree_getpath(node, buf, sizeof(buf));
-       Dmsg2(100, "%d: %s\n", node->FileIndex, buf);
-    }
-
-    node = (TREE_NODE *)root;
-    Pmsg0(000, "doing cd /home/kern/bacula/k/techlogs\n");
-    node = tree_cwd("/home/kern/bacula/k/techlogs", root, node);
-    if (node) {
-       tree_getpath(node, buf, sizeof(buf));
-       Dmsg2(100, "findex=%d: cwd=%s\n", node->FileIndex, buf);
-    }
-
-    Pmsg0(000, "doing cd /home/kern/bacula/k/src/testprogs\n");
-    node = tree_cwd("/home/kern/bacula/k/src/testprogs", root, node);
-    if (node) {
-       tree_getpath(node, buf, sizeof(buf));
-       Dmsg2(100, "findex=%d: cwd=%s\n", node->FileIndex, buf);
-    } else {
-       Dmsg0(100, "testprogs not found.\n");
-    }
-
-    free_tree((TREE_NODE *)root);
-
-    return 0;
+   if (nb_entries == max_entries) {
+      max_entries = max_entries ? 2 * max_entries : 100000;
+      entries = (tree_entry *)realloc(entries, max_entries * sizeof(tree_entry));
+   }
+   entries[nb_entries].path = bstrdup(path);
+   entries[nb_entries].fname = bstrdup(fname);
+   nb_entries++;
 }
 
-void FillDirectoryTree(char *path, TREE_ROOT *root, TREE_NODE *parent)
+static int entry_compare(const void *e1, const void *e2)
 {
-   TREE_NODE *newparent = NULL;
-   TREE_NODE *node;
-   struct stat statbuf;
-   DIR *dp;
+   const tree_entry *a = (const tree_entry *)e1;
+   const tree_entry *b = (const tree_entry *)e2;
+   int ret = strcmp(a->path, b->path);
+   return ret ? ret : strcmp(a->fname, b->fname);
+}
+
+/* Collect the entries of a directory like the catalog has them */
+static void load_directory(const char *path)
+{
+   POOL_MEM fname, dirpath;
+   struct stat statp;
    struct dirent *dir;
-   char pathbuf[MAXPATHLEN];
-   char file[MAXPATHLEN];
-   int type;
-   int i;
-
-   Dmsg1(100, "FillDirectoryTree: %s\n", path);
-   dp = opendir(path);
-   if (!dp) {
+   DIR *dp;
+
+   Mmsg(dirpath, "%s/", path);
+   add_entry(dirpath.c_str(), "");
+   if (!(dp = opendir(path))) {
       return;
    }
    while ((dir = readdir(dp))) {
       if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) {
          continue;
       }
-      bstrncpy(file, dir->d_name, sizeof(file));
-      snprintf(pathbuf, MAXPATHLEN-1, "%s/%s", path, file);
-      if (lstat(pathbuf, &statbuf) < 0) {
-         berrno be;
-         printf("lstat() failed. ERR=%s\n", be.bstrerror(errno));
+      Mmsg(fname, "%s/%s", path, dir->d_name);
+      if (lstat(fname.c_str(), &statp) < 0) {
          continue;
       }
-//      printf("got file=%s, pathbuf=%s\n", file, pathbuf);
-      type = TN_FILE;
-      if (S_ISLNK(statbuf.st_mode))
-         type =  TN_FILE;  /* link */
-      else if (S_ISREG(statbuf.st_mode))
-         type = TN_FILE;
-      else if (S_ISDIR(statbuf.st_mode)) {
-         type = TN_DIR;
-      } else if (S_ISCHR(statbuf.st_mode))
-         type = TN_FILE; /* char dev */
-      else if (S_ISBLK(statbuf.st_mode))
-         type = TN_FILE; /* block dev */
-      else if (S_ISFIFO(statbuf.st_mode))
-         type = TN_FILE; /* fifo */
-      else if (S_ISSOCK(statbuf.st_mode))
-         type = TN_FILE; /* sock */
-      else {
-         type = TN_FILE;
-         printf("Unknown file type: 0x%x\n", statbuf.st_mode);
+      if (S_ISDIR(statp.st_mode)) {
+         load_directory(fname.c_str());
+      } else {
+         add_entry(dirpath.c_str(), dir->d_name);
       }
+   }
+   closedir(dp);
+}
 
-      Dmsg2(100, "Doing: %d %s\n", type, pathbuf);
-      node = new_tree_node(root);
-      node->FileIndex = ++FileIndex;
-      parent = insert_tree_node(pathbuf, node, root, parent);
-      if (S_ISDIR(statbuf.st_mode) && !S_ISLNK(statbuf.st_mode)) {
-         Dmsg2(100, "calling fill. pathbuf=%s, file=%s\n", pathbuf, file);
-         FillDirectoryTree(pathbuf, root, node);
+static void make_entries(int nb_files, int files_per_dir, bool reverse)
+{
+   char path[200], fname[200];
+   int ndirs = (nb_files + files_per_dir - 1) / files_per_dir;
+   int i, j, k;
+
+   for (i = 0; i < ndirs; i++) {
+      bsnprintf(path, sizeof(path), "/bench/d%04d/dir%06d/", i / 100, i);
+      add_entry(path, "");
+      for (j = 0; j < files_per_dir && i * files_per_dir + j < nb_files; j++) {
+         k = reverse ? files_per_dir - j : j;
+         bsnprintf(fname, sizeof(fname), "file%07d_%d.dat", k, i % 1000);
+         add_entry(path, fname);
       }
    }
-   closedir(dp);
 }
 
-#ifndef MAXPATHLEN
-#define MAXPATHLEN 2000
-#endif
+static void usage()
+{
+   fprintf(stderr,
+"Usage: tree_test [-n files] [-f files-per-dir] [-r] [directory]\n"
+"       -n <nb>     number of files of the synthetic tree, default 1000000\n"
+"       -f <nb>     files per directory, default 1000\n"
+"       -r          insert the files of a directory in reverse order\n"
+"       -?          print this message.\n"
+"\n");
+   exit(1);
+}
 
-void print_tree(char *path, TREE_NODE *tree)
+int main(int argc, char *argv[])
 {
-   char buf[MAXPATHLEN];
-   char *termchr;
+   TREE_ROOT *root;
+   TREE_NODE *node, *child, *prev;
+   int nb_files = 1000000, files_per_dir = 1000;
+   bool reverse = false;
+   btime_t start, build_time, walk_time, ls_time;
+   uint32_t nodes = 0, dirs = 0, unordered = 0;
+   char ed1[50], ed2[50];
+   int ch, i;
+
+   my_name_is(argc, argv, "tree_test");
+   init_msg(NULL, NULL);
+
+   while ((ch = getopt(argc, argv, "f:n:r?")) != -1) {
+      switch (ch) {
+      case 'f':
+         files_per_dir = MAX(atoi(optarg), 1);
+         break;
+      case 'n':
+         nb_files = atoi(optarg);
+         break;
+      case 'r':
+         reverse = true;
+         break;
+      case '?':
+      default:
+         usage();
+      }
+   }
+   argc -= optind;
+   argv += optind;
 
-   if (!tree) {
-      return;
+   if (argc > 0) {
+      load_directory(argv[0]);
+      qsort(entries, nb_entries, sizeof(tree_entry), entry_compare);
+   } else {
+      make_entries(nb_files, files_per_dir, reverse);
    }
-   switch (tree->type) {
-   case TN_DIR_NLS:
-   case TN_DIR:
-   case TN_NEWDIR:
-      termchr = "/";
-      break;
-   case TN_ROOT:
-   case TN_FILE:
-   default:
-      termchr = "";
-      break;
-   }
-   Pmsg3(-1, "%s/%s%s\n", path, tree->fname, termchr);
-   switch (tree->type) {
-   case TN_FILE:
-   case TN_NEWDIR:
-   case TN_DIR:
-   case TN_DIR_NLS:
-      bsnprintf(buf, sizeof(buf), "%s/%s", path, tree->fname);
-      print_tree(buf, first_child(tree));
-      break;
-   case TN_ROOT:
-      print_tree(path, first_child(tree));
-      break;
-   default:
-      Pmsg1(000, "Unknown node type %d\n", tree->type);
-   }
-   print_tree(path, tree->sibling_);
-   return;
+
+   start = get_current_btime();
+   root = new_tree(nb_entries);
+   for (i = 0; i < nb_entries; i++) {
+      int type = *entries[i].fname ? TN_FILE : TN_DIR;
+      node = insert_tree_node(entries[i].path, entries[i].fname, type, root, NULL);
+      node->FileIndex = i + 1;
+      node->JobId = 1;
+      node->type = type;
+   }
+   build_time = get_current_btime() - start;
+
+   start = get_current_btime();
+   for (node = first_tree_node(root); node; node = next_tree_node(node)) {
+      nodes++;
+   }
+   walk_time = get_current_btime() - start;
+
+   /* List every directory, like a "ls" of the whole tree */
+   start = get_current_btime();
+   for (node = first_tree_node(root); node; node = next_tree_node(node)) {
+      if (!tree_node_has_child(node)) {
+         continue;
+      }
+      dirs++;
+      prev = NULL;
+      foreach_child(child, node) {
+         if (prev && strcmp(prev->fname, child->fname) >= 0) {
+            unordered++;
+         }
+         prev = child;
+      }
+   }
+   ls_time = get_current_btime() - start;
+
+   printf("%s entries, %u nodes, %u directories\n",
+          edit_uint64_with_commas(nb_entries, ed1), nodes, dirs);
+   printf("Build: %.3f s, %.0f nodes/s\n", build_time / 1000000.0,
+          build_time ? nodes * 1000000.0 / build_time : 0.0);
+   printf("Memory: %s bytes, %.1f bytes per node\n",
+          edit_uint64_with_commas(root->total_size, ed2),
+          nodes ? (double)root->total_size / nodes : 0.0);
+   printf("Walk: %.3f s, list: %.3f s\n", walk_time / 1000000.0, ls_time / 1000000.0);
+   if (unordered) {
+      printf("ERR: %u children not in name order\n", unordered);
+   }
+
+   free_tree(root);
+   for (i = 0; i < nb_entries; i++) {
+      free(entries[i].path);
+      free(entries[i].fname);
+   }
+   free(entries);
+   term_msg();
+   return 0;
 }
 
 #endif
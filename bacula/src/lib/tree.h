@@ -31,14 +31,20 @@ struct s_mem {
 
 #define USE_DLIST
 
+/*
+ * The children of a node are kept in a circular list in
+ *   the order they were inserted, node->child being the last
+ *   one. They are sorted by name the first time they are
+ *   listed if they were not inserted in order.
+ */
 #define foreach_child(var, list) \
-    for((var)=NULL; (*((TREE_NODE **)&(var))=(TREE_NODE*)(list->child.next(var))); )
+    for((var)=NULL; (*((TREE_NODE **)&(var))=tree_next_child((TREE_NODE *)(list), (TREE_NODE *)(var))); )
 
 #define tree_node_has_child(node) \
-        ((node)->child.size() > 0)
+        ((node)->child != NULL)
 
 #define first_child(node) \
-        ((TREE_NODE *)(node->child.first())
+        tree_next_child((TREE_NODE *)(node), NULL)
 
 struct delta_list {
    struct delta_list *next;
@@ -51,11 +57,12 @@ struct delta_list {
  *   there is one for each file.
  */
 struct s_tree_node {
-   /* KEEP sibling as the first member to avoid having to
-    *  do initialization of child */
-   rblink sibling;
-   rblist child;
    char *fname;                       /* file name */
+   struct s_tree_node *parent;
+   struct s_tree_node *sibling;       /* next child of parent */
+   struct s_tree_node *child;         /* last child */
+   struct s_tree_node *hnext;         /* next in the name hash chain */
+   struct delta_list *delta_list;     /* delta parts for this node */
    int32_t FileIndex;                 /* file index */
    uint32_t JobId;                    /* JobId */
    int32_t delta_seq;                 /* current delta sequence */
@@ -67,18 +74,28 @@ struct s_tree_node {
    unsigned int soft_link: 1;         /* set if is soft link */
    unsigned int inserted: 1;          /* set when node newly inserted */
    unsigned int loaded: 1;            /* set when the dir is in the tree */
-   struct s_tree_node *parent;
-   struct s_tree_node *next;          /* next hash of FileIndex */
-   struct delta_list *delta_list;     /* delta parts for this node */
+   unsigned int unsorted: 1;          /* children not in name order */
 };
 typedef struct s_tree_node TREE_NODE;
 
+/*
+ * The nodes are allocated in arrays, the last node of each
+ *   array links to the next array with its parent pointer.
+ */
+struct s_node_mem {
+   struct s_node_mem *next;           /* next array */
+   uint32_t size;                     /* number of nodes */
+   uint32_t used;                     /* nodes in use */
+   TREE_NODE node[1];                 /* the nodes */
+};
+
 struct s_tree_root {
-   /* KEEP sibling as the first member to avoid having to
-    *  do initialization of child */
-   rblink sibling;
-   rblist child;
    const char *fname;                 /* file name */
+   struct s_tree_node *parent;
+   struct s_tree_node *sibling;       /* next child of parent */
+   struct s_tree_node *child;         /* last child */
+   struct s_tree_node *hnext;         /* next in the name hash chain */
+   struct delta_list *delta_list;     /* delta parts for this node */
    int32_t FileIndex;                 /* file index */
    uint32_t JobId;                    /* JobId */
    int32_t delta_seq;                 /* current delta sequence */
@@ -87,17 +104,20 @@ struct s_tree_root {
    unsigned int extract: 1;           /* extract item */
    unsigned int extract_dir: 1;       /* extract dir entry only */
    unsigned int have_link: 1;         /* set if have hard link */
+   unsigned int soft_link: 1;         /* set if is soft link */
    unsigned int inserted: 1;          /* set when newly inserted */
    unsigned int loaded: 1;            /* set when the dir is in the tree */
-   struct s_tree_node *parent;
-   struct s_tree_node *next;          /* next hash of FileIndex */
-   struct delta_list *delta_list;     /* delta parts for this node */
+   unsigned int unsorted: 1;          /* children not in name order */
 
    /* The above ^^^ must be identical to a TREE_NODE structure */
    struct s_tree_node *first;         /* first entry in the tree */
-   struct s_tree_node *last;          /* last entry in tree */
-   struct s_mem *mem;                 /* tree memory */
-   uint32_t total_size;               /* total bytes allocated */
+   struct s_node_mem *nodes;          /* node arrays, current first */
+   struct s_mem *mem;                 /* names and delta parts */
+   struct s_tree_node **names;        /* (parent, name) hash buckets */
+   uint32_t names_mask;               /* number of buckets - 1 */
+   uint32_t node_count;               /* nodes in the tree */
+   uint32_t expected_count;           /* nodes expected by new_tree() */
+   uint64_t total_size;               /* total bytes allocated */
    uint32_t blocks;                   /* total mallocs */
    int cached_path_len;               /* length of cached path */
    char *cached_path;                 /* cached current path */
@@ -133,6 +153,8 @@ void tree_add_delta_part(TREE_ROOT *root, TREE_NODE *node,
 void free_tree(TREE_ROOT *root);
 int tree_getpath(TREE_NODE *node, char *buf, int buf_size);
 void tree_remove_node(TREE_ROOT *root, TREE_NODE *node);
+TREE_NODE *tree_next_child(TREE_NODE *parent, TREE_NODE *child);
+TREE_NODE *tree_next_node(TREE_NODE *node);
 
 /*
  * Use the following for traversing the whole tree. It will be
@@ -140,4 +162,4 @@ void tree_remove_node(TREE_ROOT *root, TREE_NODE *node);
  *   tree.
  */
 #define first_tree_node(r) (r)->first
-#define next_tree_node(n)  (n)->next
+#define next_tree_node(n)  tree_next_node(n)
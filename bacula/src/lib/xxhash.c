@@ -0,0 +1,169 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * This code implements the XXH64 hash of Yann Collet's xxHash
+ *  (BSD 2-Clause), written from the algorithm description.
+ *
+ * XXH64 is not a cryptographic digest: it is only meant to detect
+ *  changes in the data of a file, at a speed close to the memory
+ *  bandwidth.  The digest is stored in the canonical (big endian)
+ *  form, so that it is the same on every platform and equal to the
+ *  output of the xxhsum -H1 command.
+ *
+ * Usage is the same as the MD5 code: XXH64Init(), XXH64Update() as
+ *  many times as needed, then XXH64Final().
+ */
+
+#include "bacula.h"
+
+#define PRIME64_1 ((uint64_t)0x9E3779B185EBCA87ULL)
+#define PRIME64_2 ((uint64_t)0xC2B2AE3D27D4EB4FULL)
+#define PRIME64_3 ((uint64_t)0x165667B19E3779F9ULL)
+#define PRIME64_4 ((uint64_t)0x85EBCA77C2B2AE63ULL)
+#define PRIME64_5 ((uint64_t)0x27D4EB2F165667C5ULL)
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+/* Input is little endian whatever the platform */
+static inline uint64_t read64(const uint8_t *p)
+{
+   return (uint64_t)p[0]         | ((uint64_t)p[1] << 8)  |
+          ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+          ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+          ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+          ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+   acc += input * PRIME64_2;
+   acc = rotl64(acc, 31);
+   return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val)
+{
+   acc ^= xxh64_round(0, val);
+   return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* Hash one 32 byte stripe in the four lanes */
+static inline void xxh64_stripe(uint64_t *v, const uint8_t *p)
+{
+   v[0] = xxh64_round(v[0], read64(p));
+   v[1] = xxh64_round(v[1], read64(p + 8));
+   v[2] = xxh64_round(v[2], read64(p + 16));
+   v[3] = xxh64_round(v[3], read64(p + 24));
+}
+
+void XXH64Init(struct XXH64Context *ctx, uint64_t seed)
+{
+   ctx->total_len = 0;
+   ctx->v[0] = seed + PRIME64_1 + PRIME64_2;
+   ctx->v[1] = seed + PRIME64_2;
+   ctx->v[2] = seed;
+   ctx->v[3] = seed - PRIME64_1;
+   ctx->memsize = 0;
+}
+
+void XXH64Update(struct XXH64Context *ctx, const uint8_t *buf, uint32_t len)
+{
+   const uint8_t *end = buf + len;
+   uint64_t v[4];
+
+   ctx->total_len += len;
+
+   /* Not enough for a stripe, keep it for later */
+   if (ctx->memsize + len < 32) {
+      memcpy(ctx->mem + ctx->memsize, buf, len);
+      ctx->memsize += len;
+      return;
+   }
+
+   /* Complete the pending stripe */
+   if (ctx->memsize) {
+      memcpy(ctx->mem + ctx->memsize, buf, 32 - ctx->memsize);
+      buf += 32 - ctx->memsize;
+      xxh64_stripe(ctx->v, ctx->mem);
+      ctx->memsize = 0;
+   }
+
+   /* Work on local copies so that the compiler keeps them in registers */
+   memcpy(v, ctx->v, sizeof(v));
+   while (buf + 32 <= end) {
+      xxh64_stripe(v, buf);
+      buf += 32;
+   }
+   memcpy(ctx->v, v, sizeof(v));
+
+   if (buf < end) {
+      ctx->memsize = end - buf;
+      memcpy(ctx->mem, buf, ctx->memsize);
+   }
+}
+
+void XXH64Final(uint8_t digest[XXH64HashSize], struct XXH64Context *ctx)
+{
+   const uint8_t *p = ctx->mem;
+   const uint8_t *end = ctx->mem + ctx->memsize;
+   uint64_t h;
+   int i;
+
+   if (ctx->total_len >= 32) {
+      h = rotl64(ctx->v[0], 1) + rotl64(ctx->v[1], 7) +
+          rotl64(ctx->v[2], 12) + rotl64(ctx->v[3], 18);
+      for (i = 0; i < 4; i++) {
+         h = xxh64_merge(h, ctx->v[i]);
+      }
+   } else {
+      h = ctx->v[2] + PRIME64_5;      /* v[2] is still the seed */
+   }
+   h += ctx->total_len;
+
+   for ( ; p + 8 <= end; p += 8) {
+      h ^= xxh64_round(0, read64(p));
+      h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+   }
+   if (p + 4 <= end) {
+      h ^= (uint64_t)read32(p) * PRIME64_1;
+      h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+      p += 4;
+   }
+   for ( ; p < end; p++) {
+      h ^= (uint64_t)*p * PRIME64_5;
+      h = rotl64(h, 11) * PRIME64_1;
+   }
+
+   /* Final avalanche */
+   h ^= h >> 33;
+   h *= PRIME64_2;
+   h ^= h >> 29;
+   h *= PRIME64_3;
+   h ^= h >> 32;
+
+   for (i = XXH64HashSize - 1; i >= 0; i--) {
+      digest[i] = (uint8_t)h;
+      h >>= 8;
+   }
+}
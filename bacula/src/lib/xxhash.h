@@ -0,0 +1,39 @@
+/*
+ * Bacula xxHash definitions
+ *
+ */
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+
+#ifndef __BXXHASH_H
+#define __BXXHASH_H
+
+#define XXH64HashSize 8
+
+struct XXH64Context {
+   uint64_t total_len;
+   uint64_t v[4];
+   uint8_t  mem[32];                  /* not yet hashed input */
+   uint32_t memsize;
+};
+
+typedef struct XXH64Context XXH64Context;
+
+extern void XXH64Init(struct XXH64Context *ctx, uint64_t seed);
+extern void XXH64Update(struct XXH64Context *ctx, const uint8_t *buf, uint32_t len);
+extern void XXH64Final(uint8_t digest[XXH64HashSize], struct XXH64Context *ctx);
+
+#endif /* !__BXXHASH_H */
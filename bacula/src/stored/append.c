@@ -27,6 +27,11 @@
 static char OK_data[]    = "3000 OK data\n";
 static char OK_append[]  = "3000 OK append data\n";
 
+/* Forward referenced functions */
+static bool append_block_records(JCR *jcr, DEV_RECORD *rec, uint32_t len,
+               int32_t *last_file_index);
+static bool is_attribute_stream(int32_t stream);
+
 /*
  *  Append Data sent from Client (FD/SD)
  *
@@ -36,6 +41,8 @@ bool do_append_data(JCR *jcr)
    int32_t n;
    int32_t file_index, stream, last_file_index;
    uint64_t stream_len;
+   uint32_t block_len;
+   DEV_RECORD *brec = NULL;
    BSOCK *fd = jcr->file_bsock;
    bool ok = true;
    DEV_RECORD rec;
@@ -130,6 +137,7 @@ bool do_append_data(JCR *jcr)
     */
    dcr->VolFirstIndex = dcr->VolLastIndex = 0;
    jcr->run_time = time(NULL);              /* start counting time for rates */
+   begin_async_writes(dcr);
    for (last_file_index = 0; ok && !jcr->is_job_canceled(); ) {
 
       /* Read Stream header from the File daemon.
@@ -151,6 +159,15 @@ bool do_append_data(JCR *jcr)
          break;
       }
 
+      /* Records copied as they are in a block by the reading SD */
+      if (sscanf(fd->msg, "recblock %u", &block_len) == 1) {
+         if (!brec) {
+            brec = new_record();
+         }
+         ok = append_block_records(jcr, brec, block_len, &last_file_index);
+         continue;
+      }
+
       if (sscanf(fd->msg, "%ld %ld %lld", &file_index, &stream, &stream_len) != 3) {
          Jmsg1(jcr, M_FATAL, 0, _("Malformed data header from FD: %s\n"), fd->msg);
          ok = false;
@@ -227,6 +244,15 @@ fi_checked:
       }
    }
 
+   if (brec) {
+      free_record(brec);
+   }
+
+   /* Wait for the last data block given to the device writer */
+   if (!end_async_writes(dcr)) {
+      ok = false;
+   }
+
    /* Create Job status for end of session label */
    jcr->setJobStatus(ok?JS_Terminated:JS_ErrorTerminated);
 
@@ -307,13 +333,163 @@ fi_checked:
 }
 
 
+/*
+ * Append one record header and len bytes of its data to the block,
+ *  continuing the record in new blocks as needed.
+ */
+static bool write_block_record(DCR *dcr, int32_t FileIndex, int32_t Stream,
+               uint32_t data_bytes, char *data, uint32_t len)
+{
+   ser_declare;
+   JCR *jcr = dcr->jcr;
+   DEV_BLOCK *block;
+   uint32_t n;
+
+   for ( ;; ) {
+      block = dcr->block;             /* may change at each write */
+      if (block->buf_len - block->binbuf <= WRITE_RECHDR_LENGTH) {
+         if (!dcr->write_block_to_device()) {
+            return false;
+         }
+         continue;
+      }
+      ser_begin(block->bufp, WRITE_RECHDR_LENGTH);
+      ser_int32(FileIndex);
+      ser_int32(Stream);
+      ser_uint32(data_bytes);
+      block->bufp += WRITE_RECHDR_LENGTH;
+      block->binbuf += WRITE_RECHDR_LENGTH;
+      n = MIN(len, block->buf_len - block->binbuf);
+      memcpy(block->bufp, data, n);
+      block->bufp += n;
+      block->binbuf += n;
+      block->VolSessionId = jcr->VolSessionId;
+      block->VolSessionTime = jcr->VolSessionTime;
+      if (block->FirstIndex == 0) {
+         block->FirstIndex = FileIndex;
+      }
+      block->LastIndex = FileIndex;
+      data += n;
+      len -= n;
+      data_bytes -= n;
+      if (len == 0) {
+         return true;
+      }
+      /* The rest goes in the next block as a continuation */
+      if (!dcr->write_block_to_device()) {
+         return false;
+      }
+      if (Stream > 0) {
+         Stream = -Stream;
+      }
+   }
+}
+
+/*
+ * Append the data records sent by a reading SD as they were in one
+ *  of its blocks (see mac_block_cb() in read.c). The FileIndexes are
+ *  already sequential, the session is the one of the block we write,
+ *  and the checksum is computed when the block is written.
+ *
+ * A record that continues in the next block comes at the end of the
+ *  data, the block is then written so that the continuation sent
+ *  next is at the start of a block, as the reader expects.
+ *
+ * rec keeps the attributes that are sent to the Director.
+ */
+static bool append_block_records(JCR *jcr, DEV_RECORD *rec, uint32_t len,
+               int32_t *last_file_index)
+{
+   ser_declare;
+   BSOCK *fd = jcr->file_bsock;
+   DCR *dcr = jcr->dcr;
+   int32_t FileIndex, Stream;
+   uint32_t data_bytes, rlen;
+   bool partial = false;
+   char *p, *end;
+   int32_t n;
+
+   if ((n=bget_msg(fd)) <= 0 || (uint32_t)fd->msglen != len) {
+      Jmsg3(jcr, M_FATAL, 0, _("Error reading data block from FD. n=%d msglen=%d ERR=%s\n"),
+            n, fd->msglen, fd->bstrerror());
+      return false;
+   }
+   end = fd->msg + len;
+   for (p = fd->msg; p + WRITE_RECHDR_LENGTH <= end; p += rlen) {
+      unser_begin(p, WRITE_RECHDR_LENGTH);
+      unser_int32(FileIndex);
+      unser_int32(Stream);
+      unser_uint32(data_bytes);
+      p += WRITE_RECHDR_LENGTH;
+      rlen = MIN(data_bytes, (uint32_t)(end - p));
+      partial = data_bytes > rlen;
+
+      /* Same checks as for the stream headers */
+      if (FileIndex <= 0 || (FileIndex != *last_file_index &&
+          FileIndex != *last_file_index + 1 &&
+          !(jcr->rerunning && *last_file_index == 0))) {
+         Jmsg2(jcr, M_FATAL, 0, _("FI=%d from FD not positive or last_FI=%d\n"),
+               FileIndex, *last_file_index);
+         return false;
+      }
+      jcr->JobFiles = *last_file_index = FileIndex;
+
+      if (!write_block_record(dcr, FileIndex, Stream, data_bytes, p, rlen)) {
+         Dmsg2(90, "Got write_block_to_dev error on device %s. %s\n",
+               dcr->dev->print_name(), dcr->dev->bstrerror());
+         return false;
+      }
+      jcr->JobBytes += rlen;
+
+      if (!is_attribute_stream(abs(Stream) & STREAMMASK_TYPE)) {
+         continue;
+      }
+      if (Stream > 0) {
+         rec->data_len = 0;           /* new record */
+      }
+      rec->data = check_pool_memory_size(rec->data, rec->data_len + rlen + 1);
+      memcpy(rec->data + rec->data_len, p, rlen);
+      rec->data_len += rlen;
+      rec->data[rec->data_len] = 0;
+      if (!partial) {
+         rec->VolSessionId = jcr->VolSessionId;
+         rec->VolSessionTime = jcr->VolSessionTime;
+         rec->FileIndex = FileIndex;
+         rec->Stream = abs(Stream);
+         rec->maskedStream = rec->Stream & STREAMMASK_TYPE;
+         send_attrs_to_dir(jcr, rec);
+      }
+   }
+   if (p != end) {
+      Jmsg1(jcr, M_FATAL, 0, _("Malformed data block from FD. len=%u\n"), len);
+      return false;
+   }
+   if (partial && !dcr->write_block_to_device()) {
+      Dmsg2(90, "Got write_block_to_dev error on device %s. %s\n",
+            dcr->dev->print_name(), dcr->dev->bstrerror());
+      return false;
+   }
+   if ((n=bget_msg(fd)) != BNET_SIGNAL || fd->msglen != BNET_EOD) {
+      Jmsg3(jcr, M_FATAL, 0, _("Error reading data block from FD. n=%d msglen=%d ERR=%s\n"),
+            n, fd->msglen, fd->bstrerror());
+      return false;
+   }
+   return true;
+}
+
+/* Is this a stream that is sent to the Director for the Catalog */
+static bool is_attribute_stream(int32_t stream)
+{
+   return stream == STREAM_UNIX_ATTRIBUTES    ||
+          stream == STREAM_UNIX_ATTRIBUTES_EX ||
+          stream == STREAM_RESTORE_OBJECT     ||
+          crypto_digest_stream_type(stream) != CRYPTO_DIGEST_NONE;
+}
+
 /* Send attributes and digest to Director for Catalog */
 bool send_attrs_to_dir(JCR *jcr, DEV_RECORD *rec)
 {
-   if (rec->maskedStream == STREAM_UNIX_ATTRIBUTES    ||
-       rec->maskedStream == STREAM_UNIX_ATTRIBUTES_EX ||
-       rec->maskedStream == STREAM_RESTORE_OBJECT     ||
-       crypto_digest_stream_type(rec->maskedStream) != CRYPTO_DIGEST_NONE) {
+   if (is_attribute_stream(rec->maskedStream)) {
       if (!jcr->no_attributes) {
          BSOCK *dir = jcr->dir_bsock;
          if (are_attributes_spooled(jcr)) {
@@ -0,0 +1,317 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ *  Asynchronous block writer
+ *
+ *  With "Asynchronous Writes = yes" in the Device resource, a job
+ *   that appends data hands each full block to a writer thread of
+ *   the device, and goes on receiving and packing records into a
+ *   second block while the device writes the first one. This keeps
+ *   a tape drive streaming when the client rate is irregular.
+ *
+ *  Only the write() itself is done by the writer thread. The
+ *   accounting of the block (VolCatBytes, EndBlock, JobMedia
+ *   indexes, ...) and the end of medium handling are done under
+ *   the device lock by the next write_block_to_device() on the
+ *   device, before anything else touches it, so the Volume sees
+ *   exactly the sequence of blocks of synchronous writes.
+ *
+ *  That is normally the job that submitted the block. When another
+ *   job writes on the device in between, it accounts the block for
+ *   its owner, or, if the write failed, handles the end of medium
+ *   as if its own write had failed. The owner then rewrites its
+ *   block on the next Volume.
+ *
+ */
+
+#include "bacula.h"
+#include "stored.h"
+
+static const int dbglvl = 150;
+
+static void *async_writer_thread(void *arg);
+
+/*
+ * Called by the appending job before it writes data blocks.
+ *  Does nothing unless the device is configured for it.
+ *  Spooled data is written by the despooling code.
+ */
+void begin_async_writes(DCR *dcr)
+{
+   if (!dcr->dev->do_async_writes() || dcr->spool_data) {
+      return;
+   }
+   if (!dcr->ablock) {
+      dcr->ablock = new_block(dcr->dev);
+   }
+   dcr->async_writes = true;
+   Dmsg1(dbglvl, "Asynchronous writes on device %s\n", dcr->dev->print_name());
+}
+
+/*
+ * Start the writer thread of the device. Called with the
+ *  device locked.
+ */
+static ASYNC_WRITER *get_async_writer(DEVICE *dev)
+{
+   ASYNC_WRITER *aw;
+   int stat;
+
+   if (dev->aw) {
+      return dev->aw;
+   }
+   aw = (ASYNC_WRITER *)malloc(sizeof(ASYNC_WRITER));
+   memset(aw, 0, sizeof(ASYNC_WRITER));
+   pthread_mutex_init(&aw->mutex, NULL);
+   pthread_cond_init(&aw->cond, NULL);
+   dev->aw = aw;
+   if ((stat = pthread_create(&aw->thid, NULL, async_writer_thread, dev)) != 0) {
+      berrno be;
+      Dmsg2(dbglvl, "Cannot start writer thread for %s. ERR=%s\n",
+            dev->print_name(), be.bstrerror(stat));
+      pthread_cond_destroy(&aw->cond);
+      pthread_mutex_destroy(&aw->mutex);
+      free(aw);
+      dev->aw = NULL;
+   }
+   return dev->aw;
+}
+
+/*
+ * Hand dcr->block, already serialized by write_block_to_dev(),
+ *  to the writer thread, and give the DCR its spare block to
+ *  continue. Called with the device locked and nothing in flight.
+ *
+ *  Returns: true  if the write is in progress
+ *           false if the caller must write the block itself
+ */
+bool submit_async_write(DCR *dcr, uint32_t wlen)
+{
+   DEVICE *dev = dcr->dev;
+   ASYNC_WRITER *aw;
+   DEV_BLOCK *block = dcr->block;
+
+   /*
+    * When several jobs write on the device, each write must
+    *  be accounted before the next one starts.
+    */
+   if (!dcr->ablock || dev->num_writers > 1) {
+      return false;
+   }
+   if ((aw = get_async_writer(dev)) == NULL) {
+      return false;
+   }
+   P(aw->mutex);
+   ASSERT(aw->block == NULL);
+   aw->dcr = dcr;
+   aw->block = block;
+   aw->wlen = wlen;
+   aw->busy = true;
+   pthread_cond_broadcast(&aw->cond);
+   V(aw->mutex);
+
+   dcr->block = dcr->ablock;
+   dcr->ablock = NULL;
+   dcr->block->BlockNumber = block->BlockNumber + 1;
+   Dmsg2(dbglvl, "Submit block %u len=%u\n", block->BlockNumber, wlen);
+   return true;
+}
+
+/*
+ * Complete the block in flight, if any. Called with the device
+ *  locked by write_block_to_device(), before anything else is
+ *  done on the device.
+ *
+ *  Returns: true  on success
+ *           false if a block could not be written
+ */
+bool finish_async_write(DCR *dcr)
+{
+   DEVICE *dev = dcr->dev;
+   ASYNC_WRITER *aw = dev->aw;
+   JCR *jcr = dcr->jcr;
+   DEV_BLOCK *block, *wblock;
+   DCR *owner;
+   ssize_t stat;
+   uint32_t wlen;
+   int werrno;
+   bool accounted, passed;
+   bool ok = true;
+
+   if (!aw) {
+      return true;
+   }
+   P(aw->mutex);
+   if (!aw->block) {
+      V(aw->mutex);
+      return true;
+   }
+   while (aw->busy) {
+      pthread_cond_wait(&aw->cond, &aw->mutex);
+   }
+   owner = aw->dcr;
+   wblock = aw->block;
+   stat = aw->stat;
+   werrno = aw->werrno;
+   wlen = aw->wlen;
+   accounted = aw->accounted;
+   passed = aw->passed;
+   if (owner == dcr) {
+      aw->block = NULL;
+      aw->dcr = NULL;
+      aw->accounted = aw->passed = false;
+   } else if (stat == (ssize_t)wlen) {
+      aw->accounted = true;
+   } else {
+      aw->passed = true;
+   }
+   V(aw->mutex);
+
+   if (owner != dcr) {
+      if (accounted || passed) {
+         return true;                 /* already done by someone */
+      }
+      Dmsg2(dbglvl, "Finish block of JobId=%d stat=%d\n", owner->jcr->JobId, stat);
+      if (stat == (ssize_t)wlen) {
+         return finish_block_write(owner, wblock, stat, wlen);
+      }
+      /*
+       * The Volume is full or in error. Terminate it as if our
+       *  own block had failed, and let fixup write our block on
+       *  the next Volume. The owner will write its block after it.
+       */
+      errno = werrno;
+      if (!finish_block_write(dcr, wblock, stat, wlen)) {
+         if (job_canceled(jcr) || jcr->getJobType() == JT_SYSTEM) {
+            ok = false;
+         } else {
+            ok = fixup_device_block_write_error(dcr);
+         }
+      }
+      return ok;
+   }
+
+   block = dcr->block;
+   dcr->block = wblock;
+   if (accounted) {
+      Dmsg1(dbglvl, "Block %u accounted by another job\n", wblock->BlockNumber);
+   } else if (passed && !check_for_newvol_or_newfile(dcr)) {
+      ok = false;                     /* fatal error */
+   } else {
+      if (passed) {
+         /* Another job moved to the next Volume, write the block there */
+         Dmsg1(dbglvl, "Rewrite block %u\n", wblock->BlockNumber);
+         ok = dcr->write_block_to_dev();
+      } else {
+         errno = werrno;
+         ok = finish_block_write(dcr, wblock, stat, wlen);
+      }
+      if (!ok && !job_canceled(jcr) && jcr->getJobType() != JT_SYSTEM) {
+         Dmsg0(40, "Calling fixup_device_block_write_error ...\n");
+         ok = fixup_device_block_write_error(dcr);
+      }
+   }
+   wblock = dcr->block;
+   dcr->block = block;
+   block->BlockNumber = wblock->BlockNumber;
+   block->BlockAddr = wblock->BlockAddr;
+   empty_block(wblock);
+   dcr->ablock = wblock;
+   Dmsg2(dbglvl, "Finished block len=%u ok=%d\n", wlen, ok);
+   return ok;
+}
+
+/*
+ * Called by the appending job when it has no more data blocks
+ *  to write. Completes its block in flight, if any, and goes back
+ *  to synchronous writes.
+ *
+ *  Returns: false if the last block could not be written
+ */
+bool end_async_writes(DCR *dcr)
+{
+   DEVICE *dev = dcr->dev;
+   ASYNC_WRITER *aw = dev->aw;
+   bool ok = true;
+   bool mine = false;
+
+   if (!dcr->async_writes) {
+      return true;
+   }
+   dcr->async_writes = false;
+   if (aw) {
+      P(aw->mutex);
+      mine = aw->block && aw->dcr == dcr;
+      V(aw->mutex);
+   }
+   if (mine) {
+      dev->rLock(false);
+      ok = finish_async_write(dcr);
+      dev->Unlock();
+   }
+   free_block(dcr->ablock);
+   dcr->ablock = NULL;
+   return ok;
+}
+
+/*
+ * Stop the writer thread of a device that is being destroyed
+ */
+void term_async_writer(DEVICE *dev)
+{
+   ASYNC_WRITER *aw = dev->aw;
+
+   if (!aw) {
+      return;
+   }
+   P(aw->mutex);
+   aw->quit = true;
+   pthread_cond_broadcast(&aw->cond);
+   V(aw->mutex);
+   pthread_join(aw->thid, NULL);
+   pthread_cond_destroy(&aw->cond);
+   pthread_mutex_destroy(&aw->mutex);
+   free(aw);
+   dev->aw = NULL;
+}
+
+static void *async_writer_thread(void *arg)
+{
+   DEVICE *dev = (DEVICE *)arg;
+   ASYNC_WRITER *aw = dev->aw;
+   ssize_t stat;
+   int werrno;
+
+   P(aw->mutex);
+   for ( ;; ) {
+      while (!aw->busy && !aw->quit) {
+         pthread_cond_wait(&aw->cond, &aw->mutex);
+      }
+      if (!aw->busy) {
+         break;                       /* quit */
+      }
+      V(aw->mutex);
+      stat = write_serialized_block(aw->dcr, aw->block, aw->wlen);
+      werrno = errno;
+      P(aw->mutex);
+      aw->stat = stat;
+      aw->werrno = werrno;
+      aw->busy = false;
+      pthread_cond_broadcast(&aw->cond);
+   }
+   V(aw->mutex);
+   return NULL;
+}
@@ -30,6 +30,12 @@
 #include <lzo/lzoconf.h>
 #include <lzo/lzo1x.h>
 #endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
 extern bool parse_sd_config(CONFIG *config, const char *configfile, int exit_code);
 
@@ -50,6 +56,9 @@ static char *where;
 static uint32_t num_files = 0;
 static uint32_t compress_buf_size = 70000;
 static POOLMEM *compress_buf;
+#ifdef HAVE_ZSTD
+static ZSTD_DCtx *zstd_dctx = NULL;
+#endif
 static int prog_name_msg = 0;
 static int win32_data_msg = 0;
 static char *VolumeName = NULL;
@@ -267,6 +276,12 @@ static void do_extract(char *devname)
    free_attr(attr);
    free_jcr(jcr);
    dev->term();
+#ifdef HAVE_ZSTD
+   if (zstd_dctx) {
+      ZSTD_freeDCtx(zstd_dctx);
+      zstd_dctx = NULL;
+   }
+#endif
 
    printf(_("%u files restored.\n"), num_files);
    return;
@@ -548,6 +563,75 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
                fileAddr += compress_len;
                Dmsg2(100, "Compress len=%d uncompressed=%d\n", rec->data_len, compress_len);
                break;
+#endif
+#ifdef HAVE_ZSTD
+            case COMPRESS_ZSTD: {
+               const char *zbuf = wbuf + sizeof(comp_stream_header);
+               unsigned long long zsize;
+               size_t zstat;
+
+               if (!zstd_dctx && !(zstd_dctx = ZSTD_createDCtx())) {
+                  Emsg0(M_ERROR, 0, _("zstd decompression context allocation failed\n"));
+                  extract = false;
+                  return true;
+               }
+               zsize = ZSTD_getFrameContentSize(zbuf, comp_len);
+               if (zsize == ZSTD_CONTENTSIZE_ERROR || zsize == ZSTD_CONTENTSIZE_UNKNOWN ||
+                   zsize > 0x7fffffff) {
+                  Emsg0(M_ERROR, 0, _("zstd uncompression error. ERR=bad frame header\n"));
+                  extract = false;
+                  return true;
+               }
+               if (zsize > compress_buf_size) {
+                  compress_buf_size = zsize;
+                  compress_buf = check_pool_memory_size(compress_buf, compress_buf_size);
+               }
+               zstat = ZSTD_decompressDCtx(zstd_dctx, compress_buf, compress_buf_size,
+                                           zbuf, comp_len);
+               if (ZSTD_isError(zstat)) {
+                  Emsg1(M_ERROR, 0, _("zstd uncompression error. ERR=%s\n"),
+                        ZSTD_getErrorName(zstat));
+                  extract = false;
+                  return true;
+               }
+               Dmsg2(100, "Write uncompressed %d bytes, total before write=%d\n", (int)zstat, total);
+               store_data(&bfd, compress_buf, zstat);
+               total += zstat;
+               fileAddr += zstat;
+               Dmsg2(100, "Compress len=%d uncompressed=%d\n", rec->data_len, (int)zstat);
+               break;
+            }
+#endif
+#ifdef HAVE_LZ4
+            case COMPRESS_LZ4: {
+               uint32_t lz4size = 0;
+               int lz4len = -1;
+
+               /* The LZ4 block is preceded by its uncompressed size */
+               if (comp_len >= sizeof(uint32_t)) {
+                  unser_begin(wbuf + sizeof(comp_stream_header), sizeof(uint32_t));
+                  unser_uint32(lz4size);
+                  if (lz4size <= 0x7fffffff) {
+                     if (lz4size > compress_buf_size) {
+                        compress_buf_size = lz4size;
+                        compress_buf = check_pool_memory_size(compress_buf, compress_buf_size);
+                     }
+                     lz4len = LZ4_decompress_safe(wbuf + sizeof(comp_stream_header) + sizeof(uint32_t),
+                                 compress_buf, comp_len - sizeof(uint32_t), lz4size);
+                  }
+               }
+               if (lz4len < 0 || (uint32_t)lz4len != lz4size) {
+                  Emsg1(M_ERROR, 0, _("LZ4 uncompression error. ERR=%d\n"), lz4len);
+                  extract = false;
+                  return true;
+               }
+               Dmsg2(100, "Write uncompressed %d bytes, total before write=%d\n", lz4len, total);
+               store_data(&bfd, compress_buf, lz4len);
+               total += lz4len;
+               fileAddr += lz4len;
+               Dmsg2(100, "Compress len=%d uncompressed=%d\n", rec->data_len, lz4len);
+               break;
+            }
 #endif
             default:
                Emsg1(M_ERROR, 0, _("Compression algorithm 0x%x found, but not supported!\n"), comp_magic);
@@ -562,6 +646,7 @@ static bool record_cb(DCR *dcr, DEV_RECORD *rec)
    case STREAM_SHA1_DIGEST:
    case STREAM_SHA256_DIGEST:
    case STREAM_SHA512_DIGEST:
+   case STREAM_XXH64_DIGEST:
       break;
 
    case STREAM_SIGNED_DIGEST:
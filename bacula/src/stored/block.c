@@ -69,13 +69,19 @@ bool DCR::write_block_to_device()
       dev->rLock(false);          /* no, lock it */
    }
 
+   /* Complete the block that is still being written, if any */
+   if (!finish_async_write(dcr)) {
+      stat = false;
+      goto bail_out;
+   }
+
    if (!check_for_newvol_or_newfile(dcr)) {
       stat = false;
       goto bail_out;   /* fatal error */
    }
 
    Dmsg1(500, "Write block to dev=%p\n", dcr->dev);
-   if (!write_block_to_dev()) {
+   if (!write_block_to_dev(dcr->async_writes)) {
       if (job_canceled(jcr) || jcr->getJobType() == JT_SYSTEM) {
          stat = false;
          Dmsg2(40, "cancel=%d or SYSTEM=%d\n", job_canceled(jcr),
@@ -97,14 +103,18 @@ bail_out:
 /*
  * Write a block to the device
  *
+ *  If async is set, the serialized block may be handed to the
+ *  writer thread of the device, in which case dcr->block is
+ *  replaced by an empty block and the result of the write is
+ *  known only in finish_async_write().
+ *
  *  Returns: true  on success or EOT
  *           false on hard error
  */
-bool DCR::write_block_to_dev()
+bool DCR::write_block_to_dev(bool async)
 {
    ssize_t stat = 0;
    uint32_t wlen;                     /* length to write */
-   bool ok = true;
    DCR *dcr = this;
    uint32_t checksum;
    uint32_t pad;                      /* padding or zeros written */
@@ -200,13 +210,44 @@ bool DCR::write_block_to_dev()
    }
 #endif
 
-   /*
-    * Do write here, make a somewhat feeble attempt to recover from
-    *  I/O errors, or from the OS telling us it is busy.
-    */
+   if (async && submit_async_write(dcr, wlen)) {
+      return true;
+   }
+
+   stat = write_serialized_block(dcr, block, wlen);
+
+   if (debug_block_checksum) {
+      uint32_t achecksum = ser_block_header(block, dev->do_checksum());
+      if (checksum != achecksum) {
+         Jmsg2(jcr, M_ERROR, 0, _("Block checksum changed during write: before=%ud after=%ud\n"),
+            checksum, achecksum);
+         dump_block(block, "with checksum error");
+      }
+   }
+
+#ifdef DEBUG_BLOCK_ZEROING
+   if (bp[0] == 0 && bp[1] == 0 && bp[2] == 0 && block->buf[12] == 0) {
+      Jmsg0(jcr, M_ABORT, 0, _("Write block header zeroed.\n"));
+   }
+#endif
+
+   return finish_block_write(dcr, block, stat, wlen);
+}
+
+/*
+ * Do write here, make a somewhat feeble attempt to recover from
+ *  I/O errors, or from the OS telling us it is busy.
+ *
+ * Called by write_block_to_dev() and by the writer thread of the
+ *  device, so it must not touch anything but the device I/O.
+ */
+ssize_t write_serialized_block(DCR *dcr, DEV_BLOCK *block, uint32_t wlen)
+{
+   DEVICE *dev = dcr->dev;
+   ssize_t stat = 0;
    int retry = 0;
+
    errno = 0;
-   stat = 0;
    do {
       if (retry > 0 && stat == -1 && errno == EBUSY) {
          berrno be;
@@ -220,21 +261,22 @@ bool DCR::write_block_to_dev()
          block->BlockAddr, dev->lseek(dcr, 0, SEEK_CUR),
          dev->VolHdr.VolumeName, wlen);
    } while (stat == -1 && (errno == EBUSY || errno == EIO) && retry++ < 3);
+   return stat;
+}
 
-   if (debug_block_checksum) {
-      uint32_t achecksum = ser_block_header(block, dev->do_checksum());
-      if (checksum != achecksum) {
-         Jmsg2(jcr, M_ERROR, 0, _("Block checksum changed during write: before=%ud after=%ud\n"),
-            checksum, achecksum);
-         dump_block(block, "with checksum error");
-      }
-   }
-
-#ifdef DEBUG_BLOCK_ZEROING
-   if (bp[0] == 0 && bp[1] == 0 && bp[2] == 0 && block->buf[12] == 0) {
-      Jmsg0(jcr, M_ABORT, 0, _("Write block header zeroed.\n"));
-   }
-#endif
+/*
+ * Account for the write of block by dcr, or handle the error
+ *  if the write returned something else than wlen. errno
+ *  must still be the one set by the write.
+ *
+ *  Returns: true  on success
+ *           false on EOT or hard error
+ */
+bool finish_block_write(DCR *dcr, DEV_BLOCK *block, ssize_t stat, uint32_t wlen)
+{
+   DEVICE *dev = dcr->dev;
+   JCR *jcr = dcr->jcr;
+   bool ok;
 
    if (stat != (ssize_t)wlen) {
       /* Some devices simply report EIO when the volume is full.
@@ -592,6 +634,9 @@ reread:
       dev->file_addr = pos;
       dev->file_size = pos;
    }
+   if (dev->is_file()) {
+      dev->read_ahead(dcr);
+   }
    Dmsg3(150, "Exit read_block read_len=%d block_len=%d binbuf=%d\n",
       block->read_len, block->block_len, block->binbuf);
    block->block_read = true;
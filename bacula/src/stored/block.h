@@ -125,4 +125,27 @@ struct DEV_BLOCK {
 
 #define block_is_empty(block) ((block)->read_len == 0)
 
+class DCR;                            /* for forward reference */
+
+/*
+ * Asynchronous block writer of a device (see async_write.c).
+ *  At most one block is in flight. The DCR that submitted it
+ *  keeps filling its spare block, and gets the written block
+ *  back before it writes the next one.
+ */
+struct ASYNC_WRITER {
+   pthread_t thid;                    /* writer thread */
+   pthread_mutex_t mutex;             /* protects the fields below */
+   pthread_cond_t cond;               /* signaled on every state change */
+   DCR *dcr;                          /* owner of the block in flight */
+   DEV_BLOCK *block;                  /* block in flight, NULL if none */
+   uint32_t wlen;                     /* bytes to write */
+   ssize_t stat;                      /* result of the write */
+   int werrno;                        /* errno of the write */
+   bool busy;                         /* set until the write returns */
+   bool accounted;                    /* write accounted by another DCR */
+   bool passed;                       /* write failed, another DCR went on */
+   bool quit;                         /* set to stop the thread */
+};
+
 #endif
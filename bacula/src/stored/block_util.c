@@ -173,6 +173,10 @@ void DCR::free_blocks()
    if (block) {
       free_block(block);
    }
+   if (ablock) {
+      free_block(ablock);
+      ablock = NULL;
+   }
 }
 
 /*
@@ -84,7 +84,6 @@ struct BSR_VOLFILE {
    BSR_VOLFILE *next;
    uint32_t sfile;                    /* start file */
    uint32_t efile;                    /* end file */
-   bool done;                         /* local done */
 };
 
 struct BSR_VOLBLOCK {
@@ -98,14 +97,12 @@ struct BSR_VOLADDR {
    BSR_VOLADDR *next;
    uint64_t saddr;                   /* start address */
    uint64_t eaddr;                   /* end address */
-   bool done;                        /* local done */
 };
 
 struct BSR_FINDEX {
    BSR_FINDEX *next;
    int32_t findex;                    /* start file index */
    int32_t findex2;                   /* end file index */
-   bool done;                         /* local done */
 };
 
 struct BSR_JOBID {
@@ -135,6 +132,26 @@ struct BSR_STREAM {
    int32_t stream;                    /* stream desired */
 };
 
+/*
+ * The FileIndex, VolAddr, VolFile and VolSessionId ranges of a bsr
+ *  sorted by start value, see build_bsr_index() in match_bsr.c.
+ *  A range is done when a greater value than its end was read,
+ *  a value matches when it is in a range that is not done.
+ */
+struct BSR_RANGE {
+   uint64_t start;                    /* first value */
+   uint64_t end;                      /* last value */
+   uint64_t end_max;                  /* greatest end of this and previous ranges */
+};
+
+struct BSR_RANGES {
+   BSR_RANGE *range;                  /* count ranges, NULL if none */
+   int32_t count;
+   int32_t cursor;                    /* range of the last lookup */
+   uint64_t high;                     /* greatest value read */
+   bool seen;                         /* set when high is valid */
+};
+
 struct BSR {
    /* NOTE!!! next must be the first item */
    BSR          *next;                /* pointer to next one */
@@ -158,12 +175,17 @@ struct BSR {
    BSR_JOB      *job;
    BSR_CLIENT   *client;
    BSR_FINDEX   *FileIndex;
+   BSR_FINDEX   *last_FileIndex;      /* end of the FileIndex list */
    BSR_JOBTYPE  *JobType;
    BSR_JOBLEVEL *JobLevel;
    BSR_STREAM   *stream;
    char         *fileregex;           /* set if restore is filtered on filename */
    regex_t      *fileregex_re;
    ATTR         *attr;                /* scratch space for unpacking */
+   BSR_RANGES    volfile_index;       /* sorted copies of the lists above */
+   BSR_RANGES    voladdr_index;
+   BSR_RANGES    sessid_index;
+   BSR_RANGES    findex_index;
 };
 
 
@@ -881,6 +881,7 @@ void DEVICE::term(void)
 {
    DEVICE *dev = NULL;
    Dmsg1(900, "term dev: %s\n", print_name());
+   term_async_writer(this);
    close();
    if (dev_name) {
       free_memory(dev_name);
@@ -121,6 +121,8 @@ enum {
 #define CAP_REQMOUNT       (1<<21)    /* Require mount/unmount */
 #define CAP_CHECKLABELS    (1<<22)    /* Check for ANSI/IBM labels */
 #define CAP_BLOCKCHECKSUM  (1<<23)    /* Create/test block checksum */
+#define CAP_ASYNCWRITES    (1<<24)    /* Write blocks from a writer thread */
+#define CAP_DIRECTIO       (1<<25)    /* O_DIRECT writes, keep Volumes out of the cache */
 
 /* Test state */
 #define dev_state(dev, st_state) ((dev)->state & (st_state))
@@ -203,6 +205,7 @@ class VOLRES; /* forward reference */
 class DEVICE: public SMARTALLOC {
 protected:
    int m_fd;                          /* file descriptor */
+   int m_dio_fd;                      /* O_DIRECT descriptor of a file Volume */
 private:
    int m_blocked;                     /* set if we must wait (i.e. change tape) */
    int m_count;                       /* Mutex use count -- DEBUG only */
@@ -285,6 +288,12 @@ public:
    DEVRES *device;                    /* pointer to Device Resource */
    VOLRES *vol;                       /* Pointer to Volume reservation item */
    btimer_t *tid;                     /* timer id */
+   ASYNC_WRITER *aw;                  /* asynchronous block writer */
+   char *dio_mem;                     /* O_DIRECT write buffer as allocated */
+   char *dio_buf;                     /* aligned O_DIRECT write buffer */
+   uint32_t dio_size;                 /* size of dio_buf */
+   uint64_t ra_addr;                  /* end of the read ahead asked */
+   uint64_t drop_addr;                /* start of the Volume still cached */
 
    VOLUME_CAT_INFO VolCatInfo;        /* Volume Catalog Information */
    VOLUME_LABEL VolHdr;               /* Actual volume label */
@@ -309,6 +318,7 @@ public:
    btime_t  DevWriteTime;
    uint64_t DevWriteBytes;
    uint64_t DevReadBytes;
+   uint64_t DevReadAheadBytes;
 
    /* Methods */
    btime_t get_timer_count();         /* return the last timer interval (ms) */
@@ -317,6 +327,9 @@ public:
    void clear_cap(int cap) { capabilities &= ~cap; }
    void set_cap(int cap) { capabilities |= cap; }
    bool do_checksum() const { return (capabilities & CAP_BLOCKCHECKSUM) != 0; }
+   bool do_async_writes() const { return (capabilities & CAP_ASYNCWRITES) != 0; }
+   bool do_direct_io() const { return (capabilities & CAP_DIRECTIO) != 0; }
+   bool is_direct_io() const { return m_dio_fd >= 0; }
    int is_autochanger() const { return capabilities & CAP_AUTOCHANGER; }
    int requires_mount() const { return capabilities & CAP_REQMOUNT; }
    int is_removable() const { return capabilities & CAP_REM; }
@@ -398,7 +411,7 @@ public:
    void clear_offline() { state &= ~ST_OFFLINE; };
    void clear_eot() { state &= ~ST_EOT; };
    void clear_eof() { state &= ~ST_EOF; };
-   void clear_opened() { m_fd = -1; };
+   void clear_opened() { m_fd = m_dio_fd = -1; };
    void clear_mounted() { state &= ~ST_MOUNTED; };
    void clear_media() { state &= ~ST_MEDIA; };
    void clear_short_block() { state &= ~ST_SHORT; };
@@ -466,6 +479,12 @@ public:
    uint32_t get_block_num();              /* in dev.c */
 
    int fd() const { return m_fd; };
+   void open_direct_io(const char *archive_name); /* in file_dev.c */
+   void close_direct_io();                /* in file_dev.c */
+   void read_ahead(DCR *dcr);             /* in file_dev.c */
+   void drop_cache(boffset_t pos);        /* in file_dev.c */
+   uint64_t read_ahead_queued() const {
+      return is_open() && ra_addr > file_addr ? ra_addr - file_addr : 0; };
 
    /* Virtual functions that can be overridden */
    virtual int d_ioctl(int fd, ioctl_req_t request, char *mt_com=NULL);
@@ -579,6 +598,7 @@ public:
    DEVICE *ameta_dev;                 /* pointer to ameta_dev */
    DEVRES *device;                    /* pointer to device resource */
    DEV_BLOCK *block;                  /* pointer to block */
+   DEV_BLOCK *ablock;                 /* spare block for async writes */
    DEV_RECORD *rec;                   /* pointer to record */
    pthread_t tid;                     /* Thread running this dcr */
    int spool_fd;                      /* fd if spooling */
@@ -593,6 +613,7 @@ public:
    bool any_volume;                   /* Any OK for dir_find_next... */
    bool attached_to_dev;              /* set when attached to dev */
    bool keep_dcr;                     /* do not free dcr in release_dcr */
+   bool async_writes;                 /* hand full blocks to dev->aw */
    uint32_t VolFirstIndex;            /* First file index this Volume */
    uint32_t VolLastIndex;             /* Last file index this Volume */
    uint32_t FileIndex;                /* Current File Index */
@@ -680,7 +701,7 @@ public:
    /* Methods in block.c */
    void free_blocks();
    bool write_block_to_device();
-   bool write_block_to_dev();
+   bool write_block_to_dev(bool async=false);
    bool read_block_from_device(bool check_block_numbers);
    bool read_block_from_dev(bool check_block_numbers);
 
@@ -28,6 +28,20 @@
 /* Imported functions */
 const char *mode_to_str(int mode);
 
+/*
+ * With "Direct IO = yes", the data of a file Volume is written with
+ *  O_DIRECT, and the part of the Volume that is read or written is
+ *  dropped from the page cache behind the job, so a multi-TB Volume
+ *  does not push everything else out of the cache.
+ *
+ *  "Read Ahead = <size>" asks the kernel to read that much of the
+ *  Volume ahead of the reader, limited to the parts the bootstrap
+ *  asks for when it gives the Volume addresses.
+ */
+static const uint32_t dio_align = 4096;      /* O_DIRECT alignment */
+static const uint64_t drop_lag = 4 * 1024 * 1024; /* kept in the cache */
+static const uint64_t drop_chunk = 1024 * 1024;   /* smallest range dropped */
+static const int max_ra_ranges = 64;         /* ranges asked per read ahead */
 
 /* default primitives are designed for file */
 int DEVICE::d_open(const char *pathname, int flags)
@@ -55,6 +69,200 @@ ssize_t DEVICE::d_write(int fd, const void *buffer, size_t count)
    return ::write(fd, buffer, count);
 }
 
+int file_dev::d_close(int fd)
+{
+   if (fd == m_fd) {
+      close_direct_io();
+   }
+   return ::close(fd);
+}
+
+/*
+ * Write with O_DIRECT the part of the buffer that covers whole
+ *  pages of the Volume, and through the cache the partial pages
+ *  at both ends, blocks are not page aligned on the Volume.
+ *  Returns like write(), with the file offset of m_fd after the
+ *  bytes written.
+ */
+ssize_t file_dev::d_write(int fd, const void *buffer, size_t count)
+{
+   const char *buf = (const char *)buffer;
+   boffset_t pos, start, end;
+   size_t head, mid, tail;
+   ssize_t stat;
+
+   if (fd != m_fd || m_dio_fd < 0) {
+      stat = ::write(fd, buffer, count);
+      if (fd == m_fd && stat > 0) {
+         drop_cache(file_addr);
+      }
+      return stat;
+   }
+   if ((pos = ::lseek(m_fd, 0, SEEK_CUR)) < 0) {
+      return -1;
+   }
+   start = (pos + dio_align - 1) & ~(boffset_t)(dio_align - 1);
+   end = (pos + count) & ~(boffset_t)(dio_align - 1);
+   if (end <= start || (size_t)(end - start) > dio_size) {
+      return ::write(m_fd, buffer, count);
+   }
+   head = start - pos;
+   mid = end - start;
+   tail = count - head - mid;
+
+   if (head > 0 && (stat = ::write(m_fd, buf, head)) != (ssize_t)head) {
+      return stat;
+   }
+   memcpy(dio_buf, buf + head, mid);
+   stat = pwrite(m_dio_fd, dio_buf, mid, start);
+   if (stat < 0 && errno == EINVAL) {
+      /* The filesystem does not accept O_DIRECT, continue without */
+      Dmsg1(100, "O_DIRECT write refused on %s, using buffered writes\n", print_name());
+      close_direct_io();
+      stat = ::write(m_fd, buf + head, count - head);
+      if (stat < 0) {
+         return head > 0 ? (ssize_t)head : -1;
+      }
+      return head + stat;
+   }
+   if (stat != (ssize_t)mid) {
+      if (stat <= 0) {
+         return head > 0 ? (ssize_t)head : -1;
+      }
+      ::lseek(m_fd, start + stat, SEEK_SET);
+      return head + stat;
+   }
+   ::lseek(m_fd, end, SEEK_SET);
+   if (tail > 0 && (stat = ::write(m_fd, buf + head + mid, tail)) != (ssize_t)tail) {
+      return head + mid + MAX(stat, 0);
+   }
+   drop_cache(end);
+   return count;
+}
+
+/*
+ * Open the O_DIRECT descriptor used by file_dev::d_write(). The
+ *  Volume stays open with m_fd for everything else. Without it,
+ *  the Volume is written through the cache as usual.
+ */
+void DEVICE::open_direct_io(const char *archive_name)
+{
+#ifdef O_DIRECT
+   uint32_t size;
+
+   if (!is_file() || !do_direct_io() || openmode == OPEN_READ_ONLY) {
+      return;
+   }
+   if ((m_dio_fd = ::open(archive_name, O_WRONLY|O_BINARY|O_DIRECT)) < 0) {
+      berrno be;
+      Dmsg2(100, "Cannot open %s with O_DIRECT: ERR=%s\n", archive_name, be.bstrerror());
+      return;
+   }
+   size = max_block_size ? max_block_size : DEFAULT_BLOCK_SIZE;
+   dio_size = (size + dio_align - 1) & ~(dio_align - 1);
+   dio_mem = (char *)malloc(dio_size + dio_align);
+   dio_buf = (char *)(((uintptr_t)dio_mem + dio_align - 1) &
+                      ~((uintptr_t)dio_align - 1));
+   Dmsg2(100, "open dev: %s O_DIRECT fd=%d opened\n", print_name(), m_dio_fd);
+#endif
+}
+
+void DEVICE::close_direct_io()
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+   if (do_direct_io() && m_fd >= 0) {
+      posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+   }
+#endif
+   if (m_dio_fd >= 0) {
+      ::close(m_dio_fd);
+      m_dio_fd = -1;
+   }
+   if (dio_mem) {
+      free(dio_mem);
+      dio_mem = dio_buf = NULL;
+      dio_size = 0;
+   }
+}
+
+/*
+ * With Direct IO, drop from the cache the part of the Volume that
+ *  was read or written more than drop_lag bytes before pos. The
+ *  pages still dirty are only scheduled for writeback by the kernel,
+ *  they are dropped by a later call.
+ */
+void DEVICE::drop_cache(boffset_t pos)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_DONTNEED)
+   uint64_t end;
+
+   if (!do_direct_io() || !is_file() || m_fd < 0) {
+      return;
+   }
+   if ((uint64_t)pos < drop_addr) {
+      drop_addr = pos;                /* repositioned backward */
+   }
+   if ((uint64_t)pos < drop_addr + drop_lag + drop_chunk) {
+      return;
+   }
+   end = pos - drop_lag;
+   posix_fadvise(m_fd, drop_addr, end - drop_addr, POSIX_FADV_DONTNEED);
+   drop_addr = end;
+#endif
+}
+
+/*
+ * Called after each block read from a file Volume. When less than
+ *  half of the read ahead window is already asked, ask the kernel
+ *  for the rest of the window, or only for the VolAddr ranges of
+ *  the bootstrap that fall in it.
+ */
+void DEVICE::read_ahead(DCR *dcr)
+{
+   drop_cache(file_addr);
+
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+   uint64_t window = device->read_ahead;
+   uint64_t limit, from, start, end;
+   BSR *bsr;
+   int i, stat;
+
+   if (!is_file() || window == 0 || m_fd < 0) {
+      return;
+   }
+   limit = file_addr + window;
+   if (ra_addr < file_addr || ra_addr > limit) {
+      ra_addr = file_addr;            /* repositioned */
+   }
+   if (limit - ra_addr < window / 2) {
+      return;
+   }
+   bsr = dcr->jcr ? dcr->jcr->bsr : NULL;
+   from = ra_addr;
+   for (i = 0; from < limit && i < max_ra_ranges; i++) {
+      stat = bsr ? get_bsr_next_range(bsr, VolHdr.VolumeName, from, &start, &end) : -1;
+      if (stat == 0) {
+         break;                       /* nothing more to read on this Volume */
+      }
+      if (stat < 0) {
+         start = from;                /* no addresses, read sequentially */
+         end = limit;
+      } else {
+         start = MAX(start, from);
+         end = MIN(end + 1, limit);   /* end of range is inclusive */
+         if (start >= limit) {
+            break;
+         }
+      }
+      Dmsg3(250, "Read ahead %s %lld-%lld\n", print_name(), start, end);
+      posix_fadvise(m_fd, start, end - start, POSIX_FADV_WILLNEED);
+      DevReadAheadBytes += end - start;
+      from = end;
+   }
+   ra_addr = limit;
+#endif
+}
+
 /* Rewind file device */
 bool DEVICE::rewind(DCR *dcr)
 {
@@ -176,6 +384,8 @@ void DEVICE::open_file_device(DCR *dcr, int omode)
       dev_errno = 0;
       file = 0;
       file_addr = 0;
+      ra_addr = drop_addr = 0;
+      open_direct_io(archive_name.c_str());
    }
    Dmsg1(100, "open dev: disk fd=%d opened\n", m_fd);
 }
@@ -236,6 +446,7 @@ bool DEVICE::truncate(DCR *dcr) /* We need the DCR for DVD-writing */
                print_name(), archive_name.c_str());
 
          /* Close file and blow it away */
+         dev->close_direct_io();
          ::close(dev->m_fd);
          ::unlink(archive_name.c_str());
 
@@ -253,6 +464,7 @@ bool DEVICE::truncate(DCR *dcr) /* We need the DCR for DVD-writing */
 
          /* Reset proper owner */
          chown(archive_name.c_str(), st.st_uid, st.st_gid);
+         dev->open_direct_io(archive_name.c_str());
       }
       return true;
    }
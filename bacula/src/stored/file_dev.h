@@ -25,6 +25,10 @@ public:
 
    file_dev() { };
    ~file_dev() { m_fd = -1; };
+
+   /* Direct IO versions of the default primitives, in file_dev.c */
+   int d_close(int fd);
+   ssize_t d_write(int fd, const void *buffer, size_t count);
 };
 
 #endif /* __FILE_DEV_ */
@@ -43,22 +43,258 @@ const int dbglevel = 500;
 /* Forward references */
 static int match_volume(BSR *bsr, BSR_VOLUME *volume, VOLUME_LABEL *volrec, bool done);
 static int match_sesstime(BSR *bsr, BSR_SESSTIME *sesstime, DEV_RECORD *rec, bool done);
-static int match_sessid(BSR *bsr, BSR_SESSID *sessid, DEV_RECORD *rec);
+static int match_sessid(BSR *bsr, DEV_RECORD *rec);
 static int match_client(BSR *bsr, BSR_CLIENT *client, SESSION_LABEL *sessrec, bool done);
 static int match_job(BSR *bsr, BSR_JOB *job, SESSION_LABEL *sessrec, bool done);
 static int match_job_type(BSR *bsr, BSR_JOBTYPE *job_type, SESSION_LABEL *sessrec, bool done);
 static int match_job_level(BSR *bsr, BSR_JOBLEVEL *job_level, SESSION_LABEL *sessrec, bool done);
 static int match_jobid(BSR *bsr, BSR_JOBID *jobid, SESSION_LABEL *sessrec, bool done);
-static int match_findex(BSR *bsr, BSR_FINDEX *findex, DEV_RECORD *rec, bool done);
-static int match_volfile(BSR *bsr, BSR_VOLFILE *volfile, DEV_RECORD *rec, bool done);
-static int match_voladdr(BSR *bsr, BSR_VOLADDR *voladdr, DEV_RECORD *rec, bool done);
+static int match_findex(BSR *bsr, DEV_RECORD *rec);
+static int match_volfile(BSR *bsr, DEV_RECORD *rec);
+static int match_voladdr(BSR *bsr, DEV_RECORD *rec);
 static int match_stream(BSR *bsr, BSR_STREAM *stream, DEV_RECORD *rec, bool done);
-static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec, SESSION_LABEL *sessrec, bool done, JCR *jcr);
+static int match_one(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec, SESSION_LABEL *sessrec, JCR *jcr);
+static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec, SESSION_LABEL *sessrec, JCR *jcr);
 static int match_block_sesstime(BSR *bsr, BSR_SESSTIME *sesstime, DEV_BLOCK *block);
-static int match_block_sessid(BSR *bsr, BSR_SESSID *sessid, DEV_BLOCK *block);
 static BSR *find_smallest_volfile(BSR *fbsr, BSR *bsr);
 
 
+/*********************************************************************
+ *
+ *  Range index
+ *
+ *  Each list of FileIndex, VolAddr, VolFile and VolSessionId ranges
+ *   of a bsr is copied into an array sorted by start value, where
+ *   each range also has the greatest end of the ranges up to it.
+ *   The range that can hold a value is then found by a binary
+ *   search, or directly in the usual case where the value is in the
+ *   range of the previous lookup or in the next one, and the value
+ *   matches if that greatest end is not below the greatest value
+ *   read so far (i.e. some range holding it is not done).
+ *
+ *  Values are read in increasing order within a session, so this
+ *   gives the same result as walking the lists.
+ */
+static int compare_range(const void *a, const void *b)
+{
+   const BSR_RANGE *r1 = (const BSR_RANGE *)a;
+   const BSR_RANGE *r2 = (const BSR_RANGE *)b;
+
+   if (r1->start < r2->start) {
+      return -1;
+   }
+   return r1->start > r2->start ? 1 : 0;
+}
+
+static void init_ranges(BSR_RANGES *ranges, int32_t count)
+{
+   memset(ranges, 0, sizeof(BSR_RANGES));
+   if (count > 0) {
+      ranges->range = (BSR_RANGE *)malloc(count * sizeof(BSR_RANGE));
+   }
+}
+
+static void add_range(BSR_RANGES *ranges, uint64_t start, uint64_t end)
+{
+   BSR_RANGE *r = &ranges->range[ranges->count++];
+   r->start = start;
+   r->end = end;
+}
+
+static void sort_ranges(BSR_RANGES *ranges)
+{
+   uint64_t end_max = 0;
+
+   qsort(ranges->range, ranges->count, sizeof(BSR_RANGE), compare_range);
+   for (int32_t i = 0; i < ranges->count; i++) {
+      end_max = MAX(end_max, ranges->range[i].end);
+      ranges->range[i].end_max = end_max;
+   }
+}
+
+/*
+ * Build the range index of each bsr of the chain, called once
+ *  the bootstrap file is parsed.
+ */
+void build_bsr_index(BSR *root_bsr)
+{
+   int32_t count;
+
+   for (BSR *bsr = root_bsr; bsr; bsr = bsr->next) {
+      count = 0;
+      for (BSR_VOLFILE *vf = bsr->volfile; vf; vf = vf->next) {
+         count++;
+      }
+      init_ranges(&bsr->volfile_index, count);
+      for (BSR_VOLFILE *vf = bsr->volfile; vf; vf = vf->next) {
+         add_range(&bsr->volfile_index, vf->sfile, vf->efile);
+      }
+      sort_ranges(&bsr->volfile_index);
+
+      count = 0;
+      for (BSR_VOLADDR *va = bsr->voladdr; va; va = va->next) {
+         count++;
+      }
+      init_ranges(&bsr->voladdr_index, count);
+      for (BSR_VOLADDR *va = bsr->voladdr; va; va = va->next) {
+         add_range(&bsr->voladdr_index, va->saddr, va->eaddr);
+      }
+      sort_ranges(&bsr->voladdr_index);
+
+      count = 0;
+      for (BSR_SESSID *sid = bsr->sessid; sid; sid = sid->next) {
+         count++;
+      }
+      init_ranges(&bsr->sessid_index, count);
+      for (BSR_SESSID *sid = bsr->sessid; sid; sid = sid->next) {
+         add_range(&bsr->sessid_index, sid->sessid, sid->sessid2);
+      }
+      sort_ranges(&bsr->sessid_index);
+
+      count = 0;
+      for (BSR_FINDEX *fi = bsr->FileIndex; fi; fi = fi->next) {
+         count++;
+      }
+      init_ranges(&bsr->findex_index, count);
+      for (BSR_FINDEX *fi = bsr->FileIndex; fi; fi = fi->next) {
+         add_range(&bsr->findex_index, fi->findex, fi->findex2);
+      }
+      sort_ranges(&bsr->findex_index);
+   }
+}
+
+void free_bsr_index(BSR *bsr)
+{
+   BSR_RANGES *ranges[] = { &bsr->volfile_index, &bsr->voladdr_index,
+                            &bsr->sessid_index, &bsr->findex_index };
+
+   for (int i = 0; i < 4; i++) {
+      if (ranges[i]->range) {
+         free(ranges[i]->range);
+      }
+      memset(ranges[i], 0, sizeof(BSR_RANGES));
+   }
+}
+
+/*
+ * Returns: the last range that starts at or before value
+ *          -1 if there is none
+ */
+static int32_t search_range(BSR_RANGES *ranges, uint64_t value)
+{
+   BSR_RANGE *r = ranges->range;
+   int32_t lo, hi, mid;
+
+   lo = 0;
+   hi = ranges->count - 1;
+   while (lo <= hi) {
+      mid = (lo + hi) / 2;
+      if (r[mid].start <= value) {
+         lo = mid + 1;
+      } else {
+         hi = mid - 1;
+      }
+   }
+   return hi;
+}
+
+/*
+ * Same as search_range(), starting with the range of the last
+ *  lookup.
+ */
+static int32_t find_range(BSR_RANGES *ranges, uint64_t value)
+{
+   BSR_RANGE *r = ranges->range;
+   int32_t n = ranges->count;
+   int32_t i = ranges->cursor;
+
+   /* Same range as the last time, or the next one */
+   for (int k = 0; k < 2 && i < n; k++, i++) {
+      if (r[i].start <= value && (i + 1 == n || r[i + 1].start > value)) {
+         ranges->cursor = i;
+         return i;
+      }
+   }
+   i = search_range(ranges, value);
+   if (i >= 0) {
+      ranges->cursor = i;
+   }
+   return i;
+}
+
+/*
+ * Returns: true if value is in a range
+ *  With done set, value is also recorded as read, and the
+ *  ranges that end before the greatest value read are ignored.
+ */
+static bool match_range(BSR_RANGES *ranges, uint64_t value, bool done)
+{
+   uint64_t low = value;
+   int32_t i;
+
+   if (done) {
+      if (!ranges->seen || value > ranges->high) {
+         ranges->high = value;
+         ranges->seen = true;
+      }
+      low = ranges->high;
+   }
+   i = find_range(ranges, value);
+   return i >= 0 && ranges->range[i].end_max >= low;
+}
+
+/*
+ * Same as match_range(), but the value is never recorded as read
+ */
+static bool peek_range(BSR_RANGES *ranges, uint64_t value, bool done)
+{
+   uint64_t low = value;
+   int32_t i;
+
+   if (done && ranges->seen && ranges->high > low) {
+      low = ranges->high;
+   }
+   i = search_range(ranges, value);
+   return i >= 0 && ranges->range[i].end_max >= low;
+}
+
+/*
+ * Returns: true if all the ranges end before the greatest value read
+ */
+static bool ranges_done(BSR_RANGES *ranges)
+{
+   return ranges->seen && ranges->count > 0 &&
+          ranges->high > ranges->range[ranges->count - 1].end_max;
+}
+
+/*
+ * Get the smallest start of the ranges that are not done
+ *
+ * Returns: false if they are all done
+ */
+static bool first_pending_range(BSR_RANGES *ranges, uint64_t *start)
+{
+   BSR_RANGE *r = ranges->range;
+   int32_t lo = 0, hi = ranges->count - 1, mid;
+
+   if (ranges->count == 0 || ranges_done(ranges)) {
+      return false;
+   }
+   if (ranges->seen) {
+      /* end_max grows, find the first range that ends after high */
+      while (lo < hi) {
+         mid = (lo + hi) / 2;
+         if (r[mid].end_max >= ranges->high) {
+            hi = mid;
+         } else {
+            lo = mid + 1;
+         }
+      }
+   }
+   *start = r[lo].start;
+   return true;
+}
+
 /*********************************************************************
  *
  *  If possible, position the archive device (tape) to read the
@@ -91,7 +327,8 @@ int match_bsr_block(BSR *bsr, DEV_BLOCK *block)
       if (!match_block_sesstime(bsr, bsr->sesstime, block)) {
          continue;
       }
-      if (!match_block_sessid(bsr, bsr->sessid, block)) {
+      if (bsr->sessid_index.count &&
+          !match_range(&bsr->sessid_index, block->VolSessionId, false)) {
          continue;
       }
       return 1;
@@ -99,30 +336,68 @@ int match_bsr_block(BSR *bsr, DEV_BLOCK *block)
    return 0;
 }
 
-static int match_block_sesstime(BSR *bsr, BSR_SESSTIME *sesstime, DEV_BLOCK *block)
+/*
+ * Tell, without changing the state of the bsrs, if match_bsr()
+ *  would surely select this data record: the first bsr that
+ *  matches it up to the FileIndex must be one created by Bacula
+ *  (with a count), and without a file regex. The records of a
+ *  block that are all selected can then be copied as they are.
+ *
+ *   returns:  true  if the record would be selected
+ *             false if it would not or if we cannot tell
+ */
+bool is_record_selected(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec)
 {
-   if (!sesstime) {
-      return 1;                       /* no specification matches all */
-   }
-   if (sesstime->sesstime == block->VolSessionTime) {
-      return 1;
+   if (rec->FileIndex < 0) {
+      return false;
    }
-   if (sesstime->next) {
-      return match_block_sesstime(bsr, sesstime->next, block);
+   for ( ; bsr; bsr=bsr->next) {
+      if (bsr->done || !match_volume(bsr, bsr->volume, volrec, 1)) {
+         continue;
+      }
+      if (bsr->volfile && !peek_range(&bsr->volfile_index, rec->File, true)) {
+         continue;
+      }
+      if (bsr->voladdr &&
+          !peek_range(&bsr->voladdr_index, get_record_address(rec), true)) {
+         continue;
+      }
+      if (bsr->sesstime) {
+         BSR_SESSTIME *st;
+         for (st = bsr->sesstime; st; st = st->next) {
+            if (st->sesstime == rec->VolSessionTime) {
+               break;
+            }
+         }
+         if (!st) {
+            continue;
+         }
+      }
+      if (bsr->sessid &&
+          !peek_range(&bsr->sessid_index, rec->VolSessionId, false)) {
+         continue;
+      }
+      if (!bsr->FileIndex || !bsr->count || bsr->fileregex_re) {
+         return false;                /* other selections follow */
+      }
+      if (!peek_range(&bsr->findex_index, rec->FileIndex, true)) {
+         continue;
+      }
+      return true;
    }
-   return 0;
+   return false;
 }
 
-static int match_block_sessid(BSR *bsr, BSR_SESSID *sessid, DEV_BLOCK *block)
+static int match_block_sesstime(BSR *bsr, BSR_SESSTIME *sesstime, DEV_BLOCK *block)
 {
-   if (!sessid) {
+   if (!sesstime) {
       return 1;                       /* no specification matches all */
    }
-   if (sessid->sessid <= block->VolSessionId && sessid->sessid2 >= block->VolSessionId) {
+   if (sesstime->sesstime == block->VolSessionTime) {
       return 1;
    }
-   if (sessid->next) {
-      return match_block_sessid(bsr, sessid->next, block);
+   if (sesstime->next) {
+      return match_block_sesstime(bsr, sesstime->next, block);
    }
    return 0;
 }
@@ -176,7 +451,7 @@ int match_bsr(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec, SESSION_LABEL *se
     */
    if (bsr) {
       bsr->reposition = false;
-      stat = match_all(bsr, rec, volrec, sessrec, true, jcr);
+      stat = match_all(bsr, rec, volrec, sessrec, jcr);
       /*
        * Note, bsr->reposition is set by match_all when
        *  a bsr is done. We turn it off if a match was
@@ -235,38 +510,11 @@ BSR *find_next_bsr(BSR *root_bsr, DEVICE *dev)
 }
 
 /*
- * Get the smallest address from this voladdr part
- * Don't use "done" elements
- */
-static bool get_smallest_voladdr(BSR_VOLADDR *va, uint64_t *ret)
-{
-   bool ok=false;
-   uint64_t min_val=0;
-
-   for (; va ; va = va->next) {
-      if (!va->done) {
-         if (ok) {
-            min_val = MIN(min_val, va->saddr);
-         } else {
-            min_val = va->saddr;
-            ok=true;
-         }
-      }
-   }
-   *ret = min_val;
-   return ok;
-}
-
-/* FIXME
- * This routine needs to be fixed to only look at items that
- *   are not marked as done.  Otherwise, it can find a bsr
- *   that has already been consumed, and this will cause the
- *   bsr to be used, thus we may seek back and re-read the
- *   same records, causing an error.  This deficiency must
- *   be fixed.  For the moment, it has been kludged in
- *   read_record.c to avoid seeking back if find_next_bsr
- *   returns a bsr pointing to a smaller address (file/block).
- *
+ * With VolAddr, only the addresses that are not done are compared.
+ *  The VolFile/VolBlock comparison still looks at all the items,
+ *  it has been kludged in read_record.c to avoid seeking back if
+ *  find_next_bsr returns a bsr pointing to a smaller address
+ *  (file/block).
  */
 static BSR *find_smallest_volfile(BSR *found_bsr, BSR *bsr)
 {
@@ -278,8 +526,8 @@ static BSR *find_smallest_volfile(BSR *found_bsr, BSR *bsr)
    uint64_t found_bsr_saddr, bsr_saddr;
 
    /* if we have VolAddr, use it, else try with File and Block */
-   if (get_smallest_voladdr(found_bsr->voladdr, &found_bsr_saddr)) {
-      if (get_smallest_voladdr(bsr->voladdr, &bsr_saddr)) {
+   if (first_pending_range(&found_bsr->voladdr_index, &found_bsr_saddr)) {
+      if (first_pending_range(&bsr->voladdr_index, &bsr_saddr)) {
          if (found_bsr_saddr > bsr_saddr) {
             return bsr;
          } else {
@@ -367,61 +615,59 @@ bool is_this_bsr_done(BSR *bsr, DEV_RECORD *rec)
 }
 
 /*
- * Match all the components of current record
+ * Match all the components of current record with one bsr
  *   returns  1 on match
  *   returns  0 no match
- *   returns -1 no additional matches possible
  */
-static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
-                     SESSION_LABEL *sessrec, bool done, JCR *jcr)
+static int match_one(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
+                     SESSION_LABEL *sessrec, JCR *jcr)
 {
-   Dmsg0(dbglevel, "Enter match_all\n");
    if (bsr->done) {
 //    Dmsg0(dbglevel, "bsr->done set\n");
-      goto no_match;
+      return 0;
    }
    if (!match_volume(bsr, bsr->volume, volrec, 1)) {
       Dmsg2(dbglevel, "bsr fail bsr_vol=%s != rec read_vol=%s\n", bsr->volume->VolumeName,
             volrec->VolumeName);
-      goto no_match;
+      return 0;
    }
    Dmsg2(dbglevel, "OK bsr match bsr_vol=%s read_vol=%s\n", bsr->volume->VolumeName,
             volrec->VolumeName);
 
-   if (!match_volfile(bsr, bsr->volfile, rec, 1)) {
+   if (!match_volfile(bsr, rec)) {
       if (bsr->volfile) {
          Dmsg3(dbglevel, "Fail on file=%u. bsr=%u,%u\n",
                rec->File, bsr->volfile->sfile, bsr->volfile->efile);
       }
-      goto no_match;
+      return 0;
    }
 
-   if (!match_voladdr(bsr, bsr->voladdr, rec, 1)) {
+   if (!match_voladdr(bsr, rec)) {
       if (bsr->voladdr) {
          Dmsg3(dbglevel, "Fail on Addr=%llu. bsr=%llu,%llu\n",
                get_record_address(rec), bsr->voladdr->saddr, bsr->voladdr->eaddr);
       }
-      goto no_match;
+      return 0;
    }
 
    if (!match_sesstime(bsr, bsr->sesstime, rec, 1)) {
       Dmsg2(dbglevel, "Fail on sesstime. bsr=%u rec=%u\n",
          bsr->sesstime->sesstime, rec->VolSessionTime);
-      goto no_match;
+      return 0;
    }
 
    /* NOTE!! This test MUST come after the sesstime test */
-   if (!match_sessid(bsr, bsr->sessid, rec)) {
+   if (!match_sessid(bsr, rec)) {
       Dmsg2(dbglevel, "Fail on sessid. bsr=%u rec=%u\n",
          bsr->sessid->sessid, rec->VolSessionId);
-      goto no_match;
+      return 0;
    }
 
    /* NOTE!! This test MUST come after sesstime and sessid tests */
-   if (!match_findex(bsr, bsr->FileIndex, rec, 1)) {
+   if (!match_findex(bsr, rec)) {
       Dmsg3(dbglevel, "Fail on findex=%d. bsr=%d,%d\n",
          rec->FileIndex, bsr->FileIndex->findex, bsr->FileIndex->findex2);
-      goto no_match;
+      return 0;
    }
    if (bsr->FileIndex) {
       Dmsg3(dbglevel, "match on findex=%d. bsr=%d,%d\n",
@@ -430,13 +676,13 @@ static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
 
    if (!match_fileregex(bsr, rec, jcr)) {
      Dmsg1(dbglevel, "Fail on fileregex='%s'\n", NPRT(bsr->fileregex));
-     goto no_match;
+     return 0;
    }
 
    /* This flag is set by match_fileregex (and perhaps other tests) */
    if (bsr->skip_file) {
       Dmsg1(dbglevel, "Skipping findex=%d\n", rec->FileIndex);
-      goto no_match;
+      return 0;
    }
 
    /*
@@ -460,36 +706,51 @@ static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
     */
    if (!match_jobid(bsr, bsr->JobId, sessrec, 1)) {
       Dmsg0(dbglevel, "fail on JobId\n");
-      goto no_match;
+      return 0;
 
    }
    if (!match_job(bsr, bsr->job, sessrec, 1)) {
       Dmsg0(dbglevel, "fail on Job\n");
-      goto no_match;
+      return 0;
    }
    if (!match_client(bsr, bsr->client, sessrec, 1)) {
       Dmsg0(dbglevel, "fail on Client\n");
-      goto no_match;
+      return 0;
    }
    if (!match_job_type(bsr, bsr->JobType, sessrec, 1)) {
       Dmsg0(dbglevel, "fail on Job type\n");
-      goto no_match;
+      return 0;
    }
    if (!match_job_level(bsr, bsr->JobLevel, sessrec, 1)) {
       Dmsg0(dbglevel, "fail on Job level\n");
-      goto no_match;
+      return 0;
    }
    if (!match_stream(bsr, bsr->stream, rec, 1)) {
       Dmsg0(dbglevel, "fail on stream\n");
-      goto no_match;
+      return 0;
    }
    return 1;
+}
 
-no_match:
-   if (bsr->next) {
-      return match_all(bsr->next, rec, volrec, sessrec, bsr->done && done, jcr);
+/*
+ * Match all the components of current record with the bsr chain
+ *   returns  1 on match
+ *   returns  0 no match
+ *   returns -1 no additional matches possible
+ */
+static int match_all(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
+                     SESSION_LABEL *sessrec, JCR *jcr)
+{
+   bool done = true;
+
+   Dmsg0(dbglevel, "Enter match_all\n");
+   for ( ; bsr; bsr = bsr->next) {
+      if (match_one(bsr, rec, volrec, sessrec, jcr)) {
+         return 1;
+      }
+      done = done && bsr->done;
    }
-   if (bsr->done && done) {
+   if (done) {
       Dmsg0(dbglevel, "Leave match all -1\n");
       return -1;
    }
@@ -582,85 +843,42 @@ static int match_jobid(BSR *bsr, BSR_JOBID *jobid, SESSION_LABEL *sessrec, bool
    return 0;
 }
 
-static int match_volfile(BSR *bsr, BSR_VOLFILE *volfile, DEV_RECORD *rec, bool done)
+static int match_volfile(BSR *bsr, DEV_RECORD *rec)
 {
-   if (!volfile) {
+   if (!bsr->volfile) {
       return 1;                       /* no specification matches all */
    }
-/*
- * The following code is turned off because this should now work
- *   with disk files too, though since a "volfile" is 4GB, it does
- *   not improve performance much.
- */
-#ifdef xxx
-   /* For the moment, these tests work only with tapes. */
-   if (!(rec->state & REC_ISTAPE)) {
-      return 1;                       /* All File records OK for this match */
-   }
-   Dmsg3(dbglevel, "match_volfile: sfile=%u efile=%u recfile=%u\n",
-             volfile->sfile, volfile->efile, rec->File);
-#endif
-   if (volfile->sfile <= rec->File && volfile->efile >= rec->File) {
+   if (match_range(&bsr->volfile_index, rec->File, true)) {
       return 1;
    }
-   /* Once we get past last efile, we are done */
-   if (rec->File > volfile->efile) {
-      volfile->done = true;              /* set local done */
-   }
-   if (volfile->next) {
-      return match_volfile(bsr, volfile->next, rec, volfile->done && done);
-   }
-
-   /* If we are done and all prior matches are done, this bsr is finished */
-   if (volfile->done && done) {
+   /* Once we get past last efile, this bsr is finished */
+   if (ranges_done(&bsr->volfile_index)) {
       bsr->done = true;
       bsr->root->reposition = true;
-      Dmsg2(dbglevel, "bsr done from volfile rec=%u volefile=%u\n",
-         rec->File, volfile->efile);
+      Dmsg1(dbglevel, "bsr done from volfile rec=%u\n", rec->File);
    }
    return 0;
 }
 
-static int match_voladdr(BSR *bsr, BSR_VOLADDR *voladdr, DEV_RECORD *rec, bool done)
+static int match_voladdr(BSR *bsr, DEV_RECORD *rec)
 {
-   if (!voladdr) {
-      return 1;                       /* no specification matches all */
-   }
+   uint64_t addr;
 
-#ifdef xxx
-
-   /* For the moment, these tests work only with disk. */
-   if (rec->state & REC_ISTAPE) {
-      uint32_t sFile = (voladdr->saddr)>>32;
-      uint32_t eFile = (voladdr->eaddr)>>32;
-      if (sFile <= rec->File && eFile >= rec->File) {
-         return 1;
-      }
+   if (!bsr->voladdr) {
+      return 1;                       /* no specification matches all */
    }
+   addr = get_record_address(rec);
+   Dmsg3(dbglevel, "match_voladdr: recaddr=%llu sfile=%u recfile=%u\n",
+         addr, addr>>32, rec->File);
 
-#endif
-
-   uint64_t addr = get_record_address(rec);
-   Dmsg6(dbglevel, "match_voladdr: saddr=%llu eaddr=%llu recaddr=%llu sfile=%u efile=%u recfile=%u\n",
-         voladdr->saddr, voladdr->eaddr, addr, voladdr->saddr>>32, voladdr->eaddr>>32, addr>>32);
-
-   if (voladdr->saddr <= addr && voladdr->eaddr >= addr) {
+   if (match_range(&bsr->voladdr_index, addr, true)) {
       return 1;
    }
-   /* Once we get past last eblock, we are done */
-   if (addr > voladdr->eaddr) {
-      voladdr->done = true;              /* set local done */
-   }
-   if (voladdr->next) {
-      return match_voladdr(bsr, voladdr->next, rec, voladdr->done && done);
-   }
-
-   /* If we are done and all prior matches are done, this bsr is finished */
-   if (voladdr->done && done) {
+   /* Once we get past last eaddr, this bsr is finished */
+   if (ranges_done(&bsr->voladdr_index)) {
       bsr->done = true;
       bsr->root->reposition = true;
-      Dmsg2(dbglevel, "bsr done from voladdr rec=%llu voleaddr=%llu\n",
-            addr, voladdr->eaddr);
+      Dmsg1(dbglevel, "bsr done from voladdr rec=%llu\n", addr);
    }
    return 0;
 }
@@ -707,46 +925,31 @@ static int match_sesstime(BSR *bsr, BSR_SESSTIME *sesstime, DEV_RECORD *rec, boo
  *  have interleaved records, and there may be more of what we want
  *  later.
  */
-static int match_sessid(BSR *bsr, BSR_SESSID *sessid, DEV_RECORD *rec)
+static int match_sessid(BSR *bsr, DEV_RECORD *rec)
 {
-   if (!sessid) {
+   if (!bsr->sessid) {
       return 1;                       /* no specification matches all */
    }
-   if (sessid->sessid <= rec->VolSessionId && sessid->sessid2 >= rec->VolSessionId) {
-      return 1;
-   }
-   if (sessid->next) {
-      return match_sessid(bsr, sessid->next, rec);
-   }
-   return 0;
+   return match_range(&bsr->sessid_index, rec->VolSessionId, false);
 }
 
 /*
  * When reading the Volume, the Volume Findex (rec->FileIndex) always
  *   are found in sequential order. Thus we can make optimizations.
- *
- *  ***FIXME*** optimizations
- * We could optimize by removing the recursion.
  */
-static int match_findex(BSR *bsr, BSR_FINDEX *findex, DEV_RECORD *rec, bool done)
+static int match_findex(BSR *bsr, DEV_RECORD *rec)
 {
-   if (!findex) {
+   if (!bsr->FileIndex) {
       return 1;                       /* no specification matches all */
    }
-   if (!findex->done) {
-      if (findex->findex <= rec->FileIndex && findex->findex2 >= rec->FileIndex) {
-         Dmsg3(dbglevel, "Match on findex=%d. bsrFIs=%d,%d\n",
-               rec->FileIndex, findex->findex, findex->findex2);
-         return 1;
-      }
-      if (rec->FileIndex > findex->findex2) {
-         findex->done = true;
-      }
+   if (rec->FileIndex < 0) {
+      return 0;                       /* labels are not selected by FileIndex */
    }
-   if (findex->next) {
-      return match_findex(bsr, findex->next, rec, findex->done && done);
+   if (match_range(&bsr->findex_index, rec->FileIndex, true)) {
+      Dmsg1(dbglevel, "Match on findex=%d\n", rec->FileIndex);
+      return 1;
    }
-   if (findex->done && done) {
+   if (ranges_done(&bsr->findex_index)) {
       bsr->done = true;
       bsr->root->reposition = true;
       Dmsg1(dbglevel, "bsr done from findex %d\n", rec->FileIndex);
@@ -761,7 +964,10 @@ uint64_t get_bsr_start_addr(BSR *bsr, uint32_t *file, uint32_t *block)
 
    if (bsr) {
       if (bsr->voladdr) {
-         bsr_addr = bsr->voladdr->saddr;
+         /* Start at the first address not read yet */
+         if (!first_pending_range(&bsr->voladdr_index, &bsr_addr)) {
+            bsr_addr = bsr->voladdr_index.range[0].start;
+         }
          sfile = bsr_addr>>32;
          sblock = (uint32_t)bsr_addr;
 
@@ -779,3 +985,188 @@ uint64_t get_bsr_start_addr(BSR *bsr, uint32_t *file, uint32_t *block)
 
    return bsr_addr;
 }
+
+/*
+ * Find the first part of the Volume at or after addr that the bsrs
+ *  of the Volume still have to read, from their VolAddr ranges.
+ *  Used to read ahead on file Volumes, the ranges read so far are
+ *  not taken into account.
+ *
+ * Returns: 1 with *start and *end (inclusive) set
+ *          0 if no VolAddr range of the Volume goes past addr
+ *         -1 if a bsr of the Volume has no VolAddr
+ */
+int get_bsr_next_range(BSR *root_bsr, const char *VolumeName, uint64_t addr,
+                       uint64_t *start, uint64_t *end)
+{
+   BSR_VOLUME *vol;
+   BSR_RANGES *ranges;
+   uint64_t s, e;
+   int32_t i;
+   int found = 0;
+
+   for (BSR *bsr = root_bsr; bsr; bsr = bsr->next) {
+      if (bsr->done) {
+         continue;
+      }
+      for (vol = bsr->volume; vol; vol = vol->next) {
+         if (strcmp(vol->VolumeName, VolumeName) == 0) {
+            break;
+         }
+      }
+      if (!vol) {
+         continue;
+      }
+      ranges = &bsr->voladdr_index;
+      if (ranges->count == 0) {
+         return -1;
+      }
+      i = search_range(ranges, addr);
+      if (i >= 0 && ranges->range[i].end_max >= addr) {
+         /* addr is in a range, up to the greatest end of those holding it */
+         s = addr;
+         e = ranges->range[i].end_max;
+      } else if (i + 1 < ranges->count) {
+         s = ranges->range[i + 1].start;
+         e = ranges->range[i + 1].end;
+      } else {
+         continue;
+      }
+      if (!found || s < *start || (s == *start && e > *end)) {
+         *start = s;
+         *end = e;
+         found = 1;
+      }
+   }
+   return found;
+}
+
+#ifdef TEST_PROGRAM
+/*
+ * Replay a synthetic bootstrap against the records of a synthetic
+ *  Volume holding jobs jobs of files files each, every file being
+ *  written as recs records. Each bsr selects ranges files of its job,
+ *  spread over the job, as a restore of scattered files does.
+ *
+ *  match_bsr_test [-j jobs] [-f files] [-n ranges] [-r recs] [-w dir]
+ */
+void add_read_volume(JCR *jcr, const char *VolumeName) { }
+void remove_read_volume(JCR *jcr, const char *VolumeName) { }
+
+int main(int argc, char *argv[])
+{
+   int32_t jobs = 2, files = 500000, nranges = 100000, recs = 2;
+   const char *dir = "/tmp";
+   uint32_t recno = 0, nrecs = 0, matched = 0, step;
+   int32_t lastFileIndex = -1;
+   uint32_t lastSessId = 0;
+   int ch, stat = 0;
+   POOL_MEM fname;
+   VOLUME_LABEL volrec;
+   SESSION_LABEL sessrec;
+   DEV_RECORD *rec;
+   btime_t start, elapsed;
+   BSR *bsr;
+   FILE *fp;
+
+   while ((ch = getopt(argc, argv, "j:f:n:r:w:?")) != -1) {
+      switch (ch) {
+      case 'j':
+         jobs = atoi(optarg);
+         break;
+      case 'f':
+         files = atoi(optarg);
+         break;
+      case 'n':
+         nranges = atoi(optarg);
+         break;
+      case 'r':
+         recs = atoi(optarg);
+         break;
+      case 'w':
+         dir = optarg;
+         break;
+      default:
+         fprintf(stderr, "Usage: match_bsr_test [-j jobs] [-f files] [-n ranges] "
+                 "[-r recs] [-w dir]\n");
+         exit(1);
+      }
+   }
+   if (jobs < 1 || files < 1 || recs < 1 || nranges < 1 || nranges > files) {
+      fprintf(stderr, "Invalid arguments\n");
+      exit(1);
+   }
+   step = files / nranges;
+
+   /* One bsr per job, the records are 64 per block */
+   Mmsg(fname, "%s/match_bsr_test.bsr", dir);
+   if ((fp = fopen(fname.c_str(), "w")) == NULL) {
+      berrno be;
+      fprintf(stderr, "Cannot create %s: ERR=%s\n", fname.c_str(), be.bstrerror());
+      exit(1);
+   }
+   for (int32_t j = 0; j < jobs; j++) {
+      uint32_t first = recno;
+      recno += files * recs;
+      fprintf(fp, "Volume=\"TestVolume001\"\nMediaType=\"File\"\n"
+              "VolSessionId=%d\nVolSessionTime=1000\nVolAddr=%u-%u\n",
+              j + 1, first / 64, (recno - 1) / 64);
+      for (int32_t i = 0; i < nranges; i++) {
+         fprintf(fp, "FileIndex=%u\n", i * step + 1);
+      }
+      fprintf(fp, "Count=%d\n", nranges);
+   }
+   fclose(fp);
+   bsr = parse_bsr(NULL, fname.c_str());
+   unlink(fname.c_str());
+   if (!bsr) {
+      fprintf(stderr, "Cannot parse the bootstrap\n");
+      exit(1);
+   }
+
+   memset(&volrec, 0, sizeof(volrec));
+   bstrncpy(volrec.VolumeName, "TestVolume001", sizeof(volrec.VolumeName));
+   memset(&sessrec, 0, sizeof(sessrec));
+   rec = new_record();
+   rec->VolSessionTime = 1000;
+
+   start = get_current_btime();
+   recno = 0;
+   for (int32_t j = 0; j < jobs && stat >= 0; j++) {
+      rec->VolSessionId = j + 1;
+      for (int32_t i = 1; i <= files && stat >= 0; i++) {
+         rec->FileIndex = i;
+         for (int32_t r = 0; r < recs; r++) {
+            rec->Block = recno++ / 64;
+            rec->Stream = rec->maskedStream = r == 0 ? STREAM_UNIX_ATTRIBUTES : STREAM_FILE_DATA;
+            nrecs++;
+            stat = match_bsr(bsr, rec, &volrec, &sessrec, NULL);
+            if (stat < 0) {
+               break;                 /* all done */
+            }
+            if (stat == 0) {
+               continue;
+            }
+            if (lastFileIndex != rec->FileIndex || lastSessId != rec->VolSessionId) {
+               if (lastFileIndex != -1) {
+                  is_this_bsr_done(bsr, rec);
+               }
+               lastFileIndex = rec->FileIndex;
+               lastSessId = rec->VolSessionId;
+               matched++;
+            }
+         }
+      }
+   }
+   elapsed = get_current_btime() - start;
+   printf("%u records, %u files matched, %.0f records/s\n", nrecs, matched,
+          elapsed > 0 ? (double)nrecs * 1000000 / elapsed : 0.0);
+   free_record(rec);
+   free_bsr(bsr);
+   if (matched != (uint32_t)(jobs * nranges)) {
+      printf("Expected %d files\n", jobs * nranges);
+      exit(1);
+   }
+   return 0;
+}
+#endif
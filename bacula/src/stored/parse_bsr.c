@@ -160,6 +160,7 @@ BSR *parse_bsr(JCR *jcr, char *fname)
    for (bsr=root_bsr; bsr; bsr=bsr->next) {
       bsr->root = root_bsr;
    }
+   build_bsr_index(root_bsr);
    return root_bsr;
 }
 
@@ -241,16 +242,13 @@ static BSR *store_findex(LEX *lc, BSR *bsr)
       memset(findex, 0, sizeof(BSR_FINDEX));
       findex->findex = lc->pint32_val;
       findex->findex2 = lc->pint32_val2;
-      /* Add it to the end of the chain */
+      /* Add it to the end of the chain, there may be many of them */
       if (!bsr->FileIndex) {
          bsr->FileIndex = findex;
       } else {
-         /* Add to end of chain */
-         BSR_FINDEX *bs = bsr->FileIndex;
-         for ( ;bs->next; bs=bs->next)
-            {  }
-         bs->next = findex;
+         bsr->last_FileIndex->next = findex;
       }
+      bsr->last_FileIndex = findex;
       token = lex_get_token(lc, T_ALL);
       if (token != T_COMMA) {
          break;
@@ -866,6 +864,7 @@ void remove_bsr(BSR *bsr)
    free_bsr_item((BSR *)bsr->FileIndex);
    free_bsr_item((BSR *)bsr->JobType);
    free_bsr_item((BSR *)bsr->JobLevel);
+   free_bsr_index(bsr);
    if (bsr->fileregex) {
       bfree(bsr->fileregex);
    }
@@ -33,6 +33,13 @@ void     free_dcr(DCR *dcr);
 /* From append.c */
 bool send_attrs_to_dir(JCR *jcr, DEV_RECORD *rec);
 
+/* From async_write.c */
+void     begin_async_writes(DCR *dcr);
+bool     submit_async_write(DCR *dcr, uint32_t wlen);
+bool     finish_async_write(DCR *dcr);
+bool     end_async_writes(DCR *dcr);
+void     term_async_writer(DEVICE *dev);
+
 /* From askdir.c */
 enum get_vol_info_rw {
    GET_VOL_INFO_FOR_WRITE,
@@ -74,6 +81,8 @@ void    print_block_read_errors(JCR *jcr, DEV_BLOCK *block);
 void    ser_block_header(DEV_BLOCK *block);
 bool    is_block_empty(DEV_BLOCK *block);
 bool    terminate_writing_volume(DCR *dcr);
+ssize_t write_serialized_block(DCR *dcr, DEV_BLOCK *block, uint32_t wlen);
+bool    finish_block_write(DCR *dcr, DEV_BLOCK *block, ssize_t stat, uint32_t wlen);
 
 /* From block_util.c */
 bool    terminate_writing_volume(DCR *dcr);
@@ -163,15 +172,20 @@ void     _give_back_device_lock(const char *file, int line, DEVICE *dev, bsteal_
 
 
 /* From match_bsr.c */
+void     build_bsr_index(BSR *root_bsr);
+void     free_bsr_index(BSR *bsr);
 int      match_bsr(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec,
               SESSION_LABEL *sesrec, JCR *jcr);
 int      match_bsr_block(BSR *bsr, DEV_BLOCK *block);
 void     position_bsr_block(BSR *bsr, DEV_BLOCK *block);
 BSR     *find_next_bsr(BSR *root_bsr, DEVICE *dev);
 bool     is_this_bsr_done(BSR *bsr, DEV_RECORD *rec);
+bool     is_record_selected(BSR *bsr, DEV_RECORD *rec, VOLUME_LABEL *volrec);
 uint64_t get_bsr_start_addr(BSR *bsr,
                             uint32_t *file=NULL,
                             uint32_t *block=NULL);
+int      get_bsr_next_range(BSR *root_bsr, const char *VolumeName,
+                            uint64_t addr, uint64_t *start, uint64_t *end);
 
 
 /* From mount.c */
@@ -198,7 +212,8 @@ uint64_t    get_record_address(DEV_RECORD *rec);
 /* From read_record.c */
 bool read_records(DCR *dcr,
        bool record_cb(DCR *dcr, DEV_RECORD *rec),
-       bool mount_cb(DCR *dcr));
+       bool mount_cb(DCR *dcr),
+       bool block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len)=NULL);
 
 /* From reserve.c */
 void    init_reservations_lock();
@@ -26,12 +26,16 @@
 /* Forward referenced subroutines */
 static bool read_record_cb(DCR *dcr, DEV_RECORD *rec);
 static bool mac_record_cb(DCR *dcr, DEV_RECORD *rec);
+static bool mac_block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len);
+static void update_copy_stats(JCR *jcr, bool blocks, uint64_t bytes);
+static uint64_t copy_rate(uint64_t bytes, btime_t elapsed);
 
 
 /* Responses sent to the File daemon */
 static char OK_data[]    = "3000 OK data\n";
 static char FD_error[]   = "3000 error\n";
 static char rec_header[] = "rechdr %ld %ld %ld %ld %ld";
+static char rec_block[]  = "recblock %u\n";
 
 /*
  *  Read Data and send to File Daemon
@@ -73,8 +77,12 @@ bool do_read_data(JCR *jcr)
    jcr->run_time = time(NULL);
    jcr->JobFiles = 0;
 
+   /* Queue the record headers, send them with the record data */
+   fd->begin_batch();
+
    if (jcr->is_JobType(JT_MIGRATE) || jcr->is_JobType(JT_COPY)) {
-      ok = read_records(dcr, mac_record_cb, mount_next_read_volume);
+      jcr->CopyLastTime = get_current_btime();
+      ok = read_records(dcr, mac_record_cb, mount_next_read_volume, mac_block_cb);
    } else {
       ok = read_records(dcr, read_record_cb, mount_next_read_volume);
    }
@@ -92,9 +100,20 @@ bool do_read_data(JCR *jcr)
    Jmsg(dcr->jcr, M_INFO, 0, _("Elapsed time=%02d:%02d:%02d, Transfer rate=%s Bytes/second\n"),
          job_elapsed / 3600, job_elapsed % 3600 / 60, job_elapsed % 60,
          edit_uint64_with_suffix(jcr->JobBytes / job_elapsed, ec));
+   if (jcr->is_JobType(JT_MIGRATE) || jcr->is_JobType(JT_COPY)) {
+      char ec1[50], ec2[50], ec3[50];
+      Jmsg(jcr, M_INFO, 0, _("Block copy=%sB at %sB/s, Record copy=%sB at %sB/s\n"),
+         edit_uint64_with_suffix(jcr->CopyBlockBytes, ec),
+         edit_uint64_with_suffix(copy_rate(jcr->CopyBlockBytes, jcr->CopyBlockTime), ec1),
+         edit_uint64_with_suffix(jcr->CopyRecordBytes, ec2),
+         edit_uint64_with_suffix(copy_rate(jcr->CopyRecordBytes, jcr->CopyRecordTime), ec3));
+   }
 
    /* Send end of data to FD */
    fd->signal(BNET_EOD);
+   if (!fd->end_batch()) {
+      ok = false;
+   }
 
    if (!release_device(jcr->read_dcr)) {
       ok = false;
@@ -260,6 +279,7 @@ static bool mac_record_cb(DCR *dcr, DEV_RECORD *rec)
    fd->msg = rec->data;         /* pass data directly to the FD */
    fd->msglen = rec->data_len;
    jcr->JobBytes += rec->data_len;   /* increment bytes this job */
+   update_copy_stats(jcr, false, rec->data_len);
    Dmsg1(400, ">filed: send %d bytes data.\n", fd->msglen);
    if (!fd->send()) {
       Pmsg1(000, _("Error sending to FD. ERR=%s\n"), fd->bstrerror());
@@ -276,3 +296,106 @@ static bool mac_record_cb(DCR *dcr, DEV_RECORD *rec)
 
    return ok;
 }
+
+/*
+ * Called here by read_records() for the data records at the start of
+ *  a block that are selected by the bsr. They are renumbered in place
+ *  and sent to the SD as they are in the block with a recblock header,
+ *  the SD writes them with its own session.
+ *  Returns: true if OK
+ *           false if error
+ */
+static bool mac_block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len)
+{
+   ser_declare;
+   JCR *jcr = dcr->jcr;
+   BSOCK *fd = jcr->file_bsock;
+   char *p, *end = data + len;
+   int32_t FileIndex, Stream;
+   uint32_t data_bytes, rlen;
+   uint64_t bytes = 0;
+   POOLMEM *save_msg;
+   char save_hdr[sizeof(int32_t)];
+   bool ok = true;
+
+   /* End the stream started by mac_record_cb() */
+   if (rec->last_VolSessionId != 0) {
+      if (!fd->signal(BNET_EOD)) {
+         Jmsg(jcr, M_FATAL, 0, _("Error sending to File daemon. ERR=%s\n"),
+                  fd->bstrerror());
+         return false;
+      }
+      rec->last_VolSessionId = 0;
+   }
+
+   /* Set sequential output FileIndexes, as mac_record_cb() does */
+   for (p = data; p < end; ) {
+      unser_begin(p, WRITE_RECHDR_LENGTH);
+      unser_int32(FileIndex);
+      unser_int32(Stream);
+      unser_uint32(data_bytes);
+      if (FileIndex != rec->last_FileIndex) {
+         jcr->JobFiles++;
+         rec->last_FileIndex = FileIndex;
+      }
+      ser_begin(p, sizeof(int32_t));
+      ser_int32(jcr->JobFiles);
+      rlen = MIN(data_bytes, (uint32_t)(end - p) - WRITE_RECHDR_LENGTH);
+      Dmsg4(500, "Block record FI=%d->%d Strm=%d len=%u\n", FileIndex,
+         jcr->JobFiles, Stream, rlen);
+      bytes += rlen;
+      p += WRITE_RECHDR_LENGTH + rlen;
+   }
+   Dmsg2(400, "Send block to SD: len=%u FI=%d\n", len, jcr->JobFiles);
+
+   if (!fd->fsend(rec_block, len)) {
+      Jmsg1(jcr, M_FATAL, 0, _("Error sending to File daemon. ERR=%s\n"),
+         fd->bstrerror());
+      return false;
+   }
+   /*
+    * The data goes directly from the block, send() stores the packet
+    *  length just before it.
+    */
+   save_msg = fd->msg;
+   memcpy(save_hdr, data - sizeof(save_hdr), sizeof(save_hdr));
+   fd->msg = data;
+   fd->msglen = len;
+   if (!fd->send() || !fd->signal(BNET_EOD)) {
+      Jmsg1(jcr, M_FATAL, 0, _("Error sending to File daemon. ERR=%s\n"),
+         fd->bstrerror());
+      ok = false;
+   }
+   memcpy(data - sizeof(save_hdr), save_hdr, sizeof(save_hdr));
+   fd->msg = save_msg;
+   jcr->JobBytes += bytes;
+   update_copy_stats(jcr, true, bytes);
+   return ok;
+}
+
+/*
+ * Account the bytes copied, and the time since the last call,
+ *  to the block or the record copy.
+ */
+static void update_copy_stats(JCR *jcr, bool blocks, uint64_t bytes)
+{
+   btime_t now = get_current_btime();
+
+   if (blocks) {
+      jcr->CopyBlockBytes += bytes;
+      jcr->CopyBlockTime += now - jcr->CopyLastTime;
+   } else {
+      jcr->CopyRecordBytes += bytes;
+      jcr->CopyRecordTime += now - jcr->CopyLastTime;
+   }
+   jcr->CopyLastTime = now;
+}
+
+/* Bytes/second, the times are in microseconds */
+static uint64_t copy_rate(uint64_t bytes, btime_t elapsed)
+{
+   if (elapsed <= 0) {
+      elapsed = 1;
+   }
+   return (uint64_t)((double)bytes * 1000000 / elapsed);
+}
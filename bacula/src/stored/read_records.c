@@ -35,6 +35,9 @@
 static void handle_session_record(DEVICE *dev, DEV_RECORD *rec, SESSION_LABEL *sessrec);
 static BSR *position_to_first_file(JCR *jcr, DCR *dcr);
 static bool try_repositioning(JCR *jcr, DEV_RECORD *rec, DCR *dcr);
+static bool pass_records(DCR *dcr, DEV_RECORD *rec, SESSION_LABEL *sessrec,
+              int32_t *lastFileIndex, bool *skip_block,
+              bool block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len));
 #ifdef DEBUG
 static char *rec_state_bits_to_str(DEV_RECORD *rec);
 #endif
@@ -46,10 +49,15 @@ static const int no_FileIndex = -999999;
  * This subroutine reads all the records and passes them back to your
  *  callback routine (also mount routine at EOM).
  * You must not change any values in the DEV_RECORD packet
+ *
+ * If block_cb is given, the data records at the start of a block
+ *  that are all selected by the bsr are passed to it as they are in
+ *  the block, without being unpacked (see pass_records()).
  */
 bool read_records(DCR *dcr,
        bool record_cb(DCR *dcr, DEV_RECORD *rec),
-       bool mount_cb(DCR *dcr))
+       bool mount_cb(DCR *dcr),
+       bool block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len))
 {
    JCR *jcr = dcr->jcr;
    DEVICE *dev = dcr->dev;
@@ -172,6 +180,13 @@ bool read_records(DCR *dcr,
       lastFileIndex = no_FileIndex;
       Dmsg1(dbglvl, "Block %s empty\n", is_block_marked_empty(rec)?"is":"NOT");
       for (rec->state_bits=0; ok && !is_block_marked_empty(rec); ) {
+         if (block_cb && rec->remainder == 0) {
+            bool skip_block;
+            ok = pass_records(dcr, rec, &sessrec, &lastFileIndex, &skip_block, block_cb);
+            if (!ok || skip_block) {
+               break;
+            }
+         }
          if (!read_record_from_block(dcr, rec)) {
             Dmsg3(200, "!read-break. state_bits=%s blk=%d rem=%d\n", rec_state_bits_to_str(rec),
                   block->BlockNumber, rec->remainder);
@@ -304,6 +319,133 @@ bool read_records(DCR *dcr,
    return ok;
 }
 
+/*
+ * Find the next data records of the block that are all selected
+ *  by the bsr, and pass them to block_cb() as they are in the block.
+ *  block_cb() may change the record headers. The bsrs are updated
+ *  as if the records had been read one by one, and the record
+ *  after them is left to be read by read_record_from_block().
+ *
+ * When the last record passed is continued in the next block of
+ *  the session, its end is always passed too, the record is never
+ *  read half with each method.
+ *
+ *  Returns: false if block_cb() failed
+ *           true  otherwise, with skip_block set if nothing is left
+ *                 to read in the block
+ */
+static bool pass_records(DCR *dcr, DEV_RECORD *rec, SESSION_LABEL *sessrec,
+              int32_t *lastFileIndex, bool *skip_block,
+              bool block_cb(DCR *dcr, DEV_RECORD *rec, char *data, uint32_t len))
+{
+   ser_declare;
+   JCR *jcr = dcr->jcr;
+   DEV_BLOCK *block = dcr->block;
+   DEVICE *dev = (DEVICE *)block->dev;
+   DEV_RECORD trec;
+   bool continued = rec->passed_partial;
+   bool partial = false;
+   int32_t FileIndex, Stream;
+   uint32_t data_bytes, rlen;
+   uint32_t len = 0;
+   char *p;
+
+   *skip_block = false;
+   rec->passed_partial = false;
+   if (!jcr->bsr || block->BlockVer < 2 || rec->remainder) {
+      return true;
+   }
+
+   /* Find how many records we can pass, without changing the bsrs */
+   memset(&trec, 0, sizeof(trec));
+   trec.File = dev->EndFile;
+   trec.Block = dev->EndBlock;
+   trec.VolSessionId = block->VolSessionId;
+   trec.VolSessionTime = block->VolSessionTime;
+   while (len + WRITE_RECHDR_LENGTH <= block->binbuf) {
+      unser_begin(block->bufp + len, WRITE_RECHDR_LENGTH);
+      unser_int32(FileIndex);
+      unser_int32(Stream);
+      unser_uint32(data_bytes);
+      rlen = block->binbuf - len - WRITE_RECHDR_LENGTH;
+      if (data_bytes >= MAX_BLOCK_LENGTH) {
+         break;                       /* let read_record_from_block() complain */
+      }
+      if (Stream < 0) {
+         /* Only the end of a record we passed the start of */
+         if (len > 0 || !continued) {
+            break;
+         }
+      } else if (FileIndex < 0) {
+         break;                       /* labels are read one by one */
+      } else {
+         trec.FileIndex = FileIndex;
+         trec.Stream = Stream;
+         if (!is_record_selected(jcr->bsr, &trec, &dev->VolHdr)) {
+            break;
+         }
+      }
+      partial = data_bytes > rlen;
+      len += WRITE_RECHDR_LENGTH + (partial ? rlen : data_bytes);
+   }
+   if (len == 0) {
+      return true;
+   }
+
+   /* Now do what read_records() would have done with each record */
+   p = block->bufp;
+   while (p < block->bufp + len) {
+      unser_begin(p, WRITE_RECHDR_LENGTH);
+      unser_int32(FileIndex);
+      unser_int32(Stream);
+      unser_uint32(data_bytes);
+      rlen = block->bufp + len - p - WRITE_RECHDR_LENGTH;
+      rec->File = dev->EndFile;
+      rec->Block = dev->EndBlock;
+      rec->VolSessionId = block->VolSessionId;
+      rec->VolSessionTime = block->VolSessionTime;
+      rec->FileIndex = FileIndex;
+      rec->Stream = Stream < 0 ? -Stream : Stream;
+      rec->maskedStream = rec->Stream & STREAMMASK_TYPE;
+      if (FileIndex > 0) {
+         if (block->FirstIndex == 0) {
+            block->FirstIndex = FileIndex;
+         }
+         block->LastIndex = FileIndex;
+      }
+      rec->match_stat = match_bsr(jcr->bsr, rec, &dev->VolHdr, sessrec, jcr);
+      dcr->VolLastIndex = rec->FileIndex;
+      if (data_bytes <= rlen) {
+         if (*lastFileIndex != no_FileIndex && *lastFileIndex != rec->FileIndex) {
+            if (is_this_bsr_done(jcr->bsr, rec) && try_repositioning(jcr, rec, dcr)) {
+               /* Like read_records(), forget the rest of the block */
+               Dmsg2(dbglvl, "This bsr done, break pos %u:%u\n",
+                     dev->file, dev->block_num);
+               len = p - block->bufp;
+               partial = false;
+               *skip_block = true;
+               break;
+            }
+         }
+         *lastFileIndex = rec->FileIndex;
+      }
+      p += WRITE_RECHDR_LENGTH + MIN(data_bytes, rlen);
+   }
+   Dmsg3(dbglvl, "Pass %u bytes of block %u partial=%d\n", len,
+         block->BlockNumber, partial);
+
+   rec->passed_partial = partial;
+   if (len > 0 && !block_cb(dcr, rec, block->bufp, len)) {
+      return false;
+   }
+   block->bufp += len;
+   block->binbuf -= len;
+   if (block->binbuf < WRITE_RECHDR_LENGTH) {
+      *skip_block = true;
+   }
+   return true;
+}
+
 /*
  * See if we can reposition.
  *   Returns:  true  if at end of volume
@@ -113,6 +113,7 @@ struct DEV_RECORD {
    uint32_t last_VolSessionId;        /* used in sequencing FI for Vbackup */
    uint32_t last_VolSessionTime;
    int32_t  last_FileIndex;
+   bool     passed_partial;           /* record continued in next block passed as is */
 };
 
 
@@ -28,7 +28,7 @@ static void make_unique_data_spool_filename(DCR *dcr, POOLMEM **name);
 static bool open_data_spool_file(DCR *dcr);
 static bool close_data_spool_file(DCR *dcr);
 static bool despool_data(DCR *dcr, bool commit);
-static int  read_block_from_spool_file(DCR *dcr);
+static int  read_block_from_spool_file(struct spool_reader *sr, DEV_BLOCK *block);
 static bool open_attr_spool_file(JCR *jcr, BSOCK *bs);
 static bool close_attr_spool_file(JCR *jcr, BSOCK *bs);
 static bool write_spool_header(DCR *dcr);
@@ -43,6 +43,11 @@ struct spool_stats_t {
    int64_t max_attr_size;
    int64_t data_size;                 /* current data size (all jobs running) */
    int64_t attr_size;
+   uint32_t total_despools;           /* total despool passes */
+   uint64_t despool_bytes;            /* bytes despooled */
+   uint64_t despool_time;             /* seconds spent despooling */
+   uint64_t despool_read_waits;       /* reader waited for the device */
+   uint64_t despool_write_waits;      /* device waited for the reader */
 };
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -62,6 +67,42 @@ enum {
    RB_OK
 };
 
+/* Size of the reads done on the spool file, multiple of the page size */
+static const uint32_t spool_read_size = 1024 * 1024;
+static const uint32_t spool_read_align = 4096;
+
+/*
+ * Reader of a spool file during despooling.
+ *
+ *  The spool file is read in large chunks, with O_DIRECT if the
+ *   device has "Despool Direct IO = yes", and cut into blocks.
+ *   With "Despool Read Ahead = n", a reader thread fills a ring
+ *   of n blocks while the despooling job writes them to the device.
+ */
+struct spool_reader {
+   DCR *dcr;                          /* dcr being despooled */
+   int fd;                            /* fd to read */
+   bool direct;                       /* fd is opened with O_DIRECT */
+   char *mem;                         /* allocated read buffer */
+   char *buf;                         /* aligned read buffer */
+   uint32_t len;                      /* bytes in buf */
+   uint32_t pos;                      /* next byte to use in buf */
+   boffset_t offset;                  /* file offset of the end of buf */
+   DEV_BLOCK *block;                  /* block being written */
+   /* Read ahead */
+   pthread_t thid;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   DEV_BLOCK **ring;                  /* blocks read ahead */
+   uint32_t nring;                    /* size of ring, 0 if no read ahead */
+   uint32_t first;                    /* first block in ring */
+   uint32_t count;                    /* blocks in ring */
+   int ring_stat;                     /* RB_OK or end status of the reader */
+   bool quit;                         /* reader must stop */
+   uint32_t read_waits;               /* times the ring was full */
+   uint32_t write_waits;              /* times the ring was empty */
+};
+
 void list_spool_stats(void sendit(const char *msg, int len, void *sarg), void *arg)
 {
    char ed1[30], ed2[30];
@@ -86,6 +127,19 @@ void list_spool_stats(void sendit(const char *msg, int len, void *sarg), void *a
 
       sendit(msg.c_str(), len, arg);
    }
+   if (spool_stats.total_despools) {
+      char ed3[30], ed4[30];
+      uint64_t secs = spool_stats.despool_time ? spool_stats.despool_time : 1;
+      len = Mmsg(msg, _("Despooling: %u total, %s bytes, %s bytes/second; "
+         "device waited %s times, reader waited %s times.\n"),
+         spool_stats.total_despools,
+         edit_uint64_with_commas(spool_stats.despool_bytes, ed1),
+         edit_uint64_with_commas(spool_stats.despool_bytes / secs, ed2),
+         edit_uint64_with_commas(spool_stats.despool_write_waits, ed3),
+         edit_uint64_with_commas(spool_stats.despool_read_waits, ed4));
+
+      sendit(msg.c_str(), len, arg);
+   }
 }
 
 bool begin_data_spool(DCR *dcr)
@@ -168,6 +222,224 @@ static bool open_data_spool_file(DCR *dcr)
 
 static const char *spool_name = "*spool*";
 
+static void *spool_reader_thread(void *arg);
+
+/*
+ * Prepare the reading of the spool file of dcr into the blocks
+ *  of rdcr, and start the read ahead thread if the device wants it.
+ */
+static void init_spool_reader(spool_reader *sr, DCR *dcr, DCR *rdcr)
+{
+   DEVRES *device = dcr->dev->device;
+   int stat;
+
+   memset(sr, 0, sizeof(spool_reader));
+   sr->dcr = dcr;
+   sr->fd = rdcr->spool_fd;
+   sr->block = rdcr->block;
+   sr->mem = (char *)malloc(spool_read_size + spool_read_align);
+   sr->buf = (char *)(((uintptr_t)sr->mem + spool_read_align - 1) &
+                      ~((uintptr_t)spool_read_align - 1));
+   sr->ring_stat = RB_OK;
+
+#ifdef O_DIRECT
+   if (device->despool_direct_io) {
+      POOLMEM *name = get_pool_memory(PM_MESSAGE);
+      int fd;
+      make_unique_data_spool_filename(dcr, &name);
+      if ((fd = open(name, O_RDONLY|O_BINARY|O_DIRECT)) >= 0) {
+         sr->fd = fd;
+         sr->direct = true;
+      } else {
+         berrno be;
+         Dmsg2(100, "Cannot open %s with O_DIRECT: ERR=%s\n", name, be.bstrerror());
+      }
+      free_pool_memory(name);
+   }
+#endif
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+   if (!sr->direct) {
+      posix_fadvise(sr->fd, 0, 0, POSIX_FADV_WILLNEED);
+   }
+#endif
+
+   if (device->despool_read_ahead == 0) {
+      return;
+   }
+   sr->nring = device->despool_read_ahead;
+   sr->ring = (DEV_BLOCK **)malloc(sr->nring * sizeof(DEV_BLOCK *));
+   for (uint32_t i=0; i < sr->nring; i++) {
+      sr->ring[i] = new_block(rdcr->dev);
+   }
+   pthread_mutex_init(&sr->mutex, NULL);
+   pthread_cond_init(&sr->cond, NULL);
+   if ((stat = pthread_create(&sr->thid, NULL, spool_reader_thread, sr)) != 0) {
+      berrno be;
+      Jmsg(dcr->jcr, M_WARNING, 0, _("Cannot start despool reader thread: ERR=%s\n"),
+           be.bstrerror(stat));
+      pthread_cond_destroy(&sr->cond);
+      pthread_mutex_destroy(&sr->mutex);
+      for (uint32_t i=0; i < sr->nring; i++) {
+         free_block(sr->ring[i]);
+      }
+      free(sr->ring);
+      sr->ring = NULL;
+      sr->nring = 0;
+      return;
+   }
+   Dmsg2(100, "Despool read ahead %u blocks direct=%d\n", sr->nring, sr->direct);
+}
+
+/*
+ * Stop the read ahead thread and release the reader
+ */
+static void term_spool_reader(spool_reader *sr)
+{
+   if (sr->nring) {
+      P(sr->mutex);
+      sr->quit = true;
+      pthread_cond_broadcast(&sr->cond);
+      V(sr->mutex);
+      pthread_join(sr->thid, NULL);
+      pthread_cond_destroy(&sr->cond);
+      pthread_mutex_destroy(&sr->mutex);
+      for (uint32_t i=0; i < sr->nring; i++) {
+         free_block(sr->ring[i]);
+      }
+      free(sr->ring);
+   }
+   if (sr->direct) {
+      close(sr->fd);
+   }
+   free(sr->mem);
+   Dmsg2(100, "Despool waits: device=%u reader=%u\n", sr->write_waits, sr->read_waits);
+}
+
+/*
+ * Copy the next len bytes of the spool file to buf
+ *
+ *  Returns: number of bytes copied, less than len at the end of file
+ *           -1 on error, with errno set
+ */
+static ssize_t read_spool(spool_reader *sr, char *buf, uint32_t len)
+{
+   uint32_t done = 0, n;
+   ssize_t stat;
+
+   while (done < len) {
+      if (sr->pos == sr->len) {
+         stat = read(sr->fd, sr->buf, spool_read_size);
+#ifdef O_DIRECT
+         if (stat < 0 && sr->direct && errno == EINVAL) {
+            /* Filesystem does not accept O_DIRECT, continue without */
+            Dmsg0(100, "O_DIRECT read refused, using buffered reads\n");
+            close(sr->fd);
+            sr->fd = sr->dcr->spool_fd;
+            sr->direct = false;
+            lseek(sr->fd, sr->offset, SEEK_SET);
+            continue;
+         }
+#endif
+         if (stat < 0) {
+            return -1;
+         }
+         if (stat == 0) {
+            break;                    /* end of file */
+         }
+         sr->len = stat;
+         sr->pos = 0;
+         sr->offset += stat;
+      }
+      n = MIN(len - done, sr->len - sr->pos);
+      memcpy(buf + done, sr->buf + sr->pos, n);
+      sr->pos += n;
+      done += n;
+   }
+   return done;
+}
+
+/*
+ * Read ahead thread, fills the free blocks of the ring
+ */
+static void *spool_reader_thread(void *arg)
+{
+   spool_reader *sr = (spool_reader *)arg;
+   DEV_BLOCK *block;
+   int stat;
+
+   P(sr->mutex);
+   while (!sr->quit) {
+      if (sr->count == sr->nring) {
+         sr->read_waits++;            /* the device is slower than us */
+         while (sr->count == sr->nring && !sr->quit) {
+            pthread_cond_wait(&sr->cond, &sr->mutex);
+         }
+         continue;
+      }
+      block = sr->ring[(sr->first + sr->count) % sr->nring];
+      V(sr->mutex);
+      stat = read_block_from_spool_file(sr, block);
+      P(sr->mutex);
+      if (stat != RB_OK) {
+         sr->ring_stat = stat;
+         pthread_cond_broadcast(&sr->cond);
+         break;
+      }
+      sr->count++;
+      pthread_cond_broadcast(&sr->cond);
+   }
+   V(sr->mutex);
+   return NULL;
+}
+
+/*
+ * Get the next block of the spool file in sr->block
+ *
+ *  Returns RB_OK, RB_EOT or RB_ERROR like read_block_from_spool_file()
+ */
+static int get_spool_block(spool_reader *sr)
+{
+   DEV_BLOCK *block;
+   int stat;
+
+   if (sr->nring == 0) {
+      return read_block_from_spool_file(sr, sr->block);
+   }
+   P(sr->mutex);
+   if (sr->count == 0 && sr->ring_stat == RB_OK) {
+      sr->write_waits++;              /* the device waits for the disk */
+      while (sr->count == 0 && sr->ring_stat == RB_OK) {
+         pthread_cond_wait(&sr->cond, &sr->mutex);
+      }
+   }
+   if (sr->count == 0) {
+      stat = sr->ring_stat;
+   } else {
+      block = sr->ring[sr->first];
+      /* Blocks are numbered by the block that writes them */
+      block->BlockNumber = sr->block->BlockNumber;
+      sr->block = block;
+      stat = RB_OK;
+   }
+   V(sr->mutex);
+   return stat;
+}
+
+/*
+ * Give the block written to the device back to the read ahead thread
+ */
+static void release_spool_block(spool_reader *sr)
+{
+   if (sr->nring == 0) {
+      return;
+   }
+   P(sr->mutex);
+   sr->first = (sr->first + 1) % sr->nring;
+   sr->count--;
+   pthread_cond_broadcast(&sr->cond);
+   V(sr->mutex);
+}
+
 /*
  * NB! This routine locks the device, but if committing will
  *     not unlock it. If not committing, it will be unlocked.
@@ -179,6 +451,7 @@ static bool despool_data(DCR *dcr, bool commit)
    bool ok = true;
    DEV_BLOCK *block;
    JCR *jcr = dcr->jcr;
+   spool_reader sr;
    int stat;
    char ec1[50];
 
@@ -231,32 +504,29 @@ static bool despool_data(DCR *dcr, bool commit)
    rdcr = new_dcr(jcr, NULL, rdev, SD_READ);
    rdcr->spool_fd = dcr->spool_fd;
    block = dcr->block;                /* save block */
-   dcr->block = rdcr->block;          /* make read and write block the same */
 
    Dmsg1(800, "read/write block size = %d\n", block->buf_len);
    lseek(rdcr->spool_fd, 0, SEEK_SET); /* rewind */
 
-#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
-   posix_fadvise(rdcr->spool_fd, 0, 0, POSIX_FADV_WILLNEED);
-#endif
-
    /* Add run time, to get current wait time */
    int32_t despool_start = time(NULL) - jcr->run_time;
 
    set_new_file_parameters(dcr);
 
+   init_spool_reader(&sr, dcr, rdcr);
    for ( ; ok; ) {
       if (job_canceled(jcr)) {
          ok = false;
          break;
       }
-      stat = read_block_from_spool_file(rdcr);
+      stat = get_spool_block(&sr);
       if (stat == RB_EOT) {
          break;
       } else if (stat == RB_ERROR) {
          ok = false;
          break;
       }
+      dcr->block = sr.block;          /* make read and write block the same */
       ok = dcr->write_block_to_device();
       if (!ok) {
          Jmsg2(jcr, M_FATAL, 0, _("Fatal append error on device %s: ERR=%s\n"),
@@ -265,8 +535,12 @@ static bool despool_data(DCR *dcr, bool commit)
                dcr->dev->print_name(), dcr->dev->bstrerror());
          jcr->forceJobStatus(JS_FatalError);
       }
-      Dmsg3(800, "Write block ok=%d FI=%d LI=%d\n", ok, block->FirstIndex, block->LastIndex);
+      Dmsg3(800, "Write block ok=%d FI=%d LI=%d\n", ok, sr.block->FirstIndex,
+            sr.block->LastIndex);
+      release_spool_block(&sr);
    }
+   term_spool_reader(&sr);
+   dcr->block = block;                /* reset block */
 
    if (!dir_create_jobmedia_record(dcr)) {
       Jmsg2(jcr, M_FATAL, 0, _("Could not create JobMedia record for Volume=\"%s\" Job=%s\n"),
@@ -291,8 +565,6 @@ static bool despool_data(DCR *dcr, bool commit)
          despool_elapsed / 3600, despool_elapsed % 3600 / 60, despool_elapsed % 60,
          edit_uint64_with_suffix(jcr->dcr->job_spool_size / despool_elapsed, ec1));
 
-   dcr->block = block;                /* reset block */
-
    lseek(rdcr->spool_fd, 0, SEEK_SET); /* rewind */
    if (ftruncate(rdcr->spool_fd, 0) != 0) {
       berrno be;
@@ -307,6 +579,11 @@ static bool despool_data(DCR *dcr, bool commit)
    } else {
       spool_stats.data_size -= dcr->job_spool_size;
    }
+   spool_stats.total_despools++;
+   spool_stats.despool_bytes += dcr->job_spool_size;
+   spool_stats.despool_time += despool_elapsed;
+   spool_stats.despool_read_waits += sr.read_waits;
+   spool_stats.despool_write_waits += sr.write_waits;
    V(mutex);
    P(dcr->dev->spool_mutex);
    dcr->dev->spool_size -= dcr->job_spool_size;
@@ -339,16 +616,16 @@ static bool despool_data(DCR *dcr, bool commit)
  *          RB_EOT when file done
  *          RB_ERROR on error
  */
-static int read_block_from_spool_file(DCR *dcr)
+static int read_block_from_spool_file(spool_reader *sr, DEV_BLOCK *block)
 {
    uint32_t rlen;
    ssize_t stat;
    spool_hdr hdr;
-   DEV_BLOCK *block = dcr->block;
+   DCR *dcr = sr->dcr;
    JCR *jcr = dcr->jcr;
 
    rlen = sizeof(hdr);
-   stat = read(dcr->spool_fd, (char *)&hdr, (size_t)rlen);
+   stat = read_spool(sr, (char *)&hdr, rlen);
    if (stat == 0) {
       Dmsg0(100, "EOT on spool read.\n");
       return RB_EOT;
@@ -371,7 +648,7 @@ static int read_block_from_spool_file(DCR *dcr)
       jcr->forceJobStatus(JS_FatalError);
       return RB_ERROR;
    }
-   stat = read(dcr->spool_fd, (char *)block->buf, (size_t)rlen);
+   stat = read_spool(sr, (char *)block->buf, rlen);
    if (stat != (ssize_t)rlen) {
       Pmsg2(000, _("Spool data read error. Wanted %u bytes, got %d\n"), rlen, stat);
       Jmsg2(dcr->jcr, M_FATAL, 0, _("Spool data read error. Wanted %u bytes, got %d\n"), rlen, stat);
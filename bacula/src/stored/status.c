@@ -50,6 +50,7 @@ static void list_running_jobs(STATUS_PKT *sp);
 static void list_jobs_waiting_on_reservation(STATUS_PKT *sp);
 static void list_status_header(STATUS_PKT *sp);
 static void list_devices(STATUS_PKT *sp);
+static void send_device_io_status(DEVICE *dev, STATUS_PKT *sp);
 
 /*
  * Status command from Director
@@ -218,12 +219,54 @@ static void list_devices(STATUS_PKT *sp)
             sendit(msg, len, sp);
          }
       }
+      if (dev) {
+         send_device_io_status(dev, sp);
+      }
 
       if (!sp->api) sendit("==\n", 4, sp);
    }
    if (!sp->api) sendit("====\n\n", 6, sp);
 }
 
+/* Bytes per second while the device was busy */
+static uint64_t device_rate(uint64_t bytes, btime_t usecs)
+{
+   if (usecs <= 0) {
+      return 0;
+   }
+   return (uint64_t)((double)bytes * 1000000.0 / (double)usecs);
+}
+
+/*
+ * Throughput of the device reads and writes, and what is queued on
+ *  it: bytes asked by the read ahead and not read yet, block in
+ *  flight in the asynchronous writer.
+ */
+static void send_device_io_status(DEVICE *dev, STATUS_PKT *sp)
+{
+   char b1[35], b2[35], b3[35], b4[35];
+   POOL_MEM msg(PM_MESSAGE);
+   int len;
+   int in_flight = 0;
+
+   len = Mmsg(msg, _("    Device I/O: Read=%s bytes at %s B/s Write=%s bytes at %s B/s\n"),
+      edit_uint64_with_commas(dev->DevReadBytes, b1),
+      edit_uint64_with_commas(device_rate(dev->DevReadBytes, dev->DevReadTime), b2),
+      edit_uint64_with_commas(dev->DevWriteBytes, b3),
+      edit_uint64_with_commas(device_rate(dev->DevWriteBytes, dev->DevWriteTime), b4));
+   sendit(msg, len, sp);
+   if (dev->aw) {
+      P(dev->aw->mutex);
+      in_flight = dev->aw->block ? 1 : 0;
+      V(dev->aw->mutex);
+   }
+   len = Mmsg(msg, _("    Device queue: ReadAhead=%s bytes (total %s) AsyncWrites=%d DirectIO=%d\n"),
+      edit_uint64_with_commas(dev->read_ahead_queued(), b1),
+      edit_uint64_with_commas(dev->DevReadAheadBytes, b2),
+      in_flight, dev->is_direct_io());
+   sendit(msg, len, sp);
+}
+
 static void list_status_header(STATUS_PKT *sp)
 {
    char dt[MAX_TIME_LENGTH];
@@ -508,6 +551,12 @@ static void list_running_jobs(STATUS_PKT *sp)
          jcr->LastJobBytes = jcr->JobBytes;
          jcr->last_time = now;
          found = true;
+         if (jcr->file_bsock && jcr->file_bsock->write_bytes > 0) {
+            len = Mmsg(msg, _("    FDWriteCalls=%s WriteCalls/MB=%.2f\n"),
+               edit_uint64_with_commas(jcr->file_bsock->write_calls, b1),
+               jcr->file_bsock->write_calls_per_mb());
+            sendit(msg, len, sp);
+         }
 #ifdef DEBUG
          if (jcr->file_bsock) {
             len = Mmsg(msg, _("    FDReadSeqNo=%s in_msg=%u out_msg=%d fd=%d\n"),
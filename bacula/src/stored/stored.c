@@ -267,6 +267,7 @@ int main (int argc, char *argv[])
       Emsg1(M_ABORT, 0, _("Unable to create thread. ERR=%s\n"), be.bstrerror());
    }
 
+   start_message_dispatcher();        /* deliver messages in background */
    start_watchdog();                  /* start watchdog thread */
    init_jcr_subsystem();              /* start JCR watchdogs etc. */
 
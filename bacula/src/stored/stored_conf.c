@@ -124,6 +124,8 @@ static RES_ITEM dev_items[] = {
    {"requiresmount",         store_bit,  ITEM(res_dev.cap_bits), CAP_REQMOUNT, ITEM_DEFAULT, 0},
    {"offlineonunmount",      store_bit,  ITEM(res_dev.cap_bits), CAP_OFFLINEUNMOUNT, ITEM_DEFAULT, 0},
    {"blockchecksum",         store_bit,  ITEM(res_dev.cap_bits), CAP_BLOCKCHECKSUM, ITEM_DEFAULT, 1},
+   {"asynchronouswrites",    store_bit,  ITEM(res_dev.cap_bits), CAP_ASYNCWRITES, ITEM_DEFAULT, 0},
+   {"directio",              store_bit,  ITEM(res_dev.cap_bits), CAP_DIRECTIO, ITEM_DEFAULT, 0},
    {"autoselect",            store_bool, ITEM(res_dev.autoselect), 1, ITEM_DEFAULT, 1},
    {"readonly",              store_bool, ITEM(res_dev.read_only), 1, ITEM_DEFAULT, 0},
    {"changerdevice",         store_strname,ITEM(res_dev.changer_name), 0, 0, 0},
@@ -143,6 +145,9 @@ static RES_ITEM dev_items[] = {
    {"spooldirectory",        store_dir,    ITEM(res_dev.spool_directory), 0, 0, 0},
    {"maximumspoolsize",      store_size64,   ITEM(res_dev.max_spool_size), 0, 0, 0},
    {"maximumjobspoolsize",   store_size64,   ITEM(res_dev.max_job_spool_size), 0, 0, 0},
+   {"despoolreadahead",      store_pint32,   ITEM(res_dev.despool_read_ahead), 0, ITEM_DEFAULT, 0},
+   {"despooldirectio",       store_bool,   ITEM(res_dev.despool_direct_io), 1, ITEM_DEFAULT, 0},
+   {"readahead",             store_size32,   ITEM(res_dev.read_ahead), 0, ITEM_DEFAULT, 0},
    {"driveindex",            store_pint32,   ITEM(res_dev.drive_index), 0, 0, 0},
    {"maximumpartsize",       store_size64,   ITEM(res_dev.max_part_size), 0, ITEM_DEFAULT, 0},
    {"mountpoint",            store_strname,ITEM(res_dev.mount_point), 0, 0, 0},
@@ -297,6 +302,9 @@ void dump_resource(int type, RES *reshdr, void sendit(void *sock, const char *fm
       sendit(sock, "        spool_directory=%s\n", NPRT(res->res_dev.spool_directory));
       sendit(sock, "        max_spool_size=%" lld " max_job_spool_size=%" lld "\n",
          res->res_dev.max_spool_size, res->res_dev.max_job_spool_size);
+      sendit(sock, "        despool_read_ahead=%u despool_direct_io=%d\n",
+         res->res_dev.despool_read_ahead, res->res_dev.despool_direct_io);
+      sendit(sock, "        read_ahead=%u\n", res->res_dev.read_ahead);
       if (res->res_dev.changer_res) {
          sendit(sock, "         changer=%p\n", res->res_dev.changer_res);
       }
@@ -346,6 +354,12 @@ void dump_resource(int type, RES *reshdr, void sendit(void *sock, const char *fm
       if (res->res_dev.cap_bits & CAP_OFFLINEUNMOUNT) {
          bstrncat(buf, "CAP_OFFLINEUNMOUNT ", sizeof(buf));
       }
+      if (res->res_dev.cap_bits & CAP_ASYNCWRITES) {
+         bstrncat(buf, "CAP_ASYNCWRITES ", sizeof(buf));
+      }
+      if (res->res_dev.cap_bits & CAP_DIRECTIO) {
+         bstrncat(buf, "CAP_DIRECTIO ", sizeof(buf));
+      }
       bstrncat(buf, "\n", sizeof(buf));
       sendit(sock, buf);
       break;
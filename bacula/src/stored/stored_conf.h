@@ -137,6 +137,9 @@ public:
    int64_t min_free_space;            /* Minimum disk free space */
    int64_t max_spool_size;            /* Max spool size for all jobs */
    int64_t max_job_spool_size;        /* Max spool size for any single job */
+   uint32_t despool_read_ahead;       /* blocks read ahead when despooling */
+   bool despool_direct_io;            /* read spool files with O_DIRECT */
+   uint32_t read_ahead;               /* bytes of a file Volume read ahead */
 
    int64_t max_part_size;             /* Max part size */
    char *mount_point;                 /* Mount point for require mount devices */
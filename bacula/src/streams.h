@@ -53,6 +53,7 @@
  *   STREAM_SHA1_DIGEST
  *   STREAM_SHA256_DIGEST
  *   STREAM_SHA512_DIGEST
+ *   STREAM_XXH64_DIGEST
  */
 #define STREAM_NONE                         0    /* Reserved Non-Stream */
 #define STREAM_UNIX_ATTRIBUTES              1    /* Generic Unix attributes */
@@ -94,6 +95,7 @@
 #define STREAM_WIN32_COMPRESSED_DATA           31    /* Compressed Win32 BackupRead data */
 #define STREAM_ENCRYPTED_FILE_COMPRESSED_DATA  32    /* Encrypted, compressed data */
 #define STREAM_ENCRYPTED_WIN32_COMPRESSED_DATA 33    /* Encrypted, compressed Win32 BackupRead data */
+#define STREAM_XXH64_DIGEST                    34    /* XXH64 digest for the file (not cryptographic) */
 
 /**
  * Additional Stream definitions. Once defined these must NEVER
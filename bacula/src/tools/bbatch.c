@@ -57,6 +57,7 @@ static const char *db_name = "bacula";
 static const char *db_user = "bacula";
 static const char *db_password = "";
 static const char *db_host = NULL;
+static uint32_t batch_size = 0;
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -67,7 +68,9 @@ PROG_COPYRIGHT
 "\nVersion: %s (%s)\n"
 "Example : bbatch -w /path/to/workdir -h localhost -f dat1 -f dat -f datx\n"
 " will start 3 thread and load dat1, dat and datx in your catalog\n"
-"See bbatch.c to generate datafile\n\n"
+"See bbatch.c to generate datafile\n"
+"Each thread reports the number of rows inserted per second by the\n"
+"database backend, to compare backends and batch sizes.\n\n"
 "Usage: bbatch [ options ] -w working/dir -f datafile\n"
 "       -b                with batch mode\n"
 "       -B                without batch mode\n"
@@ -79,6 +82,7 @@ PROG_COPYRIGHT
 "       -h <host>         specify database host (default NULL)\n"
 "       -w <working>      specify working directory\n"
 "       -r <jobids>       call restore code with given jobids\n"
+"       -s <rows>         use a fixed batch size (default tuned by backend)\n"
 "       -v                verbose\n"
 "       -f <file>         specify data file\n"
 "       -?                print this message\n\n"), 2001, VERSION, BDATE);
@@ -113,11 +117,14 @@ int main (int argc, char *argv[])
 
    OSDependentInit();
 
-   while ((ch = getopt(argc, argv, "bBh:c:d:n:P:Su:vf:w:r:?")) != -1) {
+   while ((ch = getopt(argc, argv, "bBh:c:d:n:P:s:Su:vf:w:r:?")) != -1) {
       switch (ch) {
       case 'r':
          restore_list=bstrdup(optarg);
          break;
+      case 's':
+         batch_size = str_to_int64(optarg);
+         break;
       case 'B':
          disable_batch = true;
          break;
@@ -234,7 +241,7 @@ int main (int argc, char *argv[])
       pm_strcpy(bjcr->fileset_md5, "Dummy.fileset.md5");
 
       if ((db = db_init_database(NULL, NULL, db_name, db_user, db_password,
-                                 db_host, 0, NULL, false, false)) == NULL) {
+                                 db_host, 0, NULL, false, disable_batch)) == NULL) {
          Emsg0(M_ERROR_TERM, 0, _("Could not init Bacula database\n"));
       }
       if (!db_open_database(NULL, db)) {
@@ -242,8 +249,10 @@ int main (int argc, char *argv[])
       }
       Dmsg0(200, "Database opened\n");
       if (verbose) {
-         Pmsg2(000, _("Using Database: %s, User: %s\n"), db_name, db_user);
+         Pmsg3(000, _("Using Database: %s, User: %s, Backend: %s\n"), db_name,
+               db_user, db_get_type(db));
       }
+      db_set_batch_size(db, batch_size);
 
       bjcr->db = db;
 
@@ -296,7 +305,9 @@ static void *do_batch(void *jcr)
    struct ATTR_DBR ar;
    memset(&ar, 0, sizeof(ar));
    btime_t begin = get_current_btime();
+   btime_t inserted;
    char *datafile = bjcr->where;
+   uint32_t size;
 
    FILE *fd = fopen(datafile, "r");
    if (!fd) {
@@ -314,15 +325,21 @@ static void *do_batch(void *jcr)
       }
    }
    fclose(fd);
+   inserted = get_current_btime();
+   /* The batch connection is the one that did the inserts */
+   size = db_get_batch_size(bjcr->db_batch ? bjcr->db_batch : bjcr->db);
    db_write_batch_file_records(bjcr);
    btime_t end = get_current_btime();
 
    P(mutex);
    char ed1[200], ed2[200];
+   double secs = (double)MAX(end - begin, 1) / 1000000;
+   double isecs = (double)MAX(inserted - begin, 1) / 1000000;
    printf("\rbegin = %s, end = %s\n", edit_int64(begin, ed1),edit_int64(end, ed2));
-   printf("Insert time = %sms\n", edit_int64((end - begin) / 10000, ed1));
-   printf("Create %u files at %.2f/s\n", lineno,
-          (lineno / ((float)((end - begin) / 1000000))));
+   printf("Insert time = %sms\n", edit_int64((end - begin) / 1000, ed1));
+   printf("Create %u files at %.2f/s\n", lineno, lineno / secs);
+   printf("%s: %u rows inserted at %.2f rows/s, batch size %u\n",
+          db_get_type(bjcr->db), lineno, lineno / isecs, size);
    nb--;
    V(mutex);
    pthread_exit(NULL);
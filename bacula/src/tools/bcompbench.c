@@ -0,0 +1,535 @@
+/*
+   Bacula® - The Network Backup Solution
+
+   Copyright (C) 2000-2014 Free Software Foundation Europe e.V.
+
+   The main author of Bacula is Kern Sibbald, with contributions from many
+   others, a complete list can be found in the file AUTHORS.
+
+   You may use this file and others of this release according to the
+   license defined in the LICENSE file, which includes the Affero General
+   Public License, v3.0 ("AGPLv3") and some additional permissions and
+   terms pursuant to its AGPLv3 Section 7.
+
+   Bacula® is a registered trademark of Kern Sibbald.
+*/
+/*
+ * Compression benchmark
+ *
+ *  Read the files of a sample directory in blocks of the File
+ *  daemon read size, then compress and uncompress every block
+ *  independently with each codec, the same way the File daemon
+ *  does, and report the ratio and the speed of each codec.
+ *
+ *  The codec names are the ones of the FileSet Compression option
+ *  (gzip6, lzo, lz4, zstd3, ...).
+ *
+ *  The same sample is then hashed with each file digest of the
+ *  FileSet Signature option (md5, sha1, ..., xxh64) to compare
+ *  their speed.
+ */
+
+#include "bacula.h"
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZO
+#include <lzo/lzoconf.h>
+#include <lzo/lzo1x.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+/* The default set of codecs */
+static const char *default_codecs = "gzip1,gzip6,gzip9,lzo,lz4,zstd1,zstd3,zstd9,zstd19";
+
+/* The default set of digests */
+static const char *default_digests = "md5,sha1,sha256,sha512,xxh64";
+
+static int32_t block_size = DEFAULT_NETWORK_BUFFER_SIZE;
+static uint64_t max_bytes = 256 * 1024 * 1024;
+
+/* The sample, read in memory so that the disk is not measured */
+static char **blocks = NULL;
+static uint32_t *lens = NULL;
+static int nblocks = 0;
+static int max_blocks = 0;
+static uint64_t sample_bytes = 0;
+static int nfiles = 0;
+
+static void usage()
+{
+   fprintf(stderr, _(
+PROG_COPYRIGHT
+"\nVersion: %s (%s)\n\n"
+"Usage: bcompbench [-b block-size] [-m max-MB] [-c codecs] [-s digests] <directory>\n"
+"       -b <size>   size of the blocks, default %d\n"
+"       -m <MB>     read at most MB of the directory, default %d\n"
+"       -c <list>   comma separated list of codecs, default\n"
+"                   %s\n"
+"       -s <list>   comma separated list of digests, default\n"
+"                   %s\n"
+"       -d <nn>     set debug level to <nn>\n"
+"       -?          print this message.\n"
+"\n"), 2000, VERSION, BDATE, DEFAULT_NETWORK_BUFFER_SIZE,
+      (int)(max_bytes / (1024 * 1024)), default_codecs, default_digests);
+   exit(1);
+}
+
+/*
+ * Read one file in blocks of block_size
+ */
+static void load_file(const char *fname)
+{
+   int fd;
+   ssize_t len;
+
+   if ((fd = open(fname, O_RDONLY | O_BINARY)) < 0) {
+      berrno be;
+      Pmsg2(0, _("Cannot open %s: ERR=%s\n"), fname, be.bstrerror());
+      return;
+   }
+   nfiles++;
+   while (sample_bytes < max_bytes) {
+      if (nblocks == max_blocks) {
+         max_blocks = max_blocks ? 2 * max_blocks : 1024;
+         blocks = (char **)realloc(blocks, max_blocks * sizeof(char *));
+         lens = (uint32_t *)realloc(lens, max_blocks * sizeof(uint32_t));
+      }
+      blocks[nblocks] = (char *)malloc(block_size);
+      if ((len = read(fd, blocks[nblocks], block_size)) <= 0) {
+         free(blocks[nblocks]);
+         break;
+      }
+      lens[nblocks++] = len;
+      sample_bytes += len;
+   }
+   close(fd);
+}
+
+/*
+ * Walk the directory and load its regular files
+ */
+static void load_dir(const char *dname)
+{
+   DIR *dp;
+   struct dirent *entry;
+   struct stat statp;
+   POOL_MEM fname;
+
+   if (!(dp = opendir(dname))) {
+      berrno be;
+      Pmsg2(0, _("Cannot open directory %s: ERR=%s\n"), dname, be.bstrerror());
+      return;
+   }
+   while (sample_bytes < max_bytes && (entry = readdir(dp)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+         continue;
+      }
+      Mmsg(fname, "%s/%s", dname, entry->d_name);
+      if (lstat(fname.c_str(), &statp) < 0) {
+         continue;
+      }
+      if (S_ISDIR(statp.st_mode)) {
+         load_dir(fname.c_str());
+      } else if (S_ISREG(statp.st_mode)) {
+         load_file(fname.c_str());
+      }
+   }
+   closedir(dp);
+}
+
+/*
+ * Compress or uncompress one block with the codec.
+ *  Returns: the output length, or -1 on error
+ */
+static int32_t codec_compress(const char *codec, int level, void *ctx,
+                              const char *in, uint32_t len, char *out, uint32_t out_size)
+{
+#ifdef HAVE_LIBZ
+   if (strcmp(codec, "gzip") == 0) {
+      z_stream *strm = (z_stream *)ctx;
+      int32_t clen;
+      strm->next_in = (Bytef *)in;
+      strm->avail_in = len;
+      strm->next_out = (Bytef *)out;
+      strm->avail_out = out_size;
+      if (deflate(strm, Z_FINISH) != Z_STREAM_END) {
+         return -1;
+      }
+      clen = strm->total_out;
+      deflateReset(strm);
+      return clen;
+   }
+#endif
+#ifdef HAVE_LZO
+   if (strcmp(codec, "lzo") == 0) {
+      lzo_uint clen;
+      if (lzo1x_1_compress((const unsigned char *)in, len, (unsigned char *)out,
+                           &clen, ctx) != LZO_E_OK) {
+         return -1;
+      }
+      return clen;
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (strcmp(codec, "zstd") == 0) {
+      size_t clen = ZSTD_compressCCtx((ZSTD_CCtx *)ctx, out, out_size, in, len, level);
+      return ZSTD_isError(clen) ? -1 : (int32_t)clen;
+   }
+#endif
+#ifdef HAVE_LZ4
+   if (strcmp(codec, "lz4") == 0) {
+      int clen = LZ4_compress_default(in, out, len, out_size);
+      return clen > 0 ? clen : -1;
+   }
+#endif
+   return -1;
+}
+
+static int32_t codec_uncompress(const char *codec, void *ctx, const char *in,
+                                uint32_t len, char *out, uint32_t out_size)
+{
+#ifdef HAVE_LIBZ
+   if (strcmp(codec, "gzip") == 0) {
+      uLong ulen = out_size;
+      if (uncompress((Byte *)out, &ulen, (const Byte *)in, len) != Z_OK) {
+         return -1;
+      }
+      return ulen;
+   }
+#endif
+#ifdef HAVE_LZO
+   if (strcmp(codec, "lzo") == 0) {
+      lzo_uint ulen = out_size;
+      if (lzo1x_decompress_safe((const unsigned char *)in, len, (unsigned char *)out,
+                                &ulen, NULL) != LZO_E_OK) {
+         return -1;
+      }
+      return ulen;
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (strcmp(codec, "zstd") == 0) {
+      size_t ulen = ZSTD_decompressDCtx((ZSTD_DCtx *)ctx, out, out_size, in, len);
+      return ZSTD_isError(ulen) ? -1 : (int32_t)ulen;
+   }
+#endif
+#ifdef HAVE_LZ4
+   if (strcmp(codec, "lz4") == 0) {
+      int ulen = LZ4_decompress_safe(in, out, len, out_size);
+      return ulen >= 0 ? ulen : -1;
+   }
+#endif
+   return -1;
+}
+
+/* MB/s of bytes processed in usecs */
+static double mb_per_sec(uint64_t bytes, btime_t usecs)
+{
+   if (usecs <= 0) {
+      usecs = 1;
+   }
+   return (double)bytes / (double)usecs;      /* bytes/usec == MB/s */
+}
+
+/*
+ * Run one codec over the sample and print its line.
+ *  name is gzip<n>, lzo, lz4 or zstd<n>
+ */
+static void bench_codec(const char *name)
+{
+   char codec[20];
+   int level = 0;
+   void *cctx = NULL, *dctx = NULL;
+   char **cblocks;
+   uint32_t *clens;
+   char *ubuf;
+   uint32_t csize;
+   uint64_t cbytes = 0;
+   btime_t start, comp_time, dec_time;
+   int i, ncblocks;
+   int32_t len;
+   bool supported = false;
+   bool ok = true;
+
+   /* gzip and zstd take the level after the name */
+   bstrncpy(codec, name, sizeof(codec));
+   if (strncmp(codec, "gzip", 4) == 0 || strncmp(codec, "zstd", 4) == 0) {
+      level = str_to_int64(codec + 4);
+      codec[4] = 0;
+   }
+
+   /* The compression contexts, initialized once like in the FD */
+#ifdef HAVE_LIBZ
+   if (strcmp(codec, "gzip") == 0) {
+      z_stream *strm = (z_stream *)malloc(sizeof(z_stream));
+      memset(strm, 0, sizeof(z_stream));
+      if (deflateInit(strm, level ? level : Z_DEFAULT_COMPRESSION) == Z_OK) {
+         cctx = strm;
+         supported = true;
+      } else {
+         free(strm);
+      }
+   }
+#endif
+#ifdef HAVE_LZO
+   if (strcmp(codec, "lzo") == 0 && lzo_init() == LZO_E_OK) {
+      cctx = malloc(LZO1X_1_MEM_COMPRESS);
+      supported = true;
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (strcmp(codec, "zstd") == 0) {
+      if (level == 0) {
+         level = ZSTD_CLEVEL_DEFAULT;
+      }
+      cctx = ZSTD_createCCtx();
+      dctx = ZSTD_createDCtx();
+      supported = cctx && dctx;
+   }
+#endif
+#ifdef HAVE_LZ4
+   if (strcmp(codec, "lz4") == 0) {
+      supported = true;               /* no context */
+   }
+#endif
+   if (!supported) {
+      printf(_("%-8s not supported\n"), name);
+#ifdef HAVE_ZSTD
+      ZSTD_freeCCtx((ZSTD_CCtx *)cctx);        /* NULL is accepted */
+      ZSTD_freeDCtx((ZSTD_DCtx *)dctx);
+#endif
+      return;
+   }
+
+   /* Same output size as the FD compression buffer */
+   csize = block_size + (block_size / 16) + 67 + 12;
+   cblocks = (char **)malloc(nblocks * sizeof(char *));
+   clens = (uint32_t *)malloc(nblocks * sizeof(uint32_t));
+   ubuf = (char *)malloc(block_size);
+
+   start = get_current_btime();
+   for (ncblocks = 0; ncblocks < nblocks; ncblocks++) {
+      cblocks[ncblocks] = (char *)malloc(csize);
+      len = codec_compress(codec, level, cctx, blocks[ncblocks], lens[ncblocks],
+                           cblocks[ncblocks], csize);
+      if (len < 0) {
+         Pmsg2(0, _("%s compression error on block %d\n"), name, ncblocks);
+         free(cblocks[ncblocks]);
+         ok = false;
+         break;
+      }
+      clens[ncblocks] = len;
+      cbytes += len;
+   }
+   comp_time = get_current_btime() - start;
+
+   start = get_current_btime();
+   for (i = 0; i < ncblocks && ok; i++) {
+      len = codec_uncompress(codec, dctx, cblocks[i], clens[i], ubuf, block_size);
+      if (len != (int32_t)lens[i] || memcmp(ubuf, blocks[i], len) != 0) {
+         Pmsg2(0, _("%s uncompression error on block %d\n"), name, i);
+         ok = false;
+      }
+   }
+   dec_time = get_current_btime() - start;
+
+   if (ok) {
+      printf("%-8s %7.3f %6.1f%% %10.1f %10.1f\n", name,
+             cbytes ? (double)sample_bytes / (double)cbytes : 0.0,
+             sample_bytes ? 100.0 * cbytes / sample_bytes : 0.0,
+             mb_per_sec(sample_bytes, comp_time), mb_per_sec(sample_bytes, dec_time));
+   }
+
+   for (i = 0; i < ncblocks; i++) {
+      free(cblocks[i]);
+   }
+   free(cblocks);
+   free(clens);
+   free(ubuf);
+#ifdef HAVE_LIBZ
+   if (strcmp(codec, "gzip") == 0) {
+      deflateEnd((z_stream *)cctx);
+      free(cctx);
+   }
+#endif
+#ifdef HAVE_LZO
+   if (strcmp(codec, "lzo") == 0) {
+      free(cctx);
+   }
+#endif
+#ifdef HAVE_ZSTD
+   if (strcmp(codec, "zstd") == 0) {
+      ZSTD_freeCCtx((ZSTD_CCtx *)cctx);
+      ZSTD_freeDCtx((ZSTD_DCtx *)dctx);
+   }
+#endif
+}
+
+/*
+ * Hash the sample with one digest and print its line.
+ *  name is md5, sha1, sha256, sha512 or xxh64
+ */
+static void bench_digest(const char *name)
+{
+   static const struct {
+      const char *name;
+      crypto_digest_t type;
+   } digests[] = {
+      {"md5",    CRYPTO_DIGEST_MD5},
+      {"sha1",   CRYPTO_DIGEST_SHA1},
+      {"sha256", CRYPTO_DIGEST_SHA256},
+      {"sha512", CRYPTO_DIGEST_SHA512},
+      {"xxh64",  CRYPTO_DIGEST_XXH64},
+      {NULL,     CRYPTO_DIGEST_NONE}
+   };
+   crypto_digest_t type = CRYPTO_DIGEST_NONE;
+   DIGEST *digest = NULL;
+   uint8_t md[CRYPTO_DIGEST_MAX_SIZE];
+   uint32_t size = sizeof(md);
+   btime_t start, hash_time;
+   bool ok = true;
+   int i;
+
+   for (i = 0; digests[i].name; i++) {
+      if (strcasecmp(name, digests[i].name) == 0) {
+         type = digests[i].type;
+         break;
+      }
+   }
+   if (type != CRYPTO_DIGEST_NONE) {
+      digest = crypto_digest_new(NULL, type);
+   }
+   if (!digest) {
+      printf(_("%-8s not supported\n"), name);
+      return;
+   }
+
+   start = get_current_btime();
+   for (i = 0; i < nblocks && ok; i++) {
+      ok = crypto_digest_update(digest, (uint8_t *)blocks[i], lens[i]);
+   }
+   ok = ok && crypto_digest_finalize(digest, md, &size);
+   hash_time = get_current_btime() - start;
+
+   if (ok) {
+      printf("%-8s %5d %10.1f\n", name, size * 8, mb_per_sec(sample_bytes, hash_time));
+   } else {
+      Pmsg1(0, _("%s digest error\n"), name);
+   }
+   crypto_digest_free(digest);
+}
+
+int main(int argc, char *argv[])
+{
+   const char *codecs = default_codecs;
+   const char *digests = default_digests;
+   char *list, *name, *p;
+   char ed1[50];
+   int ch, i;
+
+   setlocale(LC_ALL, "");
+   bindtextdomain("bacula", LOCALEDIR);
+   textdomain("bacula");
+   init_stack_dump();
+   my_name_is(argc, argv, "bcompbench");
+   init_msg(NULL, NULL);
+
+   while ((ch = getopt(argc, argv, "b:c:d:m:s:?")) != -1) {
+      switch (ch) {
+      case 'b':
+         block_size = atoi(optarg);
+         if (block_size < 512) {
+            block_size = 512;
+         }
+         break;
+
+      case 'c':
+         codecs = optarg;
+         break;
+
+      case 'd':                       /* set debug level */
+         debug_level = atoi(optarg);
+         if (debug_level <= 0) {
+            debug_level = 1;
+         }
+         break;
+
+      case 'm':
+         max_bytes = (uint64_t)str_to_int64(optarg) * 1024 * 1024;
+         break;
+
+      case 's':
+         digests = optarg;
+         break;
+
+      case '?':
+      default:
+         usage();
+
+      }
+   }
+   argc -= optind;
+   argv += optind;
+
+   if (argc != 1) {
+      Pmsg0(0, _("A sample directory must be specified.\n"));
+      usage();
+   }
+
+   OSDependentInit();
+   if (init_crypto() != 0) {
+      Emsg0(M_ERROR_TERM, 0, _("Cryptography library initialization failed.\n"));
+   }
+
+   load_dir(argv[0]);
+   if (nblocks == 0) {
+      Pmsg1(0, _("No data found in %s\n"), argv[0]);
+      exit(1);
+   }
+   printf(_("%d files, %s bytes in %d blocks of %d bytes\n\n"), nfiles,
+          edit_uint64_with_commas(sample_bytes, ed1), nblocks, block_size);
+   printf("%-8s %7s %7s %10s %10s\n", _("Codec"), _("Ratio"), _("Size"),
+          _("Comp MB/s"), _("Dec MB/s"));
+
+   list = bstrdup(codecs);
+   for (p = list; (name = p) != NULL; ) {
+      if ((p = strchr(p, ',')) != NULL) {
+         *p++ = 0;
+      }
+      if (*name) {
+         bench_codec(name);
+      }
+   }
+   free(list);
+
+   printf("\n%-8s %5s %10s\n", _("Digest"), _("Bits"), _("MB/s"));
+   list = bstrdup(digests);
+   for (p = list; (name = p) != NULL; ) {
+      if ((p = strchr(p, ',')) != NULL) {
+         *p++ = 0;
+      }
+      if (*name) {
+         bench_digest(name);
+      }
+   }
+   free(list);
+
+   for (i = 0; i < nblocks; i++) {
+      free(blocks[i]);
+   }
+   free(blocks);
+   free(lens);
+   cleanup_crypto();
+   term_msg();
+   exit(0);
+}
@@ -42,6 +42,9 @@ static int max_path_len = 0;
 static int trunc_fname = 0;
 static int trunc_path = 0;
 static int attrs = 0;
+static int scan_threads = 0;
+static bool bench = false;
+static uint64_t num_entries = 0;
 static CONFIG *config;
 
 static JCR *jcr;
@@ -50,6 +53,7 @@ static int print_file(JCR *jcr, FF_PKT *ff, bool);
 static void count_files(FF_PKT *ff);
 static bool copy_fileset(FF_PKT *ff, JCR *jcr);
 static void set_options(findFOPTS *fo, const char *opts);
+static void run_bench(FF_PKT *ff, int nthreads);
 
 static void usage()
 {
@@ -57,10 +61,12 @@ static void usage()
 "\n"
 "Usage: testfind [-d debug_level] [-] [pattern1 ...]\n"
 "       -a          print extended attributes (Win32 debug)\n"
+"       -b          benchmark the walk, serial then with -j threads\n"
 "       -d <nn>     set debug level to <nn>\n"
 "       -dt         print timestamp in debug output\n"
 "       -c          specify config file containing FileSet resources\n"
 "       -f          specify which FileSet to use\n"
+"       -j <nn>     read the directories with <nn> scan threads\n"
 "       -?          print this message.\n"
 "\n"
 "Patterns are used for file inclusion -- normally directories.\n"
@@ -69,6 +75,8 @@ static void usage()
 "Errors are always printed.\n"
 "Files/paths truncated is the number of files/paths with len > 255.\n"
 "Truncation is only in the catalog.\n"
+"With -b, run it twice on the same tree so that both walks\n"
+"see the same (cold or warm) metadata cache.\n"
 "\n"));
 
    exit(1);
@@ -90,12 +98,16 @@ main (int argc, char *const *argv)
    textdomain("bacula");
    lmgr_init_thread();
 
-   while ((ch = getopt(argc, argv, "ac:d:f:?")) != -1) {
+   while ((ch = getopt(argc, argv, "abc:d:f:j:?")) != -1) {
       switch (ch) {
          case 'a':                    /* print extended attributes *debug* */
             attrs = 1;
             break;
 
+         case 'b':                    /* benchmark serial vs scan threads */
+            bench = true;
+            break;
+
          case 'c':                    /* set debug level */
             configfile = optarg;
             break;
@@ -115,6 +127,13 @@ main (int argc, char *const *argv)
             fileset_name = optarg;
             break;
 
+         case 'j':                    /* directory scan threads */
+            scan_threads = atoi(optarg);
+            if (scan_threads < 0) {
+               scan_threads = 0;
+            }
+            break;
+
          case '?':
          default:
             usage();
@@ -156,7 +175,13 @@ main (int argc, char *const *argv)
 
    copy_fileset(ff, jcr);
 
-   find_files(jcr, ff, print_file, NULL);
+   if (bench) {
+      run_bench(ff, 0);
+      run_bench(ff, scan_threads > 0 ? scan_threads : 4);
+   } else {
+      set_find_scan_threads(ff, scan_threads);
+      find_files(jcr, ff, print_file, NULL);
+   }
 
    free_jcr(jcr);
    if (config) {
@@ -239,8 +264,33 @@ main (int argc, char *const *argv)
    exit(0);
 }
 
+/*
+ * Walk the FileSet and report the number of entries per second
+ */
+static void run_bench(FF_PKT *ff, int nthreads)
+{
+   btime_t start, end;
+   double secs;
+
+   term_find_one(ff);                 /* forget the hard links of the previous run */
+   num_files = 0;
+   num_entries = 0;
+   set_find_scan_threads(ff, nthreads);
+
+   start = get_current_btime();
+   find_files(jcr, ff, print_file, NULL);
+   end = get_current_btime();
+
+   secs = (end - start) / 1000000.0;
+   printf(_("%-8s threads=%d entries=%llu secs=%.3f entries/sec=%.0f\n"),
+          nthreads ? _("Parallel") : _("Serial"), nthreads,
+          (unsigned long long)num_entries, secs,
+          secs > 0 ? num_entries / secs : 0.0);
+}
+
 static int print_file(JCR *jcr, FF_PKT *ff, bool top_level)
 {
+   num_entries++;
 
    switch (ff->type) {
    case FT_LNKSAVED:
@@ -445,7 +495,7 @@ static bool copy_fileset(FF_PKT *ff, JCR *jcr)
             fileset->incexe = (findINCEXE *)malloc(sizeof(findINCEXE));
             memset(fileset->incexe, 0, sizeof(findINCEXE));
             fileset->incexe->opts_list.init(1, true);
-            fileset->incexe->name_list.init(0, 0);
+            fileset->incexe->name_list.init(); /* dlist of dlistString */
             fileset->include_list.append(fileset->incexe);
          } else {
             ie = jcr_fileset->exclude_items[i];
@@ -454,7 +504,7 @@ static bool copy_fileset(FF_PKT *ff, JCR *jcr)
             fileset->incexe = (findINCEXE *)malloc(sizeof(findINCEXE));
             memset(fileset->incexe, 0, sizeof(findINCEXE));
             fileset->incexe->opts_list.init(1, true);
-            fileset->incexe->name_list.init(0, 0);
+            fileset->incexe->name_list.init(); /* dlist of dlistString */
             fileset->exclude_list.append(fileset->incexe);
          }
 
@@ -511,7 +561,7 @@ static bool copy_fileset(FF_PKT *ff, JCR *jcr)
          }
 
          for (j=0; j<ie->name_list.size(); j++) {
-            fileset->incexe->name_list.append(bstrdup((const char *)ie->name_list.get(j)));
+            fileset->incexe->name_list.append(new_dlistString((const char *)ie->name_list.get(j)));
          }
       }
 
@@ -584,6 +634,10 @@ static void set_options(findFOPTS *fo, const char *opts)
             p++;
             break;
 #endif
+         case '4':
+            fo->flags |= FO_XXH64;
+            p++;
+            break;
          default:
             /* Automatically downgrade to SHA-1 if an unsupported
              * SHA variant is specified */
@@ -632,6 +686,20 @@ static void set_options(findFOPTS *fo, const char *opts)
             fo->Compress_algo = COMPRESS_LZO1X;
             fo->Compress_level = 1; /* not used with LZO */
          }
+         else if (*p == 'l') {
+            fo->flags |= FO_COMPRESS;
+            fo->Compress_algo = COMPRESS_LZ4;
+            fo->Compress_level = 1; /* not used with LZ4 */
+         }
+         else if (*p == 'z') {
+            fo->flags |= FO_COMPRESS;
+            fo->Compress_algo = COMPRESS_ZSTD;
+            fo->Compress_level = 0;
+            while (B_ISDIGIT(p[1])) {
+               p++;
+               fo->Compress_level = fo->Compress_level * 10 + *p - '0';
+            }
+         }
          Dmsg2(200, "Compression alg=%d level=%d\n", fo->Compress_algo, fo->Compress_level);
          break;
       case 'X':